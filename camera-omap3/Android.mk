@@ -11,6 +11,8 @@ LOCAL_SRC_FILES:= \
     CameraHal.cpp \
     CameraHal_Utils.cpp \
     MessageQueue.cpp \
+    PPMTimeline.cpp \
+    BufferOwnership.cpp \
     
 LOCAL_SHARED_LIBRARIES:= \
     libdl \
@@ -51,7 +53,8 @@ LOCAL_SHARED_LIBRARIES += \
     libOMX_Core
 
 LOCAL_STATIC_LIBRARIES := \
-        libexifgnu
+        libexifgnu \
+        libcamera_scale_cpu
 
 endif
 
@@ -95,6 +98,37 @@ include $(BUILD_SHARED_LIBRARY)
 
 ifdef HARDWARE_OMX
 
+# CPU fallback of the VPP resize, kept apart so it's optimized even when libcamera is built with -O0
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := scale_cpu.c
+
+LOCAL_CFLAGS += -O2 -fstrict-aliasing
+
+LOCAL_ARM_MODE := arm
+
+LOCAL_MODULE := libcamera_scale_cpu
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    ScaleCpuTest.c \
+    scale_cpu.c \
+
+LOCAL_CFLAGS += -O2
+
+LOCAL_LDLIBS += -lm
+
+LOCAL_MODULE := ScaleCpuTest
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES := JpegEncoderTest.cpp
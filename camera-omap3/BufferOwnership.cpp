@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LOG_TAG "BufferOwnership"
+#include <utils/Log.h>
+#include <cutils/atomic.h>
+
+#include "BufferOwnership.h"
+
+#define OWNER_ALL ( OWNER_CAMERA | OWNER_DISPLAY | OWNER_ENCODER | OWNER_APP )
+
+static const char *slot_names[] = { "hal", "camera", "display", "encoder", "app" };
+
+BufferOwnership::BufferOwnership()
+{
+    nsecs_t start = now();
+
+    memset(mBuffers, 0, sizeof(mBuffers));
+    for ( int i = 0; i < MAX_BUFFERS; i++ ) {
+        mBuffers[i].since[SLOT_HAL] = start;
+    }
+
+    mInvalid = 0;
+}
+
+nsecs_t BufferOwnership::now()
+{
+    return systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+int BufferOwnership::slot(int32_t owner)
+{
+    switch ( owner ) {
+        case OWNER_CAMERA:
+            return SLOT_CAMERA;
+        case OWNER_DISPLAY:
+            return SLOT_DISPLAY;
+        case OWNER_ENCODER:
+            return SLOT_ENCODER;
+        case OWNER_APP:
+            return SLOT_APP;
+        default:
+            return SLOT_HAL;
+    }
+}
+
+const char *BufferOwnership::stateName(int32_t state, char *str, int size)
+{
+    int len = 0;
+
+    str[0] = '\0';
+    if ( 0 == state ) {
+        snprintf(str, size, "%s", slot_names[SLOT_HAL]);
+        return str;
+    }
+
+    for ( int32_t owner = OWNER_CAMERA; owner <= OWNER_APP; owner <<= 1 ) {
+        if ( ( state & owner ) && ( len < size ) ) {
+            len += snprintf(str + len, size - len, "%s%s", len ? "+" : "", slot_names[slot(owner)]);
+        }
+    }
+
+    return str;
+}
+
+void BufferOwnership::account(Buffer *buffer, int slot, nsecs_t now)
+{
+    int32_t held = (int32_t) ns2ms(now - buffer->since[slot]);
+
+    android_atomic_add(held, &buffer->total[slot]);
+    if ( held > buffer->longest[slot] )
+        buffer->longest[slot] = held;
+}
+
+bool BufferOwnership::transition(int index, int32_t clear, int32_t set, int32_t forbidden, int line)
+{
+    Buffer *buffer;
+    int32_t state, next;
+    nsecs_t time;
+    char held[32], owner[16];
+
+    if ( ( 0 > index ) || ( MAX_BUFFERS <= index ) ) {
+        LOGE("Invalid buffer index %d, line=%d", index, line);
+        return false;
+    }
+
+    buffer = &mBuffers[index];
+
+    do {
+        state = buffer->state;
+
+        if ( ( state & forbidden ) || ( ( state & clear ) != clear ) ) {
+            android_atomic_inc(&mInvalid);
+            LOGE("Invalid transition of buffer#%d held by %s: %s %s, line=%d",
+                 index, stateName(state, held, sizeof(held)),
+                 set ? "acquire by" : "release by", stateName(set | clear, owner, sizeof(owner)), line);
+            return false;
+        }
+
+        next = ( state & ~clear ) | set;
+    } while ( android_atomic_cmpxchg(state, next, &buffer->state) );
+
+    // The owner bits are exclusive, nobody else touches the bookkeeping of this transition
+    time = now();
+    if ( clear )
+        account(buffer, slot(clear), time);
+    if ( 0 == state )
+        account(buffer, SLOT_HAL, time);
+    if ( set )
+        buffer->since[slot(set)] = time;
+    if ( 0 == next )
+        buffer->since[SLOT_HAL] = time;
+
+    android_atomic_inc(&buffer->transitions);
+
+    return true;
+}
+
+bool BufferOwnership::acquire(int index, Owner owner, int line)
+{
+    int32_t forbidden;
+
+    switch ( owner ) {
+        case OWNER_CAMERA:
+            // The driver fills the buffer, nobody else may look at it meanwhile
+            forbidden = OWNER_ALL;
+            break;
+        case OWNER_DISPLAY:
+        case OWNER_ENCODER:
+            // Both only read the frame, they can share it
+            forbidden = OWNER_CAMERA | OWNER_APP | owner;
+            break;
+        case OWNER_APP:
+        default:
+            forbidden = OWNER_CAMERA | owner;
+            break;
+    }
+
+    return transition(index, 0, owner, forbidden, line);
+}
+
+bool BufferOwnership::release(int index, Owner owner, int line)
+{
+    return transition(index, owner, 0, 0, line);
+}
+
+void BufferOwnership::reset(int index)
+{
+    Buffer *buffer;
+    int32_t state;
+    nsecs_t time;
+
+    if ( ( 0 > index ) || ( MAX_BUFFERS <= index ) )
+        return;
+
+    buffer = &mBuffers[index];
+
+    do {
+        state = buffer->state;
+    } while ( android_atomic_cmpxchg(state, 0, &buffer->state) );
+
+    if ( 0 == state )
+        return;
+
+    time = now();
+    for ( int32_t owner = OWNER_CAMERA; owner <= OWNER_APP; owner <<= 1 ) {
+        if ( state & owner )
+            account(buffer, slot(owner), time);
+    }
+    buffer->since[SLOT_HAL] = time;
+}
+
+bool BufferOwnership::holds(int index, Owner owner) const
+{
+    if ( ( 0 > index ) || ( MAX_BUFFERS <= index ) )
+        return false;
+
+    return ( mBuffers[index].state & owner ) != 0;
+}
+
+bool BufferOwnership::isIdle(int index) const
+{
+    if ( ( 0 > index ) || ( MAX_BUFFERS <= index ) )
+        return false;
+
+    return 0 == mBuffers[index].state;
+}
+
+int BufferOwnership::count(Owner owner) const
+{
+    int held = 0;
+
+    for ( int i = 0; i < MAX_BUFFERS; i++ ) {
+        if ( mBuffers[i].state & owner )
+            held++;
+    }
+
+    return held;
+}
+
+int BufferOwnership::format(char *str, int size, int index) const
+{
+    const Buffer *buffer = &mBuffers[index];
+    int32_t state = buffer->state;
+    nsecs_t time = now();
+    int32_t age = 0;
+    char held[32];
+    int len;
+
+    // Age of the oldest current owner, a stuck buffer shows up here
+    for ( int s = SLOT_HAL; s < SLOT_COUNT; s++ ) {
+        bool current = ( SLOT_HAL == s ) ? ( 0 == state ) : ( ( state >> ( s - 1 ) ) & 1 );
+        if ( current && ( ns2ms(time - buffer->since[s]) > age ) )
+            age = (int32_t) ns2ms(time - buffer->since[s]);
+    }
+
+    len = snprintf(str, size, "buffer#%d %s for %d ms, %d transitions, total/longest ms:",
+                   index, stateName(state, held, sizeof(held)), age, buffer->transitions);
+
+    for ( int s = SLOT_HAL; ( s < SLOT_COUNT ) && ( len < size ); s++ ) {
+        len += snprintf(str + len, size - len, " %s %d/%d", slot_names[s], buffer->total[s], buffer->longest[s]);
+    }
+
+    if ( len >= size )
+        len = size - 1;
+
+    return len;
+}
+
+void BufferOwnership::dump(int fd, int bufferCount) const
+{
+    char line[256];
+    int len;
+
+    if ( bufferCount > MAX_BUFFERS )
+        bufferCount = MAX_BUFFERS;
+
+    len = snprintf(line, sizeof(line), "Buffers held: camera %d, display %d, encoder %d, app %d. %d invalid transitions\n",
+                   count(OWNER_CAMERA), count(OWNER_DISPLAY), count(OWNER_ENCODER), count(OWNER_APP), mInvalid);
+    write(fd, line, len);
+
+    for ( int i = 0; i < bufferCount; i++ ) {
+        len = format(line, sizeof(line) - 1, i);
+        line[len++] = '\n';
+        write(fd, line, len);
+    }
+}
+
+void BufferOwnership::log(int bufferCount) const
+{
+    char line[256];
+
+    if ( bufferCount > MAX_BUFFERS )
+        bufferCount = MAX_BUFFERS;
+
+    LOGE("Buffers held: camera %d, display %d, encoder %d, app %d. %d invalid transitions",
+         count(OWNER_CAMERA), count(OWNER_DISPLAY), count(OWNER_ENCODER), count(OWNER_APP), mInvalid);
+
+    for ( int i = 0; i < bufferCount; i++ ) {
+        format(line, sizeof(line), i);
+        LOGE("%s", line);
+    }
+}
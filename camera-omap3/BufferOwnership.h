@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __BUFFEROWNERSHIP_H__
+#define __BUFFEROWNERSHIP_H__
+
+#include <stdint.h>
+#include <utils/Timers.h>
+
+/*
+ * Ownership of the preview/video buffers shared by the camera driver, the
+ * display (DSS), the video encoder and the preview callback. A buffer nobody
+ * else holds belongs to the HAL. Display and encoder may hold a buffer at the
+ * same time, the camera and the app only get it exclusively.
+ *
+ * The state of a buffer is a set of owner bits changed with compare and swap,
+ * a transition the state doesn't allow is refused, logged and counted. Time
+ * spent with each owner is accumulated per buffer for dump().
+ */
+class BufferOwnership
+{
+public:
+    enum {
+        MAX_BUFFERS = 16,
+    };
+
+    enum Owner {
+        OWNER_CAMERA    = 1,
+        OWNER_DISPLAY   = 1 << 1,
+        OWNER_ENCODER   = 1 << 2,
+        OWNER_APP       = 1 << 3,
+    };
+
+    BufferOwnership();
+
+    // Hands the buffer to owner, line identifies the caller in the error log
+    bool acquire(int index, Owner owner, int line);
+    // Gives the buffer back, owner has to be holding it
+    bool release(int index, Owner owner, int line);
+    // Returns the buffer to the HAL whoever holds it, e.g. when the overlay goes away
+    void reset(int index);
+
+    bool holds(int index, Owner owner) const;
+    bool isIdle(int index) const;
+    // Number of buffers currently held by owner
+    int count(Owner owner) const;
+
+    void dump(int fd, int bufferCount) const;
+    void log(int bufferCount) const;
+
+private:
+    enum {
+        SLOT_HAL = 0,
+        SLOT_CAMERA,
+        SLOT_DISPLAY,
+        SLOT_ENCODER,
+        SLOT_APP,
+        SLOT_COUNT,
+    };
+
+    struct Buffer {
+        volatile int32_t state;
+        // Written by the thread which made the transition only
+        nsecs_t since[SLOT_COUNT];          // when the owner got the buffer
+        volatile int32_t total[SLOT_COUNT]; // ms spent with each owner
+        volatile int32_t longest[SLOT_COUNT];
+        volatile int32_t transitions;
+    };
+
+    bool transition(int index, int32_t clear, int32_t set, int32_t forbidden, int line);
+    void account(Buffer *buffer, int slot, nsecs_t now);
+    int format(char *str, int size, int index) const;
+
+    static int slot(int32_t owner);
+    static const char *stateName(int32_t state, char *str, int size);
+    static nsecs_t now();
+
+    Buffer mBuffers[MAX_BUFFERS];
+    volatile int32_t mInvalid;
+};
+
+#endif
@@ -144,10 +144,15 @@ CameraHal::CameraHal(int cameraId)
     mCallbackCookie = 0;
     mMsgEnabled = 0 ;
     mFalsePreview = false;  //Eclair HAL
-    mZoomSpeed = 1;
     mZoomTargetIdx = 0;
     mZoomCurrentIdx = 0;
-    mSmoothZoomStatus = SMOOTH_STOP;
+    mZoomStartIdx = 0;
+    mZoomStartTime = 0;
+    mZoomDuration = 0;
+    mZoomSmooth = false;
+    mZoomStopPending = false;
+    mZoomEnabled = false;
+    mZoomExit = false;
     rotation = 0;
 
 #ifdef HARDWARE_OMX
@@ -169,7 +174,6 @@ CameraHal::CameraHal(int cameraId)
     int i = 0;
     for(i = 0; i < VIDEO_FRAME_COUNT_MAX; i++) {
         mVideoBuffer[i] = 0;
-        mVideoBufferStatus[i] = BUFF_IDLE;
     }
 
     for (i = 0; i < MAX_BURST; i++) {
@@ -177,6 +181,18 @@ CameraHal::CameraHal(int cameraId)
         mYuvBufferLen[i] = 0;
     }
 
+    mYuvArena = NULL;
+    mYuvArenaSize = 0;
+    mYuvSlotLen = 0;
+    mYuvSlotCount = 0;
+
+    mShotHead = 0;
+    mShotsInFlight = 0;
+    mShotsQueued = 0;
+    mShotIndex = 0;
+    mLastShotDelivery.tv_sec = 0;
+    mLastShotDelivery.tv_usec = 0;
+
     CameraCreate();
 
     initDefaultParameters();
@@ -214,10 +230,26 @@ CameraHal::CameraHal(int cameraId)
         LOGE("Failed creating pipe");
     }
 
+    if( pipe(encodePipe) != 0 ){
+        LOGE("Failed creating pipe");
+    }
+
+    if( pipe(deliveryPipe) != 0 ){
+        LOGE("Failed creating pipe");
+    }
+
     mPROCThread = new PROCThread(this);
     mPROCThread->run("CameraPROCThread", PRIORITY_URGENT_DISPLAY);
     LOGD("STARTING PROC THREAD \n");
 
+    mEncodeThread = new EncodeThread(this);
+    mEncodeThread->run("CameraEncodeThread", PRIORITY_URGENT_DISPLAY);
+    LOGD("STARTING Encode THREAD \n");
+
+    mDeliveryThread = new DeliveryThread(this);
+    mDeliveryThread->run("CameraDeliveryThread", PRIORITY_URGENT_DISPLAY);
+    LOGD("STARTING Delivery THREAD \n");
+
     mShutterThread = new ShutterThread(this);
     mShutterThread->run("CameraShutterThread", PRIORITY_URGENT_DISPLAY);
     LOGD("STARTING Shutter THREAD \n");
@@ -230,6 +262,10 @@ CameraHal::CameraHal(int cameraId)
     mSnapshotThread->run("CameraSnapshotThread", PRIORITY_URGENT_DISPLAY);
     LOGD("STARTING Snapshot THREAD \n");
 
+    mZoomThread = new ZoomThread(this);
+    mZoomThread->run("CameraZoomThread", PRIORITY_URGENT_DISPLAY);
+    LOGD("STARTING Zoom THREAD \n");
+
     char value[PROPERTY_VALUE_MAX];
     property_get("debug.image.showfps", value, "0");
     mDebugFps = atoi(value);
@@ -495,6 +531,8 @@ CameraHal::~CameraHal()
     int err = 0;
     int procMessage [1];
     sp<PROCThread> procThread;
+    sp<EncodeThread> encodeThread;
+    sp<DeliveryThread> deliveryThread;
     sp<RawThread> rawThread;
     sp<ShutterThread> shutterThread;
     sp<SnapshotThread> snapshotThread;
@@ -526,6 +564,28 @@ CameraHal::~CameraHal()
         mPreviewThread.clear();
     }
 
+    {
+        Mutex::Autolock lock(mZoomLock);
+        mZoomExit = true;
+        mZoomCondition.signal();
+    }
+
+    sp<ZoomThread> zoomThread;
+
+    { // scope for the lock
+        Mutex::Autolock lock(mLock);
+        zoomThread = mZoomThread;
+    }
+
+    if (zoomThread != 0) {
+        zoomThread->requestExitAndWait();
+    }
+
+    { // scope for the lock
+        Mutex::Autolock lock(mLock);
+        mZoomThread.clear();
+    }
+
     procMessage[0] = PROC_THREAD_EXIT;
     write(procPipe[1], procMessage, sizeof(unsigned int));
 
@@ -546,6 +606,31 @@ CameraHal::~CameraHal()
         close(procPipe[1]);
     }
 
+    // procThread forwarded the exit request down the shot pipeline
+    { // scope for the lock
+        Mutex::Autolock lock(mLock);
+        encodeThread = mEncodeThread;
+        deliveryThread = mDeliveryThread;
+    }
+
+    if (encodeThread != 0) {
+        encodeThread->requestExitAndWait();
+    }
+
+    if (deliveryThread != 0) {
+        deliveryThread->requestExitAndWait();
+    }
+
+    { // scope for the lock
+        Mutex::Autolock lock(mLock);
+        mEncodeThread.clear();
+        mDeliveryThread.clear();
+        close(encodePipe[0]);
+        close(encodePipe[1]);
+        close(deliveryPipe[0]);
+        close(deliveryPipe[1]);
+    }
+
     procMessage[0] = SHUTTER_THREAD_EXIT;
     write(shutterPipe[1], procMessage, sizeof(unsigned int));
 
@@ -637,6 +722,17 @@ CameraHal::~CameraHal()
         mOverlay->destroy();
     }
 
+#if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
+    {
+        char path[PROPERTY_VALUE_MAX];
+
+        // debug.camera.ppm.trace=<file> saves the timeline of the session on close
+        property_get("debug.camera.ppm.trace", path, "");
+        if ( path[0] != '\0' )
+            mTimeline.exportJson(path);
+    }
+#endif
+
     singleton[mCameraIndex].clear();
 
     LOGD("<<< Release");
@@ -885,9 +981,7 @@ void CameraHal::previewThread()
                 LOGD("Receive Command: START_SMOOTH_ZOOM %d", parm);
 
                 if ( ( parm >= 0 ) && ( parm < ZOOM_STAGES) ) {
-                    mZoomTargetIdx = parm;
-                    mZoomSpeed = 1;
-                    mSmoothZoomStatus = SMOOTH_START;
+                    setZoom(parm, true);
                     msg.command = PREVIEW_ACK;
                 } else {
                     msg.command = PREVIEW_NACK;
@@ -900,10 +994,7 @@ void CameraHal::previewThread()
             case STOP_SMOOTH_ZOOM:
 
                 LOGD("Receive Command: STOP_SMOOTH_ZOOM");
-                if(mSmoothZoomStatus == SMOOTH_START)
-                {
-                    mSmoothZoomStatus = SMOOTH_NOTIFY_AND_STOP;
-                }
+                stopSmoothZoom();
                 msg.command = PREVIEW_ACK;
 
                 previewThreadAckQ.put(&msg);
@@ -1220,7 +1311,7 @@ int CameraHal::CameraDestroy(bool destroyOverlay)
             mPreviewHeaps[i].clear();
             mVideoBuffer[i].clear();
             mVideoHeaps[i].clear();
-            mVideoBufferStatus[i] = BUFF_IDLE;
+            mBufferOwnership.reset(i);
         }
         mOverlay->destroy();
         mOverlay = NULL;
@@ -1374,7 +1465,7 @@ int CameraHal::CameraStart()
         LOGD("User Buffer [%d].start = %p  length = %d\n", i,
              (void*)v4l2_cam_buffer[i].m.userptr, v4l2_cam_buffer[i].length);
 
-        if (mVideoBufferStatus[i] == BUFF_IDLE) {
+        if (mBufferOwnership.isIdle(i)) {
             if (false == queueToCamera(i))
                 goto fail_loop;
         } else {
@@ -1397,13 +1488,20 @@ int CameraHal::CameraStart()
 
     LOGE("Initial Crop: crop_top = %d, crop_left = %d, crop_width = %d, crop_height = %d", mInitialCrop.c.top, mInitialCrop.c.left, mInitialCrop.c.width, mInitialCrop.c.height);
 
-    if ( mZoomTargetIdx != mZoomCurrentIdx ) {
+    {
+        Mutex::Autolock lock(mZoomLock);
+
+        if ( mZoomTargetIdx != mZoomCurrentIdx ) {
 
-        if( ZoomPerform(zoom_step[mZoomTargetIdx]) < 0 )
-            LOGE("Error while applying zoom");
+            if( ZoomPerform(zoom_step[mZoomTargetIdx]) < 0 )
+                LOGE("Error while applying zoom");
 
-        mZoomCurrentIdx = mZoomTargetIdx;
-        mParameters.set("zoom", (int) mZoomCurrentIdx);
+            mZoomCurrentIdx = mZoomTargetIdx;
+            mParameters.set("zoom", (int) mZoomCurrentIdx);
+        }
+
+        // From now on the zoom thread owns the crop
+        mZoomEnabled = true;
     }
 
     type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -1430,6 +1528,12 @@ int CameraHal::CameraStop()
 
     nCameraBuffersQueued = 0;
 
+    // STREAMOFF hands the queued buffers back without a DQBUF
+    for (int i = 0; i < MAX_CAMERA_BUFFERS; i++) {
+        if (mBufferOwnership.holds(i, BufferOwnership::OWNER_CAMERA))
+            releaseBuffer(i, OWNER_CAMERA);
+    }
+
     struct v4l2_requestbuffers creqbuf;
     creqbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     if (ioctl(camera_device, VIDIOC_STREAMOFF, &creqbuf.type) == -1) {
@@ -1438,7 +1542,11 @@ int CameraHal::CameraStop()
     }
 
     //Force the zoom to be updated next time preview is started.
-    mZoomCurrentIdx = 0;
+    {
+        Mutex::Autolock lock(mZoomLock);
+        mZoomEnabled = false;
+        mZoomCurrentIdx = 0;
+    }
 
     LOG_FUNCTION_NAME_EXIT
 
@@ -1464,16 +1572,24 @@ static void debugShowFPS()
 
 void CameraHal::queueToOverlay(int index)
 {
+    // The DSS may scan the buffer out as soon as it is queued
+    if (!acquireBuffer(index, OWNER_DISPLAY)) {
+        debugShowBufferStatus();
+        // Don't lose it, queueToCamera() leaves it alone if somebody else still holds it
+        queueToCamera(index);
+        return;
+    }
+
     int nBuffers_queued_to_dss = mOverlay->queueBuffer((void*)index);
     if (nBuffers_queued_to_dss < 0) {
         LOGE("Failed queue buffer#%d to overlay! Queue it back to camera.", index);
+        releaseBuffer(index, OWNER_DISPLAY);
         debugShowBufferStatus();
         queueToCamera(index);
         return;
     }
 
     nOverlayBuffersQueued++;
-    mVideoBufferStatus[index] |= BUFF_Q2DSS;
 
     if (nBuffers_queued_to_dss == nOverlayBuffersQueued) {
         // No error.
@@ -1489,8 +1605,8 @@ void CameraHal::queueToOverlay(int index)
         if (k == index)
             continue;
 
-        if (mVideoBufferStatus[k] & BUFF_Q2DSS) {
-            mVideoBufferStatus[k] &= ~BUFF_Q2DSS;
+        if (mBufferOwnership.holds(k, BufferOwnership::OWNER_DISPLAY)) {
+            releaseBuffer(k, OWNER_DISPLAY);
             nOverlayBuffersQueued--;
 
             queueToCamera(k);
@@ -1509,7 +1625,7 @@ int CameraHal::dequeueFromOverlay()
     }
 
     nOverlayBuffersQueued--;
-    mVideoBufferStatus[(int)overlaybuffer] &= ~BUFF_Q2DSS;
+    releaseBuffer((int)overlaybuffer, OWNER_DISPLAY);
     lastOverlayBufferDQ = (int)overlaybuffer;
 
     return (int)overlaybuffer;
@@ -1522,14 +1638,19 @@ bool CameraHal::__queueToCamera(int index, int line)
         return false;
     }
 
-    if (mVideoBufferStatus[index] != BUFF_IDLE) {
-        LOGV("queued non-idle buffer#%d(stat=%d) to camera. line=%d",
-                index, mVideoBufferStatus[index], line);
+    // Still held by the display or the encoder, whoever releases it last queues it
+    if (!mBufferOwnership.isIdle(index)) {
+        LOGV("queued non-idle buffer#%d to camera. line=%d", index, line);
+        return false;
+    }
+
+    if (!mBufferOwnership.acquire(index, BufferOwnership::OWNER_CAMERA, line)) {
         return false;
     }
 
     if (ioctl(camera_device, VIDIOC_QBUF, &v4l2_cam_buffer[index]) < 0) {
-        LOGE("VIDIOC_QBUF Failed. buffer#%d(stat=%d), line=%d", index, mVideoBufferStatus[index],line);
+        LOGE("VIDIOC_QBUF Failed. buffer#%d, line=%d", index, line);
+        releaseBuffer(index, OWNER_CAMERA);
         return false;
     }
 
@@ -1552,7 +1673,7 @@ int CameraHal::dequeueFromCamera(nsecs_t *timestamp)
 
 
     int index = cfilledbuffer.index;
-    mVideoBufferStatus[index] &= ~BUFF_Q2DSS;
+    releaseBuffer(index, OWNER_CAMERA);
     if (NULL != timestamp) {
         *timestamp = s2ns(cfilledbuffer.timestamp.tv_sec) + us2ns(cfilledbuffer.timestamp.tv_usec);
     }
@@ -1561,51 +1682,124 @@ int CameraHal::dequeueFromCamera(nsecs_t *timestamp)
     return index;
 }
 
-void CameraHal::nextPreview()
+void CameraHal::setZoom(int index, bool smooth)
 {
-    static int frame_count = 0;
-    int zoom_inc, err;
-    struct timeval lowLightTime;
+    Mutex::Autolock lock(mZoomLock);
 
-    //Zoom
-    frame_count++;
-    if( mZoomCurrentIdx != mZoomTargetIdx){
+    // A new target restarts the animation from wherever the crop is now
+    mZoomStartIdx = mZoomCurrentIdx;
+    mZoomTargetIdx = index;
+    mZoomStartTime = systemTime();
+    mZoomDuration = smooth ? ms2ns(abs(index - mZoomCurrentIdx) * SMOOTH_ZOOM_STEP_TIME) : 0;
+    mZoomSmooth = smooth;
 
-        if( mZoomCurrentIdx < mZoomTargetIdx)
-            zoom_inc = 1;
-        else
-            zoom_inc = -1;
+    mZoomCondition.signal();
+}
 
-        if ( mZoomSpeed > 0 ){
-            if( (frame_count % mZoomSpeed) == 0){
-                mZoomCurrentIdx += zoom_inc;
-            }
-        } else {
-            mZoomCurrentIdx = mZoomTargetIdx;
+void CameraHal::stopSmoothZoom()
+{
+    Mutex::Autolock lock(mZoomLock);
+
+    if ( mZoomSmooth ) {
+        mZoomTargetIdx = mZoomCurrentIdx;
+        mZoomSmooth = false;
+        // The final callback comes from the zoom thread, after any step it is still reporting
+        mZoomStopPending = true;
+        mZoomCondition.signal();
+    }
+}
+
+/*
+ * Applies zoom changes off the preview thread. A smooth zoom follows an ease
+ * in/out curve over wall clock time, each update jumps straight to the stage
+ * due at that moment, so a slow VIDIOC_S_CROP or a low preview frame rate
+ * drops stages instead of slowing the animation down.
+ */
+void CameraHal::zoomThread()
+{
+    int index, target;
+    bool smooth;
+    nsecs_t elapsed;
+    float progress;
+
+    LOG_FUNCTION_NAME
+
+    mZoomLock.lock();
+
+    while ( !mZoomExit ) {
+
+        if ( mZoomStopPending ) {
+            mZoomStopPending = false;
+            index = mZoomCurrentIdx;
+
+            mZoomLock.unlock();
+            mNotifyCb(CAMERA_MSG_ZOOM, index, 1, mCallbackCookie);
+            mZoomLock.lock();
+
+            continue;
         }
 
-        ZoomPerform(zoom_step[mZoomCurrentIdx]);
+        if ( !mZoomEnabled || ( mZoomCurrentIdx == mZoomTargetIdx ) ) {
+            mZoomCondition.wait(mZoomLock);
+            continue;
+        }
 
-        //Avoid segfault. mParameters may be used somewhere else, e.g. in SetParameters()
-        {
-            Mutex::Autolock lock(mLock);
-            mParameters.set("zoom", mZoomCurrentIdx);
+        elapsed = systemTime() - mZoomStartTime;
+        if ( elapsed >= mZoomDuration ) {
+            index = mZoomTargetIdx;
+        } else {
+            progress = (float) elapsed / mZoomDuration;
+            progress = progress * progress * ( 3.0f - 2.0f * progress );
+            index = mZoomStartIdx + (int) floorf(( mZoomTargetIdx - mZoomStartIdx ) * progress + 0.5f);
         }
 
-        // Immediate zoom should not generate callbacks.
-        if ( mSmoothZoomStatus == SMOOTH_START ||  mSmoothZoomStatus == SMOOTH_NOTIFY_AND_STOP)  {
-            if(mSmoothZoomStatus == SMOOTH_NOTIFY_AND_STOP)
+        if ( index != mZoomCurrentIdx ) {
+
+            if( ZoomPerform(zoom_step[index]) < 0 )
+                LOGE("Error while applying zoom");
+
+            mZoomCurrentIdx = index;
+            target = mZoomTargetIdx;
+            smooth = mZoomSmooth;
+            if ( index == target ) {
+                mZoomSmooth = false;
+            }
+
+            // setParameters() takes mLock before mZoomLock
+            mZoomLock.unlock();
+
             {
-                mZoomTargetIdx = mZoomCurrentIdx;
-                mSmoothZoomStatus = SMOOTH_STOP;
+                Mutex::Autolock lock(mLock);
+                mParameters.set("zoom", index);
             }
-            if( mZoomCurrentIdx == mZoomTargetIdx )
-                mNotifyCb(CAMERA_MSG_ZOOM, mZoomCurrentIdx, 1, mCallbackCookie);
-            else
-                mNotifyCb(CAMERA_MSG_ZOOM, mZoomCurrentIdx, 0, mCallbackCookie);
+
+            // Immediate zoom should not generate callbacks.
+            if ( smooth ) {
+                mNotifyCb(CAMERA_MSG_ZOOM, index, ( index == target ) ? 1 : 0, mCallbackCookie);
+            }
+
+            mZoomLock.lock();
+        }
+
+        if ( mZoomCurrentIdx != mZoomTargetIdx ) {
+            mZoomCondition.waitRelative(mZoomLock, ms2ns(ZOOM_UPDATE_PERIOD));
         }
     }
 
+    mZoomLock.unlock();
+
+    LOG_FUNCTION_NAME_EXIT
+}
+
+void CameraHal::nextPreview()
+{
+    static int frame_count = 0;
+    int err;
+    struct timeval lowLightTime;
+
+    // Zoom is applied by zoomThread(), the frame rate doesn't matter to it
+    frame_count++;
+
 #ifdef FW3A
     if (isStart_FW3A != 0){
     //Low light notification
@@ -1652,8 +1846,11 @@ void CameraHal::nextPreview()
         return;
     }
 
-    if(msgTypeEnabled(CAMERA_MSG_PREVIEW_FRAME))
+    if(msgTypeEnabled(CAMERA_MSG_PREVIEW_FRAME)) {
+        acquireBuffer(index, OWNER_APP);
         mDataCb(CAMERA_MSG_PREVIEW_FRAME, mPreviewBuffers[index], mCallbackCookie);
+        releaseBuffer(index, OWNER_APP);
+    }
 
     mRecordingLock.lock();
     if(mRecordEnabled) {
@@ -1663,7 +1860,7 @@ void CameraHal::nextPreview()
             goto queue_and_exit;
         }
 
-        mVideoBufferStatus[index] |= BUFF_Q2VE;
+        acquireBuffer(index, OWNER_ENCODER);
         mDataCbTimestamp(timestamp, CAMERA_MSG_VIDEO_FRAME, mVideoBuffer[index], mCallbackCookie, 0, 0);
     }
 
@@ -2026,6 +2223,7 @@ int  CameraHal::ICapturePerform()
     procMessage[PROC_MSG_IDX_EXIF_BUFF] = (unsigned int) exif_buf;
 #endif
 
+    shotQueued();
     write(procPipe[1], &procMessage, sizeof(procMessage));
 
     mIPPToEnable = false; // reset ipp enable after sending to proc thread
@@ -2762,15 +2960,15 @@ void CameraHal::procThread()
     int err;
     int pixelFormat;
     unsigned int procMessage[PROC_MSG_IDX_MAX];
-    unsigned int jpegQuality, jpegSize, size, base, tmpBase, offset, yuv_len, image_rotation;
+    unsigned int shotMessage[SHOT_PIPE_NUM_ARGS];
+    unsigned int jpegQuality, yuv_len, image_rotation;
     unsigned int crop_top, crop_left, crop_width, crop_height;
     double image_zoom;
-    sp<MemoryHeapBase> JPEGPictureHeap;
-    sp<MemoryBase> JPEGPictureMemBase;
     data_callback RawPictureCallback;
     data_callback JpegPictureCallback;
-    void *yuv_buffer, *outBuffer, *PictureCallbackCookie;
+    void *yuv_buffer, *PictureCallbackCookie;
     int thumb_width, thumb_height;
+    capture_shot *shot;
 
 #ifdef HARDWARE_OMX
     exif_buffer *exif_buf;
@@ -2795,11 +2993,6 @@ void CameraHal::procThread()
     FD_ZERO(&descriptorSet);
     FD_SET(procPipe[0], &descriptorSet);
 
-    mJPEGLength  = MAX_THUMB_WIDTH*MAX_THUMB_HEIGHT + PICTURE_WIDTH*PICTURE_HEIGHT + ((2*PAGE) - 1);
-    mJPEGLength &= ~((2*PAGE) - 1);
-    mJPEGLength  += 2*PAGE;
-    JPEGPictureHeap = new MemoryHeapBase(mJPEGLength);
-
     while(1){
 
         err = select(max_fd,  &descriptorSet, NULL, NULL, NULL);
@@ -2874,20 +3067,12 @@ void CameraHal::procThread()
                 exif_buf = (exif_buffer *)procMessage[PROC_MSG_IDX_EXIF_BUFF];
 #endif
 
-                LOGD("JPEGPictureHeap->getStrongCount() = %d, base = 0x%x",
-                        JPEGPictureHeap->getStrongCount(), (unsigned int)JPEGPictureHeap->getBase());
-                jpegSize = mJPEGLength;
-
-                if(JPEGPictureHeap->getStrongCount() > 1 )
-                {
-                    JPEGPictureHeap.clear();
-                    JPEGPictureHeap = new MemoryHeapBase(jpegSize);
-                }
+                // Blocks while SHOT_PIPELINE_DEPTH shots are between IPP and delivery
+                shot = acquireShot();
 
-                base = (unsigned long) JPEGPictureHeap->getBase();
-                base = (unsigned long) NEXT_4K_ALIGN_ADDR(base);
-                offset = base - (unsigned long) JPEGPictureHeap->getBase();
-                outBuffer = (void *) base;
+#if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
+                gettimeofday(&shot->ipp_start, NULL);
+#endif
 
                 pixelFormat = PIX_YUV422I;
 
@@ -2915,6 +3100,9 @@ void CameraHal::procThread()
 
                     if(ipp_to_enable) {
 
+                         // Shots still in the pipeline may use the IPP output buffer
+                         waitForShots(1);
+
 #ifdef DEBUG_LOG
 
                          PPM("Before init IPP");
@@ -2931,6 +3119,10 @@ void CameraHal::procThread()
 
                      }
 
+                   // Out of place IPP has a single output buffer, it can't overlap with the JPEG stage
+                   if(!(pIPP.ippconfig.isINPLACE))
+                       waitForShots(1);
+
                    err = PopulateArgsIPP(capture_width, capture_height, pixelFormat, ippMode);
                     if( err )
                          LOGE("ERROR PopulateArgsIPP() failed");
@@ -2974,93 +3166,356 @@ void CameraHal::procThread()
                         input_buffer = pIPP.pIppOutputBuffer;
                         input_length = pIPP.outputBufferSize;
                     }
+
+#if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
+                    PPM("Shot %d IPP", &shot->ipp_start, shot->index);
+#endif
                }
 #endif
 
+                //workaround for thumbnail size  - it should be smaller than captured image
+                if ((image_width<thumb_width) || (image_height<thumb_width) ||
+                    (image_width<thumb_height) || (image_height<thumb_height)) {
+                     thumb_width = MIN_THUMB_WIDTH;
+                     thumb_height = MIN_THUMB_HEIGHT;
+                }
+
+                shot->burst = ( mBurstShots > 1 );
+                shot->input_buffer = input_buffer;
+                shot->input_length = input_length;
+                shot->pixelFormat = pixelFormat;
+                shot->capture_width = capture_width;
+                shot->capture_height = capture_height;
+                shot->image_width = image_width;
+                shot->image_height = image_height;
+                shot->thumb_width = thumb_width;
+                shot->thumb_height = thumb_height;
+                shot->jpegQuality = jpegQuality;
+                shot->image_rotation = image_rotation;
+                shot->image_zoom = image_zoom;
+                shot->crop_top = crop_top;
+                shot->crop_left = crop_left;
+                shot->crop_width = crop_width;
+                shot->crop_height = crop_height;
+                shot->JpegPictureCallback = JpegPictureCallback;
+                shot->PictureCallbackCookie = PictureCallbackCookie;
+
+#ifdef HARDWARE_OMX
+                shot->exif_buf = exif_buf;
+#endif
+
+                // Hand the shot over, IPP of the next shot can start right away
+                shotMessage[0] = ENCODE_THREAD_PROCESS;
+                shotMessage[1] = (unsigned int) shot;
+                write(encodePipe[1], &shotMessage, sizeof(shotMessage));
+
+            } else if(procMessage[PROC_MSG_IDX_ACTION] == PROC_THREAD_EXIT) {
+                LOGD("PROC_THREAD_EXIT_RECEIVED");
+
+                // Queued behind the shots already handed over
+                shotMessage[0] = ENCODE_THREAD_EXIT;
+                shotMessage[1] = 0;
+                write(encodePipe[1], &shotMessage, sizeof(shotMessage));
+                break;
+            }
+        }
+    }
+
+    LOG_FUNCTION_NAME_EXIT
+}
+
+void CameraHal::encodeThread()
+{
+    LOG_FUNCTION_NAME
+
+    fd_set descriptorSet;
+    int max_fd;
+    int err;
+    unsigned int shotMessage[SHOT_PIPE_NUM_ARGS];
+    unsigned int jpegSize, base, offset;
+    sp<MemoryHeapBase> JPEGPictureHeap[JPEG_HEAP_COUNT];
+    sp<MemoryHeapBase> heap;
+    void *outBuffer;
+    capture_shot *shot;
+    int heapIndex = 0;
+    bool sessionOpen = false;
+    struct timeval timeout;
+
+    max_fd = encodePipe[0] + 1;
+
+    mJPEGLength  = MAX_THUMB_WIDTH*MAX_THUMB_HEIGHT + PICTURE_WIDTH*PICTURE_HEIGHT + ((2*PAGE) - 1);
+    mJPEGLength &= ~((2*PAGE) - 1);
+    mJPEGLength  += 2*PAGE;
+
+    while(1){
+
+        // select() clears the set on timeout
+        FD_ZERO(&descriptorSet);
+        FD_SET(encodePipe[0], &descriptorSet);
+        timeout.tv_sec = JPEG_SESSION_IDLE_TIMEOUT;
+        timeout.tv_usec = 0;
+
+        err = select(max_fd,  &descriptorSet, NULL, NULL, sessionOpen ? &timeout : NULL);
+
+        if (err == 0) {
+#if JPEG
+            // No shot for a while, give the DSP resources of the encoder back
+            LOGD("Encode: JPEG session idle, releasing it");
+            jpegEncoder->releaseSession();
+#endif
+            sessionOpen = false;
+            continue;
+        }
+
+        if (err < 1) {
+            LOGE("Encode: Error in select");
+        }
+
+        if(FD_ISSET(encodePipe[0], &descriptorSet)){
+
+            read(encodePipe[0], &shotMessage, sizeof(shotMessage));
+
+            if(shotMessage[0] == ENCODE_THREAD_PROCESS) {
+
+                shot = (capture_shot *) shotMessage[1];
+
+#if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
+                gettimeofday(&shot->encode_start, NULL);
+#endif
+
+                jpegSize = mJPEGLength;
+
+                // The heap used two shots ago may still be referenced by the application
+                // or by the delivery stage
+                heap = JPEGPictureHeap[heapIndex];
+                if( (heap == NULL) || (heap->getStrongCount() > 1) )
+                {
+                    JPEGPictureHeap[heapIndex].clear();
+                    heap.clear();
+                    heap = new MemoryHeapBase(jpegSize);
+                    JPEGPictureHeap[heapIndex] = heap;
+                }
+                heapIndex = (heapIndex + 1) % JPEG_HEAP_COUNT;
+
+                LOGD("JPEGPictureHeap->getStrongCount() = %d, base = 0x%x",
+                        heap->getStrongCount(), (unsigned int)heap->getBase());
+
+                base = (unsigned long) heap->getBase();
+                base = (unsigned long) NEXT_4K_ALIGN_ADDR(base);
+                offset = base - (unsigned long) heap->getBase();
+                outBuffer = (void *) base;
+
 #if JPEG
                 err = 0;
 
 #ifdef DEBUG_LOG
                 LOGD(" outbuffer = %p, jpegSize = %d, input_buffer = %p, input_length = %d, "
                         "image_width = %d, image_height = %d, quality = %d",
-                        outBuffer , jpegSize, input_buffer, input_length,
-                        image_width, image_height, jpegQuality);
+                        outBuffer , jpegSize, shot->input_buffer, shot->input_length,
+                        shot->image_width, shot->image_height, shot->jpegQuality);
 #endif
-                //workaround for thumbnail size  - it should be smaller than captured image
-                if ((image_width<thumb_width) || (image_height<thumb_width) ||
-                    (image_width<thumb_height) || (image_height<thumb_height)) {
-                     thumb_width = MIN_THUMB_WIDTH;
-                     thumb_height = MIN_THUMB_HEIGHT;
-                }
 
 #if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
                 PPM("BEFORE JPEG Encode Image");
 #endif
-                if (!( jpegEncoder->encodeImage((uint8_t *)outBuffer , jpegSize, input_buffer, input_length,
-                                             capture_width, capture_height, jpegQuality, exif_buf, pixelFormat, thumb_width, thumb_height, image_width, image_height,
-                                             image_rotation, image_zoom, crop_top, crop_left, crop_width, crop_height)))
+                if (!( jpegEncoder->encodeImage((uint8_t *)outBuffer , jpegSize, shot->input_buffer, shot->input_length,
+                                             shot->capture_width, shot->capture_height, shot->jpegQuality, shot->exif_buf, shot->pixelFormat,
+                                             shot->thumb_width, shot->thumb_height, shot->image_width, shot->image_height,
+                                             shot->image_rotation, shot->image_zoom, shot->crop_top, shot->crop_left,
+                                             shot->crop_width, shot->crop_height)))
                 {
                     err = -1;
                     LOGE("JPEG Encoding failed");
                 }
+                sessionOpen = true;
 #if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
                 PPM("AFTER JPEG Encode Image");
-                if ( 0 != image_rotation )
-                    PPM("Shot to JPEG with %d deg rotation", &ppm_receiveCmdToTakePicture, image_rotation);
+                PPM("Shot %d JPEG", &shot->encode_start, shot->index);
+                if ( 0 != shot->image_rotation )
+                    PPM("Shot to JPEG with %d deg rotation", &ppm_receiveCmdToTakePicture, shot->image_rotation);
                 else
                     PPM("Shot to JPEG", &ppm_receiveCmdToTakePicture);
 #endif
 
-                JPEGPictureMemBase = new MemoryBase(JPEGPictureHeap, offset, jpegEncoder->jpegSize);
+                shot->JPEGPictureMemBase = new MemoryBase(heap, offset, jpegEncoder->jpegSize);
+
+#ifdef DEBUG_LOG
+
+                LOGD("jpegEncoder->jpegSize=%d jpegSize=%d", jpegEncoder->jpegSize, jpegSize);
+
+#endif
+#endif
+
+#ifdef HARDWARE_OMX
+
+                if((shot->exif_buf != NULL) && (shot->exif_buf->data != NULL))
+                    exif_buf_free(shot->exif_buf);
+                shot->exif_buf = NULL;
+
+#endif
+
+                heap.clear();
+
+                shotMessage[0] = DELIVERY_THREAD_CALL;
+                write(deliveryPipe[1], &shotMessage, sizeof(shotMessage));
+
+            } else if(shotMessage[0] == ENCODE_THREAD_EXIT) {
+                LOGD("ENCODE_THREAD_EXIT_RECEIVED");
+
+                shotMessage[0] = DELIVERY_THREAD_EXIT;
+                write(deliveryPipe[1], &shotMessage, sizeof(shotMessage));
+                break;
+            }
+        }
+    }
+
+    for (int i = 0; i < JPEG_HEAP_COUNT; i++) {
+        JPEGPictureHeap[i].clear();
+    }
+
+    LOG_FUNCTION_NAME_EXIT
+}
+
+void CameraHal::deliveryThread()
+{
+    LOG_FUNCTION_NAME
+
+    fd_set descriptorSet;
+    int max_fd;
+    int err;
+    unsigned int shotMessage[SHOT_PIPE_NUM_ARGS];
+    capture_shot *shot;
+
+    max_fd = deliveryPipe[0] + 1;
+
+    FD_ZERO(&descriptorSet);
+    FD_SET(deliveryPipe[0], &descriptorSet);
+
+    while(1){
+
+        err = select(max_fd,  &descriptorSet, NULL, NULL, NULL);
+
+        if (err < 1) {
+            LOGE("Delivery: Error in select");
+        }
+
+        if(FD_ISSET(deliveryPipe[0], &descriptorSet)){
+
+            read(deliveryPipe[0], &shotMessage, sizeof(shotMessage));
+
+            if(shotMessage[0] == DELIVERY_THREAD_CALL) {
+
+                shot = (capture_shot *) shotMessage[1];
+
+#if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
+                gettimeofday(&shot->delivery_start, NULL);
 #endif
+
                 /* Disable the jpeg message enabled check for now */
                 if(/*JpegPictureCallback*/ true) {
 
 #if JPEG
 
-                    if ( mBurstShots > 1 ){
-                        JpegPictureCallback(CAMERA_MSG_BURST_IMAGE, JPEGPictureMemBase, PictureCallbackCookie);
+                    if ( shot->burst ){
+                        shot->JpegPictureCallback(CAMERA_MSG_BURST_IMAGE, shot->JPEGPictureMemBase, shot->PictureCallbackCookie);
                     }
                     else {
-                        JpegPictureCallback(CAMERA_MSG_COMPRESSED_IMAGE, JPEGPictureMemBase, PictureCallbackCookie);
+                        shot->JpegPictureCallback(CAMERA_MSG_COMPRESSED_IMAGE, shot->JPEGPictureMemBase, shot->PictureCallbackCookie);
                     }
 #else
 
-                    JpegPictureCallback(CAMERA_MSG_COMPRESSED_IMAGE, NULL, PictureCallbackCookie);
+                    shot->JpegPictureCallback(CAMERA_MSG_COMPRESSED_IMAGE, NULL, shot->PictureCallbackCookie);
 
 #endif
 
                 }
 
-#ifdef DEBUG_LOG
+#if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
+                PPM("Shot %d delivery", &shot->delivery_start, shot->index);
+                PPM("Shot %d IPP to delivery", &shot->ipp_start, shot->index);
+                if ( shot->burst && ( 0 < mLastShotDelivery.tv_sec ) )
+                    PPM("Shot %d shot to shot", &mLastShotDelivery, shot->index);
+                gettimeofday(&mLastShotDelivery, NULL);
+#endif
 
-                LOGD("jpegEncoder->jpegSize=%d jpegSize=%d", jpegEncoder->jpegSize, jpegSize);
+                releaseShot(shot);
 
-#endif
+            } else if(shotMessage[0] == DELIVERY_THREAD_EXIT) {
+                LOGD("DELIVERY_THREAD_EXIT_RECEIVED");
+                break;
+            }
+        }
+    }
 
-#ifdef HARDWARE_OMX
+    LOG_FUNCTION_NAME_EXIT
+}
 
-                if((exif_buf != NULL) && (exif_buf->data != NULL))
-                    exif_buf_free(exif_buf);
+capture_shot *CameraHal::acquireShot()
+{
+    capture_shot *shot;
 
-#endif
+    Mutex::Autolock lock(mShotLock);
 
-                JPEGPictureMemBase.clear();
+    while ( mShotsInFlight >= SHOT_PIPELINE_DEPTH ) {
+        mShotCondition.wait(mShotLock);
+    }
 
-                // Release constraint to DSP OPP by setting lowest Hz
-                SetDSPHz(DSP3630_HZ_MIN);
+    shot = &mShots[mShotHead];
+    mShotHead = (mShotHead + 1) % SHOT_PIPELINE_DEPTH;
+    mShotsInFlight++;
 
-            } else if(procMessage[PROC_MSG_IDX_ACTION] == PROC_THREAD_EXIT) {
-                LOGD("PROC_THREAD_EXIT_RECEIVED");
-                JPEGPictureHeap.clear();
-                break;
-            }
-        }
+    shot->index = mShotIndex++;
+
+    return shot;
+}
+
+void CameraHal::releaseShot(capture_shot *shot)
+{
+    bool idle;
+
+    shot->JPEGPictureMemBase.clear();
+
+    {
+        Mutex::Autolock lock(mShotLock);
+        mShotsInFlight--;
+        mShotsQueued--;
+        idle = ( 0 == mShotsQueued );
+        mShotCondition.broadcast();
     }
 
-    JPEGPictureHeap.clear();
+    // Release constraint to DSP OPP by setting lowest Hz once the pipeline drains
+    if ( idle ) {
+        SetDSPHz(DSP3630_HZ_MIN);
 
-    LOG_FUNCTION_NAME_EXIT
+#if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
+        mLastShotDelivery.tv_sec = 0;
+        mLastShotDelivery.tv_usec = 0;
+#endif
+    }
+}
+
+void CameraHal::waitForShots(int maxInFlight)
+{
+    Mutex::Autolock lock(mShotLock);
+
+    while ( mShotsInFlight > maxInFlight ) {
+        mShotCondition.wait(mShotLock);
+    }
+}
+
+void CameraHal::shotQueued()
+{
+    Mutex::Autolock lock(mShotLock);
+    mShotsQueued++;
+}
+
+void CameraHal::drainShots()
+{
+    Mutex::Autolock lock(mShotLock);
+
+    while ( mShotsQueued > 0 ) {
+        mShotCondition.wait(mShotLock);
+    }
 }
 
 int CameraHal::allocatePictureBuffers(size_t length, int burstCount)
@@ -3071,39 +3526,100 @@ int CameraHal::allocatePictureBuffers(size_t length, int burstCount)
         return -1;
     }
 
+    // Shots of a previous capture may still be encoded out of these buffers
+    drainShots();
+
     length += ((2*PAGE) - 1) + 10*PAGE;
     length &= ~((2*PAGE) - 1);
     length += 2*PAGE;
 
-    for (int i = 0; i < burstCount; i++) {
-        if (mYuvBuffer[i] != NULL && mYuvBufferLen[i] == length) {
-            // proper buffer already allocated. skip alloc.
-            continue;
+    // The arena of the previous capture is reused as long as the resolution
+    // doesn't change, so ICapture gets the same addresses shot after shot
+    if ( ( mYuvArena == NULL ) || ( mYuvSlotLen != length ) || ( mYuvSlotCount < burstCount ) ) {
+        // Drop the old arena first, its pages are needed for the new one
+        freePictureBuffers();
+
+        if ( allocYuvArena(length, burstCount) < 0 ) {
+
+#if defined(HARDWARE_OMX) && JPEG
+            if ( isStart_JPEG ) {
+                // Low on memory, the idle encoder session is the first thing to go
+                LOGE("YUV arena allocation failed, releasing the JPEG encoder session");
+                jpegEncoder->releaseSession();
+            }
+#endif
+
+            if ( allocYuvArena(length, burstCount) < 0 ) {
+                LOGE("YUV arena allocation failed, %d buffers of %d bytes", burstCount, length);
+                return -1;
+            }
         }
+    }
 
-        if (mYuvBuffer[i])
-            free(mYuvBuffer[i]);
+    for (int i = 0; i < MAX_BURST; i++) {
+        if ( i < mYuvSlotCount ) {
+            mYuvBuffer[i] = (uint8_t *) mYuvArena + YUV_ARENA_GUARD + i * ( mYuvSlotLen + YUV_ARENA_GUARD );
+            mYuvBufferLen[i] = mYuvSlotLen;
+        } else {
+            mYuvBuffer[i] = NULL;
+            mYuvBufferLen[i] = 0;
+        }
+    }
+
+    return NO_ERROR;
+}
 
-        mYuvBuffer[i] = (uint8_t *) malloc(length);
-        mYuvBufferLen[i] = length;
+/*
+ * Snapshot buffers come straight from mmap() instead of the heap, so a large
+ * capture doesn't depend on finding a hole in a fragmented heap and the pages
+ * go back to the system on release. The mapping is page aligned, which covers
+ * both the cache line and the DSP (DSP_CACHE_ALIGNMENT) requirements.
+ */
+int CameraHal::allocYuvArena(size_t slotLen, int slotCount)
+{
+    size_t size = YUV_ARENA_GUARD + slotCount * ( slotLen + YUV_ARENA_GUARD );
+    void *arena;
 
-        if (mYuvBuffer[i] == NULL) {
-            LOGE("mYuvBuffer[%d] malloc failed", i);
-            return -1;
+    arena = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ( arena == MAP_FAILED ) {
+        LOGE("mmap of %d bytes failed", size);
+        return -1;
+    }
+
+#if YUV_ARENA_GUARD
+
+    // Guard page in front of every slot and one behind the last
+    for ( int i = 0; i <= slotCount; i++ ) {
+        if ( mprotect((uint8_t *) arena + i * ( slotLen + YUV_ARENA_GUARD ), YUV_ARENA_GUARD, PROT_NONE) < 0 ) {
+            LOGE("Failed to protect the guard page of slot %d", i);
         }
     }
 
+#endif
+
+    mYuvArena = arena;
+    mYuvArenaSize = size;
+    mYuvSlotLen = slotLen;
+    mYuvSlotCount = slotCount;
+
+    LOGD("YUV arena %p, %d slots of %d bytes", arena, slotCount, slotLen);
+
     return NO_ERROR;
 }
 
 int CameraHal::freePictureBuffers(void)
 {
     for (int i = 0; i < MAX_BURST; i++) {
-        if (mYuvBuffer[i]) {
-            free(mYuvBuffer[i]);
-            mYuvBuffer[i] = NULL;
-            mYuvBufferLen[i] = 0;
-        }
+        mYuvBuffer[i] = NULL;
+        mYuvBufferLen[i] = 0;
+    }
+
+    if ( mYuvArena ) {
+        munmap(mYuvArena, mYuvArenaSize);
+        mYuvArena = NULL;
+        mYuvArenaSize = 0;
+        mYuvSlotLen = 0;
+        mYuvSlotCount = 0;
     }
 
     return NO_ERROR;
@@ -3238,7 +3754,7 @@ status_t CameraHal::setOverlay(const sp<Overlay> &overlay)
             mPreviewHeaps[i].clear();
             mVideoBuffer[i].clear();
             mVideoHeaps[i].clear();
-            mVideoBufferStatus[i] = BUFF_IDLE;
+            mBufferOwnership.reset(i);
         }
 
         mOverlay->destroy();
@@ -3363,8 +3879,8 @@ status_t CameraHal::startRecording( )
     {
         mVideoHeaps[i].clear();
         mVideoBuffer[i].clear();
-        if(mVideoBufferStatus[i] & BUFF_Q2VE)
-            mVideoBufferStatus[i] &= ~BUFF_Q2VE;
+        if (mBufferOwnership.holds(i, BufferOwnership::OWNER_ENCODER))
+            releaseBuffer(i, OWNER_ENCODER);
     }
 
     debugShowBufferStatus();
@@ -3384,8 +3900,8 @@ status_t CameraHal::startRecording( )
             {
                 mVideoHeaps[j].clear();
                 mVideoBuffer[j].clear();
-                if(mVideoBufferStatus[i] & BUFF_Q2VE)
-                    mVideoBufferStatus[i] &= ~BUFF_Q2VE;
+                if (mBufferOwnership.holds(i, BufferOwnership::OWNER_ENCODER))
+                    releaseBuffer(i, OWNER_ENCODER);
             }
             LOGD("Error: data from overlay returned null");
             return UNKNOWN_ERROR;
@@ -3429,8 +3945,8 @@ void CameraHal::releaseRecordingFrame(const sp<IMemory>& mem)
         return;
     }
 
-    if (0 == (mVideoBufferStatus[index] & BUFF_Q2VE)) {
-        LOGW("Buffer#%d(stat=%d) not queued to VE.", index, mVideoBufferStatus[index]);
+    if (!mBufferOwnership.holds(index, BufferOwnership::OWNER_ENCODER)) {
+        LOGW("Buffer#%d not queued to VE.", index);
         return;
     }
 
@@ -3438,7 +3954,7 @@ void CameraHal::releaseRecordingFrame(const sp<IMemory>& mem)
 
     mRecordingLock.lock();
 
-    mVideoBufferStatus[index] &= ~BUFF_Q2VE;
+    releaseBuffer(index, OWNER_ENCODER);
     queueToCamera(index);
 
     mRecordingLock.unlock();
@@ -3660,13 +4176,12 @@ status_t CameraHal::setParameters(const CameraParameters &params)
     zoom = mParameters.getInt(CameraParameters::KEY_ZOOM);
     if( (zoom >= 0) && ( zoom < ZOOM_STAGES) ){
         // immediate zoom
-        mZoomSpeed = 0;
-        mZoomTargetIdx = zoom;
+        setZoom(zoom, false);
     } else if(zoom>= ZOOM_STAGES){
         mParameters.set(CameraParameters::KEY_ZOOM, zoom_save);
         return -EINVAL;
     } else {
-        mZoomTargetIdx = 0;
+        setZoom(0, false);
     }
     LOGD("Zoom by App %d", zoom);
 
@@ -4581,6 +5096,17 @@ exit:
 
 status_t  CameraHal::dump(int fd, const Vector<String16>& args) const
 {
+    // "buffers" dumps who holds the preview/video buffers instead of the trace
+    if ( ( args.size() > 0 ) && ( args[0] == String16("buffers") ) ) {
+        mBufferOwnership.dump(fd, VIDEO_FRAME_COUNT_MAX);
+        return 0;
+    }
+
+#if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
+    // Chrome trace event JSON, load it in chrome://tracing
+    mTimeline.exportJson(fd);
+#endif
+
     return 0;
 }
 
@@ -4961,9 +5487,7 @@ void CameraHal::debugShowBufferStatus()
     LOGE("nOverlayBuffersQueued=%d", nOverlayBuffersQueued);
     LOGE("nCameraBuffersQueued=%d", nCameraBuffersQueued);
     LOGE("mVideoBufferCount=%d", mVideoBufferCount);
-    for (int i=0; i< VIDEO_FRAME_COUNT_MAX; i++) {
-        LOGE("mVideoBufferStatus[%d]=%d", i, mVideoBufferStatus[i]);
-    }
+    mBufferOwnership.log(VIDEO_FRAME_COUNT_MAX);
 }
 #endif
 
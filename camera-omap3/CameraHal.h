@@ -44,6 +44,7 @@
 #include <ui/Overlay.h>
 #include <camera/CameraHardwareInterface.h>
 #include "MessageQueue.h"
+#include "BufferOwnership.h"
 #include "overlay_common.h"
 #include "CameraHalParams.h"
 
@@ -57,6 +58,10 @@
 
 #define PPM_INSTRUMENTATION 1
 
+#if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
+#include "PPMTimeline.h"
+#endif
+
 #define DEBUG_LOG 1
 
 //#undef FW3A
@@ -289,8 +294,31 @@ enum {
 #define SNAPSHOT_THREAD_START       0x1
 #define SNAPSHOT_THREAD_EXIT        0x2
 #define SNAPSHOT_THREAD_START_GEN   0x3
+#define ENCODE_THREAD_PROCESS       0x1
+#define ENCODE_THREAD_EXIT          0x2
+#define DELIVERY_THREAD_CALL        0x1
+#define DELIVERY_THREAD_EXIT        0x2
+#define SHOT_PIPE_NUM_ARGS          2
+
+/* Shots processed concurrently by the IPP, JPEG and delivery stages */
+#define SHOT_PIPELINE_DEPTH     3
+/* Output heaps rotated by the JPEG stage, one being encoded and one being delivered */
+#define JPEG_HEAP_COUNT         2
+/* Seconds without a shot before the JPEG encoder session is released */
+#define JPEG_SESSION_IDLE_TIMEOUT   10
+/* Smooth zoom duration per zoom stage, ms */
+#define SMOOTH_ZOOM_STEP_TIME       33
+/* Interval between two zoom updates during a smooth zoom, ms */
+#define ZOOM_UPDATE_PERIOD          16
 
 #define PAGE                    0x1000
+
+/* Inaccessible page between the snapshot buffer slots, catches overruns on the spot */
+#ifdef DEBUG_LOG
+#define YUV_ARENA_GUARD         PAGE
+#else
+#define YUV_ARENA_GUARD         0
+#endif
 #define PARAM_BUFFER            512
 
 #ifdef FW3A
@@ -325,6 +353,28 @@ typedef struct {
     size_t height;
 } supported_resolution;
 
+/* Capture in flight between procThread, encodeThread and deliveryThread */
+typedef struct {
+    int index;
+    bool burst;
+    void *input_buffer;
+    unsigned int input_length;
+    int pixelFormat;
+    int capture_width, capture_height;
+    int image_width, image_height;
+    int thumb_width, thumb_height;
+    unsigned int jpegQuality, image_rotation;
+    double image_zoom;
+    unsigned int crop_top, crop_left, crop_width, crop_height;
+    data_callback JpegPictureCallback;
+    void *PictureCallbackCookie;
+#ifdef HARDWARE_OMX
+    exif_buffer *exif_buf;
+#endif
+    sp<MemoryBase> JPEGPictureMemBase;
+    struct timeval ipp_start, encode_start, delivery_start;
+} capture_shot;
+
 class CameraHal : public CameraHardwareInterface {
 public:
     virtual sp<IMemoryHeap> getRawHeap() const;
@@ -419,6 +469,42 @@ public:
         }
     };
 
+    class EncodeThread : public Thread {
+        CameraHal* mHardware;
+    public:
+        EncodeThread(CameraHal* hw)
+            : Thread(false), mHardware(hw) { }
+
+        virtual bool threadLoop() {
+            mHardware->encodeThread();
+            return false;
+        }
+    };
+
+    class DeliveryThread : public Thread {
+        CameraHal* mHardware;
+    public:
+        DeliveryThread(CameraHal* hw)
+            : Thread(false), mHardware(hw) { }
+
+        virtual bool threadLoop() {
+            mHardware->deliveryThread();
+            return false;
+        }
+    };
+
+    class ZoomThread : public Thread {
+        CameraHal* mHardware;
+    public:
+        ZoomThread(CameraHal* hw)
+            : Thread(false), mHardware(hw) { }
+
+        virtual bool threadLoop() {
+            mHardware->zoomThread();
+            return false;
+        }
+    };
+
     class RawThread : public Thread {
         CameraHal* mHardware;
     public:
@@ -437,9 +523,19 @@ public:
     bool validateSize(size_t width, size_t height, const supported_resolution *supRes, size_t count);
     bool validateRange(int min, int max, const char *supRang);
     void procThread();
+    void encodeThread();
+    void deliveryThread();
+    capture_shot *acquireShot();
+    void releaseShot(capture_shot *shot);
+    void waitForShots(int maxInFlight);
+    void shotQueued();
+    void drainShots();
     void shutterThread();
     void rawThread();
     void snapshotThread();
+    void zoomThread();
+    void setZoom(int index, bool smooth);
+    void stopSmoothZoom();
     void *getLastOverlayAddress();
     size_t getLastOverlayLength();
 
@@ -518,6 +614,7 @@ public:
 
     int allocatePictureBuffers(size_t length, int burstCount);
     int freePictureBuffers(void);
+    int allocYuvArena(size_t slotLen, int slotCount);
 
     int SaveFile(char *filename, char *ext, void *buffer, int jpeg_size);
     
@@ -549,13 +646,20 @@ public:
     int mJPEGOffset, mJPEGLength;
     unsigned int mYuvBufferLen[MAX_BURST];
     void *mYuvBuffer[MAX_BURST];
+    void *mYuvArena;
+    size_t mYuvArenaSize;
+    size_t mYuvSlotLen;
+    int mYuvSlotCount;
     int  mPreviewFrameSize;
     sp<Overlay>  mOverlay;
     sp<PreviewThread>  mPreviewThread;
     sp<PROCThread>  mPROCThread;
+    sp<EncodeThread> mEncodeThread;
+    sp<DeliveryThread> mDeliveryThread;
     sp<ShutterThread> mShutterThread;
     sp<RawThread> mRawThread;
     sp<SnapshotThread> mSnapshotThread;
+    sp<ZoomThread> mZoomThread;
     bool mPreviewRunning;
     bool mIPPInitAlgoState;
     bool mIPPToEnable;
@@ -566,10 +670,9 @@ public:
     sp<MemoryHeapBase> mVideoHeaps[VIDEO_FRAME_COUNT_MAX];
     sp<MemoryBase> mVideoBuffer[VIDEO_FRAME_COUNT_MAX];
 
-#define BUFF_IDLE       (0)
-#define BUFF_Q2DSS      (1)
-#define BUFF_Q2VE       (1<<1)
-    int                 mVideoBufferStatus[MAX_CAMERA_BUFFERS];
+    BufferOwnership mBufferOwnership;
+#define acquireBuffer(x, owner) mBufferOwnership.acquire(x, BufferOwnership::owner, __LINE__)
+#define releaseBuffer(x, owner) mBufferOwnership.release(x, BufferOwnership::owner, __LINE__)
 #ifdef DEBUG_LOG
     void debugShowBufferStatus();
 #else
@@ -597,6 +700,18 @@ public:
     char focusDistances[FOCUS_DISTANCE_BUFFER_SIZE];
     static const char PARAMS_DELIMITER[];
     int procPipe[2], shutterPipe[2], rawPipe[2], snapshotPipe[2], snapshotReadyPipe[2];
+    int encodePipe[2], deliveryPipe[2];
+
+    /* Shot pipeline. mShotsQueued counts the shots sent to procThread and not yet delivered,
+       mShotsInFlight the ones holding a slot of mShots */
+    Mutex mShotLock;
+    Condition mShotCondition;
+    capture_shot mShots[SHOT_PIPELINE_DEPTH];
+    int mShotHead;
+    int mShotsInFlight;
+    int mShotsQueued;
+    int mShotIndex;
+    struct timeval mLastShotDelivery;
     int mippMode;
     int pictureNumber;
     bool mCaptureRunning;
@@ -609,6 +724,7 @@ public:
     struct timeval focus_before, focus_after;
     struct timeval ppm_before, ppm_after;
     struct timeval ipp_before, ipp_after;
+    PPMTimeline mTimeline;
 #endif
     int lastOverlayBufferDQ;
 
@@ -649,16 +765,17 @@ public:
     int mflash;
     int mred_eye;
     int mcapture_mode;
-    int mZoomCurrentIdx, mZoomTargetIdx, mZoomSpeed;
+    int mZoomCurrentIdx, mZoomTargetIdx;
     int mcaf;
     int j;
     bool useFramerateRange;
 
-    enum SmoothZoomStatus {
-        SMOOTH_START = 0,
-        SMOOTH_NOTIFY_AND_STOP,
-        SMOOTH_STOP
-    } mSmoothZoomStatus;
+    // Zoom animation, applied by the zoom thread
+    Mutex mZoomLock;
+    Condition mZoomCondition;
+    int mZoomStartIdx;
+    nsecs_t mZoomStartTime, mZoomDuration;
+    bool mZoomSmooth, mZoomStopPending, mZoomEnabled, mZoomExit;
 
     enum PreviewThreadCommands {
 
@@ -1365,6 +1365,10 @@ void CameraHal::SetDSPHz(unsigned int Hz)
 
 void CameraHal::PPM(const char* str){
 
+#if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
+    mTimeline.instant(str);
+#endif
+
 #if PPM_INSTRUMENTATION
 
     gettimeofday(&ppm, NULL);
@@ -1392,14 +1396,16 @@ void CameraHal::PPM(const char* str){
 void CameraHal::PPM(const char* str, struct timeval* ppm_first, ...){
 #if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
     char temp_str[256];
+    struct timeval now; //called concurrently by the shot pipeline stages
     va_list args;
     va_start(args, ppm_first);
-    vsprintf(temp_str, str, args);
-	gettimeofday(&ppm, NULL); 
-	ppm.tv_sec = ppm.tv_sec - ppm_first->tv_sec; 
-	ppm.tv_sec = ppm.tv_sec * 1000000; 
-	ppm.tv_sec = ppm.tv_sec + ppm.tv_usec - ppm_first->tv_usec; 
-	LOGD("PPM: %s :%ld.%ld ms",temp_str, ppm.tv_sec/1000, ppm.tv_sec%1000 );
+    vsnprintf(temp_str, sizeof(temp_str), str, args);
+    mTimeline.complete(temp_str, ppm_first);
+	gettimeofday(&now, NULL); 
+	now.tv_sec = now.tv_sec - ppm_first->tv_sec; 
+	now.tv_sec = now.tv_sec * 1000000; 
+	now.tv_sec = now.tv_sec + now.tv_usec - ppm_first->tv_usec; 
+	LOGD("PPM: %s :%ld.%ld ms",temp_str, now.tv_sec/1000, now.tv_sec%1000 );
     va_end(args);
 #endif
 }
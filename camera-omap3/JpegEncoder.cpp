@@ -32,6 +32,8 @@
 *
 */
 
+#include <errno.h>
+
 #include "JpegEncoder.h"
 #include <utils/Log.h>
 #include <OMX_JpegEnc_CustomCmd.h>
@@ -83,25 +85,16 @@ JpegEncoder::JpegEncoder()
     pOutBuffHead = NULL;
     semaphore = NULL;
     pOMXHandle = NULL;
+    iState = STATE_LOADED;
+    iLastState = STATE_LOADED;
     semaphore = (sem_t*)malloc(sizeof(sem_t)) ;
     sem_init(semaphore, 0x00, 0x00);
 }
 
 JpegEncoder::~JpegEncoder()
 {
-    OMX_ERRORTYPE eError = OMX_ErrorNone;
-#if OPTIMIZE
-    if( ( iLastState || iState ) && ( NULL != pOMXHandle ) ){
-        eError = OMX_SendCommand(pOMXHandle,OMX_CommandStateSet, OMX_StateIdle, NULL);
-        if ( eError != OMX_ErrorNone ) {
-            PRINTF("\nError from SendCommand-Idle(nStop) State function\n");
-            iState = STATE_ERROR;
-            sem_post(semaphore) ;
-        }
+    releaseSession();
 
-        Run();
-    }
-#endif    
     sem_destroy(semaphore);
     if (semaphore != NULL) {
         free(semaphore);
@@ -322,37 +315,12 @@ EXIT:
 
 bool JpegEncoder::StartFromLoadedState()
 {
-
-    int nRetval;
-    int nIndex1;
-    int nIndex2;
-    int bitsPerPixel;
-    int nMultFactor = 0;
-    int nHeightNew, nWidthNew;
     char strTIJpegEnc[] = "OMX.TI.JPEG.encoder";
-    char strQFactor[] = "OMX.TI.JPEG.encoder.Config.QFactor";
-	char strConversionFlag[] = "OMX.TI.JPEG.encoder.Config.ConversionFlag";
-	char strPPLibEnable[] = "OMX.TI.JPEG.encoder.Config.PPLibEnable";
-
-    OMX_S32 nCompId = 300;
-    OMX_PORT_PARAM_TYPE PortType;
     OMX_ERRORTYPE eError = OMX_ErrorNone;
-    OMX_IMAGE_PARAM_QFACTORTYPE QfactorType;
-	JPE_CONVERSION_FLAG_TYPE nConversionFlag = JPE_CONV_NONE;
-	OMX_BOOL bPPLibEnable;
-    OMX_INDEXTYPE nCustomIndex = OMX_IndexMax;
     OMX_CALLBACKTYPE JPEGCallBack ={OMX_JPEGE_EventHandler, OMX_JPEGE_EmptyBufferDone, OMX_JPEGE_FillBufferDone};
 
     if (pOMXHandle) { // we should not have more than one instance of JPEG encoder open
-
-        eError = TIOMX_Deinit();
-        if ( eError != OMX_ErrorNone ) {
-            PRINTF("\nError returned by TIOMX_Deinit()\n");
-        }
-        eError = TIOMX_FreeHandle(pOMXHandle);
-        if ( (eError != OMX_ErrorNone) )    {
-            PRINTF("\nError in Free Handle function\n");
-        }
+        FreeSession();
     }
 
     eError = TIOMX_Init();
@@ -367,9 +335,39 @@ bool JpegEncoder::StartFromLoadedState()
     eError = TIOMX_GetHandle(&pOMXHandle, strTIJpegEnc, (void *)this, &JPEGCallBack);
     if ( (eError != OMX_ErrorNone) ||  (pOMXHandle == NULL) ) {
         PRINTF ("Error in Get Handle function\n");
+        pOMXHandle = NULL;
+        TIOMX_Deinit();
         goto EXIT;
     }
 
+    if ( ConfigurePorts() )
+        return true;
+
+    FreeSession();
+
+EXIT:
+
+    return false;
+
+}
+
+/*
+ * Sets up both ports and the static configs, then takes a Loaded component
+ * to Executing and encodes the current buffers.
+ */
+bool JpegEncoder::ConfigurePorts()
+{
+
+    int nIndex1;
+    int nIndex2;
+	char strConversionFlag[] = "OMX.TI.JPEG.encoder.Config.ConversionFlag";
+
+    OMX_S32 nCompId = 300;
+    OMX_PORT_PARAM_TYPE PortType;
+    OMX_ERRORTYPE eError = OMX_ErrorNone;
+	JPE_CONVERSION_FLAG_TYPE nConversionFlag = JPE_CONV_NONE;
+    OMX_INDEXTYPE nCustomIndex = OMX_IndexMax;
+
     PortType.nSize = sizeof(OMX_PORT_PARAM_TYPE);
     PortType.nVersion.s.nVersionMajor = 0x1;
     PortType.nVersion.s.nVersionMinor = 0x0;
@@ -487,23 +485,8 @@ bool JpegEncoder::StartFromLoadedState()
         goto EXIT;
     }
 
-    QfactorType.nSize = sizeof(OMX_IMAGE_PARAM_QFACTORTYPE);
-    QfactorType.nQFactor = (OMX_U32) mQuality;
-    QfactorType.nVersion.s.nVersionMajor = 0x1;
-    QfactorType.nVersion.s.nVersionMinor = 0x0;
-    QfactorType.nVersion.s.nRevision = 0x0;
-    QfactorType.nVersion.s.nStep = 0x0;
-    QfactorType.nPortIndex = 0x0;
-
-    eError = OMX_GetExtensionIndex(pOMXHandle, strQFactor, (OMX_INDEXTYPE*)&nCustomIndex);
+    eError = SetQFactor();
     if ( eError != OMX_ErrorNone ) {
-        PRINTF("\n%d::APP_Error at function call: %x\n", __LINE__, eError);
-        goto EXIT;
-    }
-    
-    eError = OMX_SetConfig (pOMXHandle, nCustomIndex, &QfactorType);
-    if ( eError != OMX_ErrorNone ) {
-        PRINTF("\n%d::APP_Error at function call: %x\n", __LINE__, eError);
         goto EXIT;
     }
 
@@ -565,12 +548,148 @@ bool JpegEncoder::StartFromLoadedState()
 
     Run();
 
-    return true;
+    // Run() leaves the component in Executing once the buffer is encoded
+    return ( iState == STATE_EMPTY_BUFFER_DONE_CALLED );
+
+EXIT:
+
+    return false;
+
+}
+
+/*
+ * Size, format or rotation changed. The component goes back to Loaded to
+ * get new port definitions but keeps its handle and DSP node.
+ */
+bool JpegEncoder::ReconfigurePorts()
+{
+    OMX_ERRORTYPE eError = OMX_ErrorNone;
+
+    eError = OMX_SendCommand(pOMXHandle, OMX_CommandStateSet, OMX_StateIdle, NULL);
+    if ( ( eError != OMX_ErrorNone ) || !WaitForState(STATE_IDLE) ) {
+        PRINTF("\nError while moving the encoder to Idle\n");
+        goto EXIT;
+    }
+
+    eError = OMX_SendCommand(pOMXHandle, OMX_CommandStateSet, OMX_StateLoaded, NULL);
+    if ( eError != OMX_ErrorNone ) {
+        PRINTF("\nError from SendCommand-Loaded State function\n");
+        goto EXIT;
+    }
+
+    eError = OMX_FreeBuffer(pOMXHandle, InPortDef.nPortIndex, pInBuffHead);
+    if ( eError != OMX_ErrorNone ) {
+        PRINTF("\nError from OMX_FreeBuffer. Input port.\n");
+        goto EXIT;
+    }
+
+    eError = OMX_FreeBuffer(pOMXHandle, OutPortDef.nPortIndex, pOutBuffHead);
+    if ( eError != OMX_ErrorNone ) {
+        PRINTF("\nError from OMX_FreeBuffer. Output port.\n");
+        goto EXIT;
+    }
+
+    if ( !WaitForState(STATE_LOADED) ) {
+        PRINTF("\nError while moving the encoder to Loaded\n");
+        goto EXIT;
+    }
+
+    return ConfigurePorts();
 
 EXIT:
 
     return false;
+}
+
+bool JpegEncoder::WaitForState(JPEGENC_State state)
+{
+    while ( sem_wait(semaphore) ) {
+        if ( errno != EINTR )
+            return false;
+    }
+
+    return ( iState == state );
+}
+
+OMX_ERRORTYPE JpegEncoder::SetQFactor()
+{
+    OMX_ERRORTYPE eError = OMX_ErrorNone;
+    OMX_INDEXTYPE nCustomIndex = OMX_IndexMax;
+    OMX_IMAGE_PARAM_QFACTORTYPE QfactorType;
+    char strQFactor[] = "OMX.TI.JPEG.encoder.Config.QFactor";
+
+    QfactorType.nSize = sizeof(OMX_IMAGE_PARAM_QFACTORTYPE);
+    QfactorType.nQFactor = (OMX_U32) mQuality;
+    QfactorType.nVersion.s.nVersionMajor = 0x1;
+    QfactorType.nVersion.s.nVersionMinor = 0x0;
+    QfactorType.nVersion.s.nRevision = 0x0;
+    QfactorType.nVersion.s.nStep = 0x0;
+    QfactorType.nPortIndex = 0x0;
+
+    eError = OMX_GetExtensionIndex(pOMXHandle, strQFactor, (OMX_INDEXTYPE*)&nCustomIndex);
+    if ( eError != OMX_ErrorNone ) {
+        PRINTF("\n%d::APP_Error at function call: %x\n", __LINE__, eError);
+        goto EXIT;
+    }
 
+    eError = OMX_SetConfig (pOMXHandle, nCustomIndex, &QfactorType);
+    if ( eError != OMX_ErrorNone ) {
+        PRINTF("\n%d::APP_Error at function call: %x\n", __LINE__, eError);
+        goto EXIT;
+    }
+
+EXIT:
+    return eError;
+}
+
+/* Drops the component whatever state it is in, used after errors */
+void JpegEncoder::FreeSession()
+{
+    OMX_ERRORTYPE eError = OMX_ErrorNone;
+
+    if ( pOMXHandle ) {
+        eError = TIOMX_FreeHandle(pOMXHandle);
+        if ( (eError != OMX_ErrorNone) )    {
+            PRINTF("\nError in Free Handle function\n");
+        }
+        pOMXHandle = NULL;
+
+        eError = TIOMX_Deinit();
+        if ( eError != OMX_ErrorNone ) {
+            PRINTF("\nError returned by TIOMX_Deinit()\n");
+        }
+    }
+
+    iLastState = STATE_LOADED;
+    iState = STATE_LOADED;
+
+    // Drop the events the aborted session may have left behind
+    sem_destroy(semaphore);
+    sem_init(semaphore, 0x00, 0x00);
+}
+
+void JpegEncoder::releaseSession()
+{
+    OMX_ERRORTYPE eError = OMX_ErrorNone;
+
+    android::Mutex::Autolock lock(mLock);
+
+    if ( NULL == pOMXHandle )
+        return;
+
+    PRINTF("\nReleasing the JPEG encoder session\n");
+
+    if ( iState == STATE_EMPTY_BUFFER_DONE_CALLED ) {
+        // Run() takes the component through Idle and Loaded and frees it
+        eError = OMX_SendCommand(pOMXHandle,OMX_CommandStateSet, OMX_StateIdle, NULL);
+        if ( eError != OMX_ErrorNone ) {
+            PRINTF("\nError from SendCommand-Idle(nStop) State function\n");
+        } else {
+            Run();
+        }
+    }
+
+    FreeSession();
 }
 
 bool JpegEncoder::encodeImage(void* outputBuffer, int outBuffSize, void *inputBuffer, int inBuffSize, int width, int height, int quality,
@@ -604,25 +723,27 @@ bool JpegEncoder::encodeImage(void* outputBuffer, int outBuffSize, void *inputBu
     eInputCount++;
     PRINTF("\nrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrrr");
 #endif
+
+    android::Mutex::Autolock lock(mLock);
+
 #if OPTIMIZE
-    if (
+    // A session stays in Executing between captures, port settings decide how much of it is reused
+    bool sessionOpen = ( NULL != pOMXHandle ) && ( iState == STATE_EMPTY_BUFFER_DONE_CALLED );
+    bool samePorts = sessionOpen &&
         (mOutWidth == outWidth) &&
         (mOutHeight == outHeight) &&
         (mInWidth == width) &&
         (mInHeight == height) &&
-        (mQuality == quality) &&
-        (iState == STATE_EMPTY_BUFFER_DONE_CALLED) &&
+        (mInBuffSize == inBuffSize) &&
+        (mOutBuffSize == outBuffSize) &&
         (mIsPixelFmt420p == isPixelFmt420p) &&
-        (thumb_width == th_width) &&
-        (thumb_height == th_height) &&
-        (mRotation == rotation) //TODO: could optimize by setting the rotation dynamically, but it complicates the code
-    )
+        (mRotation == rotation); //TODO: could optimize by setting the rotation dynamically, but it complicates the code
+
+    if ( samePorts )
     {
-        PRINTF("\nI am already in EXECUTE state and all input params are same as before.");
+        PRINTF("\nI am already in EXECUTE state and the port settings are same as before.");
 
         //update these parameters since they can updated dynamically
-        mInWidth = width;
-        mInHeight = height;
         mZoom = zoom;
         mCrop_top = crop_top;
         mCrop_left = crop_left;
@@ -630,6 +751,13 @@ bool JpegEncoder::encodeImage(void* outputBuffer, int outBuffSize, void *inputBu
         mCrop_height = crop_height;
         SetPPLibDynamicParams();
 
+        if ( mQuality != quality ) {
+            mQuality = quality;
+            SetQFactor();
+        }
+
+        thumb_width = th_width;
+        thumb_height = th_height;
         mexif_buf = exif_buf;
         SetExifBuffer();
 
@@ -641,46 +769,53 @@ bool JpegEncoder::encodeImage(void* outputBuffer, int outBuffSize, void *inputBu
         sem_post(semaphore);
         Run();
 
+        return ( iState == STATE_EMPTY_BUFFER_DONE_CALLED );
     }
-    else
 #endif
+
+    mOutputBuffer = outputBuffer;
+    mOutBuffSize = outBuffSize;
+    mInputBuffer = inputBuffer;
+    mInBuffSize = inBuffSize;
+    mInWidth = width;
+    mInHeight = height;
+    mQuality = quality;
+    mIsPixelFmt420p = isPixelFmt420p;
+    mexif_buf = exif_buf;
+    thumb_width = th_width;
+    thumb_height = th_height;
+    mOutWidth = outWidth;
+    mOutHeight = outHeight;
+    mRotation = rotation;
+    mZoom = zoom;
+    mCrop_top = crop_top;
+    mCrop_left = crop_left;
+    mCrop_width = crop_width;
+    mCrop_height = crop_height;
+
+#if OPTIMIZE
+    if ( sessionOpen )
     {
-        mOutputBuffer = outputBuffer;
-        mOutBuffSize = outBuffSize;
-        mInputBuffer = inputBuffer;
-        mInBuffSize = inBuffSize;
-        mInWidth = width;
-        mInHeight = height;
-        mQuality = quality;
-		mIsPixelFmt420p = isPixelFmt420p;
-		mexif_buf = exif_buf;
-        iLastState = STATE_LOADED;
-        iState = STATE_LOADED;
-        thumb_width = th_width;
-        thumb_height = th_height;
-        mOutWidth = outWidth;
-        mOutHeight = outHeight;
-        mRotation = rotation;
-        mZoom = zoom;
-        mCrop_top = crop_top;
-        mCrop_left = crop_left;
-        mCrop_width = crop_width;
-        mCrop_height = crop_height;
-    
-        ret = StartFromLoadedState();
-        if (ret == false)
-        {
-            PRINTF("\nThe image cannot be encoded for some reason");
-            return  false;
-        }
-    }
+        PRINTF("\nPort settings changed, reconfiguring the open session.");
 
-    return true;
+        if ( ReconfigurePorts() )
+            return true;
 
-EXIT:
+        PRINTF("\nReconfiguration failed, restarting the encoder");
+    }
+#endif
 
-    return false;
+    iLastState = STATE_LOADED;
+    iState = STATE_LOADED;
+
+    ret = StartFromLoadedState();
+    if (ret == false)
+    {
+        PRINTF("\nThe image cannot be encoded for some reason");
+        return  false;
+    }
 
+    return true;
 }
 
 
@@ -824,6 +959,7 @@ while(1){
                 if ( (eError != OMX_ErrorNone) )    {
                     PRINTF("\nError in Free Handle function\n");
                 }
+                pOMXHandle = NULL;
             }
 
             eError = TIOMX_Deinit();
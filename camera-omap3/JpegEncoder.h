@@ -39,6 +39,7 @@ Better Error handling
 #include <semaphore.h>
 
 #include <utils/Log.h>
+#include <utils/threads.h>
 #include "JpegEncoderEXIF.h"
 #include <OMX_JpegEnc_CustomCmd.h>
 
@@ -93,10 +94,14 @@ public:
             int quality, exif_buffer *exif_buf, int mIsPixelFmt420p, int thumb_width, int thumb_height, int outWidth, int outHeight,
             int rotation, float zoom, int crop_top, int crop_left, int crop_width, int crop_height);
     bool SetJpegEncodeParameters(JpegEncoderParams * jep) {memcpy(&jpegEncParams, jep, sizeof(JpegEncoderParams)); return true;}
+    // Takes the component back to Loaded and frees it, e.g. on idle timeout or memory pressure.
+    // The next encodeImage() starts a new session.
+    void releaseSession();
     void Run();
     void PrintState();
     void FillBufferDone(OMX_U8* pBuffer, OMX_U32 size);
     bool StartFromLoadedState();
+    bool ReconfigurePorts();
     void EventHandler(OMX_HANDLETYPE hComponent,
                                             OMX_EVENTTYPE eEvent,
                                             OMX_U32 nData1,
@@ -127,8 +132,13 @@ private:
     int mCrop_left;
     int mCrop_width;
     int mCrop_height;
+    android::Mutex mLock;
     OMX_ERRORTYPE SetPPLibDynamicParams(void);
     OMX_ERRORTYPE SetExifBuffer(void);
+    OMX_ERRORTYPE SetQFactor(void);
+    bool ConfigurePorts();
+    bool WaitForState(JPEGENC_State state);
+    void FreeSession();
 };
 
 OMX_ERRORTYPE OMX_JPEGE_FillBufferDone (OMX_HANDLETYPE hComponent, OMX_PTR ptr, OMX_BUFFERHEADERTYPE* pBuffHead);
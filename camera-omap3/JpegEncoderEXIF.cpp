@@ -6,6 +6,7 @@
 #include <time.h>
 #include <sys/time.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "JpegEncoderEXIF.h"
 
@@ -302,28 +303,240 @@ void exif_entry_set_gps_version(ExifData * pEdata, ExifIfd eEifd, ExifTag eEtag,
     exif_entry_unref (pE);
 }
 
-exif_buffer *get_exif_buffer(void *params, void *gpsLocation)
+/* Tags rewritten in the cached template for every shot */
+enum {
+    EXIF_FIELD_IMAGE_LENGTH,
+    EXIF_FIELD_IMAGE_WIDTH,
+    EXIF_FIELD_ORIENTATION,
+    EXIF_FIELD_METERING_MODE,
+    EXIF_FIELD_ISO,
+    EXIF_FIELD_DIGITAL_ZOOM,
+    EXIF_FIELD_WHITE_BALANCE,
+    EXIF_FIELD_EXPOSURE_TIME,
+    EXIF_FIELD_DATE_TIME,
+    EXIF_FIELD_DATE_TIME_ORIGINAL,
+    EXIF_FIELD_DATE_TIME_DIGITIZED,
+    EXIF_FIELD_SUB_SEC_TIME,
+    EXIF_FIELD_SUB_SEC_TIME_ORIGINAL,
+    EXIF_FIELD_SUB_SEC_TIME_DIGITIZED,
+    EXIF_FIELD_GPS_LONGITUDE,
+    EXIF_FIELD_GPS_LATITUDE,
+    EXIF_FIELD_GPS_ALTITUDE,
+    EXIF_FIELD_GPS_ALTITUDE_REF,
+    EXIF_FIELD_GPS_TIME_STAMP,
+    EXIF_FIELD_GPS_DATE_STAMP,
+    EXIF_FIELD_COUNT
+};
+
+static const struct {
+    ExifIfd ifd;
+    int tag;
+} exif_fields[EXIF_FIELD_COUNT] = {
+    { EXIF_IFD_0, EXIF_TAG_IMAGE_LENGTH },
+    { EXIF_IFD_0, EXIF_TAG_IMAGE_WIDTH },
+    { EXIF_IFD_0, EXIF_TAG_ORIENTATION },
+    { EXIF_IFD_EXIF, EXIF_TAG_METERING_MODE },
+    { EXIF_IFD_EXIF, EXIF_TAG_ISO_SPEED_RATINGS },
+    { EXIF_IFD_EXIF, EXIF_TAG_DIGITAL_ZOOM_RATIO },
+    { EXIF_IFD_EXIF, EXIF_TAG_WHITE_BALANCE },
+    { EXIF_IFD_EXIF, EXIF_TAG_EXPOSURE_TIME },
+    { EXIF_IFD_0, EXIF_TAG_DATE_TIME },
+    { EXIF_IFD_EXIF, EXIF_TAG_DATE_TIME_ORIGINAL },
+    { EXIF_IFD_EXIF, EXIF_TAG_DATE_TIME_DIGITIZED },
+    { EXIF_IFD_EXIF, EXIF_TAG_SUB_SEC_TIME },
+    { EXIF_IFD_EXIF, EXIF_TAG_SUB_SEC_TIME_ORIGINAL },
+    { EXIF_IFD_EXIF, EXIF_TAG_SUB_SEC_TIME_DIGITIZED },
+    { EXIF_IFD_GPS, EXIF_TAG_GPS_LONGITUDE },
+    { EXIF_IFD_GPS, EXIF_TAG_GPS_LATITUDE },
+    { EXIF_IFD_GPS, EXIF_TAG_GPS_ALTITUDE },
+    { EXIF_IFD_GPS, EXIF_TAG_GPS_ALTITUDE_REF },
+    { EXIF_IFD_GPS, EXIF_TAG_GPS_TIME_STAMP },
+    { EXIF_IFD_GPS, EXIF_TAG_GPS_DATE_STAMP },
+};
+
+#define EXIF_KEY_STRING_MAX 64
+
+/* Everything that changes the layout of the serialized block */
+typedef struct {
+    int has_orientation;
+    int has_metering;
+    int has_iso;
+    int has_gps;
+    int has_datestamp;
+    int has_version;
+    char versionId[4];
+    char latRef[EXIF_KEY_STRING_MAX];
+    char longRef[EXIF_KEY_STRING_MAX];
+    char mapdatum[EXIF_KEY_STRING_MAX];
+    char procMethod[EXIF_KEY_STRING_MAX];
+} exif_template_key;
+
+typedef struct {
+    int valid;
+    exif_template_key key;
+    unsigned char *data;
+    unsigned int size;
+    ExifByteOrder order;
+    int offset[EXIF_FIELD_COUNT];           /* from the start of data, -1 if the tag isn't there */
+    ExifFormat format[EXIF_FIELD_COUNT];
+    unsigned int components[EXIF_FIELD_COUNT];
+} exif_template;
+
+static exif_template sTemplate;
+static pthread_mutex_t sTemplateLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* "Exif\0\0" precedes the TIFF header in the output of exif_data_save_data() */
+#define EXIF_TIFF_START 6
+
+static int exif_orientation(int rotation)
+{
+    switch( rotation ) {
+        case 0:
+            return 1;
+        case 90:
+            return 6;
+        case 180:
+            return 3;
+        case 270:
+            return 8;
+    };
+
+    return 0;
+}
+
+static int exif_metering_mode(int metering_mode)
+{
+    switch( metering_mode ) {
+        case EXIF_CENTER:
+            return 1;
+        case EXIF_AVERAGE:
+            return 2;
+    };
+
+    return 0;
+}
+
+static int exif_iso(int iso)
+{
+    switch( iso ) {
+        case EXIF_ISO_AUTO:
+            return 0;
+        case EXIF_ISO_100:
+            return 100;
+        case EXIF_ISO_200:
+            return 200;
+        case EXIF_ISO_400:
+            return 400;
+        case EXIF_ISO_800:
+            return 800;
+        case EXIF_ISO_1000:
+            return 1000;
+        case EXIF_ISO_1200:
+            return 1200;
+        case EXIF_ISO_1600:
+            return 1600;
+    };
+
+    return -1;
+}
+
+/* Capture time, always the same length so it can be patched in place */
+static void exif_get_time(char *dateTime, char *subSec)
 {
-    ExifData *pEd;
-    exif_buffer *sEb;
-    ExifRational sR;
     struct timeval sTv;
     struct tm *sTime;
-    char *TimeStr = NULL;
     int res;
-    exif_params *par;
 
-    if ( NULL == params)
-        return NULL;
+    strcpy(dateTime, "0000:00:00 00:00:00");
+    strcpy(subSec, "000000");
 
-    par = (exif_params *) params;
+    res = gettimeofday (&sTv, NULL);
+    sTime = localtime (&sTv.tv_sec);
+    if (res == 0 && sTime != NULL) {
+        snprintf(dateTime, 20, "%04d:%02d:%02d %02d:%02d:%02d",
+             sTime->tm_year + 1900,
+             sTime->tm_mon + 1,
+             sTime->tm_mday,
+             sTime->tm_hour,
+             sTime->tm_min,
+             sTime->tm_sec
+            );
+        snprintf(subSec, 7, "%06d", (int) sTv.tv_usec);
+    } else {
+        printf ("Error in time recognition. res: %d sTime: %p\n%s\n", res, sTime, strerror(errno));
+    }
+}
 
-    sEb = (exif_buffer *) malloc (sizeof (exif_buffer));
+static void exif_gps_time(gps_data *gps, ExifRational *r)
+{
+    struct tm *sTime;
+
+    r[0].numerator = 0;
+    r[1].numerator = 0;
+    r[2].numerator = 0;
+    r[0].denominator = 1;
+    r[1].denominator = 1;
+    r[2].denominator = 1;
+
+    sTime = localtime ((const time_t*) &gps->timestamp);
+    if ( NULL != sTime ) {
+        r[0].numerator = sTime->tm_hour;
+        r[1].numerator = sTime->tm_min;
+        r[2].numerator = sTime->tm_sec;
+    }
+}
+
+static int exif_copy_key_string(char *dst, const char *src)
+{
+    if ( NULL == src )
+        return 0;
+
+    if ( strlen(src) >= EXIF_KEY_STRING_MAX )
+        return -1;
+
+    strcpy(dst, src);
+
+    return 0;
+}
+
+/* Returns -1 if the configuration can't be cached */
+static int exif_make_key(exif_template_key *key, exif_params *par, gps_data *gps)
+{
+    memset(key, 0, sizeof(*key));
+
+    key->has_orientation = ( 0 != exif_orientation(par->rotation) );
+    key->has_metering = ( 0 != exif_metering_mode(par->metering_mode) );
+    key->has_iso = ( -1 != exif_iso(par->iso) );
+
+    if ( NULL == gps )
+        return 0;
+
+    key->has_gps = 1;
+    key->has_datestamp = ( strlen(gps->datestamp) == 10 );
+    if ( NULL != gps->versionId ) {
+        key->has_version = 1;
+        memcpy(key->versionId, gps->versionId, sizeof(key->versionId));
+    }
+
+    if ( exif_copy_key_string(key->latRef, gps->latRef) ||
+         exif_copy_key_string(key->longRef, gps->longRef) ||
+         exif_copy_key_string(key->mapdatum, gps->mapdatum) ||
+         exif_copy_key_string(key->procMethod, gps->procMethod) )
+        return -1;
+
+    return 0;
+}
+
+static ExifData *exif_build(exif_params *par, gps_data *gps)
+{
+    ExifData *pEd;
+    ExifRational sR;
+    char dateTime[20], subSec[7];
 
     pEd = exif_data_new ();
 
     if(pEd == NULL)
-        goto EXIT;
+        return NULL;
 
     exif_entry_set_string (pEd, EXIF_IFD_0, EXIF_TAG_MAKE, "Zoom");
     exif_entry_set_string (pEd, EXIF_IFD_0, EXIF_TAG_MODEL, "SONY IU046");
@@ -331,20 +544,8 @@ exif_buffer *get_exif_buffer(void *params, void *gpsLocation)
     exif_entry_set_short(pEd, EXIF_IFD_0, EXIF_TAG_IMAGE_LENGTH, par->width);
     exif_entry_set_short(pEd, EXIF_IFD_0, EXIF_TAG_IMAGE_WIDTH, par->height);
 
-    switch( par->rotation ) {
-        case 0:
-            exif_entry_set_short(pEd, EXIF_IFD_0, EXIF_TAG_ORIENTATION, 1);
-            break;
-        case 90:
-            exif_entry_set_short(pEd, EXIF_IFD_0, EXIF_TAG_ORIENTATION, 6);
-            break;
-        case 180:
-            exif_entry_set_short(pEd, EXIF_IFD_0, EXIF_TAG_ORIENTATION, 3);
-            break;
-        case 270:
-            exif_entry_set_short(pEd, EXIF_IFD_0, EXIF_TAG_ORIENTATION, 8);
-            break;
-    };
+    if ( exif_orientation(par->rotation) )
+        exif_entry_set_short(pEd, EXIF_IFD_0, EXIF_TAG_ORIENTATION, exif_orientation(par->rotation));
 
     sR.numerator = 4*100+68;
     sR.denominator = 100;
@@ -352,41 +553,11 @@ exif_buffer *get_exif_buffer(void *params, void *gpsLocation)
 
     exif_entry_set_short(pEd, EXIF_IFD_EXIF, EXIF_TAG_FLASH, 0);
 
-    switch( par->metering_mode ) {
-        case EXIF_CENTER:
-            exif_entry_set_short(pEd, EXIF_IFD_EXIF, EXIF_TAG_METERING_MODE, 1);
-            break;
-        case EXIF_AVERAGE:
-            exif_entry_set_short(pEd, EXIF_IFD_EXIF, EXIF_TAG_METERING_MODE, 2);
-            break;
-    };
+    if ( exif_metering_mode(par->metering_mode) )
+        exif_entry_set_short(pEd, EXIF_IFD_EXIF, EXIF_TAG_METERING_MODE, exif_metering_mode(par->metering_mode));
 
-    switch( par->iso ) {
-        case EXIF_ISO_AUTO:
-            exif_entry_set_short(pEd, EXIF_IFD_EXIF, EXIF_TAG_ISO_SPEED_RATINGS, 0);
-            break;
-        case EXIF_ISO_100:
-            exif_entry_set_short(pEd, EXIF_IFD_EXIF, EXIF_TAG_ISO_SPEED_RATINGS, 100);
-            break;
-        case EXIF_ISO_200:
-            exif_entry_set_short(pEd, EXIF_IFD_EXIF, EXIF_TAG_ISO_SPEED_RATINGS, 200);
-            break;
-        case EXIF_ISO_400:
-            exif_entry_set_short(pEd, EXIF_IFD_EXIF, EXIF_TAG_ISO_SPEED_RATINGS, 400);
-            break;
-        case EXIF_ISO_800:
-            exif_entry_set_short(pEd, EXIF_IFD_EXIF, EXIF_TAG_ISO_SPEED_RATINGS, 800);
-            break;
-        case EXIF_ISO_1000:
-            exif_entry_set_short(pEd, EXIF_IFD_EXIF, EXIF_TAG_ISO_SPEED_RATINGS, 1000);
-            break;
-        case EXIF_ISO_1200:
-            exif_entry_set_short(pEd, EXIF_IFD_EXIF, EXIF_TAG_ISO_SPEED_RATINGS, 1200);
-            break;
-        case EXIF_ISO_1600:
-            exif_entry_set_short(pEd, EXIF_IFD_EXIF, EXIF_TAG_ISO_SPEED_RATINGS, 1600);
-            break;
-    };
+    if ( -1 != exif_iso(par->iso) )
+        exif_entry_set_short(pEd, EXIF_IFD_EXIF, EXIF_TAG_ISO_SPEED_RATINGS, exif_iso(par->iso));
 
     sR.numerator = par->zoom*100;
     sR.denominator = 100;
@@ -438,73 +609,43 @@ exif_buffer *get_exif_buffer(void *params, void *gpsLocation)
     exif_entry_set_string(pEd, EXIF_IFD_INTEROPERABILITY, EXIF_TAG_INTEROPERABILITY_INDEX, "R98");
 
     /* time */
-    /* this sould be last resort */
-    res = gettimeofday (&sTv, NULL);
-    sTime = localtime (&sTv.tv_sec);
-    if (res == 0 && sTime != NULL) {
-        TimeStr = (char *) malloc(20);/* No data for secondary sensor */
-
-        if (TimeStr != NULL) {
-            snprintf(TimeStr, 20, "%04d:%02d:%02d %02d:%02d:%02d",
-                 sTime->tm_year + 1900,
-                 sTime->tm_mon + 1,
-                 sTime->tm_mday,
-                 sTime->tm_hour,
-                 sTime->tm_min,
-                 sTime->tm_sec
-                );
-            exif_entry_set_string (pEd, EXIF_IFD_0, EXIF_TAG_DATE_TIME, TimeStr);
-            exif_entry_set_string (pEd, EXIF_IFD_EXIF, EXIF_TAG_DATE_TIME_ORIGINAL, TimeStr);
-            exif_entry_set_string (pEd, EXIF_IFD_EXIF, EXIF_TAG_DATE_TIME_DIGITIZED, TimeStr);
-            snprintf(TimeStr, 20, "%06d", (int) sTv.tv_usec);
-            exif_entry_set_string (pEd, EXIF_IFD_EXIF, EXIF_TAG_SUB_SEC_TIME, TimeStr);
-            exif_entry_set_string (pEd, EXIF_IFD_EXIF, EXIF_TAG_SUB_SEC_TIME_ORIGINAL, TimeStr);
-            exif_entry_set_string (pEd, EXIF_IFD_EXIF, EXIF_TAG_SUB_SEC_TIME_DIGITIZED, TimeStr);
-            free (TimeStr);
-            TimeStr = NULL;
-        } else {
-            printf ("%s():%d:!!!!!ERROR:  malloc Failed.\n",__FUNCTION__,__LINE__);
-        }
-    } else {
-        printf ("Error in time recognition. res: %d sTime: %p\n%s\n", res, sTime, strerror(errno));
-    }
+    exif_get_time(dateTime, subSec);
+    exif_entry_set_string (pEd, EXIF_IFD_0, EXIF_TAG_DATE_TIME, dateTime);
+    exif_entry_set_string (pEd, EXIF_IFD_EXIF, EXIF_TAG_DATE_TIME_ORIGINAL, dateTime);
+    exif_entry_set_string (pEd, EXIF_IFD_EXIF, EXIF_TAG_DATE_TIME_DIGITIZED, dateTime);
+    exif_entry_set_string (pEd, EXIF_IFD_EXIF, EXIF_TAG_SUB_SEC_TIME, subSec);
+    exif_entry_set_string (pEd, EXIF_IFD_EXIF, EXIF_TAG_SUB_SEC_TIME_ORIGINAL, subSec);
+    exif_entry_set_string (pEd, EXIF_IFD_EXIF, EXIF_TAG_SUB_SEC_TIME_DIGITIZED, subSec);
 
     exif_entry_set_short (pEd, EXIF_IFD_1, EXIF_TAG_COMPRESSION, 6); /* JPEG */
     exif_entry_set_long (pEd, EXIF_IFD_1, EXIF_TAG_JPEG_INTERCHANGE_FORMAT, 0xFFFFFFFF);
     exif_entry_set_long (pEd, EXIF_IFD_1, EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH, 0xFFFFFFFF);
 
-    if ( NULL != gpsLocation ) {
-        ExifRational r1, r2, r3;
-        gps_data *gps = (gps_data *) gpsLocation;
-        
+    if ( NULL != gps ) {
+        ExifRational r1, r2, r3, t[3];
+
         /* gps data */
         r1.denominator = 1;
         r2.denominator = 1;
         r3.denominator = 1;
-        
+
         r1.numerator = gps->longDeg;
         r2.numerator = gps->longMin;
         r3.numerator = gps->longSec;
-        
+
         exif_entry_set_gps_coord(pEd, EXIF_IFD_GPS, (ExifTag) EXIF_TAG_GPS_LONGITUDE, r1, r2, r3);
-        
+
         r1.numerator = gps->latDeg;
         r2.numerator = gps->latMin;
         r3.numerator = gps->latSec;
-        
+
         exif_entry_set_gps_coord(pEd, EXIF_IFD_GPS, (ExifTag) EXIF_TAG_GPS_LATITUDE, r1, r2, r3);
-    
+
         r1.numerator = gps->altitude;
         exif_entry_set_gps_altitude(pEd, EXIF_IFD_GPS, (ExifTag) EXIF_TAG_GPS_ALTITUDE, r1);
 
-        sTime = localtime ((const time_t*) &gps->timestamp);
-        if ( NULL != sTime ) {
-            r1.numerator = sTime->tm_hour;
-            r2.numerator = sTime->tm_min;
-            r3.numerator = sTime->tm_sec;
-
-            exif_entry_set_gps_coord(pEd, EXIF_IFD_GPS, (ExifTag) EXIF_TAG_GPS_TIME_STAMP, r1, r2, r3);
-        }
+        exif_gps_time(gps, t);
+        exif_entry_set_gps_coord(pEd, EXIF_IFD_GPS, (ExifTag) EXIF_TAG_GPS_TIME_STAMP, t[0], t[1], t[2]);
 
         exif_entry_set_byte(pEd, EXIF_IFD_GPS, (ExifTag) EXIF_TAG_GPS_ALTITUDE_REF, (ExifByte) gps->altitudeRef);
 
@@ -540,19 +681,263 @@ exif_buffer *get_exif_buffer(void *params, void *gpsLocation)
             exif_entry_set_gps_version(pEd, EXIF_IFD_GPS, (ExifTag) EXIF_TAG_GPS_VERSION_ID, gps->versionId[0], gps->versionId[1], gps->versionId[2], gps->versionId[3]);
     }
 
+    return pEd;
+}
+
+/* Records where the value of every patched tag of one IFD lives */
+static int exif_template_walk(exif_template *t, unsigned int ifdOffset, ExifIfd ifd,
+    unsigned int *exifIfd, unsigned int *gpsIfd)
+{
+    const unsigned char *tiff = t->data + EXIF_TIFF_START;
+    unsigned int tiffSize = t->size - EXIF_TIFF_START;
+    unsigned int count, i, f, tag, size, valueOffset;
+    const unsigned char *entry;
+    ExifFormat format;
+
+    if ( ifdOffset + 2 > tiffSize )
+        return -1;
+
+    count = exif_get_short(tiff + ifdOffset, t->order);
+    if ( ifdOffset + 2 + count * 12 > tiffSize )
+        return -1;
+
+    for ( i = 0; i < count; i++ ) {
+        entry = tiff + ifdOffset + 2 + i * 12;
+        tag = exif_get_short(entry, t->order);
+
+        if ( ( EXIF_IFD_0 == ifd ) && ( EXIF_TAG_EXIF_IFD_POINTER == tag ) )
+            *exifIfd = exif_get_long(entry + 8, t->order);
+        else if ( ( EXIF_IFD_0 == ifd ) && ( EXIF_TAG_GPS_INFO_IFD_POINTER == tag ) )
+            *gpsIfd = exif_get_long(entry + 8, t->order);
+
+        for ( f = 0; f < EXIF_FIELD_COUNT; f++ ) {
+            if ( ( exif_fields[f].ifd != ifd ) || ( exif_fields[f].tag != (int) tag ) )
+                continue;
+
+            format = (ExifFormat) exif_get_short(entry + 2, t->order);
+            t->components[f] = exif_get_long(entry + 4, t->order);
+            size = exif_format_get_size(format) * t->components[f];
+
+            /* Values up to 4 bytes are stored in the entry itself */
+            if ( size <= 4 )
+                valueOffset = ( entry + 8 ) - tiff;
+            else
+                valueOffset = exif_get_long(entry + 8, t->order);
+
+            if ( ( 0 == size ) || ( valueOffset + size > tiffSize ) )
+                return -1;
+
+            t->format[f] = format;
+            t->offset[f] = EXIF_TIFF_START + valueOffset;
+        }
+    }
+
+    return 0;
+}
+
+static int exif_template_locate(exif_template *t)
+{
+    unsigned int exifIfd = 0, gpsIfd = 0;
+    int f;
+
+    for ( f = 0; f < EXIF_FIELD_COUNT; f++ )
+        t->offset[f] = -1;
+
+    if ( ( t->size < EXIF_TIFF_START + 8 ) || memcmp(t->data, "Exif\0\0", EXIF_TIFF_START) )
+        return -1;
+
+    if ( exif_template_walk(t, exif_get_long(t->data + EXIF_TIFF_START + 4, t->order), EXIF_IFD_0, &exifIfd, &gpsIfd) )
+        return -1;
+
+    if ( ( 0 == exifIfd ) || exif_template_walk(t, exifIfd, EXIF_IFD_EXIF, &exifIfd, &gpsIfd) )
+        return -1;
+
+    if ( t->key.has_gps && ( ( 0 == gpsIfd ) || exif_template_walk(t, gpsIfd, EXIF_IFD_GPS, &exifIfd, &gpsIfd) ) )
+        return -1;
+
+    return 0;
+}
+
+static int exif_patch_number(const exif_template *t, unsigned char *data, int f, unsigned int n)
+{
+    if ( ( t->offset[f] < 0 ) || ( 1 != t->components[f] ) )
+        return -1;
+
+    switch ( t->format[f] ) {
+        case EXIF_FORMAT_BYTE:
+            data[t->offset[f]] = (unsigned char) n;
+            break;
+        case EXIF_FORMAT_SHORT:
+            exif_set_short(data + t->offset[f], t->order, (ExifShort) n);
+            break;
+        case EXIF_FORMAT_LONG:
+            exif_set_long(data + t->offset[f], t->order, (ExifLong) n);
+            break;
+        default:
+            return -1;
+    };
+
+    return 0;
+}
+
+static int exif_patch_rational(const exif_template *t, unsigned char *data, int f, const ExifRational *r, unsigned int count)
+{
+    unsigned int i;
+
+    if ( ( t->offset[f] < 0 ) || ( EXIF_FORMAT_RATIONAL != t->format[f] ) || ( count != t->components[f] ) )
+        return -1;
+
+    for ( i = 0; i < count; i++ )
+        exif_set_rational(data + t->offset[f] + i * exif_format_get_size(EXIF_FORMAT_RATIONAL), t->order, r[i]);
+
+    return 0;
+}
+
+static int exif_patch_string(const exif_template *t, unsigned char *data, int f, const char *s)
+{
+    if ( ( t->offset[f] < 0 ) || ( EXIF_FORMAT_ASCII != t->format[f] ) || ( strlen(s) + 1 != t->components[f] ) )
+        return -1;
+
+    memcpy(data + t->offset[f], s, t->components[f]);
+
+    return 0;
+}
+
+/* Writes the per shot values into a copy of the template, fails if the layout doesn't match */
+static int exif_template_patch(const exif_template *t, unsigned char *data, exif_params *par, gps_data *gps)
+{
+    ExifRational r[3];
+    char dateTime[20], subSec[7];
+    int ret = 0;
+
+    ret |= exif_patch_number(t, data, EXIF_FIELD_IMAGE_LENGTH, par->width);
+    ret |= exif_patch_number(t, data, EXIF_FIELD_IMAGE_WIDTH, par->height);
+
+    if ( t->key.has_orientation )
+        ret |= exif_patch_number(t, data, EXIF_FIELD_ORIENTATION, exif_orientation(par->rotation));
+    if ( t->key.has_metering )
+        ret |= exif_patch_number(t, data, EXIF_FIELD_METERING_MODE, exif_metering_mode(par->metering_mode));
+    if ( t->key.has_iso )
+        ret |= exif_patch_number(t, data, EXIF_FIELD_ISO, exif_iso(par->iso));
+
+    r[0].numerator = par->zoom*100;
+    r[0].denominator = 100;
+    ret |= exif_patch_rational(t, data, EXIF_FIELD_DIGITAL_ZOOM, r, 1);
+
+    ret |= exif_patch_number(t, data, EXIF_FIELD_WHITE_BALANCE, ( EXIF_WB_AUTO == par->wb ) ? 0 : 1);
+
+    r[0].numerator = par->exposure;
+    r[0].denominator = 1000000;
+    ret |= exif_patch_rational(t, data, EXIF_FIELD_EXPOSURE_TIME, r, 1);
+
+    exif_get_time(dateTime, subSec);
+    ret |= exif_patch_string(t, data, EXIF_FIELD_DATE_TIME, dateTime);
+    ret |= exif_patch_string(t, data, EXIF_FIELD_DATE_TIME_ORIGINAL, dateTime);
+    ret |= exif_patch_string(t, data, EXIF_FIELD_DATE_TIME_DIGITIZED, dateTime);
+    ret |= exif_patch_string(t, data, EXIF_FIELD_SUB_SEC_TIME, subSec);
+    ret |= exif_patch_string(t, data, EXIF_FIELD_SUB_SEC_TIME_ORIGINAL, subSec);
+    ret |= exif_patch_string(t, data, EXIF_FIELD_SUB_SEC_TIME_DIGITIZED, subSec);
+
+    if ( NULL != gps ) {
+        r[0].denominator = r[1].denominator = r[2].denominator = 1;
+
+        r[0].numerator = gps->longDeg;
+        r[1].numerator = gps->longMin;
+        r[2].numerator = gps->longSec;
+        ret |= exif_patch_rational(t, data, EXIF_FIELD_GPS_LONGITUDE, r, 3);
+
+        r[0].numerator = gps->latDeg;
+        r[1].numerator = gps->latMin;
+        r[2].numerator = gps->latSec;
+        ret |= exif_patch_rational(t, data, EXIF_FIELD_GPS_LATITUDE, r, 3);
+
+        r[0].numerator = gps->altitude;
+        ret |= exif_patch_rational(t, data, EXIF_FIELD_GPS_ALTITUDE, r, 1);
+        ret |= exif_patch_number(t, data, EXIF_FIELD_GPS_ALTITUDE_REF, (unsigned char) gps->altitudeRef);
+
+        exif_gps_time(gps, r);
+        ret |= exif_patch_rational(t, data, EXIF_FIELD_GPS_TIME_STAMP, r, 3);
+
+        if ( t->key.has_datestamp )
+            ret |= exif_patch_string(t, data, EXIF_FIELD_GPS_DATE_STAMP, gps->datestamp);
+    }
+
+    return ret ? -1 : 0;
+}
+
+/*
+ * The EXIF block is serialized once per configuration (see exif_template_key)
+ * and every shot only patches the tags that change between shots: size,
+ * orientation, exposure, time and GPS. The thumbnail offsets in IFD1 are
+ * placeholders filled by the encoder.
+ */
+exif_buffer *get_exif_buffer(void *params, void *gpsLocation)
+{
+    exif_params *par;
+    gps_data *gps;
+    exif_template_key key;
+    exif_buffer *sEb = NULL;
+    ExifData *pEd;
+    int cacheable;
+
+    if ( NULL == params)
+        return NULL;
+
+    par = (exif_params *) params;
+    gps = (gps_data *) gpsLocation;
+
+    cacheable = ( 0 == exif_make_key(&key, par, gps) );
+
+    pthread_mutex_lock(&sTemplateLock);
+
+    if ( cacheable && sTemplate.valid && ( 0 == memcmp(&key, &sTemplate.key, sizeof(key)) ) ) {
+        sEb = exif_new_buf(sTemplate.data, sTemplate.size);
+        if ( ( NULL != sEb ) && ( 0 == exif_template_patch(&sTemplate, sEb->data, par, gps) ) )
+            goto EXIT;
+
+        /* Shouldn't happen, the layout only depends on the key */
+        if ( NULL != sEb )
+            exif_buf_free(sEb);
+        sEb = NULL;
+    }
+
+    sEb = (exif_buffer *) malloc (sizeof (exif_buffer));
+    if ( NULL == sEb )
+        goto EXIT;
+
+    pEd = exif_build(par, gps);
+    if ( NULL == pEd ) {
+        free(sEb);
+        sEb = NULL;
+        goto EXIT;
+    }
+
     /* copy data to our buffer */
     exif_data_save_data (pEd, &sEb->data, &sEb->size);
 
+    if ( cacheable ) {
+        free(sTemplate.data);
+        memset(&sTemplate, 0, sizeof(sTemplate));
+
+        sTemplate.data = (unsigned char *) malloc(sEb->size);
+        if ( NULL != sTemplate.data ) {
+            memcpy(sTemplate.data, sEb->data, sEb->size);
+            sTemplate.size = sEb->size;
+            sTemplate.order = exif_data_get_byte_order(pEd);
+            sTemplate.key = key;
+            /* Patching the fresh block proves every dynamic tag was found */
+            sTemplate.valid = ( 0 == exif_template_locate(&sTemplate) ) &&
+                              ( 0 == exif_template_patch(&sTemplate, sEb->data, par, gps) );
+            if ( !sTemplate.valid )
+                printf ("EXIF template layout not recognized, building every shot\n");
+        }
+    }
+
     /* destroy exif structure */
     exif_data_unref(pEd);
 
-    return sEb;
-
 EXIT:
-    if(sEb != NULL)
-        free(sEb);
-
-    return NULL;
+    pthread_mutex_unlock(&sTemplateLock);
 
+    return sEb;
 }
-
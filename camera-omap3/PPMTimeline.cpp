@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_TAG "PPMTimeline"
+#include <utils/Log.h>
+#include <cutils/atomic.h>
+
+#include "PPMTimeline.h"
+
+PPMTimeline::PPMTimeline()
+{
+    clear();
+}
+
+void PPMTimeline::clear()
+{
+    memset(mEvents, 0, sizeof(mEvents));
+    mNext = 0;
+}
+
+int64_t PPMTimeline::now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (int64_t) ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+void PPMTimeline::record(char phase, const char *name, int64_t ts, int64_t dur)
+{
+    int32_t index = android_atomic_inc(&mNext);
+    Event *event = &mEvents[index & ( TIMELINE_SIZE - 1 )];
+
+    // Invalidate the slot first, the exporter skips it until the new event is complete
+    android_atomic_write(0, &event->seq);
+
+    event->phase = phase;
+    event->tid = gettid();
+    event->ts = ts;
+    event->dur = dur;
+    strncpy(event->name, name, NAME_LENGTH - 1);
+    event->name[NAME_LENGTH - 1] = '\0';
+
+    android_atomic_write(index + 1, &event->seq);
+}
+
+void PPMTimeline::instant(const char *name)
+{
+    record('i', name, now(), 0);
+}
+
+void PPMTimeline::complete(const char *name, const struct timeval *begin)
+{
+    struct timeval wall;
+    int64_t dur;
+
+    // begin comes from gettimeofday(), measure the duration on the same clock
+    gettimeofday(&wall, NULL);
+    dur = (int64_t) ( wall.tv_sec - begin->tv_sec ) * 1000000LL + ( wall.tv_usec - begin->tv_usec );
+    if ( dur < 0 )
+        dur = 0;
+
+    int64_t end = now();
+    record('X', name, end - dur, dur);
+}
+
+void PPMTimeline::begin(const char *name)
+{
+    record('B', name, now(), 0);
+}
+
+void PPMTimeline::end(const char *name)
+{
+    record('E', name, now(), 0);
+}
+
+int PPMTimeline::exportJson(int fd) const
+{
+    char line[NAME_LENGTH * 2 + 128];
+    char name[NAME_LENGTH * 2];
+    int32_t last = mNext;
+    int32_t first = ( last > TIMELINE_SIZE ) ? ( last - TIMELINE_SIZE ) : 0;
+    pid_t pid = getpid();
+    int count = 0;
+    int len;
+
+    len = snprintf(line, sizeof(line), "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    write(fd, line, len);
+
+    for ( int32_t i = first; i < last; i++ ) {
+        const Event *event = &mEvents[i & ( TIMELINE_SIZE - 1 )];
+        Event copy = *event;
+
+        // Skip slots being rewritten or already reused by a newer event
+        if ( ( copy.seq != i + 1 ) || ( event->seq != i + 1 ) )
+            continue;
+
+        copy.name[NAME_LENGTH - 1] = '\0';
+        int n = 0;
+        for ( const char *c = copy.name; *c && ( n < (int) sizeof(name) - 2 ); c++ ) {
+            if ( ( '"' == *c ) || ( '\\' == *c ) )
+                name[n++] = '\\';
+            name[n++] = ( (unsigned char) *c < 0x20 ) ? ' ' : *c;
+        }
+        name[n] = '\0';
+
+        if ( 'X' == copy.phase ) {
+            len = snprintf(line, sizeof(line),
+                           "%s{\"name\":\"%s\",\"cat\":\"ppm\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%d,\"tid\":%d}",
+                           count ? ",\n" : "", name, (long long) copy.ts, (long long) copy.dur, pid, copy.tid);
+        } else if ( 'i' == copy.phase ) {
+            len = snprintf(line, sizeof(line),
+                           "%s{\"name\":\"%s\",\"cat\":\"ppm\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%lld,\"pid\":%d,\"tid\":%d}",
+                           count ? ",\n" : "", name, (long long) copy.ts, pid, copy.tid);
+        } else {
+            len = snprintf(line, sizeof(line),
+                           "%s{\"name\":\"%s\",\"cat\":\"ppm\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":%d,\"tid\":%d}",
+                           count ? ",\n" : "", name, copy.phase, (long long) copy.ts, pid, copy.tid);
+        }
+
+        if ( len >= (int) sizeof(line) )
+            len = sizeof(line) - 1;
+
+        write(fd, line, len);
+        count++;
+    }
+
+    len = snprintf(line, sizeof(line), "\n]}\n");
+    write(fd, line, len);
+
+    return count;
+}
+
+int PPMTimeline::exportJson(const char *path) const
+{
+    int fd, count;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if ( fd < 0 ) {
+        LOGE("Error: failed to open the file %s for writing", path);
+        return -1;
+    }
+
+    count = exportJson(fd);
+    close(fd);
+
+    LOGD("%d PPM events written to %s", count, path);
+
+    return count;
+}
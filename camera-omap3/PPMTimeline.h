@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __PPMTIMELINE_H__
+#define __PPMTIMELINE_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+/*
+ * Fixed size ring of PPM events, exported as Chrome trace event JSON
+ * (chrome://tracing, Perfetto). Recording takes no lock, a slot is claimed
+ * with an atomic increment and the oldest events get overwritten.
+ */
+class PPMTimeline
+{
+public:
+    enum {
+        TIMELINE_SIZE = 4096,   // must be a power of 2
+        NAME_LENGTH = 48,
+    };
+
+    PPMTimeline();
+
+    // Point in time event
+    void instant(const char *name);
+    // Complete event, started at begin (gettimeofday) and ending now
+    void complete(const char *name, const struct timeval *begin);
+    // Explicit begin/end pair, both ends have to use the same name and thread
+    void begin(const char *name);
+    void end(const char *name);
+
+    // Writes the recorded events to fd, returns the number of events written
+    int exportJson(int fd) const;
+    int exportJson(const char *path) const;
+
+    void clear();
+
+private:
+    struct Event {
+        volatile int32_t seq;   // slot index + 1 once the event is complete
+        char phase;
+        pid_t tid;
+        int64_t ts;             // CLOCK_MONOTONIC, us
+        int64_t dur;            // 'X' events only, us
+        char name[NAME_LENGTH];
+    };
+
+    void record(char phase, const char *name, int64_t ts, int64_t dur);
+    static int64_t now();
+
+    Event mEvents[TIMELINE_SIZE];
+    volatile int32_t mNext;
+};
+
+#endif
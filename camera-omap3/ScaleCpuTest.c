@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Host test for scale_cpu_process(). Scales synthetic UYVY frames and compares
+ * the result against a floating point bilinear reference. Returns non zero if
+ * the PSNR of any plane drops below MIN_PSNR or if the 180 degree output isn't
+ * the mirror of the unrotated one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "scale_cpu.h"
+
+#define MIN_PSNR 40.0
+
+typedef struct {
+    int inWidth, inHeight;
+    int outWidth, outHeight;
+    float zoom;
+    int crop_top, crop_left, crop_width, crop_height;
+} scale_case;
+
+static const scale_case cases[] = {
+    { 3264, 2448,  800,  480, 1.0f,    0,    0, 3264, 2448 },   /* snapshot to WVGA preview */
+    { 2592, 1944,  640,  480, 1.0f,    0,    0, 2592, 1944 },
+    {  640,  480,  176,  144, 1.0f,    0,    0,  640,  480 },
+    {  800,  480,  800,  480, 2.5f,    0,    0,  800,  480 },   /* digital zoom, upscale */
+    { 2048, 1536,  320,  240, 1.0f,  100,  256, 1024,  768 },   /* crop window */
+    {  640,  480,  320,  240, 1.0f,    0,    0,  640,  480 },   /* exact 2:1 */
+};
+
+/* Smooth test pattern, sharp content doesn't tell anything about the bilinear precision */
+static double pattern(int plane, double x, double y, int w, int h)
+{
+    switch ( plane ) {
+        case 0:
+            return 128.0 + 100.0 * sin(x * 6.0 / w) * cos(y * 5.0 / h);
+        case 1:
+            return 128.0 + 90.0 * cos(x * 4.0 / w + y * 3.0 / h);
+        default:
+            return 128.0 + 90.0 * sin(x * 3.0 / w - y * 4.0 / h);
+    }
+}
+
+static void fill_uyvy(unsigned char *buf, int w, int h)
+{
+    int x, y;
+
+    for ( y = 0; y < h; y++ ) {
+        unsigned char *p = buf + y * w * 2;
+        for ( x = 0; x < w; x += 2, p += 4 ) {
+            p[0] = (unsigned char) ( pattern(1, x + 1.0, y + 0.5, w, h) + 0.5 );
+            p[1] = (unsigned char) ( pattern(0, x + 0.5, y + 0.5, w, h) + 0.5 );
+            p[2] = (unsigned char) ( pattern(2, x + 1.0, y + 0.5, w, h) + 0.5 );
+            p[3] = (unsigned char) ( pattern(0, x + 1.5, y + 0.5, w, h) + 0.5 );
+        }
+    }
+}
+
+/* Bilinear sample of one UYVY channel at continuous input coordinates (pixel centers at .5) */
+static double sample(const unsigned char *buf, int w, int h, int channel, double x, double y)
+{
+    int step = ( 0 == channel ) ? 1 : 2;
+    int samples = w / step;
+    double fx = x / step - 0.5, fy = y - 0.5;
+    int x0, y0, x1, y1;
+    double wx, wy, v00, v01, v10, v11;
+
+    if ( fx < 0 ) fx = 0;
+    if ( fy < 0 ) fy = 0;
+    if ( fx > samples - 1 ) fx = samples - 1;
+    if ( fy > h - 1 ) fy = h - 1;
+
+    x0 = (int) fx; y0 = (int) fy;
+    x1 = ( x0 + 1 < samples ) ? x0 + 1 : x0;
+    y1 = ( y0 + 1 < h ) ? y0 + 1 : y0;
+    wx = fx - x0; wy = fy - y0;
+
+#define AT(xx, yy) ( ( 0 == channel ) ? buf[(yy) * w * 2 + (xx) * 2 + 1] : \
+                                        buf[(yy) * w * 2 + (xx) * 4 + ( ( 1 == channel ) ? 0 : 2 )] )
+    v00 = AT(x0, y0); v01 = AT(x1, y0);
+    v10 = AT(x0, y1); v11 = AT(x1, y1);
+#undef AT
+
+    return ( v00 * ( 1 - wx ) + v01 * wx ) * ( 1 - wy ) + ( v10 * ( 1 - wx ) + v11 * wx ) * wy;
+}
+
+static int run_case(const scale_case *c)
+{
+    unsigned char *in, *out, *rotated;
+    double err[3] = { 0, 0, 0 }, psnr[3], win_w, win_h, win_x, win_y, sx, sy, ref;
+    int count[3] = { 0, 0, 0 };
+    int x, y, ch, mismatch = 0, ret = 0;
+
+    in = malloc(c->inWidth * c->inHeight * 2);
+    out = malloc(c->outWidth * c->outHeight * 2);
+    rotated = malloc(c->outWidth * c->outHeight * 2);
+    if ( !in || !out || !rotated ) {
+        printf("allocation failed\n");
+        return -1;
+    }
+
+    fill_uyvy(in, c->inWidth, c->inHeight);
+
+    if ( scale_cpu_process(in, c->inWidth, c->inHeight, out, c->outWidth, c->outHeight, 0, c->zoom,
+                           c->crop_top, c->crop_left, c->crop_width, c->crop_height) ||
+         scale_cpu_process(in, c->inWidth, c->inHeight, rotated, c->outWidth, c->outHeight, 180, c->zoom,
+                           c->crop_top, c->crop_left, c->crop_width, c->crop_height) ) {
+        printf("scale_cpu_process() failed\n");
+        ret = -1;
+        goto exit;
+    }
+
+    win_w = c->crop_width / c->zoom;
+    win_h = c->crop_height / c->zoom;
+    win_x = c->crop_left + ( c->crop_width - win_w ) / 2;
+    win_y = c->crop_top + ( c->crop_height - win_h ) / 2;
+
+    for ( y = 0; y < c->outHeight; y++ ) {
+        sy = win_y + ( y + 0.5 ) * win_h / c->outHeight;
+        for ( x = 0; x < c->outWidth; x++ ) {
+            const unsigned char *p = out + y * c->outWidth * 2 + ( x & ~1 ) * 2;
+
+            sx = win_x + ( x + 0.5 ) * win_w / c->outWidth;
+            ref = sample(in, c->inWidth, c->inHeight, 0, sx, sy);
+            err[0] += ( ref - p[1 + ( x & 1 ) * 2] ) * ( ref - p[1 + ( x & 1 ) * 2] );
+            count[0]++;
+
+            if ( x & 1 )
+                continue;
+
+            /* Chroma of an output pair is centered between its two pixels */
+            sx = win_x + ( x + 1.0 ) * win_w / c->outWidth;
+            for ( ch = 1; ch < 3; ch++ ) {
+                ref = sample(in, c->inWidth, c->inHeight, ch, sx, sy);
+                err[ch] += ( ref - p[( ch - 1 ) * 2] ) * ( ref - p[( ch - 1 ) * 2] );
+                count[ch]++;
+            }
+        }
+    }
+
+    /* 180 degrees reverses the pixel order, the chroma pairs stay together */
+    for ( y = 0; y < c->outHeight && !mismatch; y++ ) {
+        const unsigned char *a = out + y * c->outWidth * 2;
+        const unsigned char *b = rotated + ( c->outHeight - 1 - y ) * c->outWidth * 2;
+        for ( x = 0; x < c->outWidth / 2; x++ ) {
+            const unsigned char *pa = a + x * 4;
+            const unsigned char *pb = b + ( c->outWidth / 2 - 1 - x ) * 4;
+            if ( pa[0] != pb[0] || pa[1] != pb[3] || pa[2] != pb[2] || pa[3] != pb[1] ) {
+                mismatch = 1;
+                break;
+            }
+        }
+    }
+
+    for ( ch = 0; ch < 3; ch++ ) {
+        double mse = err[ch] / count[ch];
+        psnr[ch] = ( mse > 0 ) ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+        if ( psnr[ch] < MIN_PSNR )
+            ret = -1;
+    }
+
+    if ( mismatch )
+        ret = -1;
+
+    printf("%s %dx%d -> %dx%d zoom %.2f crop %d,%d %dx%d: PSNR Y %.2f U %.2f V %.2f dB%s\n",
+           ret ? "FAIL" : "PASS",
+           c->inWidth, c->inHeight, c->outWidth, c->outHeight, c->zoom,
+           c->crop_left, c->crop_top, c->crop_width, c->crop_height,
+           psnr[0], psnr[1], psnr[2], mismatch ? ", 180 degree output mismatch" : "");
+
+exit:
+    free(in);
+    free(out);
+    free(rotated);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int i;
+    int failures = 0;
+
+    for ( i = 0; i < sizeof(cases) / sizeof(cases[0]); i++ ) {
+        if ( run_case(&cases[i]) )
+            failures++;
+    }
+
+    printf("%d of %d cases failed\n", failures, (int) ( sizeof(cases) / sizeof(cases[0]) ));
+
+    return failures ? 1 : 0;
+}
@@ -8,7 +8,9 @@
 
 #include <LCML_DspCodec.h>
 #include "scale.h"
+#include "scale_cpu.h"
 #include <utils/Log.h>
+#include <cutils/properties.h>
 
 #define USN_DLL_NAME "usn.dll64P"
 #define VPP_NODE_DLL "vpp_sn.dll64P"
@@ -99,6 +101,27 @@ int     pipeResized[2];
 #define READ_END    0
 #define WRITE_END   1
 
+/* Outputs up to this size are resized on the CPU, the DSP setup costs more than the resize itself */
+#define CPU_SCALE_MAX_PIXELS (800*480)
+
+/* debug.camera.scaler = auto, dsp or cpu */
+#define SCALER_PROPERTY "debug.camera.scaler"
+
+enum {
+    SCALER_AUTO,
+    SCALER_DSP,
+    SCALER_CPU
+};
+
+/* Same as PIX_YUV422I in CameraHal.h */
+#define PIX_422I 0
+
+static int scaler_mode = SCALER_AUTO;
+static int init_args[6];
+static int use_cpu = 0;
+static int cpu_capable = 0;
+static int dsp_ready = 0;
+
 /* -------------------------------------------------------------------*/
 /**
   *  GetLCMLHandle() function will be called to load LCML component 
@@ -307,7 +330,7 @@ int correct_range(int val, int range)
     return val;
 }
 
-int scale_process(void* inBuffer, int inWidth, int inHeight, void* outBuffer, int outWidth, int outHeight, int rotation, int fmt, float zoom, int crop_top, int crop_left, int crop_width, int crop_height)
+static int scale_dsp_process(void* inBuffer, int inWidth, int inHeight, void* outBuffer, int outWidth, int outHeight, int rotation, int fmt, float zoom, int crop_top, int crop_left, int crop_width, int crop_height)
 {
     OMX_ERRORTYPE eError = OMX_ErrorNone;
     OMX_U32 w,h,zfactor;
@@ -438,7 +461,7 @@ OMX_ERRORTYPE ZoomCallback (TUsnCodecEvent event,void * args [10])
     return OMX_ErrorNone;
 }
 
-int scale_init(int inWidth, int inHeight, int outWidth, int outHeight, int inFmt, int outFmt)
+static int scale_dsp_init(int inWidth, int inHeight, int outWidth, int outHeight, int inFmt, int outFmt)
 {
     LCML_CALLBACKTYPE   cb;
     OMX_ERRORTYPE       err;
@@ -481,7 +504,7 @@ int scale_init(int inWidth, int inHeight, int outWidth, int outHeight, int inFmt
     return 0;
 }
 
-int scale_deinit()
+static int scale_dsp_deinit()
 {
     OMX_ERRORTYPE err;
 
@@ -505,3 +528,89 @@ int scale_deinit()
 }
 
 
+int scale_init(int inWidth, int inHeight, int outWidth, int outHeight, int inFmt, int outFmt)
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    property_get(SCALER_PROPERTY, value, "auto");
+    if ( 0 == strcmp(value, "dsp") )
+        scaler_mode = SCALER_DSP;
+    else if ( 0 == strcmp(value, "cpu") )
+        scaler_mode = SCALER_CPU;
+    else
+        scaler_mode = SCALER_AUTO;
+
+    init_args[0] = inWidth;
+    init_args[1] = inHeight;
+    init_args[2] = outWidth;
+    init_args[3] = outHeight;
+    init_args[4] = inFmt;
+    init_args[5] = outFmt;
+
+    /* The CPU path handles 422 interleaved in and out only */
+    cpu_capable = ( PIX_422I == inFmt ) && ( PIX_422I == outFmt ) && ( SCALER_DSP != scaler_mode );
+    use_cpu = cpu_capable && ( ( SCALER_CPU == scaler_mode ) ||
+                               ( outWidth * outHeight <= CPU_SCALE_MAX_PIXELS ) );
+    dsp_ready = 0;
+
+    if ( use_cpu ) {
+        LOGD("Resizing %dx%d -> %dx%d on the CPU", inWidth, inHeight, outWidth, outHeight);
+        return 0;
+    }
+
+    if ( 0 == scale_dsp_init(inWidth, inHeight, outWidth, outHeight, inFmt, outFmt) ) {
+        dsp_ready = 1;
+        return 0;
+    }
+
+    if ( cpu_capable ) {
+        LOGE("VPP init failed, falling back to the CPU scaler");
+        use_cpu = 1;
+        return 0;
+    }
+
+    return -1;
+}
+
+int scale_process(void* inBuffer, int inWidth, int inHeight, void* outBuffer, int outWidth, int outHeight, int rotation, int fmt, float zoom, int crop_top, int crop_left, int crop_width, int crop_height)
+{
+    int cpu_ok = cpu_capable && ( PIX_422I == fmt ) && ( ( 0 == rotation ) || ( 180 == rotation ) );
+    int err;
+
+    if ( use_cpu && cpu_ok ) {
+        return scale_cpu_process(inBuffer, inWidth, inHeight, outBuffer, outWidth, outHeight,
+                                 rotation, zoom, crop_top, crop_left, crop_width, crop_height);
+    }
+
+    /* 90/270 degrees and 420 output still need the VPP */
+    if ( !dsp_ready ) {
+        if ( 0 != scale_dsp_init(init_args[0], init_args[1], init_args[2], init_args[3], init_args[4], init_args[5]) ) {
+            LOGE("VPP init failed");
+            return -1;
+        }
+        dsp_ready = 1;
+    }
+
+    err = scale_dsp_process(inBuffer, inWidth, inHeight, outBuffer, outWidth, outHeight,
+                            rotation, fmt, zoom, crop_top, crop_left, crop_width, crop_height);
+    if ( ( 0 != err ) && cpu_ok ) {
+        LOGE("VPP resize failed, retrying on the CPU");
+        err = scale_cpu_process(inBuffer, inWidth, inHeight, outBuffer, outWidth, outHeight,
+                                rotation, zoom, crop_top, crop_left, crop_width, crop_height);
+    }
+
+    return err;
+}
+
+int scale_deinit()
+{
+    int err = 0;
+
+    if ( dsp_ready )
+        err = scale_dsp_deinit();
+
+    dsp_ready = 0;
+    use_cpu = 0;
+
+    return err;
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "scale_cpu.h"
+
+/* Horizontal sampling position of a single output sample */
+typedef struct {
+    uint16_t offset0;   /* byte offset of the left sample inside the blended row */
+    uint16_t offset1;   /* byte offset of the right sample */
+    uint16_t weight;    /* weight of the right sample, 0-256 */
+} tap_t;
+
+static int clamp_range(int val, int min, int max)
+{
+    if( val < min )
+        return min;
+    else if( val > max )
+        return max;
+
+    return val;
+}
+
+/*
+ * Vertical pass. Blends two input rows with weight w1 (1-255) on the second one.
+ * All paths round the same way, so the output doesn't depend on the one used.
+ */
+static void blend_rows(const uint8_t *row0, const uint8_t *row1, uint8_t *dst, int len, unsigned int w1)
+{
+    unsigned int w0 = 256 - w1;
+    int i = 0;
+
+#if defined(__ARM_NEON__)
+
+    uint8x8_t v0 = vdup_n_u8(w0);
+    uint8x8_t v1 = vdup_n_u8(w1);
+
+    for ( ; i + 16 <= len; i += 16 ) {
+        uint8x16_t a = vld1q_u8(row0 + i);
+        uint8x16_t b = vld1q_u8(row1 + i);
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(a), v0), vget_low_u8(b), v1);
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(a), v0), vget_high_u8(b), v1);
+        vst1q_u8(dst + i, vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)));
+    }
+
+#elif defined(__SSE2__)
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i v0 = _mm_set1_epi16(w0);
+    __m128i v1 = _mm_set1_epi16(w1);
+    __m128i round = _mm_set1_epi16(128);
+
+    for ( ; i + 16 <= len; i += 16 ) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (row0 + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (row1 + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), v0),
+                                   _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), v1));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), v0),
+                                   _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), v1));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 8);
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_packus_epi16(lo, hi));
+    }
+
+#endif
+
+    for ( ; i < len; i++ ) {
+        dst[i] = ( row0[i] * w0 + row1[i] * w1 + 128 ) >> 8;
+    }
+}
+
+/* Horizontal pass, delta selects V (2) instead of U (0) for the chroma taps */
+static inline uint8_t tap(const uint8_t *row, const tap_t *t, int delta)
+{
+    return ( row[t->offset0 + delta] * ( 256 - t->weight ) + row[t->offset1 + delta] * t->weight + 128 ) >> 8;
+}
+
+int scale_cpu_process(void* inBuffer, int inWidth, int inHeight,
+                      void* outBuffer, int outWidth, int outHeight,
+                      int rotation, float zoom,
+                      int crop_top, int crop_left, int crop_width, int crop_height)
+{
+    const uint8_t *in = (const uint8_t *) inBuffer;
+    uint8_t *out = (uint8_t *) outBuffer;
+    int inPitch = inWidth * 2;
+    int outPitch = outWidth * 2;
+    int64_t win_x0, win_y0, win_w, win_h, step_x, step_y, pos;
+    int first, last, span, x, y, k, y0, y1, wy;
+    tap_t *luma_taps, *chroma_taps;
+    uint8_t *row, *dst;
+
+    if ( ( NULL == in ) || ( NULL == out ) || ( 2 > outWidth ) || ( 0 >= outHeight ) ||
+         ( 2 > inWidth ) || ( 0 >= inHeight ) || ( outWidth & 1 ) ||
+         ( ( 0 != rotation ) && ( 180 != rotation ) ) ) {
+        return -1;
+    }
+
+    crop_left = clamp_range(crop_left, 0, inWidth - 1);
+    crop_top = clamp_range(crop_top, 0, inHeight - 1);
+    crop_width = clamp_range(crop_width, 1, inWidth - crop_left);
+    crop_height = clamp_range(crop_height, 1, inHeight - crop_top);
+
+    if ( zoom < 1.0f )
+        zoom = 1.0f;
+
+    /* Source window in 16.16, the zoom is centered inside the crop rectangle */
+    win_w = (int64_t) ( ( crop_width << 16 ) / zoom );
+    win_h = (int64_t) ( ( crop_height << 16 ) / zoom );
+    win_x0 = ( (int64_t) crop_left << 16 ) + ( ( (int64_t) crop_width << 16 ) - win_w ) / 2;
+    win_y0 = ( (int64_t) crop_top << 16 ) + ( ( (int64_t) crop_height << 16 ) - win_h ) / 2;
+    step_x = win_w / outWidth;
+    step_y = win_h / outHeight;
+
+    /* Input columns touched by the taps, with margin for the chroma of the edge pixels */
+    first = clamp_range(( (int) ( win_x0 >> 16 ) - 2 ) & ~1, 0, inWidth);
+    last = clamp_range(( ( (int) ( ( win_x0 + win_w ) >> 16 ) + 4 ) + 1 ) & ~1, first + 2, inWidth & ~1);
+    span = ( last - first ) * 2;
+
+    luma_taps = (tap_t *) malloc(( outWidth + outWidth / 2 ) * sizeof(tap_t) + span);
+    if ( NULL == luma_taps )
+        return -1;
+
+    chroma_taps = luma_taps + outWidth;
+    row = (uint8_t *) ( chroma_taps + outWidth / 2 );
+
+    /* The taps only depend on the column, compute them once per frame */
+    for ( x = 0; x < outWidth; x++ ) {
+        pos = win_x0 + x * step_x + step_x / 2 - 0x8000;
+        pos = ( pos < 0 ) ? 0 : pos;
+        k = clamp_range((int) ( pos >> 16 ), first, last - 1);
+        luma_taps[x].offset0 = ( k - first ) * 2 + 1;
+        luma_taps[x].offset1 = ( ( k + 1 < last ) ? ( k + 1 - first ) : ( k - first ) ) * 2 + 1;
+        luma_taps[x].weight = ( pos >> 8 ) & 0xFF;
+    }
+
+    for ( x = 0; x < outWidth / 2; x++ ) {
+        /* Output pair x covers [2x, 2x + 2), chroma sample j covers input [2j, 2j + 2) */
+        pos = ( win_x0 + ( 2 * x + 1 ) * step_x - 0x10000 ) / 2;
+        pos = ( pos < 0 ) ? 0 : pos;
+        k = clamp_range((int) ( pos >> 16 ), first / 2, last / 2 - 1);
+        chroma_taps[x].offset0 = ( k * 2 - first ) * 2;
+        chroma_taps[x].offset1 = ( ( k + 1 < last / 2 ) ? ( k + 1 ) * 2 - first : k * 2 - first ) * 2;
+        chroma_taps[x].weight = ( pos >> 8 ) & 0xFF;
+    }
+
+    for ( y = 0; y < outHeight; y++ ) {
+        pos = win_y0 + y * step_y + step_y / 2 - 0x8000;
+        pos = ( pos < 0 ) ? 0 : pos;
+        y0 = clamp_range((int) ( pos >> 16 ), 0, inHeight - 1);
+        y1 = ( y0 + 1 < inHeight ) ? ( y0 + 1 ) : y0;
+        wy = ( pos >> 8 ) & 0xFF;
+
+        if ( 0 == wy ) {
+            memcpy(row, in + y0 * inPitch + first * 2, span);
+        } else {
+            blend_rows(in + y0 * inPitch + first * 2, in + y1 * inPitch + first * 2, row, span, wy);
+        }
+
+        if ( 180 == rotation ) {
+            dst = out + ( outHeight - 1 - y ) * outPitch + outPitch - 4;
+            for ( x = 0; x < outWidth / 2; x++, dst -= 4 ) {
+                dst[0] = tap(row, &chroma_taps[x], 0);
+                dst[1] = tap(row, &luma_taps[2 * x + 1], 0);
+                dst[2] = tap(row, &chroma_taps[x], 2);
+                dst[3] = tap(row, &luma_taps[2 * x], 0);
+            }
+        } else {
+            dst = out + y * outPitch;
+            for ( x = 0; x < outWidth / 2; x++, dst += 4 ) {
+                dst[0] = tap(row, &chroma_taps[x], 0);
+                dst[1] = tap(row, &luma_taps[2 * x], 0);
+                dst[2] = tap(row, &chroma_taps[x], 2);
+                dst[3] = tap(row, &luma_taps[2 * x + 1], 0);
+            }
+        }
+    }
+
+    free(luma_taps);
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef SCALE_CPU_H
+#define SCALE_CPU_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * CPU implementation of the VPP resize used by scale_process().
+ * Input and output are 422 interleaved UY (UYVY). The crop window is
+ * zoomed around its center and bilinearly scaled to the output size.
+ * Only 0 and 180 degree rotations are supported.
+ * Doesn't depend on the DSP or on Android, so it can be built on the host.
+ */
+int scale_cpu_process(void* inBuffer, int inWidth, int inHeight,
+                      void* outBuffer, int outWidth, int outHeight,
+                      int rotation, float zoom,
+                      int crop_top, int crop_left, int crop_width, int crop_height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCALE_CPU_H */
@@ -71,6 +71,9 @@ public:
 
     virtual status_t registerEndCaptureCallback(end_image_capture_callback callback, void *user_data);
 
+    //Appends the frame delivery and buffer ownership statistics in "camera.<stream>.<key>=<value>" format
+    virtual void dumpStats(String8 &out);
+
 protected:
 
     //-----------Interface that needs to be implemented by deriving classes --------------------
@@ -140,6 +143,19 @@ protected:
     int getFrameRefCount(void* frameBuf, CameraFrame::FrameType frameType);
     size_t getSubscriberCount(CameraFrame::FrameType frameType);
 
+    //Clears the frame delivery statistics
+    void resetFrameStats();
+
+    enum FrameStatsStream {
+        STATS_PREVIEW = 0,
+        STATS_SNAPSHOT,
+        STATS_VIDEO,
+        STATS_FRAME_DATA,
+        STATS_IMAGE,
+        STATS_RAW,
+        STATS_STREAM_COUNT
+    };
+
     enum FrameState {
         STOPPED = 0,
         RUNNING
@@ -215,6 +231,13 @@ protected:
     void *mReleaseData;
     void *mEndCaptureData;
     bool mRecording;
+
+    //Frame delivery statistics
+    static const char *sStatsStreamNames[STATS_STREAM_COUNT];
+    mutable Mutex mFrameStatsLock;
+    nsecs_t mFrameStatsStart;
+    uint32_t mFramesSent[STATS_STREAM_COUNT];
+    uint32_t mFramesUnsubscribed[STATS_STREAM_COUNT];
 };
 
 };
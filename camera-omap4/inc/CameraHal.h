@@ -45,6 +45,9 @@
 #include "Semaphore.h"
 #include "CameraProperties.h"
 #include "DebugUtils.h"
+#include "VideoMetadata.h"
+#include "LatencyHistogram.h"
+#include "TilerBufferPool.h"
 
 #define MIN_WIDTH           640
 #define MIN_HEIGHT          480
@@ -153,6 +156,8 @@ typedef struct {
 #define PARAM_BUFFER            6000
 #define INDEX_LENGTH            20
 
+#define CAMERA_MAX_FACES        35
+
 
 ///Forward declarations
 class CameraHal;
@@ -160,6 +165,26 @@ class CameraFrame;
 class CameraHalEvent;
 class DisplayFrame;
 
+///Single face rectangle in preview frame coordinates
+typedef struct
+    {
+    int32_t mLeft;
+    int32_t mTop;
+    uint32_t mWidth;
+    uint32_t mHeight;
+    int32_t mRoll;      ///In-plane rotation in degrees
+    uint32_t mScore;    ///Detection confidence
+    } CameraFace;
+
+///Fixed size face detection record attached to the preview frame the faces were detected on
+typedef struct
+    {
+    uint32_t mFrameNumber;  ///Matches CameraFrame::mFrameNumber of the source frame
+    nsecs_t mTimestamp;
+    uint32_t mFaceCount;
+    CameraFace mFaces[CAMERA_MAX_FACES];
+    } CameraFaceMetadata;
+
 class CameraFrame
     {
     public:
@@ -190,7 +215,9 @@ class CameraFrame
     mOffset(0),
     mAlignment(0),
     mFd(0),
-    mLength(0) {}
+    mLength(0),
+    mFrameNumber(0),
+    mFaceMetadata(NULL) {}
 
     //copy constructor
     CameraFrame(const CameraFrame &frame) :
@@ -203,7 +230,9 @@ class CameraFrame
     mOffset(frame.mOffset),
     mAlignment(frame.mAlignment),
     mFd(frame.mFd),
-    mLength(frame.mLength) {}
+    mLength(frame.mLength),
+    mFrameNumber(frame.mFrameNumber),
+    mFaceMetadata(frame.mFaceMetadata) {}
 
     void *mCookie;
     void *mBuffer;
@@ -214,6 +243,10 @@ class CameraFrame
     unsigned int mAlignment;
     int mFd;
     size_t mLength;
+    uint32_t mFrameNumber;
+    ///Faces detected on this frame, NULL if face detection isn't running.
+    ///Stays valid until the frame is returned
+    const CameraFaceMetadata *mFaceMetadata;
     ///@todo add other member vars like  stride etc
     };
 
@@ -292,6 +325,68 @@ typedef void (*event_callback) (CameraHalEvent *event);
 typedef void (*release_image_buffers_callback) (void *userData);
 typedef void (*end_image_capture_callback) (void *userData);
 
+/**
+  * Per frame latency tracing across the Camera HAL pipeline
+  * Each buffer slot carries a trace record, which gets stamped as the frame crosses the
+  * different pipeline stages. Completed records are aggregated into per stage histograms,
+  * both relative to the capture and relative to the preceeding stage.
+  * Tracing is disabled by default and can be enabled with "debug.camera.trace".
+  */
+class FrameTrace
+{
+public:
+
+    enum Stage
+        {
+        STAGE_CAPTURE = 0,      ///Frame filled by the camera adapter
+        STAGE_DISPATCH,         ///sendFrameToSubscribers
+        STAGE_APP_DEQUEUE,      ///AppCallbackNotifier picked the frame up
+        STAGE_APP_CALLBACK,     ///Application data callback returned
+        STAGE_DISPLAY_POST,     ///Frame queued to the display
+        STAGE_DISPLAY_DONE,     ///Frame released by the display
+        STAGE_RETURN,           ///All consumers returned the frame
+        STAGE_COUNT
+        };
+
+    enum Stream
+        {
+        STREAM_PREVIEW = 0,
+        STREAM_IMAGE,
+        STREAM_COUNT
+        };
+
+    static void setEnabled(bool enable);
+    static bool isEnabled() { return sEnabled; }
+
+    //Starts a new trace record for the frame filled inside 'buffer'
+    static void begin(void *buffer, Stream stream);
+
+    //Stamps a stage of the current trace record for 'buffer'. Only the first stamp counts.
+    static void mark(void *buffer, Stage stage);
+
+    //Drops all pending records and aggregated statistics
+    static void reset();
+
+    //Appends the per stage statistics as "trace.<stream>.<stage>.<key>=<value>" lines
+    static void dump(String8 &out);
+
+private:
+
+    typedef struct
+        {
+        Stream mStream;
+        nsecs_t mStamps[STAGE_COUNT];
+        } Record;
+
+    static void aggregateLocked(const Record &record);
+
+    static bool sEnabled;
+    static Mutex sLock;
+    static KeyedVector<unsigned int, Record> sRecords;
+    static LatencyHistogram sSinceCapture[STREAM_COUNT][STAGE_COUNT];
+    static LatencyHistogram sSincePrevious[STREAM_COUNT][STAGE_COUNT];
+};
+
 /**
   * Interface class implemented by classes that have some events to communicate to dependendent classes
   * Dependent classes use this interface for registering for events
@@ -398,6 +493,24 @@ public:
     static const int NOTIFIER_TIMEOUT;
     static const size_t EMPTY_RAW_SIZE;
     static const int32_t MAX_BUFFERS = 8;
+    static const int MAX_COPY_THREADS = 3;
+    ///Frames below this size per band are converted on the notifier thread only
+    static const int MIN_COPY_BAND_PIXELS = 320*240;
+
+    ///Frame conversion shared by all bands of a preview callback copy
+    typedef struct
+        {
+        void *mDst;
+        void *mSrc;
+        int mWidth;
+        int mHeight;
+        int mDstWidth;          ///Differs from mWidth/mHeight for downscaled callbacks
+        int mDstHeight;
+        size_t mStride;
+        uint32_t mOffset;
+        unsigned int mBytesPerPixel;
+        const char *mPixelFormat;
+        } CopyJob;
 
     enum NotifierCommands
         {
@@ -466,6 +579,12 @@ public:
     status_t initSharedVideoBuffers(void *buffers, uint32_t *offsets, int fd, size_t length, size_t count);
     status_t releaseRecordingFrame(const sp<IMemory>& mem);
 
+    //Deliver video_metadata_t descriptors instead of the mapped video frames
+    status_t useMetaDataBufferMode(bool enable);
+
+    //Appends the callback statistics as "app.<key>=<value>" lines
+    void dumpStats(String8 &out);
+
     //Internal class definitions
     class NotificationThread : public Thread {
         AppCallbackNotifier* mAppCallbackNotifier;
@@ -488,14 +607,38 @@ public:
         MessageQueue &msgQ() { return mNotificationThreadQ;}
     };
 
+    ///Converts row bands of the preview callback frames
+    class CopyThread : public Thread {
+        AppCallbackNotifier* mAppCallbackNotifier;
+        MessageQueue mCopyThreadQ;
+    public:
+        enum CopyThreadCommands
+        {
+        COPY_BAND,
+        COPY_EXIT,
+        };
+    public:
+        CopyThread(AppCallbackNotifier* nh)
+            : Thread(false), mAppCallbackNotifier(nh) { }
+        virtual bool threadLoop() {
+            mAppCallbackNotifier->copyThread(this);
+            return false;
+        }
+
+        MessageQueue &msgQ() { return mCopyThreadQ;}
+    };
+
     //Friend declarations
     friend class NotificationThread;
+    friend class CopyThread;
 
 private:
     void notifyEvent();
     void notifyFrame();
     bool processMessage();
     void releaseSharedVideoBuffers();
+    void copyFrame(void *dst, CameraFrame *frame, const char *pixelFormat, int dstWidth, int dstHeight);
+    void copyThread(CopyThread *thread);
 
 private:
     mutable Mutex mLock;
@@ -512,9 +655,13 @@ private:
     KeyedVector<unsigned int, unsigned int> mVideoBuffers;
     KeyedVector<unsigned int, unsigned int> mVideoMap;
     bool mBufferReleased;
+    bool mUseMetaDataBufferMode;
 
     CameraHal *mHardware;
     sp< NotificationThread> mNotificationThread;
+    sp<CopyThread> mCopyThreads[MAX_COPY_THREADS];
+    int mCopyThreadCount;
+    Semaphore mCopySem;
     EventProvider *mEventProvider;
     FrameProvider *mFrameProvider;
     MessageQueue mEventQ;
@@ -525,26 +672,47 @@ private:
     sp<MemoryHeapBase> mPreviewHeap;
     sp<MemoryHeapBase> mPreviewHeapArr[MAX_BUFFERS];
     sp<MemoryBase> mPreviewBuffers[MAX_BUFFERS];
+    //Full preview size views of mPreviewHeap for the postview copies, only while callbacks are downscaled
+    sp<MemoryBase> mPostviewBuffers[MAX_BUFFERS];
     int mPreviewBufCount;
     const char *mPreviewPixelFormat;
     KeyedVector<unsigned int, sp<MemoryHeapBase> > mSharedPreviewHeaps;
     KeyedVector<unsigned int, sp<MemoryBase> > mSharedPreviewBuffers;
     bool mAppSupportsStride;
 
+    //Size of the downscaled preview callbacks, 0 delivers the full preview size
+    int mCallbackWidth;
+    int mCallbackHeight;
+
     //Burst mode active
     bool mBurst;
     mutable Mutex mRecordingLock;
     bool mRecording;
     bool mMeasurementEnabled;
+
+    //Callback statistics
+    mutable Mutex mStatsLock;
+    uint32_t mFramesQueued;
+    uint32_t mPreviewCallbacks;
+    uint32_t mVideoCallbacks;
+    uint32_t mImageCallbacks;
+    uint32_t mFramesDropped;
+    uint32_t mFramesWithEncoder;
+    uint32_t mParallelCopies;
 };
 
 
 /**
   * Class used for allocating memory for JPEG bit stream buffers, output buffers of camera in no overlay case
+  * Released TILER blocks are kept inside a pool and handed out again to allocations with the same
+  * layout and dimensions. The pool size is limited by "debug.camera.tilerpool.max" (in MB, 0 disables it)
   */
 class MemoryManager : public BufferProvider, public virtual RefBase
 {
 public:
+    MemoryManager();
+    virtual ~MemoryManager();
+
     ///Initializes the display adapter creates any resources required
     status_t initialize(){ return NO_ERROR; }
 
@@ -554,9 +722,17 @@ public:
     virtual int getFd() ;
     virtual int freeBuffer(void* buf);
 
+    //Releases all blocks cached inside the pool back to MemMgr, returns the number of released blocks
+    int releasePool();
+
+    //Appends the allocation statistics as "memory.<key>=<value>" lines
+    void dumpStats(String8 &out);
+
 private:
 
     sp<ErrorNotifier> mErrorNotifier;
+
+    TilerBufferPool mPool;
 };
 
 
@@ -670,6 +846,9 @@ public:
     //API to get required picture buffers size with the current configuration in CameraParameters
     virtual status_t getPictureBufferSize(size_t &length, size_t bufferCount) = 0;
 
+    //Appends the adapter runtime statistics as "<key>=<value>" lines
+    virtual void dumpStats(String8 &out) = 0;
+
     virtual ~CameraAdapter() {};
 };
 
@@ -695,6 +874,8 @@ public:
     virtual int disableDisplay() = 0;
     //Used for Snapshot review temp. pause
     virtual status_t pauseDisplay(bool pause) = 0;
+    //Updates the visible frame size when the preview resolution changes on the same buffers
+    virtual status_t setFrameSize(int width, int height) = 0;
 
 
 #if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
@@ -707,6 +888,9 @@ public:
     virtual int useBuffers(void *bufArr, int num) = 0;
     virtual bool supportsExternalBuffering() = 0;
 
+    //Appends the display runtime statistics as "display.<key>=<value>" lines
+    virtual void dumpStats(String8 &out) = 0;
+
 };
 
 static void releaseImageBuffers(void *userData);
@@ -948,6 +1132,9 @@ private:
             /** Free preview buffers */
             status_t freePreviewBufs();
 
+            /** Reconfigure a running preview for a new resolution, reusing the preview buffers */
+            status_t switchPreviewResolution(const CameraParameters &adapterParams);
+
             /** Free video bufs */
             status_t freeVideoBufs();
 
@@ -990,6 +1177,8 @@ public:
     //User shutter override
     bool mShutterEnabled;
     bool mMeasurementEnabled;
+    //Recording frames are delivered as video_metadata_t descriptors
+    bool mVideoMetadataEnabled;
     //Google's parameter delimiter
     static const char PARAMS_DELIMITER[];
 
@@ -1072,6 +1261,9 @@ private:
 
     uint32_t mPreviewWidth;
     uint32_t mPreviewHeight;
+    ///Frame size the current preview buffers were allocated for
+    uint32_t mPreviewBufsWidth;
+    uint32_t mPreviewBufsHeight;
     int32_t mMaxZoomSupported;
 };
 
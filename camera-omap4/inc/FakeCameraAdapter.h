@@ -38,6 +38,30 @@ class FakeCameraAdapter : public BaseCameraAdapter
 
 public:
 
+    ///Synthetic content written into the generated frames
+    enum FramePattern
+        {
+            PATTERN_SOLID = 0,
+            PATTERN_RAMP,
+            PATTERN_NOISE
+        };
+
+    ///Load generator configuration. Populated from the "debug.camera.fake.*" properties
+    typedef struct
+        {
+        int mFrameRate;         ///Frames per second, 0 = as fast as buffers are returned, -1 = use preview frame rate
+        int mJitterUs;          ///Maximum random deviation of the frame interval in us.
+        int mBurstLength;       ///Frames generated back to back, 0 disables burst shaping
+        int mBurstGapMs;        ///Idle time between bursts in ms.
+        int mPattern;           ///One of FramePattern
+        int mStatsPeriod;       ///Frames between statistics logs, 0 disables periodic logging
+        bool mMockSinks;        ///Attach the mock display and app callback sinks
+        int mDisplayHoldUs;     ///Time the mock display holds a frame
+        int mDisplayDepth;      ///Maximum frames queued on the mock display before it drops
+        int mAppHoldUs;         ///Time the mock app callback sink holds a frame
+        int mAppDepth;          ///Maximum frames queued on the mock app sink before it drops
+        } LoadConfig;
+
     FakeCameraAdapter();
     ~FakeCameraAdapter();
 
@@ -64,6 +88,9 @@ public:
 
     virtual status_t getPictureBufferSize(size_t &length, size_t bufferCount);
 
+    //Appends the adapter and load generator statistics in "key=value" format
+    virtual void dumpStats(String8 &out);
+
 
 protected:
 
@@ -80,12 +107,21 @@ protected:
     status_t doAutofocus();
     virtual void frameThread();
     virtual void frameCallbackThread();
-    //Fills a given overlay buffer with a solid color depending on their index
-    // and type
+    //Fills a given overlay buffer with the configured pattern depending on the frame
+    // index and type
     void setBuffer(void *previewBuffer, int index, int width, int height, int pixelFormat, PreviewFrameType frame);
     virtual void sendNextFrame(PreviewFrameType frame);
     status_t startImageCapture();
 
+    //Load generator helpers
+    void readLoadConfig();
+    void resetStats();
+    void logStats();
+    nsecs_t nextFrameInterval();
+    void releasePreviewBuffer(unsigned int buffer);
+    status_t startMockSinks();
+    void stopMockSinks();
+
 //Internal class definitions
 
 class FrameCallback : public Thread {
@@ -112,9 +148,47 @@ class FramePreview : public Thread {
         }
 };
 
+/**
+  * Headless frame consumer used instead of a real DisplayAdapter or AppCallbackNotifier.
+  * Frames are held for a configurable amount of time and then returned back to the adapter.
+  * Frames arriving while the sink queue is full are returned immediately and counted as drops.
+  */
+class FakeFrameSink : public Thread {
+    public:
+        FakeFrameSink(FakeCameraAdapter *ca, const char *name, int32_t frameTypes, int holdUs, int depth);
+
+        virtual bool threadLoop();
+
+        status_t start();
+        void stop();
+        void dumpStats(String8 &out);
+
+        static void frameCallbackRelay(CameraFrame *frame);
+        void frameCallback(CameraFrame *frame);
+
+    private:
+        enum SinkCommands {
+            SINK_FRAME = 0,
+            SINK_EXIT
+        };
+
+        FakeCameraAdapter *mCameraAdapter;
+        const char *mName;
+        int32_t mFrameTypes;
+        nsecs_t mHold;
+        int mDepth;
+        MessageQueue mSinkQ;
+        mutable Mutex mLock;
+        int mQueued;
+        uint32_t mConsumed;
+        uint32_t mDropped;
+        LatencyHistogram mDelivery;
+};
+
     //friend declarations
     friend class FramePreview;
     friend class FrameCallback;
+    friend class FakeFrameSink;
 
     enum FrameCallbackCommands {
         CALL_CALLBACK = 0,
@@ -143,6 +217,26 @@ class FramePreview : public Thread {
     MessageQueue mCallbackQ;
     MessageQueue mFrameQ;
     MessageQueue mAdapterQ;
+
+    //Load generator state
+    LoadConfig mLoadConfig;
+    nsecs_t mNextFrameTime;
+    int mBurstCount;
+    unsigned int mRandSeed;
+    uint32_t mFrameIndex;
+
+    //Load generator statistics
+    mutable Mutex mStatsLock;
+    KeyedVector<unsigned int, nsecs_t> mFramesInFlight;
+    nsecs_t mStatsStart;
+    uint32_t mFramesGenerated;
+    uint32_t mFramesDropped;
+    uint32_t mFramesReturned;
+    LatencyHistogram mLatency;
+    LatencyHistogram mLateness;
+
+    sp<FakeFrameSink> mDisplaySink;
+    sp<FakeFrameSink> mAppSink;
 };
 
 };
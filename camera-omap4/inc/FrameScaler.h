@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef FRAME_SCALER_H
+#define FRAME_SCALER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace android {
+
+/**
+  * Software downscaler of the preview callback copies
+  * Works on a single 8-bit channel at a time, samples of a channel are a fixed number of bytes
+  * apart, so planar luma, interleaved NV12 chroma and YUV422I channels all go through the
+  * same code. Integer ratios use a box filter, any other ratio a bilinear filter. On NEON
+  * capable targets the box filter runs 8 output samples at once for up to 4 source samples
+  * per output sample horizontally, the results are the same as the ones of the C version.
+  * There are no dependencies on the rest of Camera HAL, so it can be built on the host.
+  */
+class FrameScaler
+{
+public:
+
+    ///Widest source row the NEON box filter handles, in samples
+    static const int MAX_NEON_SAMPLES = 4096;
+
+    ///Downscales rows [firstRow, lastRow) of a single channel
+    ///@param srcStep, dstStep - distance in bytes between two samples of the channel
+    static void scaleChannel(const uint8_t *src, size_t srcPitch, int srcStep, int srcWidth, int srcHeight,
+                             uint8_t *dst, size_t dstPitch, int dstStep, int dstWidth, int dstHeight,
+                             int firstRow, int lastRow);
+
+    ///C version of scaleChannel(), also used for the ratios the NEON path doesn't cover
+    static void scaleChannelC(const uint8_t *src, size_t srcPitch, int srcStep, int srcWidth, int srcHeight,
+                              uint8_t *dst, size_t dstPitch, int dstStep, int dstWidth, int dstHeight,
+                              int firstRow, int lastRow);
+
+    ///2:1 box filter of a NV12 luma row pair
+    static void halveLumaRow(const uint8_t *line0, const uint8_t *line1, uint8_t *out, int dstWidth);
+
+    ///2:1 box filter of a NV12 chroma row pair, stored with U and V swapped (NV21)
+    static void halveChromaRow(const uint8_t *line0, const uint8_t *line1, uint8_t *out, int dstPairs);
+
+private:
+
+    static bool boxNeon(const uint8_t *src, size_t srcPitch, int srcStep, int fx, int fy,
+                        uint8_t *dst, size_t dstPitch, int dstStep, int dstWidth,
+                        int firstRow, int lastRow);
+};
+
+};
+
+#endif //FRAME_SCALER_H
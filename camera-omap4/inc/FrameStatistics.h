@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef FRAME_STATISTICS_H
+#define FRAME_STATISTICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <utils/Errors.h>
+
+namespace android {
+
+/**
+  * Software image statistics engine
+  * Computes the luma histogram, per zone luma means, chroma means and a sharpness
+  * metric out of a NV12, YUYV or UYVY frame. Only a decimated grid is visited: every
+  * row step-th row and every second pixel of that row, so one sample carries one Y, U and V
+  * value for all supported layouts. On NEON capable targets 16 samples are processed at once.
+  * The engine has no dependencies on the rest of Camera HAL and doesn't keep any state
+  * between frames, so it can be used from any adapter and built on the host.
+  */
+class FrameStatistics
+{
+public:
+
+    enum PixelLayout
+        {
+        LAYOUT_NV12 = 0,    ///Y plane followed by an interleaved UV plane, both with the same stride
+        LAYOUT_YUYV,
+        LAYOUT_UYVY
+        };
+
+    static const int HISTOGRAM_BINS = 256;
+    static const int ZONES_X = 8;
+    static const int ZONES_Y = 8;
+
+    typedef struct
+        {
+        uint32_t mHistogram[HISTOGRAM_BINS];    ///Luma histogram of the visited samples
+        uint32_t mSamples;
+        uint8_t mZoneLuma[ZONES_Y][ZONES_X];    ///Mean luma of every zone
+        uint8_t mMeanLuma;
+        uint8_t mMeanU;
+        uint8_t mMeanV;
+        uint32_t mSharpness;                    ///Mean absolute horizontal luma gradient in 1/16 units
+        } Statistics;
+
+    FrameStatistics();
+
+    ///Visits only every step-th row, 1 visits all rows
+    void setRowStep(unsigned int step);
+
+    ///@param stride - line length in bytes. For NV12 the UV plane starts at height * stride
+    status_t process(const uint8_t *frame,
+                     PixelLayout layout,
+                     unsigned int width,
+                     unsigned int height,
+                     unsigned int stride,
+                     Statistics &stats) const;
+
+    ///Returns the luma value below which the requested percentage (0-100) of the samples lie
+    static uint8_t percentile(const Statistics &stats, unsigned int pct);
+
+private:
+
+    ///Running sums of a single zone row
+    typedef struct
+        {
+        uint32_t mLuma[ZONES_X];
+        uint32_t mSamples[ZONES_X];
+        } ZoneRow;
+
+    ///Pointers to the Y, U and V values of the first sample of a row
+    ///and the distance between two consecutive samples
+    typedef struct
+        {
+        const uint8_t *mY;
+        const uint8_t *mU;
+        const uint8_t *mV;
+        unsigned int mStep;
+        } RowSamples;
+
+    static void processRow(const RowSamples &row,
+                           PixelLayout layout,
+                           unsigned int samples,
+                           Statistics &stats,
+                           ZoneRow &zones,
+                           uint32_t &sumU,
+                           uint32_t &sumV,
+                           uint32_t &sumGradient);
+
+    static void processSamples(const RowSamples &row,
+                               unsigned int first,
+                               unsigned int last,
+                               unsigned int samples,
+                               Statistics &stats,
+                               ZoneRow &zones,
+                               uint32_t &sumU,
+                               uint32_t &sumV,
+                               uint32_t &sumGradient);
+
+    unsigned int mRowStep;
+};
+
+};
+
+#endif //FRAME_STATISTICS_H
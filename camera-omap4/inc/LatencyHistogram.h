@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+#include <utils/threads.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+/**
+  * Latency histogram used for collecting performance statistics inside Camera HAL
+  * Samples are stored in microseconds inside log-linear buckets (8 buckets per power of two),
+  * which keeps the relative error below 12.5% while using a fixed amount of memory
+  */
+class LatencyHistogram
+{
+public:
+    static const int SUB_BUCKETS = 8;
+    static const int NUM_BUCKETS = SUB_BUCKETS * 30;
+
+    LatencyHistogram() { reset(); }
+
+    void reset();
+
+    //Adds a sample given in nanoseconds. Negative samples are clamped to zero
+    void add(nsecs_t sample);
+
+    uint32_t count() const;
+
+    //Returns the requested percentile (0-100) in microseconds
+    uint32_t percentile(unsigned int pct) const;
+
+    //Appends the statistics as "<name>.<key>=<value>" lines
+    void dump(String8 &out, const char *name) const;
+
+private:
+    static int bucketIndex(uint32_t us);
+    static uint32_t bucketValue(int index);
+    uint32_t percentileLocked(unsigned int pct) const;
+
+    mutable Mutex mLock;
+    uint32_t mBuckets[NUM_BUCKETS];
+    uint32_t mCount;
+    uint64_t mSum;
+    uint32_t mMin;
+    uint32_t mMax;
+};
+
+};
+
+#endif //LATENCY_HISTOGRAM_H
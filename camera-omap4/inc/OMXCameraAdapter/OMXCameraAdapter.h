@@ -355,6 +355,9 @@ public:
 
     virtual status_t getFrameDataSize(size_t &dataFrameSize, size_t bufferCount);
 
+    //Appends the adapter and OMX command latency statistics in "key=value" format
+    virtual void dumpStats(String8 &out);
+
  OMX_ERRORTYPE OMXCameraAdapterEventHandler(OMX_IN OMX_HANDLETYPE hComponent,
                                     OMX_IN OMX_EVENTTYPE eEvent,
                                     OMX_IN OMX_U32 nData1,
@@ -469,8 +472,8 @@ private:
     //Face detection
     status_t updateFocusDistances(CameraParameters &params);
     status_t setFaceDetection(bool enable);
-    status_t detectFaces(OMX_BUFFERHEADERTYPE* pBuffHeader);
-    status_t encodeFaceCoordinates(const OMX_FACEDETECTIONTYPE *faceData, char *faceString, size_t faceStringSize);
+    status_t detectFaces(OMX_BUFFERHEADERTYPE* pBuffHeader, CameraFaceMetadata &faces);
+    status_t encodeFaceCoordinates(const CameraFaceMetadata &faces, char *faceString, size_t faceStringSize);
 
     //3A Algorithms priority configuration
     status_t setAlgoPriority(AlgoPriority priority, Algorithm3A algo, bool enable);
@@ -626,8 +629,12 @@ private:
     mutable Mutex mFaceDetectionLock;
     //Face detection status
     bool mFaceDetectionRunning;
-    //Buffer for storing face detection results
+    //Buffer for the face detection results in the legacy parameter format
     char mFaceDectionResult [FACE_DETECTION_BUFFER_SIZE];
+    //Binary face detection results, one record per preview buffer
+    CameraFaceMetadata mFaceMetadata[MAX_NO_BUFFERS];
+    const CameraFaceMetadata *mLastFaceMetadata;
+    uint32_t mPreviewFrameNumber;
     //Face detection threshold
     static const uint32_t FACE_THRESHOLD_DEFAULT = 100;
     uint32_t mFaceDetectionThreshold;
@@ -721,6 +728,11 @@ private:
     CodingMode mCodingMode;
     Mutex mEventLock;
 
+    //Time between event registration and completion, one histogram per OMX_COMMANDTYPE
+    //up to OMX_CommandPortEnable. All other events are collected in mEventLatency.
+    LatencyHistogram mCommandLatency[OMX_CommandPortEnable + 1];
+    LatencyHistogram mEventLatency;
+
     // Time source delta of ducati & system time
     OMX_TICKS mTimeSourceDelta;
     bool onlyOnce;
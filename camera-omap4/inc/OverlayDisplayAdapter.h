@@ -67,6 +67,7 @@ public:
     virtual int enableDisplay(struct timeval *refTime = NULL, S3DParameters *s3dParams = NULL);
     virtual int disableDisplay();
     virtual status_t pauseDisplay(bool pause);
+    virtual status_t setFrameSize(int width, int height);
 
 #if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
 
@@ -84,6 +85,8 @@ public:
     virtual int getFd() ;
     virtual int freeBuffer(void* buf);
 
+    virtual void dumpStats(String8 &out);
+
     ///Class specific functions
     static void frameCallbackRelay(CameraFrame* caFrame);
     void frameCallback(CameraFrame* caFrame);
@@ -95,6 +98,7 @@ public:
     bool processHalMsg();
     status_t PostFrame(OverlayDisplayAdapter::DisplayFrame &dispFrame);
     bool handleFrameReturn();
+    void dropFrame(void *frameBuf);
 
 public:
 
@@ -165,6 +169,15 @@ private:
 
     const char *mPixelFormat;
 
+    //Display statistics
+    mutable Mutex mStatsLock;
+    nsecs_t mStatsStart;
+    uint32_t mFramesPosted;
+    uint32_t mFramesDropped;
+    uint32_t mFramesDequeued;
+    uint32_t mFramesReclaimed;
+    uint32_t mTotalFailedDQs;
+
 #if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
     //Used for calculating standby to first shot
     struct timeval mStandbyToShot;
@@ -69,6 +69,8 @@ static const char  KEY_TEMP_BRACKETING_RANGE_NEG[];
 static const char  KEY_SHUTTER_ENABLE[];
 static const char  KEY_TOUCH_FOCUS_POS[];
 static const char  KEY_MEASUREMENT_ENABLE[];
+static const char  KEY_VIDEO_METADATA[];
+static const char  KEY_PREVIEW_CALLBACK_SIZE[];
 static const char  KEY_INITIAL_VALUES[];
 static const char  KEY_GBCE[];
 static const char  KEY_GLBCE[];
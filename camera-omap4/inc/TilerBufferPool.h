@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef TILER_BUFFER_POOL_H
+#define TILER_BUFFER_POOL_H
+
+#include <stdint.h>
+#include <utils/threads.h>
+#include <utils/KeyedVector.h>
+#include <utils/Vector.h>
+#include <utils/String8.h>
+
+namespace android {
+
+/**
+  * Bookkeeping of the TILER blocks handed out by MemoryManager
+  * Released blocks are kept inside a pool and handed out again to allocations with the same
+  * layout and dimensions. Once the pool grows above its limit the least recently used blocks
+  * go back to MemMgr. Only MemMgr and libutils are needed, so it can be built on the host.
+  */
+class TilerBufferPool
+{
+public:
+
+    ///TILER layout of a single buffer
+    enum BufferLayout
+        {
+        LAYOUT_1D = 0,          ///PAGE mode buffer
+        LAYOUT_2D_16BIT,        ///One 16-bit plane (YUV422I, RGB565, RAW)
+        LAYOUT_2D_NV12          ///8-bit luma plane followed by a 16-bit chroma plane
+        };
+
+    ///Buffers with matching keys are interchangeable
+    typedef struct
+        {
+        int mLayout;
+        int mWidth;
+        int mHeight;
+        int mBytes;
+        } BufferKey;
+
+    TilerBufferPool();
+    ~TilerBufferPool();
+
+    //Limits the memory kept inside the pool, 0 disables it
+    void setMaxBytes(size_t maxBytes);
+
+    //Estimates the memory backing a single buffer
+    static size_t estimateBytes(const BufferKey &key);
+
+    //Returns a block matching the key, either from the pool or freshly allocated from MemMgr
+    //with the given MemAllocBlock array. Returns 0 on failure
+    uint32_t allocateBlock(const BufferKey &key, void *allocBlocks, int numBlocks);
+
+    //Records a NULL terminated array of count blocks allocated with the same key
+    void addAllocation(uint32_t *blocks, const BufferKey &key, uint32_t count);
+
+    //Counts an allocation which couldn't be completed
+    void addFailedAllocation();
+
+    //Releases the blocks of a NULL terminated array. Blocks of a recorded allocation go
+    //to the pool if they fit, anything else goes straight back to MemMgr
+    int freeBlocks(uint32_t *blocks);
+
+    //Releases all blocks cached inside the pool back to MemMgr, returns the number of released blocks
+    int releasePool();
+
+    size_t poolBytes();
+    uint32_t poolBlocks();
+
+    //Appends the allocation statistics as "memory.<key>=<value>" lines
+    void dumpStats(String8 &out);
+
+private:
+
+    typedef struct
+        {
+        BufferKey mKey;
+        size_t mBytes;          ///Estimated footprint of a single buffer
+        uint32_t mCount;
+        } Allocation;
+
+    typedef struct
+        {
+        BufferKey mKey;
+        size_t mBytes;
+        uint32_t mBlock;
+        } PoolEntry;
+
+    static bool keysMatch(const BufferKey &a, const BufferKey &b);
+    int trimPoolLocked(size_t maxBytes);
+
+    Mutex mLock;
+    KeyedVector<unsigned int, Allocation> mAllocations;
+
+    //Released blocks, least recently used first
+    Vector<PoolEntry> mPool;
+    size_t mPoolBytes;
+    size_t mPoolMaxBytes;
+
+    //Allocation statistics
+    size_t mAllocatedBytes;
+    size_t mPeakBytes;
+    uint32_t mAllocatedBuffers;
+    uint32_t mFailedAllocations;
+    uint32_t mPoolHits;
+    uint32_t mPoolMisses;
+    uint32_t mPoolEvictions;
+    uint32_t mPoolPressureFlushes;
+};
+
+};
+
+#endif //TILER_BUFFER_POOL_H
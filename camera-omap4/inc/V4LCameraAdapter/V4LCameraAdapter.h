@@ -25,6 +25,8 @@
 #include "CameraHal.h"
 #include "BaseCameraAdapter.h"
 #include "DebugUtils.h"
+#include "V4LCaptureDevice.h"
+#include "FrameStatistics.h"
 
 namespace android {
 
@@ -65,6 +67,15 @@ public:
     ///Five second timeout
     static const int CAMERA_ADAPTER_TIMEOUT = 5000*1000;
 
+    ///Maximum time the preview thread waits for a frame before checking for exit requests
+    static const int FRAME_POLL_TIMEOUT_MS = 100;
+
+    ///Software 3A: mean luma targeted by AE and the tolerated deviation from it
+    static const int AE_TARGET_LUMA = 110;
+    static const int AE_TOLERANCE = 8;
+    ///Tolerated deviation of the mean chroma from neutral gray for AWB
+    static const int AWB_TOLERANCE = 2;
+
 public:
 
     V4LCameraAdapter();
@@ -98,6 +109,12 @@ public:
 
     virtual status_t getFrameDataSize(size_t &dataFrameSize, size_t bufferCount);
 
+    //Appends the adapter and frame timing statistics in "key=value" format
+    virtual void dumpStats(String8 &out);
+
+    //Clears the frame timing statistics
+    void resetStats();
+
 protected:
 
 //----------Parent class method implementation------------------------------------
@@ -138,6 +155,25 @@ private:
 
     char * GetFrame(int &index);
 
+    //Updates the frame timing statistics with a freshly dequeued buffer
+    void updateFrameStats(const struct v4l2_buffer &buf, nsecs_t dequeueTime);
+
+    ///Driver control used by the software 3A
+    typedef struct
+        {
+        uint32_t mId;
+        bool mAvailable;
+        int mMin;
+        int mMax;
+        int mValue;
+        } V4LControl;
+
+    //Software 3A for sensors without ISP statistics
+    void initSoftware3A();
+    void runSoftware3A(const uint8_t *frame, int width, int height);
+    void queryControl(V4LControl &control, uint32_t id);
+    status_t setControl(V4LControl &control, int value);
+
     int previewThread();
 
 public:
@@ -167,12 +203,41 @@ private:
      sp<PreviewThread>   mPreviewThread;
 
      struct VideoInfo *mVideoInfo;
-     int mCameraHandle;
+     V4LCaptureDevice *mDevice;
 
 
     int nQueued;
     int nDequeued;
 
+    //Frame timing statistics
+    mutable Mutex mStatsLock;
+    LatencyHistogram mDriverLatency;    ///Driver timestamp to dequeue
+    LatencyHistogram mFrameInterval;    ///Between consecutive driver timestamps
+    LatencyHistogram mDequeueInterval;  ///Between consecutive dequeues
+    LatencyHistogram mIntervalJitter;   ///Deviation of the frame interval from the nominal one
+    nsecs_t mLastDriverTime;
+    nsecs_t mLastDequeueTime;
+    uint32_t mLastSequence;
+    uint32_t mSequenceGaps;             ///Frames skipped by the driver
+    uint32_t mIntervalGaps;             ///Intervals longer than 1.5 nominal intervals
+    uint32_t mPollTimeouts;
+    bool mRealtimeTimestamps;
+
+    //Software 3A state, protected by mStatsLock
+    FrameStatistics mFrameStatistics;
+    FrameStatistics::Statistics mStatistics;
+    bool mStatisticsValid;
+    int m3APeriod;                      ///Frames between two 3A iterations, 0 disables software 3A
+    unsigned int m3AFrames;
+    bool mSoftAE;
+    bool mSoftAWB;
+    V4LControl mExposureControl;
+    V4LControl mGainControl;
+    V4LControl mRedControl;
+    V4LControl mBlueControl;
+    uint32_t mAEAdjustments;
+    uint32_t mAWBAdjustments;
+
 };
 }; //// namespace
 #endif //V4L_CAMERA_ADAPTER_H
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef V4L_CAPTURE_DEVICE_H
+#define V4L_CAPTURE_DEVICE_H
+
+#include <sys/types.h>
+#include <limits.h>
+#include <linux/videodev.h>
+#include <utils/threads.h>
+#include <utils/KeyedVector.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+///Magic and version of the V4L capture stream files
+#define V4L_STREAM_MAGIC 0x524C3456 //"V4LR"
+#define V4L_STREAM_VERSION 1
+
+///Header at the start of a recorded V4L capture stream
+typedef struct
+    {
+    uint32_t mMagic;
+    uint32_t mVersion;
+    uint32_t mWidth;
+    uint32_t mHeight;
+    uint32_t mPixelFormat;
+    uint32_t mFrameSize;    ///Maximum payload size of a single frame
+    } V4LStreamHeader;
+
+///Header preceeding every frame payload inside a recorded V4L capture stream
+typedef struct
+    {
+    uint64_t mTimestampUs;  ///Driver timestamp of the frame
+    uint32_t mSequence;
+    uint32_t mBytesUsed;    ///Payload size following this header
+    } V4LStreamFrame;
+
+/**
+  * Abstracts the V4L2 device node used by V4LCameraAdapter.
+  * The default implementation forwards everything to the kernel driver.
+  * The record and replay implementations below keep the same ioctl surface,
+  * so the adapter doesn't need to know where the frames come from.
+  */
+class V4LCaptureDevice
+{
+public:
+
+    V4LCaptureDevice();
+    virtual ~V4LCaptureDevice();
+
+    ///Creates the capture device selected by the "debug.camera.v4l.*" properties
+    static V4LCaptureDevice* create();
+
+    virtual status_t open(const char *device);
+    virtual void close();
+    virtual int ioctl(int request, void *arg);
+    virtual void* mmap(size_t length, off_t offset);
+    virtual int munmap(void *addr, size_t length);
+
+    ///Waits until a filled buffer can be dequeued without blocking
+    ///@return 1 if a buffer is ready, 0 on timeout, -1 on error
+    virtual int poll(int timeoutMs);
+
+protected:
+
+    int mHandle;
+};
+
+/**
+  * Captures the frame stream of a real device into a file while passing
+  * the frames through to the adapter.
+  */
+class V4LRecordDevice : public V4LCaptureDevice
+{
+public:
+
+    V4LRecordDevice(const char *path);
+    virtual ~V4LRecordDevice();
+
+    virtual status_t open(const char *device);
+    virtual void close();
+    virtual int ioctl(int request, void *arg);
+    virtual void* mmap(size_t length, off_t offset);
+
+private:
+
+    status_t writeHeader();
+    status_t writeFrame(const struct v4l2_buffer *buf);
+
+    char mPath[PATH_MAX];
+    int mFile;
+    bool mHeaderWritten;
+    struct v4l2_pix_format mFormat;
+    KeyedVector<unsigned int, unsigned int> mBufferOffsets;
+    KeyedVector<unsigned int, void *> mMappings;
+    uint32_t mFramesRecorded;
+};
+
+/**
+  * Feeds a previously recorded frame stream to the adapter, emulating the
+  * mmap streaming ioctls of a capture driver. Frames are delivered with the
+  * recorded inter frame timing scaled by the replay speed. DQBUF never
+  * blocks, it fails with EAGAIN until poll() reports the next frame due.
+  */
+class V4LReplayDevice : public V4LCaptureDevice
+{
+public:
+
+    ///@param speed - replay speed multiplier, 0 delivers the frames as fast as possible
+    ///@param loop - restart from the first frame once the stream is exhausted
+    V4LReplayDevice(const char *path, float speed, bool loop);
+    virtual ~V4LReplayDevice();
+
+    virtual status_t open(const char *device);
+    virtual void close();
+    virtual int ioctl(int request, void *arg);
+    virtual void* mmap(size_t length, off_t offset);
+    virtual int munmap(void *addr, size_t length);
+    virtual int poll(int timeoutMs);
+
+private:
+
+    status_t allocateBuffers(unsigned int count);
+    void freeBuffers();
+    int dequeueBuffer(struct v4l2_buffer *buf);
+    status_t peekFrame(V4LStreamFrame &frame);
+    status_t nextFrameDue(nsecs_t &due);
+    status_t readFrame(V4LStreamFrame &frame, void *data);
+
+    char mPath[PATH_MAX];
+    float mSpeed;
+    bool mLoop;
+    int mFile;
+    V4LStreamHeader mHeader;
+    off_t mFirstFrameOffset;
+
+    size_t mBufferLength;
+    Vector<void *> mBuffers;
+    Vector<unsigned int> mQueuedBuffers;
+    bool mStreaming;
+
+    //Replay pacing, all in monotonic time
+    nsecs_t mReplayStart;
+    uint64_t mStreamStartUs;
+    uint32_t mSequence;
+
+    Mutex mLock;
+    Condition mCondition;
+};
+
+};
+
+#endif //V4L_CAPTURE_DEVICE_H
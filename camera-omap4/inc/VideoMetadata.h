@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef VIDEO_METADATA_H
+#define VIDEO_METADATA_H
+
+#include <stdint.h>
+
+///Identifies a recording buffer which carries a video_metadata_t instead of pixel data
+#define VIDEO_METADATA_BUFFER_TYPE 0x4D444154 //"MDAT"
+#define VIDEO_METADATA_VERSION 1
+
+/**
+  * Descriptor delivered through CAMERA_MSG_VIDEO_FRAME when the "video-metadata"
+  * camera parameter is enabled. The frame itself stays in the TILER buffer owned by
+  * the camera. The encoder resolves mHandle back to that buffer, so the media
+  * server never maps or touches the pixel data. The descriptor must be released
+  * through releaseRecordingFrame() like a regular recording frame.
+  */
+typedef struct
+    {
+    uint32_t mMetadataBufferType;   ///Always VIDEO_METADATA_BUFFER_TYPE
+    uint32_t mVersion;              ///VIDEO_METADATA_VERSION
+    uint32_t mHandle;               ///Virtual address of the TILER buffer containing the frame
+    uint32_t mOffset;               ///Offset of the first pixel inside the buffer
+    uint32_t mStride;               ///Line length in bytes
+    uint32_t mWidth;
+    uint32_t mHeight;
+    uint32_t mReserved;
+    int64_t mTimestamp;             ///Frame timestamp in ns
+    } video_metadata_t;
+
+#endif //VIDEO_METADATA_H
@@ -20,7 +20,11 @@ LOCAL_SRC_FILES:= \
     MemoryManager.cpp	\
     OverlayDisplayAdapter.cpp \
     CameraProperties.cpp \
-    TICameraParameters.cpp
+    TICameraParameters.cpp \
+    FrameStatistics.cpp \
+    FrameScaler.cpp \
+    LatencyHistogram.cpp \
+    TilerBufferPool.cpp
 
 LOCAL_C_INCLUDES += \
     $(LOCAL_PATH)/../inc \
@@ -167,6 +171,7 @@ LOCAL_PRELINK_MODULE := false
 LOCAL_SRC_FILES:= \
 	BaseCameraAdapter.cpp \
 	V4LCameraAdapter/V4LCameraAdapter.cpp \
+	V4LCameraAdapter/V4LCaptureDevice.cpp \
 
 
 LOCAL_C_INCLUDES += \
@@ -208,6 +213,125 @@ LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_SHARED_LIBRARY)
 
+################################################
+
+#LatencyHistogram host test
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    LatencyHistogramTest.cpp \
+    LatencyHistogram.cpp
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/../inc
+
+LOCAL_STATIC_LIBRARIES:= \
+    libutils \
+    libcutils \
+    liblog
+
+LOCAL_LDLIBS += -lpthread
+
+LOCAL_MODULE:= LatencyHistogramTest
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+################################################
+
+#TilerBufferPool host test, MemMgr is mocked inside the test
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    TilerBufferPoolTest.cpp \
+    TilerBufferPool.cpp
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/../inc \
+    $(LOCAL_PATH)/../../../tiler
+
+LOCAL_STATIC_LIBRARIES:= \
+    libutils \
+    libcutils \
+    liblog
+
+LOCAL_LDLIBS += -lpthread
+
+LOCAL_MODULE:= TilerBufferPoolTest
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+################################################
+
+#FrameStatistics test, the host build checks the scalar path, the target build the NEON path
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    FrameStatisticsTest.cpp \
+    FrameStatistics.cpp
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/../inc
+
+LOCAL_MODULE:= FrameStatisticsTest
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    FrameStatisticsTest.cpp \
+    FrameStatistics.cpp
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/../inc
+
+LOCAL_CFLAGS += -fno-short-enums -mfpu=neon
+
+LOCAL_MODULE:= FrameStatisticsTest
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_EXECUTABLE)
+
+################################################
+
+#FrameScaler test, the host build checks the C path, the target build compares the NEON paths against it
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    FrameScalerTest.cpp \
+    FrameScaler.cpp
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/../inc
+
+LOCAL_MODULE:= FrameScalerTest
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    FrameScalerTest.cpp \
+    FrameScaler.cpp
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/../inc
+
+LOCAL_CFLAGS += -fno-short-enums -mfpu=neon
+
+LOCAL_MODULE:= FrameScalerTest
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_EXECUTABLE)
+
 endif
 endif
 
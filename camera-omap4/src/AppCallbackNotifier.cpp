@@ -24,6 +24,8 @@
 
 
 #include "CameraHal.h"
+#include "TICameraParameters.h"
+#include "FrameScaler.h"
 
 
 namespace android {
@@ -45,6 +47,46 @@ status_t AppCallbackNotifier::initialize()
     LOG_FUNCTION_NAME
 
     mMeasurementEnabled = false;
+    mUseMetaDataBufferMode = false;
+
+    mFramesQueued = 0;
+    mPreviewCallbacks = 0;
+    mVideoCallbacks = 0;
+    mImageCallbacks = 0;
+    mFramesDropped = 0;
+    mFramesWithEncoder = 0;
+    mParallelCopies = 0;
+    mCallbackWidth = 0;
+    mCallbackHeight = 0;
+
+    ///One band is always converted by the notifier thread itself
+    mCopyThreadCount = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    if ( mCopyThreadCount > MAX_COPY_THREADS )
+        {
+        mCopyThreadCount = MAX_COPY_THREADS;
+        }
+    else if ( 0 > mCopyThreadCount )
+        {
+        mCopyThreadCount = 0;
+        }
+
+    mCopySem.Create(0);
+
+    for ( int i = 0 ; i < mCopyThreadCount ; i++ )
+        {
+        mCopyThreads[i] = new CopyThread(this);
+        if ( ( NULL == mCopyThreads[i].get() ) ||
+             ( NO_ERROR != mCopyThreads[i]->run("CopyThread", PRIORITY_URGENT_DISPLAY) ) )
+            {
+            ///Fall back to the threads started so far
+            CAMHAL_LOGEB("Couldn't run CopyThread %d", i);
+            mCopyThreads[i].clear();
+            mCopyThreadCount = i;
+            break;
+            }
+        }
+
+    CAMHAL_LOGDB("Preview callback copies use up to %d bands", mCopyThreadCount + 1);
 
     ///Create the app notifier thread
     mNotificationThread = new NotificationThread(this);
@@ -281,12 +323,89 @@ void AppCallbackNotifier::notifyEvent()
 
 }
 
-static void copy2Dto1D(void *dst, void *src, int width, int height, size_t stride, uint32_t offset, unsigned int bytesPerPixel, size_t length,
-    const char *pixelFormat)
+///Downscales rows [firstRow, lastRow) of the destination frame. The source addressing
+///matches the one used by the 1:1 copy.
+static void scale2Dto1D(const AppCallbackNotifier::CopyJob &job, int firstRow, int lastRow)
+{
+    const uint8_t *src = ( const uint8_t * ) job.mSrc;
+    uint8_t *dst = ( uint8_t * ) job.mDst;
+    int width = job.mWidth;
+    int height = job.mHeight;
+    int dstWidth = job.mDstWidth;
+    int dstHeight = job.mDstHeight;
+    size_t stride = job.mStride;
+
+    if ( strcmp(job.mPixelFormat, (const char *) CameraParameters::PIXEL_FORMAT_YUV420SP) == 0 )
+        {
+        uint32_t xOff = job.mOffset % PAGE_SIZE;
+        uint32_t yOff = job.mOffset / PAGE_SIZE;
+        const uint8_t *srcY = src + job.mOffset;
+        const uint8_t *srcUV = src + job.mOffset + stride * ( height + yOff );
+        size_t pitchY = stride + xOff;
+        size_t pitchUV = stride + 2 * xOff;
+        uint8_t *dstUV = dst + dstWidth * dstHeight;
+
+        if ( ( width == ( dstWidth * 2 ) ) && ( height == ( dstHeight * 2 ) ) )
+            {
+            for ( int y = firstRow ; y < lastRow ; y++ )
+                {
+                FrameScaler::halveLumaRow(srcY + y * 2 * pitchY, srcY + ( y * 2 + 1 ) * pitchY,
+                             dst + y * dstWidth, dstWidth);
+                }
+
+            for ( int y = firstRow / 2 ; y < lastRow / 2 ; y++ )
+                {
+                FrameScaler::halveChromaRow(srcUV + y * 2 * pitchUV, srcUV + ( y * 2 + 1 ) * pitchUV,
+                                            dstUV + y * dstWidth, dstWidth / 2);
+                }
+
+            return;
+            }
+
+        FrameScaler::scaleChannel(srcY, pitchY, 1, width, height,
+                                  dst, dstWidth, 1, dstWidth, dstHeight, firstRow, lastRow);
+
+        ///NV21 chroma, V first
+        FrameScaler::scaleChannel(srcUV + 1, pitchUV, 2, width / 2, height / 2,
+                                  dstUV, dstWidth, 2, dstWidth / 2, dstHeight / 2, firstRow / 2, lastRow / 2);
+        FrameScaler::scaleChannel(srcUV, pitchUV, 2, width / 2, height / 2,
+                                  dstUV + 1, dstWidth, 2, dstWidth / 2, dstHeight / 2, firstRow / 2, lastRow / 2);
+        }
+    else
+        {
+        ///YUV422I, same line alignment as the 1:1 copy
+        size_t row = width * 2;
+        size_t pitch = ( row + ( stride - 1 ) ) & ( ~ ( stride - 1 ) );
+        size_t dstPitch = dstWidth * 2;
+
+        FrameScaler::scaleChannel(src, pitch, 2, width, height,
+                                  dst, dstPitch, 2, dstWidth, dstHeight, firstRow, lastRow);
+        FrameScaler::scaleChannel(src + 1, pitch, 4, width / 2, height,
+                                  dst + 1, dstPitch, 4, dstWidth / 2, dstHeight, firstRow, lastRow);
+        FrameScaler::scaleChannel(src + 3, pitch, 4, width / 2, height,
+                                  dst + 3, dstPitch, 4, dstWidth / 2, dstHeight, firstRow, lastRow);
+        }
+}
+
+///Copies rows [firstRow, lastRow) of a 2D frame into a 1D buffer. For NV12 the rows of the UV
+///plane belonging to the luma rows are copied as well, so bands must start at even rows.
+static void copy2Dto1D(const AppCallbackNotifier::CopyJob &job, int firstRow, int lastRow)
 {
     unsigned int alignedRow, row;
+    unsigned int bytesPerPixel = job.mBytesPerPixel;
     unsigned char *bufferDst, *bufferSrc;
     uint16_t *bufferDst_UV, *bufferSrc_UV;
+    const char *pixelFormat = job.mPixelFormat;
+    int width = job.mWidth;
+    int height = job.mHeight;
+    size_t stride = job.mStride;
+    uint32_t offset = job.mOffset;
+
+    if ( ( job.mDstWidth != width ) || ( job.mDstHeight != height ) )
+        {
+        scale2Dto1D(job, firstRow, lastRow);
+        return;
+        }
 
     if(pixelFormat!=NULL)
         {
@@ -300,23 +419,24 @@ static void copy2Dto1D(void *dst, void *src, int width, int height, size_t strid
             bytesPerPixel = 1;
             uint32_t xOff = offset % PAGE_SIZE;
             uint32_t yOff = offset / PAGE_SIZE;
-            bufferDst = ( unsigned char * ) dst;
-            bufferSrc = ( unsigned char * ) (src + offset);
             row = width*bytesPerPixel;
             alignedRow = stride-width;
+            bufferDst = ( ( unsigned char * ) job.mDst ) + firstRow*row;
+            bufferSrc = ( ( unsigned char * ) job.mSrc ) + offset + firstRow*(stride + xOff);
             int stride_bytes = stride / 8;
 
             //iterate through each row
-            for ( int i = 0 ; i < height ; i++,  bufferSrc += (stride + xOff), bufferDst += row)
+            for ( int i = firstRow ; i < lastRow ; i++,  bufferSrc += (stride + xOff), bufferDst += row)
                 {
                 memcpy(bufferDst, bufferSrc, row);
                 }
 
             ///Convert NV21 to NV12 by swapping U & V
-            bufferDst_UV = (uint16_t *) (((uint8_t*)dst)+row*height);
-            bufferSrc_UV = ( uint16_t * ) (((uint8_t*)src) + offset + stride*(height+yOff));
+            bufferDst_UV = (uint16_t *) (((uint8_t*)job.mDst)+row*height + (firstRow/2)*row);
+            bufferSrc_UV = ( uint16_t * ) (((uint8_t*)job.mSrc) + offset + stride*(height+yOff) +
+                                           (firstRow/2)*(stride + 2*xOff));
 
-            for(int i = 0 ; i < height/2 ; i++, bufferSrc_UV += (alignedRow/2 + xOff))
+            for(int i = firstRow/2 ; i < lastRow/2 ; i++, bufferSrc_UV += (alignedRow/2 + xOff))
             {
                 int n = width;
                 asm volatile (
@@ -369,18 +489,121 @@ static void copy2Dto1D(void *dst, void *src, int width, int height, size_t strid
             }
     }
 
-    bufferDst = ( unsigned char * ) dst;
-    bufferSrc = ( unsigned char * ) src;
     row = width*bytesPerPixel;
     alignedRow = ( row + ( stride -1 ) ) & ( ~ ( stride -1 ) );
+    bufferDst = ( ( unsigned char * ) job.mDst ) + firstRow*row;
+    bufferSrc = ( ( unsigned char * ) job.mSrc ) + firstRow*alignedRow;
 
     //iterate through each row
-    for ( int i = 0 ; i < height ; i++,  bufferSrc += alignedRow, bufferDst += row)
+    for ( int i = firstRow ; i < lastRow ; i++,  bufferSrc += alignedRow, bufferDst += row)
         {
         memcpy(bufferDst, bufferSrc, row);
         }
 }
 
+void AppCallbackNotifier::copyThread(CopyThread *thread)
+{
+    Message msg;
+    CopyJob *job;
+    Semaphore *sem;
+
+    LOG_FUNCTION_NAME
+
+    while ( true )
+        {
+        thread->msgQ().get(&msg);
+
+        sem = ( Semaphore * ) msg.arg4;
+        if ( CopyThread::COPY_EXIT == msg.command )
+            {
+            if ( NULL != sem )
+                {
+                sem->Signal();
+                }
+            break;
+            }
+
+        job = ( CopyJob * ) msg.arg1;
+        copy2Dto1D(*job, ( int ) msg.arg2, ( int ) msg.arg3);
+
+        if ( NULL != sem )
+            {
+            sem->Signal();
+            }
+        }
+
+    LOG_FUNCTION_NAME_EXIT
+}
+
+///Splits the copy into row bands. The bands are handed to the copy threads while
+///the calling thread converts the last band itself, the callback can be given
+///as soon as the remaining bands complete.
+void AppCallbackNotifier::copyFrame(void *dst, CameraFrame *frame, const char *pixelFormat, int dstWidth, int dstHeight)
+{
+    CopyJob job;
+    Message msg;
+    int bands, rowsPerBand, firstRow;
+
+    job.mDst = dst;
+    job.mSrc = frame->mBuffer;
+    job.mWidth = frame->mWidth;
+    job.mHeight = frame->mHeight;
+    job.mDstWidth = dstWidth;
+    job.mDstHeight = dstHeight;
+    job.mStride = frame->mAlignment;
+    job.mOffset = frame->mOffset;
+    job.mBytesPerPixel = 2;
+    job.mPixelFormat = pixelFormat;
+
+    ///Small frames are not worth the hand-off to the copy threads
+    bands = ( frame->mWidth * frame->mHeight ) / MIN_COPY_BAND_PIXELS;
+    if ( bands > ( mCopyThreadCount + 1 ) )
+        {
+        bands = mCopyThreadCount + 1;
+        }
+
+    if ( 1 >= bands )
+        {
+        copy2Dto1D(job, 0, job.mDstHeight);
+        return;
+        }
+
+    ///Bands are counted in destination rows. Band borders are kept on even rows
+    ///so the NV12 chroma rows follow their luma rows
+    rowsPerBand = ( ( job.mDstHeight / bands ) + 1 ) & ~1;
+    if ( 2 > rowsPerBand )
+        {
+        rowsPerBand = 2;
+        }
+    if ( job.mDstHeight <= ( rowsPerBand * ( bands - 1 ) ) )
+        {
+        bands = ( job.mDstHeight + rowsPerBand - 1 ) / rowsPerBand;
+        }
+
+    for ( int i = 0 ; i < ( bands - 1 ) ; i++ )
+        {
+        firstRow = i * rowsPerBand;
+        msg.command = CopyThread::COPY_BAND;
+        msg.arg1 = &job;
+        msg.arg2 = ( void * ) firstRow;
+        msg.arg3 = ( void * ) ( firstRow + rowsPerBand );
+        msg.arg4 = &mCopySem;
+        mCopyThreads[i]->msgQ().put(&msg);
+        }
+
+    copy2Dto1D(job, ( bands - 1 ) * rowsPerBand, job.mDstHeight);
+
+    for ( int i = 0 ; i < ( bands - 1 ) ; i++ )
+        {
+        mCopySem.Wait();
+        }
+
+        {
+        Mutex::Autolock lock(mStatsLock);
+        mParallelCopies++;
+        }
+}
+
 void AppCallbackNotifier::notifyFrame()
 {
     ///Receive and send the frame notifications to app
@@ -402,6 +625,14 @@ void AppCallbackNotifier::notifyFrame()
         return;
         }
 
+        {
+        Mutex::Autolock lock(mStatsLock);
+        if ( 0 < mFramesQueued )
+            {
+            mFramesQueued--;
+            }
+        }
+
     bool ret = true;
 
     if(mNotifierState != AppCallbackNotifier::NOTIFIER_STARTED)
@@ -420,6 +651,8 @@ void AppCallbackNotifier::notifyFrame()
                     break;
                     }
 
+                FrameTrace::mark(frame->mBuffer, FrameTrace::STAGE_APP_DEQUEUE);
+
                 if ( (CameraFrame::RAW_FRAME == frame->mFrameType )&&
                     ( NULL != mCameraHal.get() ) &&
                     ( NULL != mDataCb) &&
@@ -440,6 +673,12 @@ void AppCallbackNotifier::notifyFrame()
                           memcpy(buf, ( void * ) ( (unsigned int) frame->mBuffer + frame->mOffset) , frame->mLength);
 
                         mDataCb(CAMERA_MSG_RAW_IMAGE, RAWPictureMemBase, mCallbackCookie);
+                        FrameTrace::mark(frame->mBuffer, FrameTrace::STAGE_APP_CALLBACK);
+
+                            {
+                            Mutex::Autolock lock(mStatsLock);
+                            mImageCallbacks++;
+                            }
 
                         mFrameProvider->returnFrame(frame->mBuffer,  ( CameraFrame::FrameType ) frame->mFrameType);
                         }
@@ -484,6 +723,13 @@ void AppCallbackNotifier::notifyFrame()
                                 mDataCb(CAMERA_MSG_COMPRESSED_IMAGE, JPEGPictureMemBase, mCallbackCookie);
                                 }
                         }
+
+                        FrameTrace::mark(frame->mBuffer, FrameTrace::STAGE_APP_CALLBACK);
+
+                            {
+                            Mutex::Autolock lock(mStatsLock);
+                            mImageCallbacks++;
+                            }
 #else
 
                      //TODO: Find a way to map a Tiler buffer to a MemoryHeapBase
@@ -516,13 +762,41 @@ void AppCallbackNotifier::notifyFrame()
                     if(buffer)
                         {
                         //CAMHAL_LOGDB("+CB 0x%x buffer 0x%x", frame->mBuffer, buffer);
+                        if ( mUseMetaDataBufferMode )
+                            {
+                            ///Describe the frame, the encoder picks the pixels directly from the TILER buffer
+                            video_metadata_t *metadata = ( video_metadata_t * ) buffer->pointer();
+                            metadata->mHandle = ( uint32_t ) frame->mBuffer;
+                            metadata->mOffset = frame->mOffset;
+                            metadata->mStride = frame->mAlignment;
+                            metadata->mWidth = frame->mWidth;
+                            metadata->mHeight = frame->mHeight;
+                            metadata->mTimestamp = frame->mTimestamp;
+                            }
+
 #ifdef OMAP_ENHANCEMENT
-                        mDataCbTimestamp(frame->mTimestamp, CAMERA_MSG_VIDEO_FRAME, buffer, mCallbackCookie
-                                                , frame->mOffset, PAGE_SIZE);
+                        ///In metadata mode the buffer only holds the descriptor, the frame offset is inside it
+                        if ( mUseMetaDataBufferMode )
+                            {
+                            mDataCbTimestamp(frame->mTimestamp, CAMERA_MSG_VIDEO_FRAME, buffer, mCallbackCookie
+                                                    , 0, sizeof(video_metadata_t));
+                            }
+                        else
+                            {
+                            mDataCbTimestamp(frame->mTimestamp, CAMERA_MSG_VIDEO_FRAME, buffer, mCallbackCookie
+                                                    , frame->mOffset, PAGE_SIZE);
+                            }
 #else
                         mDataCbTimestamp(frame->mTimestamp, CAMERA_MSG_VIDEO_FRAME, buffer, mCallbackCookie);
 #endif
+                        FrameTrace::mark(frame->mBuffer, FrameTrace::STAGE_APP_CALLBACK);
                         //CAMHAL_LOGDA("-CB");
+
+                            {
+                            Mutex::Autolock lock(mStatsLock);
+                            mVideoCallbacks++;
+                            mFramesWithEncoder++;
+                            }
                         }
 
                     }
@@ -539,7 +813,12 @@ void AppCallbackNotifier::notifyFrame()
 
                         if(!mAppSupportsStride)
                             {
-                            buffer = mPreviewBuffers[mPreviewBufCount].get();
+                            ///Postview frames aren't downscaled along with the preview callbacks
+                            buffer = mPostviewBuffers[mPreviewBufCount].get();
+                            if ( NULL == buffer )
+                                {
+                                buffer = mPreviewBuffers[mPreviewBufCount].get();
+                                }
                             if(!buffer || !frame->mBuffer)
                                 {
                                 CAMHAL_LOGDA("Error! One of the buffer is NULL");
@@ -566,8 +845,7 @@ void AppCallbackNotifier::notifyFrame()
                                         frame->mWidth, frame->mHeight, frame->mAlignment, 2, frame->mLength, mPreviewPixelFormat);
 
                               if (buf)
-                                copy2Dto1D(buf, frame->mBuffer, frame->mWidth, frame->mHeight, frame->mAlignment, frame->mOffset, 2, frame->mLength,
-                                           mPreviewPixelFormat);
+                                copyFrame(buf, frame, mPreviewPixelFormat, frame->mWidth, frame->mHeight);
 
                             mPreviewBufCount = (mPreviewBufCount+1) % AppCallbackNotifier::MAX_BUFFERS;
 
@@ -635,8 +913,16 @@ void AppCallbackNotifier::notifyFrame()
                                       frame->mWidth, frame->mHeight, frame->mAlignment, 2, frame->mLength, mPreviewPixelFormat);
 
                             if (buf)
-                              copy2Dto1D(buf, frame->mBuffer, frame->mWidth, frame->mHeight, frame->mAlignment, frame->mOffset, 2, frame->mLength,
-                                         mPreviewPixelFormat);
+                              {
+                              if ( 0 < mCallbackWidth )
+                                  {
+                                  copyFrame(buf, frame, mPreviewPixelFormat, mCallbackWidth, mCallbackHeight);
+                                  }
+                              else
+                                  {
+                                  copyFrame(buf, frame, mPreviewPixelFormat, frame->mWidth, frame->mHeight);
+                                  }
+                              }
                             ///CAMHAL_LOGDA("-Copy");
 
                             //Increment the buffer count
@@ -647,6 +933,12 @@ void AppCallbackNotifier::notifyFrame()
 
                         ///Give preview callback to app
                         mDataCb(CAMERA_MSG_PREVIEW_FRAME, memBase, mCallbackCookie);
+                        FrameTrace::mark(frame->mBuffer, FrameTrace::STAGE_APP_CALLBACK);
+
+                            {
+                            Mutex::Autolock lock(mStatsLock);
+                            mPreviewCallbacks++;
+                            }
 
                         }
 
@@ -705,6 +997,11 @@ void AppCallbackNotifier::notifyFrame()
                     ///Give preview callback to app
                     mDataCb(CAMERA_MSG_PREVIEW_FRAME, memBase, mCallbackCookie);
 
+                        {
+                        Mutex::Autolock lock(mStatsLock);
+                        mPreviewCallbacks++;
+                        }
+
                     mFrameProvider->returnFrame(frame->mBuffer,  ( CameraFrame::FrameType ) frame->mFrameType);
 
                     }
@@ -712,6 +1009,11 @@ void AppCallbackNotifier::notifyFrame()
                     {
                     mFrameProvider->returnFrame(frame->mBuffer,  ( CameraFrame::FrameType ) frame->mFrameType);
                     CAMHAL_LOGDB("Frame type 0x%x is still unsupported!", frame->mFrameType);
+
+                        {
+                        Mutex::Autolock lock(mStatsLock);
+                        mFramesDropped++;
+                        }
                     }
 
                 break;
@@ -757,6 +1059,11 @@ void AppCallbackNotifier::frameCallback(CameraFrame* caFrame)
             msg.command = AppCallbackNotifier::NOTIFIER_CMD_PROCESS_FRAME;
             msg.arg1 = frame;
             mFrameQ.put(&msg);
+
+                {
+                Mutex::Autolock lock(mStatsLock);
+                mFramesQueued++;
+                }
             }
         else
             {
@@ -900,6 +1207,18 @@ AppCallbackNotifier::~AppCallbackNotifier()
     //Delete the display thread
     mNotificationThread.clear();
 
+    ///Stop the copy threads
+    for ( int i = 0 ; i < mCopyThreadCount ; i++ )
+        {
+        msg.command = CopyThread::COPY_EXIT;
+        msg.arg4 = &sem;
+        mCopyThreads[i]->msgQ().put(&msg);
+        sem.Wait();
+        mCopyThreads[i]->requestExitAndWait();
+        mCopyThreads[i].clear();
+        }
+    mCopyThreadCount = 0;
+
 
     ///Free the event and frame providers
     if ( NULL != mEventProvider )
@@ -1030,31 +1349,67 @@ status_t AppCallbackNotifier::startPreviewCallbacks(CameraParameters &params, vo
 
 
     int w,h;
+    int previewWidth, previewHeight;
+    size_t fullSize = 0;
     ///Get preview size
     params.getPreviewSize(&w, &h);
+    previewWidth = w;
+    previewHeight = h;
 
     //Get the preview pixel format
     mPreviewPixelFormat = params.getPreviewFormat();
 
+    ///Downscaled callbacks are copied, the shared preview buffers can't be handed out
+    mCallbackWidth = 0;
+    mCallbackHeight = 0;
+    const char *valstr = params.get(TICameraParameters::KEY_PREVIEW_CALLBACK_SIZE);
+    if ( NULL != valstr )
+        {
+        int cw = 0, ch = 0;
+
+        if ( ( 2 != sscanf(valstr, "%dx%d", &cw, &ch) ) ||
+             ( 2 > cw ) || ( 2 > ch ) || ( cw > w ) || ( ch > h ) || ( cw & 1 ) || ( ch & 1 ) )
+            {
+            CAMHAL_LOGEB("Invalid preview callback size %s, using %dx%d", valstr, w, h);
+            }
+        else if ( strcmp(mPreviewPixelFormat, (const char *) CameraParameters::PIXEL_FORMAT_RGB565) == 0 )
+            {
+            CAMHAL_LOGEA("Preview callback downscaling is not supported for RGB565");
+            }
+        else if ( ( cw != w ) || ( ch != h ) )
+            {
+            CAMHAL_LOGDB("Preview callbacks downscaled %dx%d -> %dx%d", w, h, cw, ch);
+            mCallbackWidth = cw;
+            mCallbackHeight = ch;
+            mAppSupportsStride = false;
+            w = cw;
+            h = ch;
+            }
+        }
+
      if(strcmp(mPreviewPixelFormat, (const char *) CameraParameters::PIXEL_FORMAT_YUV422I) == 0)
         {
         size = w*h*2;
+        fullSize = previewWidth*previewHeight*2;
         mPreviewPixelFormat = CameraParameters::PIXEL_FORMAT_YUV422I;
         }
     else if(strcmp(mPreviewPixelFormat, (const char *) CameraParameters::PIXEL_FORMAT_YUV420SP) == 0)
         {
         size = (w*h*3)/2;
+        fullSize = (previewWidth*previewHeight*3)/2;
         mPreviewPixelFormat = CameraParameters::PIXEL_FORMAT_YUV420SP;
         }
     else if(strcmp(mPreviewPixelFormat, (const char *) CameraParameters::PIXEL_FORMAT_RGB565) == 0)
         {
         size = w*h*2;
+        fullSize = previewWidth*previewHeight*2;
         mPreviewPixelFormat = CameraParameters::PIXEL_FORMAT_RGB565;
         }
 
    if(!mAppSupportsStride)
        {
-        mPreviewHeap = new MemoryHeapBase(size*AppCallbackNotifier::MAX_BUFFERS);
+        ///Every slot holds a full preview frame, postview frames are copied without downscaling
+        mPreviewHeap = new MemoryHeapBase(fullSize*AppCallbackNotifier::MAX_BUFFERS);
         if(!mPreviewHeap.get())
             {
             return NO_MEMORY;
@@ -1062,12 +1417,17 @@ status_t AppCallbackNotifier::startPreviewCallbacks(CameraParameters &params, vo
 
         for(int i=0;i<AppCallbackNotifier::MAX_BUFFERS;i++)
             {
-            mPreviewBuffers[i] = new MemoryBase(mPreviewHeap,size*i, size);
-            if(!mPreviewBuffers[i].get())
+            mPreviewBuffers[i] = new MemoryBase(mPreviewHeap,fullSize*i, size);
+            if ( ( fullSize != size ) && mPreviewBuffers[i].get() )
                 {
-                for(int j=0;j<i-1;j++)
+                mPostviewBuffers[i] = new MemoryBase(mPreviewHeap, fullSize*i, fullSize);
+                }
+            if(!mPreviewBuffers[i].get() || ( ( fullSize != size ) && !mPostviewBuffers[i].get() ) )
+                {
+                for(int j=0;j<=i;j++)
                     {
                     mPreviewBuffers[j].clear();
+                    mPostviewBuffers[j].clear();
                     }
                 mPreviewHeap.clear();
                 return NO_MEMORY;
@@ -1202,6 +1562,7 @@ status_t AppCallbackNotifier::stopPreviewCallbacks()
             {
             //Delete the instance
             mPreviewBuffers[i].clear();
+            mPostviewBuffers[i].clear();
             }
 
         mPreviewHeap.clear();
@@ -1247,16 +1608,76 @@ status_t AppCallbackNotifier::startRecording()
     return ret;
 }
 
+status_t AppCallbackNotifier::useMetaDataBufferMode(bool enable)
+{
+    LOG_FUNCTION_NAME
+
+    Mutex::Autolock lock(mRecordingLock);
+
+    if ( mRecording )
+        {
+        CAMHAL_LOGEA("Video buffer mode can't change while recording");
+        LOG_FUNCTION_NAME_EXIT
+        return INVALID_OPERATION;
+        }
+
+    CAMHAL_LOGDB("Video metadata buffers %s", enable ? "enabled" : "disabled");
+    mUseMetaDataBufferMode = enable;
+
+    LOG_FUNCTION_NAME_EXIT
+
+    return NO_ERROR;
+}
+
 status_t AppCallbackNotifier::initSharedVideoBuffers(void *buffers, uint32_t *offsets, int fd, size_t length, size_t count)
 {
     MemoryHeapBase *heap;
     MemoryBase *buffer;
+    video_metadata_t *metadata;
     status_t ret = NO_ERROR;
     unsigned int *bufArr;
 
     LOG_FUNCTION_NAME
 
     bufArr = ( unsigned int * ) buffers;
+
+    ///In metadata mode only the small descriptors are shared, the video buffers are never mapped
+    if ( mUseMetaDataBufferMode )
+        {
+        heap = new MemoryHeapBase(sizeof(video_metadata_t) * count);
+        if ( ( NULL == heap ) || ( NULL == heap->base() ) )
+            {
+            CAMHAL_LOGEA("Unable to allocate the video metadata heap");
+            ret = NO_MEMORY;
+            goto exit;
+            }
+        heap->incStrong(this);
+        mVideoHeaps.add( bufArr[0], ( unsigned int ) heap);
+
+        for ( unsigned int i = 0 ; i < count ; i ++ )
+            {
+            buffer = new MemoryBase(heap, sizeof(video_metadata_t) * i, sizeof(video_metadata_t));
+            if ( NULL == buffer )
+                {
+                CAMHAL_LOGEB("Unable to initialize a metadata buffer to frame 0x%x", bufArr[i]);
+                ret = NO_MEMORY;
+                goto exit;
+                }
+            buffer->incStrong(this);
+
+            metadata = ( video_metadata_t * ) buffer->pointer();
+            memset(metadata, 0, sizeof(video_metadata_t));
+            metadata->mMetadataBufferType = VIDEO_METADATA_BUFFER_TYPE;
+            metadata->mVersion = VIDEO_METADATA_VERSION;
+            metadata->mHandle = bufArr[i];
+
+            mVideoBuffers.add( bufArr[i], ( unsigned int ) buffer);
+            mVideoMap.add( ( unsigned int ) buffer->pointer(), bufArr[i]);
+            }
+
+        goto exit;
+        }
+
     for ( unsigned int i = 0 ; i < count ; i ++ )
         {
         heap = new MemoryHeapBase(fd, length, 0, offsets[i]);
@@ -1362,6 +1783,14 @@ status_t AppCallbackNotifier::releaseRecordingFrame(const sp < IMemory > & mem)
     if ( NO_ERROR == ret )
         {
          mFrameProvider->returnFrame(frame, CameraFrame::VIDEO_FRAME_SYNC);
+
+            {
+            Mutex::Autolock lock(mStatsLock);
+            if ( 0 < mFramesWithEncoder )
+                {
+                mFramesWithEncoder--;
+                }
+            }
         }
 
     LOG_FUNCTION_NAME_EXIT
@@ -1369,6 +1798,24 @@ status_t AppCallbackNotifier::releaseRecordingFrame(const sp < IMemory > & mem)
     return ret;
 }
 
+void AppCallbackNotifier::dumpStats(String8 &out)
+{
+    Mutex::Autolock lock(mStatsLock);
+
+    out.appendFormat("app.state=%d\n", mNotifierState);
+    out.appendFormat("app.queue_depth=%u\n", mFramesQueued);
+    out.appendFormat("app.preview_callbacks=%u\n", mPreviewCallbacks);
+    out.appendFormat("app.video_callbacks=%u\n", mVideoCallbacks);
+    out.appendFormat("app.image_callbacks=%u\n", mImageCallbacks);
+    out.appendFormat("app.dropped=%u\n", mFramesDropped);
+    out.appendFormat("app.buffers_with_encoder=%u\n", mFramesWithEncoder);
+    out.appendFormat("app.video_metadata=%d\n", mUseMetaDataBufferMode);
+    out.appendFormat("app.copy_bands=%d\n", mCopyThreadCount + 1);
+    out.appendFormat("app.parallel_copies=%u\n", mParallelCopies);
+    out.appendFormat("app.callback_width=%d\n", mCallbackWidth);
+    out.appendFormat("app.callback_height=%d\n", mCallbackHeight);
+}
+
 status_t AppCallbackNotifier::enableMsgType(int32_t msgType)
 {
     if(msgType & CAMERA_MSG_POSTVIEW_FRAME)
@@ -27,6 +27,16 @@ namespace android {
 
 /*--------------------Camera Adapter Class STARTS here-----------------------------*/
 
+const char *BaseCameraAdapter::sStatsStreamNames[BaseCameraAdapter::STATS_STREAM_COUNT] =
+    {
+    "preview",
+    "snapshot",
+    "video",
+    "frame_data",
+    "image",
+    "raw"
+    };
+
 BaseCameraAdapter::BaseCameraAdapter()
 {
     mReleaseImageBuffersCallback = NULL;
@@ -59,6 +69,7 @@ BaseCameraAdapter::BaseCameraAdapter()
     mStartCapture.tv_usec = 0;
 #endif
 
+    resetFrameStats();
 }
 
 status_t BaseCameraAdapter::registerImageReleaseCallback(release_image_buffers_callback callback, void *user_data)
@@ -301,6 +312,7 @@ void BaseCameraAdapter::returnFrame(void* frameBuf, CameraFrame::FrameType frame
         //check if someone is holding this buffer
         if ( 0 == refCount )
             {
+            FrameTrace::mark(frameBuf, FrameTrace::STAGE_RETURN);
             res = fillThisBuffer(frameBuf, frameType);
             }
         }
@@ -408,6 +420,7 @@ status_t BaseCameraAdapter::sendCommand(int operation, int value1, int value2, i
         case CameraAdapter::CAMERA_START_PREVIEW:
             {
             CAMHAL_LOGDA("Start Preview");
+            resetFrameStats();
             ret = startPreview();
             break;
             }
@@ -644,6 +657,7 @@ status_t BaseCameraAdapter::sendFrameToSubscribers(CameraFrame *frame)
     frame_callback callback;
     uint32_t i = 0;
     KeyedVector<int, frame_callback> *subscribers = NULL;
+    int stream = STATS_STREAM_COUNT;
 
     LOG_FUNCTION_NAME
 
@@ -656,6 +670,8 @@ status_t BaseCameraAdapter::sendFrameToSubscribers(CameraFrame *frame)
     if ( NO_ERROR == ret )
         {
 
+        FrameTrace::mark(frame->mBuffer, FrameTrace::STAGE_DISPATCH);
+
         switch(frame->mFrameType)
             {
                 case CameraFrame::IMAGE_FRAME:
@@ -668,27 +684,32 @@ status_t BaseCameraAdapter::sendFrameToSubscribers(CameraFrame *frame)
 #endif
 
                     subscribers = &mImageSubscribers;
+                    stream = STATS_IMAGE;
                     break;
                     }
                 case CameraFrame::RAW_FRAME:
                     {
                     subscribers = &mRawSubscribers;
+                    stream = STATS_RAW;
                     break;
                     }
                 case CameraFrame::VIDEO_FRAME_SYNC:
                     {
                     subscribers = &mVideoSubscribers;
+                    stream = STATS_VIDEO;
                     break;
                     }
                 case CameraFrame::FRAME_DATA_SYNC:
                     {
                     subscribers = &mFrameDataSubscribers;
+                    stream = STATS_FRAME_DATA;
                     break;
                     }
                 case CameraFrame::PREVIEW_FRAME_SYNC:
                 case CameraFrame::SNAPSHOT_FRAME:
                     {
                     subscribers = &mFrameSubscribers;
+                    stream = ( CameraFrame::SNAPSHOT_FRAME == frame->mFrameType ) ? STATS_SNAPSHOT : STATS_PREVIEW;
                     break;
                     }
                 default:
@@ -711,6 +732,20 @@ status_t BaseCameraAdapter::sendFrameToSubscribers(CameraFrame *frame)
             }
         }
 
+    if ( STATS_STREAM_COUNT != stream )
+        {
+        Mutex::Autolock lock(mFrameStatsLock);
+
+        if ( 0 < i )
+            {
+            mFramesSent[stream]++;
+            }
+        else
+            {
+            mFramesUnsubscribed[stream]++;
+            }
+        }
+
     LOG_FUNCTION_NAME_EXIT
 
     if ( 0 == i )
@@ -722,6 +757,78 @@ status_t BaseCameraAdapter::sendFrameToSubscribers(CameraFrame *frame)
     return ret;
 }
 
+void BaseCameraAdapter::resetFrameStats()
+{
+    Mutex::Autolock lock(mFrameStatsLock);
+
+    mFrameStatsStart = systemTime(SYSTEM_TIME_MONOTONIC);
+    memset(mFramesSent, 0, sizeof(mFramesSent));
+    memset(mFramesUnsubscribed, 0, sizeof(mFramesUnsubscribed));
+}
+
+///Buffers with a zero reference count are owned by the camera, the rest are held by at least one consumer
+template <typename T>
+static void dumpBufferOwnership(String8 &out, const char *name, const KeyedVector<int, T> &buffers)
+{
+    size_t withCamera = 0;
+
+    for ( size_t i = 0 ; i < buffers.size() ; i++ )
+        {
+        if ( !buffers.valueAt(i) )
+            {
+            withCamera++;
+            }
+        }
+
+    out.appendFormat("camera.%s.buffers=%u\n", name, buffers.size());
+    out.appendFormat("camera.%s.buffers_with_camera=%u\n", name, withCamera);
+    out.appendFormat("camera.%s.buffers_with_consumers=%u\n", name, buffers.size() - withCamera);
+}
+
+void BaseCameraAdapter::dumpStats(String8 &out)
+{
+    nsecs_t elapsed;
+
+    LOG_FUNCTION_NAME
+
+        {
+        Mutex::Autolock lock(mFrameStatsLock);
+
+        elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - mFrameStatsStart;
+        for ( int i = 0 ; i < STATS_STREAM_COUNT ; i++ )
+            {
+            out.appendFormat("camera.%s.frames=%u\n", sStatsStreamNames[i], mFramesSent[i]);
+            out.appendFormat("camera.%s.unsubscribed=%u\n", sStatsStreamNames[i], mFramesUnsubscribed[i]);
+            if ( 0 < elapsed )
+                {
+                out.appendFormat("camera.%s.fps=%.2f\n", sStatsStreamNames[i], ( mFramesSent[i] * float(s2ns(1)) ) / elapsed);
+                }
+            }
+        }
+
+        {
+        Mutex::Autolock lock(mPreviewBufferLock);
+        dumpBufferOwnership(out, sStatsStreamNames[STATS_PREVIEW], mPreviewBuffersAvailable);
+        }
+
+        {
+        Mutex::Autolock lock(mVideoBufferLock);
+        dumpBufferOwnership(out, sStatsStreamNames[STATS_VIDEO], mVideoBuffersAvailable);
+        }
+
+        {
+        Mutex::Autolock lock(mPreviewDataBufferLock);
+        dumpBufferOwnership(out, sStatsStreamNames[STATS_FRAME_DATA], mPreviewDataBuffersAvailable);
+        }
+
+        {
+        Mutex::Autolock lock(mCaptureBufferLock);
+        dumpBufferOwnership(out, sStatsStreamNames[STATS_IMAGE], mCaptureBuffersAvailable);
+        }
+
+    LOG_FUNCTION_NAME_EXIT
+}
+
 status_t BaseCameraAdapter::resetFrameRefCount(CameraFrame &frame)
 {
     status_t ret = NO_ERROR;
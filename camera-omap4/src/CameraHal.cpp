@@ -245,6 +245,7 @@ status_t CameraHal::setParameters(const CameraParameters &params)
     int w_orig, h_orig;
     int framerate,minframerate;
     bool framerateUpdated = true;
+    bool resolutionSwitch = false;
     int maxFPS, minFPS;
     int error;
     int base;
@@ -378,6 +379,39 @@ status_t CameraHal::setParameters(const CameraParameters &params)
             }
 
         }
+    ///A preview size change while previewing is applied in place on the existing preview buffers
+    else if ( mPreviewEnabled && !mRecordingEnabled && !mImageCaptureRunning )
+        {
+        params.getPreviewSize(&w, &h);
+        mParameters.getPreviewSize(&w_orig, &h_orig);
+
+        if ( ( w != w_orig ) || ( h != h_orig ) )
+            {
+            int orientation = mParameters.getInt(TICameraParameters::KEY_SENSOR_ORIENTATION);
+            bool valid;
+
+            if ( ( 90 == orientation ) || ( 270 == orientation ) )
+                {
+                valid = isResolutionValid(h, w, (const char*) mCameraPropertiesArr[CameraProperties::PROP_INDEX_SUPPORTED_PREVIEW_SIZES]->mPropValue);
+                }
+            else
+                {
+                valid = isResolutionValid(w, h, (const char*) mCameraPropertiesArr[CameraProperties::PROP_INDEX_SUPPORTED_PREVIEW_SIZES]->mPropValue);
+                }
+
+            if ( !valid )
+                {
+                CAMHAL_LOGEB("Invalid preview resolution %d x %d", w, h);
+                ret = -EINVAL;
+                }
+            else
+                {
+                CAMHAL_LOGDB("Preview resolution switch %d x %d -> %d x %d", w_orig, h_orig, w, h);
+                mParameters.setPreviewSize(w, h);
+                resolutionSwitch = true;
+                }
+            }
+        }
 
     ///Below parameters can be changed when the preview is running
     if ( !isParameterValid(params.getPictureFormat(),
@@ -623,6 +657,21 @@ status_t CameraHal::setParameters(const CameraParameters &params)
 
         }
 
+    ///The recording buffer mode can only change while not recording
+    if( ( (valstr = params.get(TICameraParameters::KEY_VIDEO_METADATA)) != NULL ) && !mRecordingEnabled )
+        {
+        CAMHAL_LOGDB("Video metadata set to %s", valstr);
+        mParameters.set(TICameraParameters::KEY_VIDEO_METADATA, valstr);
+        mVideoMetadataEnabled = ( strcmp(valstr, (const char *) CameraParameters::TRUE) == 0 );
+        }
+
+    ///Takes effect the next time the preview callbacks are started
+    if( (valstr = params.get(TICameraParameters::KEY_PREVIEW_CALLBACK_SIZE)) != NULL )
+        {
+        CAMHAL_LOGDB("Preview callback size set to %s", valstr);
+        mParameters.set(TICameraParameters::KEY_PREVIEW_CALLBACK_SIZE, valstr);
+        }
+
     if( (valstr = params.get(CameraParameters::KEY_EXPOSURE_COMPENSATION)) != NULL)
         {
         CAMHAL_LOGDB("Exposure compensation set %s", params.get(CameraParameters::KEY_EXPOSURE_COMPENSATION));
@@ -809,7 +858,14 @@ status_t CameraHal::setParameters(const CameraParameters &params)
 
     if ( NULL != mCameraAdapter )
         {
-        ret |= mCameraAdapter->setParameters(adapterParams);
+        if ( resolutionSwitch )
+            {
+            ret |= switchPreviewResolution(adapterParams);
+            }
+        else
+            {
+            ret |= mCameraAdapter->setParameters(adapterParams);
+            }
         }
 
     if( NULL != params.get(TICameraParameters::KEY_TEMP_BRACKETING_RANGE_POS) )
@@ -930,9 +986,23 @@ status_t CameraHal::allocPreviewBufs(int width, int height, const char* previewF
         ///@todo Pluralise the name of this method to allocateBuffers
         mPreviewLength = 0;
         mPreviewBufs = (int32_t *) newBufProvider->allocateBuffer(width, height, previewFormat, mPreviewLength, atoi(mCameraPropertiesArr[CameraProperties::PROP_INDEX_REQUIRED_PREVIEW_BUFS]->mPropValue));
+
+        ///Display buffers come from the same TILER space, which may still be occupied by the MemoryManager pool
+        if ( ( NULL == mPreviewBufs ) &&
+             ( mPreviewBufsAllocatedUsingOverlay ) &&
+             ( NULL != mMemoryManager.get() ) &&
+             ( 0 < mMemoryManager->releasePool() ) )
+            {
+            CAMHAL_LOGDA("Retrying preview buffer allocation after releasing the buffer pool");
+            mPreviewLength = 0;
+            mPreviewBufs = (int32_t *) newBufProvider->allocateBuffer(width, height, previewFormat, mPreviewLength, atoi(mCameraPropertiesArr[CameraProperties::PROP_INDEX_REQUIRED_PREVIEW_BUFS]->mPropValue));
+            }
+
         mPreviewOffsets = (uint32_t *) newBufProvider->getOffsets();
         mPreviewFd = newBufProvider->getFd();
         mBufProvider = newBufProvider;
+        mPreviewBufsWidth = width;
+        mPreviewBufsHeight = height;
 
         }
     else
@@ -957,6 +1027,8 @@ status_t CameraHal::allocPreviewBufs(int width, int height, const char* previewF
                 mPreviewOffsets = (uint32_t *) newBufProvider->getOffsets();
                 mPreviewFd = newBufProvider->getFd();
                 mBufProvider = newBufProvider;
+                mPreviewBufsWidth = width;
+                mPreviewBufsHeight = height;
 
                 }
         }
@@ -978,6 +1050,8 @@ status_t CameraHal::freePreviewBufs()
         ///@todo Pluralise the name of this method to freeBuffers
         ret = mBufProvider->freeBuffer(mPreviewBufs);
         mPreviewBufs = NULL;
+        mPreviewBufsWidth = 0;
+        mPreviewBufsHeight = 0;
         LOG_FUNCTION_NAME_EXIT
         return ret;
         }
@@ -1651,6 +1725,138 @@ void CameraHal::stopPreview()
     LOG_FUNCTION_NAME_EXIT
 }
 
+/**
+   @brief Switch the resolution of a running preview.
+
+   Only the camera preview port and the display crop get reconfigured, the preview buffers
+   are reused as long as the new padded frame size fits in them. The display is paused meanwhile,
+   so it keeps showing the last frame of the old resolution. If the in-place switch
+   isn't possible, preview is restarted with freshly allocated buffers.
+
+   @param[in] adapterParams Camera adapter parameters containing the new preview size
+   @return NO_ERROR If the new resolution is applied
+
+ */
+status_t CameraHal::switchPreviewResolution(const CameraParameters &adapterParams)
+{
+    status_t ret = NO_ERROR;
+    int bufferCount = atoi(mCameraPropertiesArr[CameraProperties::PROP_INDEX_REQUIRED_PREVIEW_BUFS]->mPropValue);
+    int w, h;
+
+    LOG_FUNCTION_NAME
+
+    if ( mMeasurementEnabled || ( NULL == mPreviewBufs ) )
+        {
+        CAMHAL_LOGDA("Preview buffers can't be reused");
+        ret = -EINVAL;
+        goto restart;
+        }
+
+    ///Keep the last frame on the display while the camera is being reconfigured
+    if ( NULL != mDisplayAdapter.get() )
+        {
+        mDisplayAdapter->pauseDisplay(true);
+        }
+
+    ///Stop the source of frames, the camera keeps its resources otherwise
+    ret = mCameraAdapter->sendCommand(CameraAdapter::CAMERA_STOP_PREVIEW);
+    if ( NO_ERROR != ret )
+        {
+        CAMHAL_LOGEB("Camera adapter stop preview failed %d", ret);
+        goto restart;
+        }
+
+    ret = mCameraAdapter->setParameters(adapterParams);
+    if ( NO_ERROR != ret )
+        {
+        CAMHAL_LOGEB("Camera adapter setParameters failed %d", ret);
+        goto restart;
+        }
+
+    ///Get the updated size from Camera Adapter, to account for padding etc
+    mCameraAdapter->getFrameSize(w, h);
+    if ( ( ( uint32_t ) w > mPreviewBufsWidth ) || ( ( uint32_t ) h > mPreviewBufsHeight ) )
+        {
+        CAMHAL_LOGDB("Preview buffers %d x %d can't hold %d x %d frames",
+                     mPreviewBufsWidth,
+                     mPreviewBufsHeight,
+                     w,
+                     h);
+        ret = -EINVAL;
+        goto restart;
+        }
+
+    mPreviewWidth = w;
+    mPreviewHeight = h;
+    mParameters.set(TICameraParameters::KEY_PADDED_WIDTH, mPreviewWidth);
+    mParameters.set(TICameraParameters::KEY_PADDED_HEIGHT, mPreviewHeight);
+
+    ///Hand the same buffers back to the Camera Adapter, this reconfigures its preview port
+    ret = mCameraAdapter->useBuffers(CameraAdapter::CAMERA_PREVIEW, mPreviewBufs, mPreviewOffsets, mPreviewFd, mPreviewLength, bufferCount);
+    if ( NO_ERROR != ret )
+        {
+        CAMHAL_LOGEB("Camera adapter useBuffers failed %d", ret);
+        goto restart;
+        }
+
+    ///Preview callback buffers depend on the preview size
+    mAppCallbackNotifier->stopPreviewCallbacks();
+    ret = mAppCallbackNotifier->startPreviewCallbacks(mParameters, mPreviewBufs, mPreviewOffsets, mPreviewFd, mPreviewLength, bufferCount);
+    if ( NO_ERROR != ret )
+        {
+        CAMHAL_LOGEB("Preview callbacks restart failed %d", ret);
+        goto restart;
+        }
+
+    if ( NULL != mDisplayAdapter.get() )
+        {
+        mParameters.getPreviewSize(&w, &h);
+        ret = mDisplayAdapter->setFrameSize(w, h);
+        if ( NO_ERROR != ret )
+            {
+            CAMHAL_LOGEB("Display frame size update failed %d", ret);
+            goto restart;
+            }
+        }
+
+    ret = mCameraAdapter->sendCommand(CameraAdapter::CAMERA_START_PREVIEW);
+    if ( NO_ERROR != ret )
+        {
+        CAMHAL_LOGEB("Camera adapter start preview failed %d", ret);
+        goto restart;
+        }
+
+    if ( NULL != mDisplayAdapter.get() )
+        {
+        mDisplayAdapter->pauseDisplay(false);
+        }
+
+    LOG_FUNCTION_NAME_EXIT
+
+    return NO_ERROR;
+
+    restart:
+
+    CAMHAL_LOGDA("Restarting preview with the new resolution");
+
+    if ( NULL != mDisplayAdapter.get() )
+        {
+        mDisplayAdapter->pauseDisplay(false);
+        }
+
+    stopPreview();
+
+    ret = mCameraAdapter->setParameters(adapterParams);
+    if ( NO_ERROR == ret )
+        {
+        ret = startPreview();
+        }
+
+    LOG_FUNCTION_NAME_EXIT
+
+    return ret;
+}
+
 /**
    @brief Returns true if preview is enabled
 
@@ -1697,6 +1903,11 @@ status_t CameraHal::startRecording( )
         return NO_INIT;
         }
 
+    if ( NO_ERROR == ret )
+        {
+        ret = mAppCallbackNotifier->useMetaDataBufferMode(mVideoMetadataEnabled);
+        }
+
     if ( NO_ERROR == ret )
         {
          ret = mAppCallbackNotifier->initSharedVideoBuffers(mPreviewBufs, mPreviewOffsets, mPreviewFd, mPreviewLength, atoi(mCameraPropertiesArr[CameraProperties::PROP_INDEX_REQUIRED_PREVIEW_BUFS]->mPropValue));
@@ -2327,6 +2538,9 @@ void CameraHal::release()
 /**
    @brief Dump state of the camera hardware
 
+   The output consists of one "<subsystem>.<key>=<value>" line per counter,
+   so that it can be parsed without knowledge of the individual subsystems.
+
    @param[in] fd    File descriptor
    @param[in] args  Arguments
    @return NO_ERROR Dump succeeded
@@ -2335,8 +2549,40 @@ void CameraHal::release()
  */
 status_t  CameraHal::dump(int fd, const Vector<String16>& args) const
 {
+    String8 result;
+
     LOG_FUNCTION_NAME
-    ///Implement this method when the h/w dump function is supported on Ducati side
+
+    result.appendFormat("hal.previewing=%d\n", mPreviewEnabled);
+    result.appendFormat("hal.recording=%d\n", mRecordingEnabled);
+    result.appendFormat("hal.msg_enabled=0x%x\n", mMsgEnabled);
+
+    if ( NULL != mCameraAdapter )
+        {
+        mCameraAdapter->dumpStats(result);
+        }
+
+    if ( NULL != mDisplayAdapter.get() )
+        {
+        mDisplayAdapter->dumpStats(result);
+        }
+
+    if ( NULL != mAppCallbackNotifier.get() )
+        {
+        mAppCallbackNotifier->dumpStats(result);
+        }
+
+    if ( NULL != mMemoryManager.get() )
+        {
+        mMemoryManager->dumpStats(result);
+        }
+
+    ///Per stage frame latencies, populated only when debug.camera.trace is set
+    FrameTrace::dump(result);
+
+    write(fd, result.string(), result.size());
+
+    ///Implement the rest of this method when the h/w dump function is supported on Ducati side
     return NO_ERROR;
 }
 
@@ -2384,6 +2630,7 @@ CameraHal::CameraHal(int cameraId)
     mMaxZoomSupported = 0;
     mShutterEnabled = true;
     mMeasurementEnabled = false;
+    mVideoMetadataEnabled = false;
     mPreviewDataBufs = NULL;
     mCameraAdapterHandle = NULL;
     mCameraPropertiesArr = NULL;
@@ -2401,6 +2648,8 @@ CameraHal::CameraHal(int cameraId)
     mPreviewFd = 0;
     mPreviewWidth = 0;
     mPreviewHeight = 0;
+    mPreviewBufsWidth = 0;
+    mPreviewBufsHeight = 0;
     mPreviewLength = 0;
     mPreviewOffsets = NULL;
     mPreviewRunning = 0;
@@ -2471,9 +2720,14 @@ status_t CameraHal::initialize()
     CameraAdapterFactory f = NULL;
 
     int sensor_index = 0;
+    char value[PROPERTY_VALUE_MAX];
 
     mLastPreviewFramerate = 0;
 
+    ///Per frame latency tracing, see FrameTrace
+    property_get("debug.camera.trace", value, "0");
+    FrameTrace::setEnabled( ( 0 != atoi(value) ));
+
     ///Initialize the event mask used for registering an event provider for AppCallbackNotifier
     ///Currently, registering all events as to be coming from CameraAdapter
     int32_t eventMask = CameraHalEvent::ALL_EVENTS;
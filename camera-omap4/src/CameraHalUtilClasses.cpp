@@ -1,110 +1,275 @@
-/*
- * Copyright (C) Texas Instruments - http://www.ti.com/
- *
- * This library is free software; you can redistribute it and/or
- * modify it under the terms of the GNU Lesser General Public
- * License as published by the Free Software Foundation; either
- * version 2.1 of the License, or (at your option) any later version.
- *
- *
- * This library is distributed in the hope that it will be useful,
- * but WITHOUT ANY WARRANTY; without even the implied warranty of
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
- * Lesser General Public License for more details.
- *
- *
- * You should have received a copy of the GNU Lesser General Public
- * License along with this library; if not, write to the Free Software
- * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
- */
-/**
-* @file CameraHalUtilClasses.cpp
-*
-* This file maps the CameraHardwareInterface to the Camera interfaces on OMAP4 (mainly OMX).
-*
-*/
-
-#define LOG_TAG "CameraHal"
-
-
-#include "CameraHal.h"
-
-namespace android {
-
-/*--------------------FrameProvider Class STARTS here-----------------------------*/
-
-int FrameProvider::enableFrameNotification(int32_t frameTypes)
-{
-    LOG_FUNCTION_NAME
-    status_t ret = NO_ERROR;
-
-    ///Enable the frame notification to CameraAdapter (which implements FrameNotifier interface)
-    mFrameNotifier->enableMsgType(frameTypes<<MessageNotifier::FRAME_BIT_FIELD_POSITION
-                                    , mFrameCallback
-                                    , NULL
-                                    , mCookie
-                                    );
-
-    LOG_FUNCTION_NAME_EXIT;
-    return ret;
-}
-
-int FrameProvider::disableFrameNotification(int32_t frameTypes)
-{
-    LOG_FUNCTION_NAME
-    status_t ret = NO_ERROR;
-
-    mFrameNotifier->disableMsgType(frameTypes<<MessageNotifier::FRAME_BIT_FIELD_POSITION
-                                    , mCookie
-                                    );
-
-    LOG_FUNCTION_NAME_EXIT;
-    return ret;
-}
-
-int FrameProvider::returnFrame(void *frameBuf, CameraFrame::FrameType frameType)
-{
-    status_t ret = NO_ERROR;
-
-    mFrameNotifier->returnFrame(frameBuf, frameType);
-
-    return ret;
-}
-
-
-/*--------------------FrameProvider Class ENDS here-----------------------------*/
-
-/*--------------------EventProvider Class STARTS here-----------------------------*/
-
-int EventProvider::enableEventNotification(int32_t frameTypes)
-{
-    LOG_FUNCTION_NAME
-    status_t ret = NO_ERROR;
-
-    ///Enable the frame notification to CameraAdapter (which implements FrameNotifier interface)
-    mEventNotifier->enableMsgType(frameTypes<<MessageNotifier::EVENT_BIT_FIELD_POSITION
-                                    , NULL
-                                    , mEventCallback
-                                    , mCookie
-                                    );
-
-    LOG_FUNCTION_NAME_EXIT
-    return ret;
-}
-
-int EventProvider::disableEventNotification(int32_t frameTypes)
-{
-    LOG_FUNCTION_NAME
-    status_t ret = NO_ERROR;
-
-    mEventNotifier->disableMsgType(frameTypes<<MessageNotifier::FRAME_BIT_FIELD_POSITION
-                                    , mCookie
-                                    );
-
-    LOG_FUNCTION_NAME_EXIT
-    return ret;
-}
-
-/*--------------------EventProvider Class ENDS here-----------------------------*/
-
-};
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/**
+* @file CameraHalUtilClasses.cpp
+*
+* This file maps the CameraHardwareInterface to the Camera interfaces on OMAP4 (mainly OMX).
+*
+*/
+
+#define LOG_TAG "CameraHal"
+
+
+#include "CameraHal.h"
+
+namespace android {
+
+/*--------------------FrameProvider Class STARTS here-----------------------------*/
+
+int FrameProvider::enableFrameNotification(int32_t frameTypes)
+{
+    LOG_FUNCTION_NAME
+    status_t ret = NO_ERROR;
+
+    ///Enable the frame notification to CameraAdapter (which implements FrameNotifier interface)
+    mFrameNotifier->enableMsgType(frameTypes<<MessageNotifier::FRAME_BIT_FIELD_POSITION
+                                    , mFrameCallback
+                                    , NULL
+                                    , mCookie
+                                    );
+
+    LOG_FUNCTION_NAME_EXIT;
+    return ret;
+}
+
+int FrameProvider::disableFrameNotification(int32_t frameTypes)
+{
+    LOG_FUNCTION_NAME
+    status_t ret = NO_ERROR;
+
+    mFrameNotifier->disableMsgType(frameTypes<<MessageNotifier::FRAME_BIT_FIELD_POSITION
+                                    , mCookie
+                                    );
+
+    LOG_FUNCTION_NAME_EXIT;
+    return ret;
+}
+
+int FrameProvider::returnFrame(void *frameBuf, CameraFrame::FrameType frameType)
+{
+    status_t ret = NO_ERROR;
+
+    mFrameNotifier->returnFrame(frameBuf, frameType);
+
+    return ret;
+}
+
+
+/*--------------------FrameProvider Class ENDS here-----------------------------*/
+
+/*--------------------EventProvider Class STARTS here-----------------------------*/
+
+int EventProvider::enableEventNotification(int32_t frameTypes)
+{
+    LOG_FUNCTION_NAME
+    status_t ret = NO_ERROR;
+
+    ///Enable the frame notification to CameraAdapter (which implements FrameNotifier interface)
+    mEventNotifier->enableMsgType(frameTypes<<MessageNotifier::EVENT_BIT_FIELD_POSITION
+                                    , NULL
+                                    , mEventCallback
+                                    , mCookie
+                                    );
+
+    LOG_FUNCTION_NAME_EXIT
+    return ret;
+}
+
+int EventProvider::disableEventNotification(int32_t frameTypes)
+{
+    LOG_FUNCTION_NAME
+    status_t ret = NO_ERROR;
+
+    mEventNotifier->disableMsgType(frameTypes<<MessageNotifier::FRAME_BIT_FIELD_POSITION
+                                    , mCookie
+                                    );
+
+    LOG_FUNCTION_NAME_EXIT
+    return ret;
+}
+
+/*--------------------EventProvider Class ENDS here-----------------------------*/
+
+/*--------------------FrameTrace Class STARTS here-----------------------------*/
+
+static const char *sTraceStageNames[FrameTrace::STAGE_COUNT] =
+    {
+    "capture",
+    "dispatch",
+    "app_dequeue",
+    "app_callback",
+    "display_post",
+    "display_done",
+    "return"
+    };
+
+static const char *sTraceStreamNames[FrameTrace::STREAM_COUNT] =
+    {
+    "preview",
+    "image"
+    };
+
+bool FrameTrace::sEnabled = false;
+Mutex FrameTrace::sLock;
+KeyedVector<unsigned int, FrameTrace::Record> FrameTrace::sRecords;
+LatencyHistogram FrameTrace::sSinceCapture[FrameTrace::STREAM_COUNT][FrameTrace::STAGE_COUNT];
+LatencyHistogram FrameTrace::sSincePrevious[FrameTrace::STREAM_COUNT][FrameTrace::STAGE_COUNT];
+
+void FrameTrace::setEnabled(bool enable)
+{
+    Mutex::Autolock lock(sLock);
+
+    sEnabled = enable;
+    if ( !sEnabled )
+        {
+        sRecords.clear();
+        }
+}
+
+void FrameTrace::begin(void *buffer, Stream stream)
+{
+    Record record;
+    ssize_t index;
+
+    if ( !sEnabled || ( NULL == buffer ) )
+        {
+        return;
+        }
+
+    memset(&record, 0, sizeof(record));
+    record.mStream = stream;
+    record.mStamps[STAGE_CAPTURE] = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    Mutex::Autolock lock(sLock);
+
+    //The previous frame inside this buffer is complete once the buffer gets refilled,
+    //this also catches stages stamped after the frame got returned
+    index = sRecords.indexOfKey( ( unsigned int ) buffer);
+    if ( 0 <= index )
+        {
+        aggregateLocked(sRecords.valueAt(index));
+        sRecords.replaceValueAt(index, record);
+        }
+    else
+        {
+        sRecords.add( ( unsigned int ) buffer, record);
+        }
+}
+
+void FrameTrace::mark(void *buffer, Stage stage)
+{
+    ssize_t index;
+    nsecs_t now;
+
+    if ( !sEnabled || ( NULL == buffer ) )
+        {
+        return;
+        }
+
+    now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    Mutex::Autolock lock(sLock);
+
+    index = sRecords.indexOfKey( ( unsigned int ) buffer);
+    if ( 0 > index )
+        {
+        return;
+        }
+
+    Record &record = sRecords.editValueAt(index);
+    if ( 0 == record.mStamps[stage] )
+        {
+        record.mStamps[stage] = now;
+        }
+}
+
+void FrameTrace::aggregateLocked(const Record &record)
+{
+    nsecs_t capture, previous;
+
+    capture = record.mStamps[STAGE_CAPTURE];
+
+    for ( int i = STAGE_CAPTURE + 1 ; i < STAGE_COUNT ; i++ )
+        {
+        if ( 0 == record.mStamps[i] )
+            {
+            continue;
+            }
+
+        //Closest stage which happened before this one
+        previous = capture;
+        for ( int j = STAGE_CAPTURE + 1 ; j < STAGE_COUNT ; j++ )
+            {
+            if ( ( j != i ) &&
+                 ( record.mStamps[j] > previous ) &&
+                 ( record.mStamps[j] <= record.mStamps[i] ) )
+                {
+                previous = record.mStamps[j];
+                }
+            }
+
+        sSinceCapture[record.mStream][i].add(record.mStamps[i] - capture);
+        sSincePrevious[record.mStream][i].add(record.mStamps[i] - previous);
+        }
+}
+
+void FrameTrace::reset()
+{
+    Mutex::Autolock lock(sLock);
+
+    sRecords.clear();
+
+    for ( int i = 0 ; i < STREAM_COUNT ; i++ )
+        {
+        for ( int j = 0 ; j < STAGE_COUNT ; j++ )
+            {
+            sSinceCapture[i][j].reset();
+            sSincePrevious[i][j].reset();
+            }
+        }
+}
+
+void FrameTrace::dump(String8 &out)
+{
+    char name[128];
+
+    out.appendFormat("trace.enabled=%d\n", sEnabled);
+
+    for ( int i = 0 ; i < STREAM_COUNT ; i++ )
+        {
+        for ( int j = STAGE_CAPTURE + 1 ; j < STAGE_COUNT ; j++ )
+            {
+            if ( 0 == sSinceCapture[i][j].count() )
+                {
+                continue;
+                }
+
+            snprintf(name, sizeof(name), "trace.%s.%s.since_capture", sTraceStreamNames[i], sTraceStageNames[j]);
+            sSinceCapture[i][j].dump(out, name);
+
+            snprintf(name, sizeof(name), "trace.%s.%s.since_previous", sTraceStreamNames[i], sTraceStageNames[j]);
+            sSincePrevious[i][j].dump(out, name);
+            }
+        }
+}
+
+/*--------------------FrameTrace Class ENDS here-----------------------------*/
+
+};
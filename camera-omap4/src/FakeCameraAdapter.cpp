@@ -22,10 +22,25 @@
 #define LOG_TAG "CameraHal"
 
 #include "FakeCameraAdapter.h"
+#include <cutils/properties.h>
 
 namespace android {
 
 #define DEFAULT_PICTURE_BUFFER_SIZE 0x1000
+#define DEFAULT_FRAME_RATE 30
+#define DEFAULT_STATS_PERIOD 0
+#define DEFAULT_SINK_DEPTH 3
+
+static int getIntProperty(const char *key, int defaultValue)
+{
+    char value[PROPERTY_VALUE_MAX];
+    char defaultStr[PROPERTY_VALUE_MAX];
+
+    snprintf(defaultStr, sizeof(defaultStr), "%d", defaultValue);
+    property_get(key, value, defaultStr);
+
+    return atoi(value);
+}
 
 /*--------------------Camera Adapter Class STARTS here-----------------------------*/
 
@@ -33,6 +48,21 @@ FakeCameraAdapter::FakeCameraAdapter()
 {
     LOG_FUNCTION_NAME
 
+    mPreviewWidth = 0;
+    mPreviewHeight = 0;
+    mPreviewFormat = 0;
+    mCaptureWidth = 0;
+    mCaptureHeight = 0;
+    mCaptureFormat = 0;
+    mFrameRate = DEFAULT_FRAME_RATE;
+    mNextFrameTime = 0;
+    mBurstCount = 0;
+    mRandSeed = 0;
+    mFrameIndex = 0;
+
+    memset(&mLoadConfig, 0, sizeof(mLoadConfig));
+    resetStats();
+
     LOG_FUNCTION_NAME_EXIT
 }
 
@@ -53,7 +83,9 @@ FakeCameraAdapter::~FakeCameraAdapter()
     mFrameThread->requestExitAndWait();
 
     mCallbackThread.clear();
-    mFrameThread.clear();;
+    mFrameThread.clear();
+
+    stopMockSinks();
 
     LOG_FUNCTION_NAME_EXIT
 }
@@ -84,6 +116,8 @@ status_t FakeCameraAdapter::initialize(int sensor_index)
 {
     LOG_FUNCTION_NAME
 
+    readLoadConfig();
+
     //Create the frame thread
     mFrameThread = new FramePreview(this);
     if ( NULL == mFrameThread.get() )
@@ -128,6 +162,11 @@ status_t FakeCameraAdapter::setParameters(const CameraParameters& params)
     params.getPreviewSize(&mPreviewWidth, &mPreviewHeight);
     params.getPictureSize(&mCaptureWidth, &mCaptureHeight);
 
+    if ( 0 < params.getPreviewFrameRate() )
+        {
+        mFrameRate = params.getPreviewFrameRate();
+        }
+
     LOG_FUNCTION_NAME_EXIT
 
     return NO_ERROR;
@@ -168,6 +207,16 @@ status_t FakeCameraAdapter::startPreview()
 
     LOG_FUNCTION_NAME
 
+    if ( mLoadConfig.mMockSinks )
+        {
+        ret = startMockSinks();
+        if ( NO_ERROR != ret )
+            {
+            CAMHAL_LOGEA("Couldn't start the mock frame sinks");
+            return ret;
+            }
+        }
+
     msg.command = BaseCameraAdapter::START_PREVIEW;
 
     mFrameQ.put(&msg);
@@ -202,6 +251,9 @@ status_t FakeCameraAdapter::stopPreview()
         ret = -1;
         }
 
+    stopMockSinks();
+    logStats();
+
     LOG_FUNCTION_NAME_EXIT
 
     return ret;
@@ -337,6 +389,7 @@ void FakeCameraAdapter::frameCallbackThread()
     bool shouldLive = true;
     Message msg;
     CameraFrame *frame;
+    status_t ret;
 
     LOG_FUNCTION_NAME
 
@@ -351,7 +404,17 @@ void FakeCameraAdapter::frameCallbackThread()
             if ( NULL != frame )
                 {
                 resetFrameRefCount(*frame);
-                sendFrameToSubscribers(frame);
+                ret = sendFrameToSubscribers(frame);
+
+                //Nobody is going to return this buffer, recycle it right away
+                if ( ( NO_ERROR != ret ) &&
+                     ( CameraFrame::PREVIEW_FRAME_SYNC == frame->mFrameType ) &&
+                     ( !mRecording || ( 0 == getSubscriberCount(CameraFrame::VIDEO_FRAME_SYNC) ) ) )
+                    {
+                    releasePreviewBuffer( ( unsigned int ) frame->mBuffer);
+                    }
+
+                delete frame;
                 }
             }
         else if ( FakeCameraAdapter::CALLBACK_EXIT == msg.command  )
@@ -366,13 +429,13 @@ void FakeCameraAdapter::frameCallbackThread()
 /**
    @brief
 
-   Fills a given overlay buffer with a solid color depending on their index
-   and type
+   Fills a given overlay buffer with synthetic content depending on the
+   configured pattern, the buffer index and the frame type
    Only YUV422I supported for now
    TODO: Add additional pixelformat support
 
    @param previewBuffer - pointer to the preview buffer
-   @param index - index of the overlay buffer
+   @param index - index of the generated frame
    @param width - width of the buffer
    @param height - height of the buffer
    @param pixelformat - pixelFormat of the buffer
@@ -385,36 +448,65 @@ void FakeCameraAdapter::setBuffer(void *previewBuffer, int index, int width, int
 {
     unsigned int alignedRow;
     unsigned char *buffer;
-    uint16_t data;
+    unsigned char data;
 
     buffer = ( unsigned char * ) previewBuffer;
     //rows are page aligned
     alignedRow = ( width * 2 + ( PAGE_SIZE -1 ) ) & ( ~ ( PAGE_SIZE -1 ) );
 
-    if ( SNAPSHOT_FRAME == frame )
+    if ( ( SNAPSHOT_FRAME == frame ) ||
+         ( PATTERN_SOLID == mLoadConfig.mPattern ) )
+        {
+        if ( ( NORMAL_FRAME == frame ) && ( index & 0x2 ) )
+            {
+            data = 0xC8; //Two alternating colors depending on the frame index
+            }
+        else
+            {
+            data = 0x0;
+            }
+
+        //iterate through each row
+        for ( int i = 0 ; i < height ; i++,  buffer += alignedRow)
+            memset(buffer, data, width * 2);
+        }
+    else if ( PATTERN_RAMP == mLoadConfig.mPattern )
         {
-        data = 0x0;
+        //UYVY with a horizontal luma ramp scrolling with every frame
+        for ( int i = 0 ; i < height ; i++,  buffer += alignedRow)
+            {
+            for ( int j = 0 ; j < width * 2 ; j += 4 )
+                {
+                data = ( unsigned char ) ( ( j / 2 ) + index * 4 );
+                buffer[j] = 0x80;
+                buffer[j + 1] = data;
+                buffer[j + 2] = 0x80;
+                buffer[j + 3] = data;
+                }
+            }
         }
     else
         {
-        if ( 2 <= index )
-            data = 0x00C8; //Two alternating colors depending on the buffer indexes
-        else
-            data = 0x0;
+        //Pseudo random content, defeats any compression or caching of the frame data
+        uint32_t lcg = mRandSeed ^ ( index * 2654435761U );
+        for ( int i = 0 ; i < height ; i++,  buffer += alignedRow)
+            {
+            uint32_t *row = ( uint32_t * ) buffer;
+            for ( int j = 0 ; j < width / 2 ; j++ )
+                {
+                lcg = lcg * 1664525 + 1013904223;
+                row[j] = lcg;
+                }
+            }
         }
-
-    //iterate through each row
-    for ( int i = 0 ; i < height ; i++,  buffer += alignedRow)
-        memset(buffer, data, sizeof(data)*width);
 }
 
  void FakeCameraAdapter::sendNextFrame(PreviewFrameType frameType)
 {
     void *previewBuffer = NULL;
-    CameraFrame frame;
+    CameraFrame *frame;
     Message msg;
-    size_t count;
-    int i = 0;
+    nsecs_t now, timestamp;
 
         {
         Mutex::Autolock lock(mPreviewVectorLock);
@@ -422,41 +514,510 @@ void FakeCameraAdapter::setBuffer(void *previewBuffer, int index, int width, int
         if ( !mFreePreviewBuffers.isEmpty() )
             {
             previewBuffer = ( void * ) mFreePreviewBuffers.top();
+            mFreePreviewBuffers.pop();
             }
         }
 
     if ( NULL == previewBuffer )
+        {
+        //All buffers are held by the consumers, the frame is lost
+        Mutex::Autolock lock(mStatsLock);
+        mFramesDropped++;
         return;
+        }
+
+    FrameTrace::begin(previewBuffer, FrameTrace::STREAM_PREVIEW);
 
     //TODO: add pixelformat
-    setBuffer(previewBuffer, i, mPreviewWidth, mPreviewHeight, 0, frameType);
+    setBuffer(previewBuffer, mFrameIndex++, mPreviewWidth, mPreviewHeight, 0, frameType);
+
+    now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    //Frames are stamped with their scheduled capture time, so the lateness of the
+    //generator itself is accounted for in the latency statistics
+    if ( ( NORMAL_FRAME == frameType ) && ( 0 < mNextFrameTime ) )
+        {
+        timestamp = mNextFrameTime;
+        }
+    else
+        {
+        timestamp = now;
+        }
+
+        {
+        Mutex::Autolock lock(mStatsLock);
+        mFramesGenerated++;
+        mFramesInFlight.add( ( unsigned int ) previewBuffer, timestamp);
+        mLateness.add(now - timestamp);
+        }
 
-    frame.mBuffer = previewBuffer;
-    frame.mAlignment = PAGE_SIZE;
-    frame.mWidth = mPreviewWidth;
-    frame.mHeight = mPreviewHeight;
-    frame.mLength = PAGE_SIZE*mPreviewHeight;
-    frame.mOffset = 0;
-    frame.mTimestamp = systemTime(SYSTEM_TIME_MONOTONIC);
-    frame.mFrameType = CameraFrame::PREVIEW_FRAME_SYNC;
+    frame = new CameraFrame();
+    if ( NULL == frame )
+        {
+        CAMHAL_LOGEA("Not enough resources to allocate CameraFrame");
+        releasePreviewBuffer( ( unsigned int ) previewBuffer);
+        return;
+        }
+
+    frame->mBuffer = previewBuffer;
+    frame->mAlignment = PAGE_SIZE;
+    frame->mWidth = mPreviewWidth;
+    frame->mHeight = mPreviewHeight;
+    frame->mLength = PAGE_SIZE*mPreviewHeight;
+    frame->mOffset = 0;
+    frame->mTimestamp = timestamp;
+    frame->mFrameType = CameraFrame::PREVIEW_FRAME_SYNC;
 
     msg.command = FakeCameraAdapter::CALL_CALLBACK;
-    msg.arg1 = ( void * ) &frame;
 
+    if ( mRecording && ( NORMAL_FRAME == frameType ) )
+        {
+        CameraFrame *videoFrame = new CameraFrame(*frame);
+        if ( NULL != videoFrame )
+            {
+            videoFrame->mFrameType = CameraFrame::VIDEO_FRAME_SYNC;
+            msg.arg1 = ( void * ) videoFrame;
+            mCallbackQ.put(&msg);
+            }
+        }
+
+    msg.arg1 = ( void * ) frame;
     mCallbackQ.put(&msg);
 
-    frame.mFrameType = CameraFrame::VIDEO_FRAME_SYNC;
+    if ( ( 0 < mLoadConfig.mStatsPeriod ) &&
+         ( 0 == ( mFramesGenerated % mLoadConfig.mStatsPeriod ) ) )
+        {
+        logStats();
+        }
+}
+
+void FakeCameraAdapter::releasePreviewBuffer(unsigned int buffer)
+{
+    ssize_t index;
+    nsecs_t timestamp = 0;
 
-    mCallbackQ.put(&msg);
+        {
+        Mutex::Autolock lock(mStatsLock);
+        index = mFramesInFlight.indexOfKey(buffer);
+        if ( 0 <= index )
+            {
+            timestamp = mFramesInFlight.valueAt(index);
+            mFramesInFlight.removeItemsAt(index);
+            mFramesReturned++;
+            mLatency.add(systemTime(SYSTEM_TIME_MONOTONIC) - timestamp);
+            }
+        }
+
+        {
+        Mutex::Autolock lock(mPreviewVectorLock);
+        mFreePreviewBuffers.push(buffer);
+        }
+}
+
+/**
+   @brief Reads the load generator configuration
+
+   The configuration comes from the following system properties:
+   debug.camera.fake.fps           - frame rate, 0 = unthrottled, -1 = preview frame rate (default)
+   debug.camera.fake.jitter        - maximum random deviation of the frame interval in us
+   debug.camera.fake.burst         - frames per burst, 0 = continuous stream
+   debug.camera.fake.burstgap      - idle time between bursts in ms
+   debug.camera.fake.pattern       - 0 solid, 1 luma ramp, 2 noise
+   debug.camera.fake.statsperiod   - frames between statistics logs, 0 = only at stopPreview (default)
+   debug.camera.fake.sinks         - 1 attaches the headless mock display and app sinks
+   debug.camera.fake.displayhold   - time in us the mock display keeps each frame
+   debug.camera.fake.displaydepth  - frames the mock display can hold before dropping
+   debug.camera.fake.apphold       - time in us the mock app sink keeps each frame
+   debug.camera.fake.appdepth      - frames the mock app sink can hold before dropping
+   debug.camera.fake.seed          - seed for the jitter and noise generators
+
+   @return none
+
+ */
+void FakeCameraAdapter::readLoadConfig()
+{
+    LOG_FUNCTION_NAME
+
+    mLoadConfig.mFrameRate = getIntProperty("debug.camera.fake.fps", -1);
+    mLoadConfig.mJitterUs = getIntProperty("debug.camera.fake.jitter", 0);
+    mLoadConfig.mBurstLength = getIntProperty("debug.camera.fake.burst", 0);
+    mLoadConfig.mBurstGapMs = getIntProperty("debug.camera.fake.burstgap", 0);
+    mLoadConfig.mPattern = getIntProperty("debug.camera.fake.pattern", PATTERN_SOLID);
+    mLoadConfig.mStatsPeriod = getIntProperty("debug.camera.fake.statsperiod", DEFAULT_STATS_PERIOD);
+    mLoadConfig.mMockSinks = ( 0 != getIntProperty("debug.camera.fake.sinks", 0) );
+    mLoadConfig.mDisplayHoldUs = getIntProperty("debug.camera.fake.displayhold", 16667);
+    mLoadConfig.mDisplayDepth = getIntProperty("debug.camera.fake.displaydepth", DEFAULT_SINK_DEPTH);
+    mLoadConfig.mAppHoldUs = getIntProperty("debug.camera.fake.apphold", 5000);
+    mLoadConfig.mAppDepth = getIntProperty("debug.camera.fake.appdepth", DEFAULT_SINK_DEPTH);
+    mRandSeed = ( unsigned int ) getIntProperty("debug.camera.fake.seed", 1);
+
+    if ( ( PATTERN_SOLID > mLoadConfig.mPattern ) || ( PATTERN_NOISE < mLoadConfig.mPattern ) )
+        {
+        CAMHAL_LOGEB("Invalid fake frame pattern %d, using solid color", mLoadConfig.mPattern);
+        mLoadConfig.mPattern = PATTERN_SOLID;
+        }
+
+    CAMHAL_LOGDB("Fake load: fps %d jitter %dus burst %d gap %dms pattern %d sinks %d",
+                 mLoadConfig.mFrameRate,
+                 mLoadConfig.mJitterUs,
+                 mLoadConfig.mBurstLength,
+                 mLoadConfig.mBurstGapMs,
+                 mLoadConfig.mPattern,
+                 mLoadConfig.mMockSinks);
+
+    LOG_FUNCTION_NAME_EXIT
+}
+
+nsecs_t FakeCameraAdapter::nextFrameInterval()
+{
+    nsecs_t interval;
+    int frameRate = mLoadConfig.mFrameRate;
+
+    if ( 0 > frameRate )
+        {
+        frameRate = mFrameRate;
+        }
+
+    if ( 0 >= frameRate )
+        {
+        //Unthrottled, frames are generated as soon as buffers are available
+        return 0;
+        }
+
+    interval = s2ns(1) / frameRate;
+
+    if ( 0 < mLoadConfig.mJitterUs )
+        {
+        interval += us2ns( ( rand_r(&mRandSeed) % ( 2 * mLoadConfig.mJitterUs + 1 ) ) - mLoadConfig.mJitterUs );
+        }
+
+    if ( 0 < mLoadConfig.mBurstLength )
+        {
+        mBurstCount++;
+        if ( mBurstCount >= mLoadConfig.mBurstLength )
+            {
+            mBurstCount = 0;
+            interval += ms2ns(mLoadConfig.mBurstGapMs);
+            }
+        else
+            {
+            //Frames within a burst are sent back to back
+            interval = 0;
+            }
+        }
+
+    if ( 0 > interval )
+        {
+        interval = 0;
+        }
+
+    return interval;
+}
+
+void FakeCameraAdapter::resetStats()
+{
+    Mutex::Autolock lock(mStatsLock);
+
+    mFramesInFlight.clear();
+    mStatsStart = systemTime(SYSTEM_TIME_MONOTONIC);
+    mFramesGenerated = 0;
+    mFramesDropped = 0;
+    mFramesReturned = 0;
+    mLatency.reset();
+    mLateness.reset();
+}
+
+void FakeCameraAdapter::dumpStats(String8 &out)
+{
+    nsecs_t elapsed;
+
+    BaseCameraAdapter::dumpStats(out);
+
+        {
+        Mutex::Autolock lock(mStatsLock);
+
+        elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - mStatsStart;
+        out.appendFormat("fake.generated=%u\n", mFramesGenerated);
+        out.appendFormat("fake.dropped=%u\n", mFramesDropped);
+        out.appendFormat("fake.returned=%u\n", mFramesReturned);
+        out.appendFormat("fake.in_flight=%u\n", mFramesInFlight.size());
+        if ( 0 < elapsed )
+            {
+            out.appendFormat("fake.throughput_fps=%.2f\n", ( mFramesReturned * float(s2ns(1)) ) / elapsed);
+            }
+        }
+
+    mLatency.dump(out, "fake.latency");
+    mLateness.dump(out, "fake.lateness");
+
+    if ( NULL != mDisplaySink.get() )
+        {
+        mDisplaySink->dumpStats(out);
+        }
+
+    if ( NULL != mAppSink.get() )
+        {
+        mAppSink->dumpStats(out);
+        }
+}
+
+void FakeCameraAdapter::logStats()
+{
+    String8 stats;
+
+    dumpStats(stats);
+
+    LOGD("FakeCameraAdapter load statistics:\n%s", stats.string());
+}
+
+status_t FakeCameraAdapter::startMockSinks()
+{
+    status_t ret = NO_ERROR;
+
+    LOG_FUNCTION_NAME
+
+    stopMockSinks();
+
+    //Mock display, consumes preview frames the way OverlayDisplayAdapter does
+    mDisplaySink = new FakeFrameSink(this, "fake.display",
+                                     CameraFrame::PREVIEW_FRAME_SYNC,
+                                     mLoadConfig.mDisplayHoldUs,
+                                     mLoadConfig.mDisplayDepth);
+
+    //Mock application, consumes preview and video frames the way AppCallbackNotifier does
+    mAppSink = new FakeFrameSink(this, "fake.app",
+                                 CameraFrame::PREVIEW_FRAME_SYNC | CameraFrame::VIDEO_FRAME_SYNC,
+                                 mLoadConfig.mAppHoldUs,
+                                 mLoadConfig.mAppDepth);
+
+    if ( ( NULL == mDisplaySink.get() ) || ( NULL == mAppSink.get() ) )
+        {
+        CAMHAL_LOGEA("Couldn't create mock frame sinks");
+        ret = NO_MEMORY;
+        }
+
+    if ( NO_ERROR == ret )
+        {
+        ret = mDisplaySink->start();
+        }
+
+    if ( NO_ERROR == ret )
+        {
+        ret = mAppSink->start();
+        }
+
+    if ( NO_ERROR != ret )
+        {
+        stopMockSinks();
+        }
+
+    LOG_FUNCTION_NAME_EXIT
+
+    return ret;
+}
+
+void FakeCameraAdapter::stopMockSinks()
+{
+    LOG_FUNCTION_NAME
+
+    if ( NULL != mDisplaySink.get() )
+        {
+        mDisplaySink->stop();
+        mDisplaySink.clear();
+        }
+
+    if ( NULL != mAppSink.get() )
+        {
+        mAppSink->stop();
+        mAppSink.clear();
+        }
+
+    LOG_FUNCTION_NAME_EXIT
+}
+
+/*--------------------FakeFrameSink Class STARTS here-----------------------------*/
+
+FakeCameraAdapter::FakeFrameSink::FakeFrameSink(FakeCameraAdapter *ca, const char *name, int32_t frameTypes, int holdUs, int depth)
+    : Thread(false),
+      mCameraAdapter(ca),
+      mName(name),
+      mFrameTypes(frameTypes),
+      mHold(us2ns(holdUs)),
+      mDepth(depth),
+      mQueued(0),
+      mConsumed(0),
+      mDropped(0)
+{
+}
+
+status_t FakeCameraAdapter::FakeFrameSink::start()
+{
+    status_t ret;
+
+    LOG_FUNCTION_NAME
+
+    ret = run(mName, PRIORITY_URGENT_DISPLAY);
+    if ( NO_ERROR != ret )
+        {
+        CAMHAL_LOGEB("Couldn't run %s sink thread", mName);
+        return ret;
+        }
+
+    //Adapter subscriptions are done one frame type at a time
+    for ( int type = CameraFrame::PREVIEW_FRAME_SYNC ; type <= CameraFrame::SNAPSHOT_FRAME ; type <<= 1 )
+        {
+        if ( type & mFrameTypes )
+            {
+            mCameraAdapter->enableMsgType(type, frameCallbackRelay, NULL, this);
+            }
+        }
+
+    LOG_FUNCTION_NAME_EXIT
+
+    return ret;
+}
+
+void FakeCameraAdapter::FakeFrameSink::stop()
+{
+    Message msg;
+
+    LOG_FUNCTION_NAME
+
+    mCameraAdapter->disableMsgType(CameraFrame::ALL_FRAMES, this);
+
+    msg.command = SINK_EXIT;
+    msg.arg1 = NULL;
+    mSinkQ.put(&msg);
+
+    requestExitAndWait();
+
+    LOG_FUNCTION_NAME_EXIT
+}
+
+void FakeCameraAdapter::FakeFrameSink::frameCallbackRelay(CameraFrame *frame)
+{
+    FakeFrameSink *sink = ( FakeFrameSink * ) frame->mCookie;
+
+    sink->frameCallback(frame);
+}
+
+void FakeCameraAdapter::FakeFrameSink::frameCallback(CameraFrame *frame)
+{
+    Message msg;
+    CameraFrame *sinkFrame;
+    bool drop = false;
+
+    mDelivery.add(systemTime(SYSTEM_TIME_MONOTONIC) - frame->mTimestamp);
+
+        {
+        Mutex::Autolock lock(mLock);
+        if ( mQueued >= mDepth )
+            {
+            mDropped++;
+            drop = true;
+            }
+        else
+            {
+            mQueued++;
+            }
+        }
+
+    sinkFrame = drop ? NULL : new CameraFrame(*frame);
+    if ( NULL == sinkFrame )
+        {
+        if ( !drop )
+            {
+            Mutex::Autolock lock(mLock);
+            mQueued--;
+            mDropped++;
+            }
+
+        mCameraAdapter->returnFrame(frame->mBuffer, ( CameraFrame::FrameType ) frame->mFrameType);
+        return;
+        }
+
+    msg.command = SINK_FRAME;
+    msg.arg1 = sinkFrame;
+    mSinkQ.put(&msg);
 }
 
+bool FakeCameraAdapter::FakeFrameSink::threadLoop()
+{
+    bool shouldLive = true;
+    Message msg;
+    CameraFrame *frame;
+
+    while ( shouldLive )
+        {
+        MessageQueue::waitForMsg(&mSinkQ, NULL, NULL, -1);
+        if ( NO_ERROR != mSinkQ.get(&msg) )
+            {
+            continue;
+            }
+
+        if ( SINK_FRAME == msg.command )
+            {
+            frame = ( CameraFrame * ) msg.arg1;
+
+            //Emulate the consumer processing time
+            if ( 0 < mHold )
+                {
+                usleep(ns2us(mHold));
+                }
+
+            mCameraAdapter->returnFrame(frame->mBuffer, ( CameraFrame::FrameType ) frame->mFrameType);
+            delete frame;
+
+                {
+                Mutex::Autolock lock(mLock);
+                mQueued--;
+                mConsumed++;
+                }
+            }
+        else if ( SINK_EXIT == msg.command )
+            {
+            shouldLive = false;
+            }
+        }
+
+    //Return everything still queued without holding
+    while ( !mSinkQ.isEmpty() )
+        {
+        if ( ( NO_ERROR == mSinkQ.get(&msg) ) && ( SINK_FRAME == msg.command ) )
+            {
+            frame = ( CameraFrame * ) msg.arg1;
+            mCameraAdapter->returnFrame(frame->mBuffer, ( CameraFrame::FrameType ) frame->mFrameType);
+            delete frame;
+            }
+        }
+
+    return false;
+}
+
+void FakeCameraAdapter::FakeFrameSink::dumpStats(String8 &out)
+{
+    String8 name(mName);
+
+        {
+        Mutex::Autolock lock(mLock);
+        out.appendFormat("%s.consumed=%u\n", mName, mConsumed);
+        out.appendFormat("%s.dropped=%u\n", mName, mDropped);
+        out.appendFormat("%s.queued=%d\n", mName, mQueued);
+        }
+
+    name.append(".delivery");
+    mDelivery.dump(out, name.string());
+}
+
+/*--------------------FakeFrameSink Class ENDS here-----------------------------*/
+
 status_t FakeCameraAdapter::startImageCapture()
 {
     status_t ret = NO_ERROR;
     CameraHalEvent shutterEvent;
     event_callback eventCb;
     Message msg;
-    CameraFrame frame;
+    CameraFrame *frame;
 
     LOG_FUNCTION_NAME
 
@@ -474,20 +1035,29 @@ status_t FakeCameraAdapter::startImageCapture()
     //simulate Snapshot
     sendNextFrame(SNAPSHOT_FRAME);
 
-    frame.mBuffer = imageBuf;
-    frame.mLength = mCaptureWidth*mCaptureHeight;
-    frame.mFrameType = CameraFrame::RAW_FRAME;
-
     msg.command = FakeCameraAdapter::CALL_CALLBACK;
-    msg.arg1 = ( void * ) &frame;
 
     //RAW Capture
-    mCallbackQ.put(&msg);
-
-    frame.mFrameType = CameraFrame::IMAGE_FRAME;
+    frame = new CameraFrame();
+    if ( NULL != frame )
+        {
+        frame->mBuffer = imageBuf;
+        frame->mLength = mCaptureWidth*mCaptureHeight;
+        frame->mFrameType = CameraFrame::RAW_FRAME;
+        msg.arg1 = ( void * ) frame;
+        mCallbackQ.put(&msg);
+        }
 
     //Jpeg encoding done
-    mCallbackQ.put(&msg);
+    frame = new CameraFrame();
+    if ( NULL != frame )
+        {
+        frame->mBuffer = imageBuf;
+        frame->mLength = mCaptureWidth*mCaptureHeight;
+        frame->mFrameType = CameraFrame::IMAGE_FRAME;
+        msg.arg1 = ( void * ) frame;
+        mCallbackQ.put(&msg);
+        }
 
     //Release image buffers
     if ( NULL != mReleaseImageBuffersCallback )
@@ -521,6 +1091,8 @@ void FakeCameraAdapter::frameThread()
     int state = FakeCameraAdapter::STOPPED;
     Message msg;
     status_t ret = NO_ERROR;
+    nsecs_t now, interval;
+    int timeout;
 
     LOG_FUNCTION_NAME
 
@@ -532,7 +1104,49 @@ void FakeCameraAdapter::frameThread()
 
                 if ( mFrameQ.isEmpty() )
                     {
-                    sendNextFrame(NORMAL_FRAME);
+                    now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+                    if ( 0 == mNextFrameTime )
+                        {
+                        bool bufferAvailable;
+
+                            {
+                            Mutex::Autolock lock(mPreviewVectorLock);
+                            bufferAvailable = !mFreePreviewBuffers.isEmpty();
+                            }
+
+                        //Unthrottled, generate whenever a buffer is free
+                        if ( bufferAvailable )
+                            {
+                            sendNextFrame(NORMAL_FRAME);
+                            }
+                        else
+                            {
+                            MessageQueue::waitForMsg(&mFrameQ, NULL, NULL, -1);
+                            }
+                        }
+                    else if ( now >= mNextFrameTime )
+                        {
+                        sendNextFrame(NORMAL_FRAME);
+
+                        interval = nextFrameInterval();
+                        mNextFrameTime += interval;
+
+                        //Don't try to catch up after a long stall, restart the schedule instead
+                        if ( mNextFrameTime + interval < now )
+                            {
+                            mNextFrameTime = now + interval;
+                            }
+                        }
+                    else
+                        {
+                        //Round up, waking up early would just spin until the deadline
+                        timeout = ns2ms(mNextFrameTime - now + ms2ns(1) - 1);
+                        if ( 0 < timeout )
+                            {
+                            MessageQueue::waitForMsg(&mFrameQ, NULL, NULL, timeout);
+                            }
+                        }
                     }
                 else
                     {
@@ -549,10 +1163,9 @@ void FakeCameraAdapter::frameThread()
                             }
                         else if ( BaseCameraAdapter::RETURN_FRAME== msg.command )
                             {
-                                {
-                                Mutex::Autolock lock(mPreviewVectorLock);
-                                mFreePreviewBuffers.push( ( unsigned int ) msg.arg1);
-                                }
+                            //Returned frames are posted asynchronously and don't get acknowledged
+                            releasePreviewBuffer( ( unsigned int ) msg.arg1);
+                            continue;
                             }
                         else if ( BaseCameraAdapter::DO_AUTOFOCUS == msg.command )
                             {
@@ -607,13 +1220,17 @@ void FakeCameraAdapter::frameThread()
                         {
                         CAMHAL_LOGDA("State set to running!");
                         state = BaseCameraAdapter::RUNNING;
+
+                        resetStats();
+                        mBurstCount = 0;
+                        mFrameIndex = 0;
+                        //A zero deadline selects the unthrottled mode
+                        mNextFrameTime = ( 0 != mLoadConfig.mFrameRate ) ? systemTime(SYSTEM_TIME_MONOTONIC) : 0;
                         }
                     else if ( BaseCameraAdapter::RETURN_FRAME== msg.command )
                         {
-                            {
-                            Mutex::Autolock lock(mPreviewVectorLock);
-                            mFreePreviewBuffers.push( ( unsigned int ) msg.arg1);
-                            }
+                        releasePreviewBuffer( ( unsigned int ) msg.arg1);
+                        continue;
                         }
                     else if ( BaseCameraAdapter::DO_AUTOFOCUS == msg.command )
                         {
@@ -670,15 +1287,9 @@ status_t FakeCameraAdapter::fillThisBuffer(void* frameBuf, CameraFrame::FrameTyp
         msg.arg1 = frameBuf;
         msg.arg2 = ( void * ) frameType;
 
+        //Don't wait for an acknowledge, the frame thread could be blocked
+        //delivering frames to the same consumer returning this buffer
         mFrameQ.put(&msg);
-
-        MessageQueue::waitForMsg(&mAdapterQ, NULL, NULL, -1);
-        mAdapterQ.get(&msg);
-
-        if ( BaseCameraAdapter::ERROR == msg.command )
-            {
-            CAMHAL_LOGEA("Error while returning preview frame!");
-            }
         }
 
     LOG_FUNCTION_NAME_EXIT
@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/**
+* @file FrameScaler.cpp
+*
+* Downscaling of the preview callback copies made by AppCallbackNotifier.
+*
+*/
+
+#include <string.h>
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
+#include "FrameScaler.h"
+
+namespace android {
+
+///The NEON box filter divides through a reciprocal in 8.24 fixed point, which is exact
+///for sums of up to 256 samples
+#define MAX_NEON_AREA 256
+#define MAX_NEON_FX 4
+#define RECIPROCAL_SHIFT 24
+
+void FrameScaler::scaleChannel(const uint8_t *src, size_t srcPitch, int srcStep, int srcWidth, int srcHeight,
+                               uint8_t *dst, size_t dstPitch, int dstStep, int dstWidth, int dstHeight,
+                               int firstRow, int lastRow)
+{
+    if ( ( 0 == ( srcWidth % dstWidth ) ) && ( 0 == ( srcHeight % dstHeight ) ) &&
+         boxNeon(src, srcPitch, srcStep, srcWidth / dstWidth, srcHeight / dstHeight,
+                 dst, dstPitch, dstStep, dstWidth, firstRow, lastRow) )
+        {
+        return;
+        }
+
+    scaleChannelC(src, srcPitch, srcStep, srcWidth, srcHeight,
+                  dst, dstPitch, dstStep, dstWidth, dstHeight, firstRow, lastRow);
+}
+
+void FrameScaler::scaleChannelC(const uint8_t *src, size_t srcPitch, int srcStep, int srcWidth, int srcHeight,
+                                uint8_t *dst, size_t dstPitch, int dstStep, int dstWidth, int dstHeight,
+                                int firstRow, int lastRow)
+{
+    const uint8_t *line0, *line1;
+    uint8_t *out;
+    unsigned int sum;
+
+    if ( ( 0 == ( srcWidth % dstWidth ) ) && ( 0 == ( srcHeight % dstHeight ) ) )
+        {
+        int fx = srcWidth / dstWidth;
+        int fy = srcHeight / dstHeight;
+        unsigned int area = fx * fy;
+
+        for ( int y = firstRow ; y < lastRow ; y++ )
+            {
+            line0 = src + y * fy * srcPitch;
+            out = dst + y * dstPitch;
+            for ( int x = 0 ; x < dstWidth ; x++, out += dstStep )
+                {
+                sum = 0;
+                for ( int j = 0 ; j < fy ; j++ )
+                    {
+                    const uint8_t *in = line0 + j * srcPitch + x * fx * srcStep;
+                    for ( int i = 0 ; i < fx ; i++, in += srcStep )
+                        {
+                        sum += *in;
+                        }
+                    }
+                *out = ( sum + area / 2 ) / area;
+                }
+            }
+
+        return;
+        }
+
+    ///Bilinear in 16.16 fixed point, sample centers are aligned between both grids
+    uint32_t stepX = ( srcWidth << 16 ) / dstWidth;
+    uint32_t stepY = ( srcHeight << 16 ) / dstHeight;
+    int32_t fy, fx;
+    int y0, y1, x0, x1;
+    unsigned int wx, wy, top, bottom;
+
+    for ( int y = firstRow ; y < lastRow ; y++ )
+        {
+        fy = ( int32_t ) ( y * stepY + stepY / 2 ) - 0x8000;
+        if ( 0 > fy )
+            {
+            fy = 0;
+            }
+        y0 = fy >> 16;
+        y1 = ( y0 + 1 < srcHeight ) ? ( y0 + 1 ) : y0;
+        wy = ( fy >> 8 ) & 0xFF;
+
+        line0 = src + y0 * srcPitch;
+        line1 = src + y1 * srcPitch;
+        out = dst + y * dstPitch;
+
+        for ( int x = 0 ; x < dstWidth ; x++, out += dstStep )
+            {
+            fx = ( int32_t ) ( x * stepX + stepX / 2 ) - 0x8000;
+            if ( 0 > fx )
+                {
+                fx = 0;
+                }
+            x0 = fx >> 16;
+            x1 = ( x0 + 1 < srcWidth ) ? ( x0 + 1 ) : x0;
+            wx = ( fx >> 8 ) & 0xFF;
+
+            top = line0[x0 * srcStep] * ( 256 - wx ) + line0[x1 * srcStep] * wx;
+            bottom = line1[x0 * srcStep] * ( 256 - wx ) + line1[x1 * srcStep] * wx;
+            *out = ( top * ( 256 - wy ) + bottom * wy + 0x8000 ) >> 16;
+            }
+        }
+}
+
+#ifdef __ARM_NEON__
+
+///Loads 16 consecutive samples of a channel with 1, 2 or 4 bytes between the samples
+static inline uint8x16_t loadSamples(const uint8_t *in, int step)
+{
+    switch ( step )
+        {
+        case 1:
+            return vld1q_u8(in);
+        case 2:
+            return vld2q_u8(in).val[0];
+        case 4:
+        default:
+            return vld4q_u8(in).val[0];
+        }
+}
+
+///Sums of fx consecutive vertical sums for 8 output samples
+static inline uint16x8_t sumColumns(const uint16_t *in, int fx)
+{
+    switch ( fx )
+        {
+        case 1:
+            return vld1q_u16(in);
+        case 2:
+            {
+            uint16x8x2_t s = vld2q_u16(in);
+            return vaddq_u16(s.val[0], s.val[1]);
+            }
+        case 3:
+            {
+            uint16x8x3_t s = vld3q_u16(in);
+            return vaddq_u16(vaddq_u16(s.val[0], s.val[1]), s.val[2]);
+            }
+        case 4:
+        default:
+            {
+            uint16x8x4_t s = vld4q_u16(in);
+            return vaddq_u16(vaddq_u16(s.val[0], s.val[1]), vaddq_u16(s.val[2], s.val[3]));
+            }
+        }
+}
+
+///Box filter for integer ratios. The fy source rows are first summed into a row of 16-bit
+///vertical sums, which is then reduced horizontally. Returns false for the ratios and
+///layouts it doesn't cover.
+bool FrameScaler::boxNeon(const uint8_t *src, size_t srcPitch, int srcStep, int fx, int fy,
+                          uint8_t *dst, size_t dstPitch, int dstStep, int dstWidth,
+                          int firstRow, int lastRow)
+{
+    uint16_t columns[MAX_NEON_SAMPLES];
+    uint8_t result[8];
+    int width = dstWidth * fx;
+    unsigned int area = fx * fy;
+
+    if ( ( MAX_NEON_FX < fx ) ||
+         ( MAX_NEON_AREA < area ) ||
+         ( MAX_NEON_SAMPLES < width ) ||
+         ( ( 1 != srcStep ) && ( 2 != srcStep ) && ( 4 != srcStep ) ) )
+        {
+        return false;
+        }
+
+    ///( sum + area / 2 ) / area == ( ( sum + area / 2 ) * scale ) >> 24 for any sum of
+    ///up to 256 samples, the product still fits into 32 bits
+    uint32x4_t scale = vdupq_n_u32(( ( 1 << RECIPROCAL_SHIFT ) + area - 1 ) / area);
+    uint16x8_t bias = vdupq_n_u16(area / 2);
+
+    ///Last source sample of a row a 16 sample load may start at, without touching
+    ///the bytes behind the last sample of the channel
+    int lastLoad = ( ( width - 1 ) * srcStep + 1 ) / srcStep - 16;
+
+    for ( int y = firstRow ; y < lastRow ; y++ )
+        {
+        const uint8_t *line = src + y * fy * srcPitch;
+        uint8_t *out = dst + y * dstPitch;
+        int x;
+
+        memset(columns, 0, width * sizeof(uint16_t));
+        for ( int j = 0 ; j < fy ; j++, line += srcPitch )
+            {
+            int i = 0;
+
+            for ( ; i <= lastLoad ; i += 16 )
+                {
+                uint8x16_t in = loadSamples(line + i * srcStep, srcStep);
+
+                vst1q_u16(columns + i, vaddw_u8(vld1q_u16(columns + i), vget_low_u8(in)));
+                vst1q_u16(columns + i + 8, vaddw_u8(vld1q_u16(columns + i + 8), vget_high_u8(in)));
+                }
+
+            for ( ; i < width ; i++ )
+                {
+                columns[i] += line[i * srcStep];
+                }
+            }
+
+        for ( x = 0 ; ( x + 8 ) <= dstWidth ; x += 8 )
+            {
+            uint16x8_t sum = vaddq_u16(sumColumns(columns + x * fx, fx), bias);
+            uint32x4_t low = vshrq_n_u32(vmulq_u32(vmovl_u16(vget_low_u16(sum)), scale), RECIPROCAL_SHIFT);
+            uint32x4_t high = vshrq_n_u32(vmulq_u32(vmovl_u16(vget_high_u16(sum)), scale), RECIPROCAL_SHIFT);
+            uint8x8_t pixels = vmovn_u16(vcombine_u16(vmovn_u32(low), vmovn_u32(high)));
+
+            if ( 1 == dstStep )
+                {
+                vst1_u8(out + x, pixels);
+                }
+            else
+                {
+                ///The bytes in between belong to the other channels
+                vst1_u8(result, pixels);
+                for ( int k = 0 ; k < 8 ; k++ )
+                    {
+                    out[( x + k ) * dstStep] = result[k];
+                    }
+                }
+            }
+
+        for ( ; x < dstWidth ; x++ )
+            {
+            unsigned int sum = area / 2;
+
+            for ( int i = 0 ; i < fx ; i++ )
+                {
+                sum += columns[x * fx + i];
+                }
+            out[x * dstStep] = sum / area;
+            }
+        }
+
+    return true;
+}
+
+void FrameScaler::halveLumaRow(const uint8_t *line0, const uint8_t *line1, uint8_t *out, int dstWidth)
+{
+    int x = 0;
+
+    for ( ; ( x + 8 ) <= dstWidth ; x += 8 )
+        {
+        uint16x8_t sum = vaddq_u16(vpaddlq_u8(vld1q_u8(line0 + x * 2)),
+                                   vpaddlq_u8(vld1q_u8(line1 + x * 2)));
+        vst1_u8(out + x, vrshrn_n_u16(sum, 2));
+        }
+
+    for ( ; x < dstWidth ; x++ )
+        {
+        out[x] = ( line0[x * 2] + line0[x * 2 + 1] + line1[x * 2] + line1[x * 2 + 1] + 2 ) >> 2;
+        }
+}
+
+void FrameScaler::halveChromaRow(const uint8_t *line0, const uint8_t *line1, uint8_t *out, int dstPairs)
+{
+    int x = 0;
+
+    for ( ; ( x + 8 ) <= dstPairs ; x += 8 )
+        {
+        uint8x16x2_t top = vld2q_u8(line0 + x * 4);
+        uint8x16x2_t bottom = vld2q_u8(line1 + x * 4);
+        uint8x8x2_t vu;
+
+        vu.val[0] = vrshrn_n_u16(vaddq_u16(vpaddlq_u8(top.val[1]), vpaddlq_u8(bottom.val[1])), 2);
+        vu.val[1] = vrshrn_n_u16(vaddq_u16(vpaddlq_u8(top.val[0]), vpaddlq_u8(bottom.val[0])), 2);
+        vst2_u8(out + x * 2, vu);
+        }
+
+    for ( ; x < dstPairs ; x++ )
+        {
+        out[x * 2] = ( line0[x * 4 + 1] + line0[x * 4 + 3] + line1[x * 4 + 1] + line1[x * 4 + 3] + 2 ) >> 2;
+        out[x * 2 + 1] = ( line0[x * 4] + line0[x * 4 + 2] + line1[x * 4] + line1[x * 4 + 2] + 2 ) >> 2;
+        }
+}
+
+#else
+
+bool FrameScaler::boxNeon(const uint8_t *src, size_t srcPitch, int srcStep, int fx, int fy,
+                          uint8_t *dst, size_t dstPitch, int dstStep, int dstWidth,
+                          int firstRow, int lastRow)
+{
+    return false;
+}
+
+void FrameScaler::halveLumaRow(const uint8_t *line0, const uint8_t *line1, uint8_t *out, int dstWidth)
+{
+    for ( int x = 0 ; x < dstWidth ; x++ )
+        {
+        out[x] = ( line0[x * 2] + line0[x * 2 + 1] + line1[x * 2] + line1[x * 2 + 1] + 2 ) >> 2;
+        }
+}
+
+void FrameScaler::halveChromaRow(const uint8_t *line0, const uint8_t *line1, uint8_t *out, int dstPairs)
+{
+    for ( int x = 0 ; x < dstPairs ; x++ )
+        {
+        out[x * 2] = ( line0[x * 4 + 1] + line0[x * 4 + 3] + line1[x * 4 + 1] + line1[x * 4 + 3] + 2 ) >> 2;
+        out[x * 2 + 1] = ( line0[x * 4] + line0[x * 4 + 2] + line1[x * 4] + line1[x * 4 + 2] + 2 ) >> 2;
+        }
+}
+
+#endif
+
+};
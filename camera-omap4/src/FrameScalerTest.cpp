@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Test of FrameScaler. Known answers on synthetic channels, then scaleChannel(),
+ * halveLumaRow() and halveChromaRow() compared bit for bit against the C version
+ * on random channels of random size, ratio, sample step and band, including a
+ * check that the bytes of the other channels are left alone. The same source
+ * builds on the host, where it covers the C path, and for the target, where the
+ * NEON paths are taken.
+ *
+ * Usage: FrameScalerTest [iterations] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FrameScaler.h"
+
+using namespace android;
+
+#define MAX_SRC_BYTES ( 2048 * 4 * 2 + 64 )
+#define MAX_SRC_ROWS 256
+#define MAX_DST_BYTES ( 2048 * 4 + 64 )
+#define MAX_DST_ROWS 128
+#define GUARD 0xA5
+
+static int failures = 0;
+
+#define CHECK(cond) do { if ( !(cond) ) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while ( 0 )
+
+static uint8_t gSrc[MAX_SRC_BYTES * MAX_SRC_ROWS];
+static uint8_t gDst[MAX_DST_BYTES * MAX_DST_ROWS];
+static uint8_t gExpected[MAX_DST_BYTES * MAX_DST_ROWS];
+
+static uint32_t lcg(uint32_t *state)
+{
+    *state = *state * 1103515245 + 12345;
+    return *state >> 8;
+}
+
+static void testKnown()
+{
+    const int width = 64, height = 32;
+    uint8_t *out;
+
+    //Flat channel stays flat at any ratio
+    memset(gSrc, 77, width * height);
+    memset(gDst, 0, sizeof(gDst));
+    FrameScaler::scaleChannel(gSrc, width, 1, width, height, gDst, 16, 1, 16, 8, 0, 8);
+    CHECK(gDst[0] == 77);
+    CHECK(gDst[7 * 16 + 15] == 77);
+    FrameScaler::scaleChannel(gSrc, width, 1, width, height, gDst, 24, 1, 24, 10, 0, 10);
+    CHECK(gDst[9 * 24 + 23] == 77);
+
+    //4:1 of a ramp of 1 per sample, every output is the rounded mean of 4 columns
+    for ( int y = 0 ; y < height ; y++ )
+        {
+        for ( int x = 0 ; x < width ; x++ )
+            {
+            gSrc[y * width + x] = x;
+            }
+        }
+    FrameScaler::scaleChannel(gSrc, width, 1, width, height, gDst, 16, 1, 16, 8, 0, 8);
+    for ( int x = 0 ; x < 16 ; x++ )
+        {
+        CHECK(gDst[3 * 16 + x] == ( ( 4 * x * 4 + 6 ) * 4 + 8 ) / 16);
+        }
+
+    //3:1 on a channel with 2 bytes between the samples, the odd bytes are left alone
+    memset(gDst, GUARD, sizeof(gDst));
+    FrameScaler::scaleChannel(gSrc, width, 2, 24, height, gDst, 32, 2, 8, 8, 0, 8);
+    out = gDst + 32;
+    for ( int x = 0 ; x < 8 ; x++ )
+        {
+        //Samples 3x..3x+2 sit at the even bytes 6x..6x+4
+        CHECK(out[x * 2] == ( 6 * x + 2 ));
+        CHECK(out[x * 2 + 1] == GUARD);
+        }
+
+    //2:1 NV12 chroma, U and V swapped on the way out
+    for ( int x = 0 ; x < width ; x++ )
+        {
+        gSrc[x] = ( x & 1 ) ? 200 : 10;
+        gSrc[width + x] = ( x & 1 ) ? 202 : 12;
+        }
+    FrameScaler::halveChromaRow(gSrc, gSrc + width, gDst, width / 4);
+    CHECK(gDst[0] == 201);
+    CHECK(gDst[1] == 11);
+    CHECK(gDst[width / 2 - 2] == 201);
+    CHECK(gDst[width / 2 - 1] == 11);
+}
+
+static void testRandom(int iterations, uint32_t seed)
+{
+    static const int steps[] = { 1, 2, 4 };
+    int mismatches = 0;
+
+    for ( int i = 0 ; i < iterations ; i++ )
+        {
+        int step = steps[lcg(&seed) % 3];
+        int offset = lcg(&seed) % step;
+        int dstWidth = 1 + lcg(&seed) % 160;
+        int dstHeight = 1 + lcg(&seed) % 16;
+        int fx = 1 + lcg(&seed) % 5;
+        int fy = 1 + lcg(&seed) % 6;
+        int srcWidth, srcHeight;
+
+        //Large vertical ratios around the limit of the NEON path
+        if ( 0 == ( i % 16 ) )
+            {
+            fy = 48 + lcg(&seed) % 24;
+            dstHeight = 1 + lcg(&seed) % 3;
+            }
+
+        //Now and then a width only the NEON path handles in several loads
+        if ( 0 == ( i % 8 ) )
+            {
+            dstWidth = 160 + lcg(&seed) % ( 2048 / fx - 160 );
+            }
+
+        srcWidth = dstWidth * fx;
+        srcHeight = dstHeight * fy;
+
+        //Non integer ratios take the bilinear filter
+        if ( 0 == ( i % 5 ) )
+            {
+            srcWidth += 1 + lcg(&seed) % ( dstWidth + 1 );
+            srcHeight += lcg(&seed) % 3;
+            }
+
+        if ( ( srcHeight > MAX_SRC_ROWS ) || ( dstHeight > MAX_DST_ROWS ) )
+            {
+            continue;
+            }
+
+        size_t srcPitch = srcWidth * step + lcg(&seed) % 64;
+        size_t dstPitch = dstWidth * step + lcg(&seed) % 64;
+        int firstRow = lcg(&seed) % dstHeight;
+        int lastRow = firstRow + 1 + lcg(&seed) % ( dstHeight - firstRow );
+
+        for ( size_t k = 0 ; k < srcPitch * srcHeight ; k++ )
+            {
+            gSrc[k] = ( 0 == ( i % 3 ) ) ? lcg(&seed) : ( ( k / 5 ) + lcg(&seed) % 16 );
+            }
+        //Saturated content checks the range of the sums
+        if ( 0 == ( i % 7 ) )
+            {
+            memset(gSrc, 255, srcPitch * srcHeight);
+            }
+
+        memset(gDst, GUARD, dstPitch * dstHeight);
+        memset(gExpected, GUARD, dstPitch * dstHeight);
+
+        FrameScaler::scaleChannel(gSrc + offset, srcPitch, step, srcWidth, srcHeight,
+                                  gDst + offset, dstPitch, step, dstWidth, dstHeight, firstRow, lastRow);
+        FrameScaler::scaleChannelC(gSrc + offset, srcPitch, step, srcWidth, srcHeight,
+                                   gExpected + offset, dstPitch, step, dstWidth, dstHeight, firstRow, lastRow);
+
+        if ( 0 != memcmp(gDst, gExpected, dstPitch * dstHeight) )
+            {
+            if ( 10 > mismatches )
+                {
+                printf("mismatch: step %d offset %d %dx%d -> %dx%d rows %d-%d\n",
+                       step, offset, srcWidth, srcHeight, dstWidth, dstHeight, firstRow, lastRow);
+                }
+            mismatches++;
+            }
+        }
+
+    CHECK(0 == mismatches);
+}
+
+static void testHalve(int iterations, uint32_t seed)
+{
+    int mismatches = 0;
+
+    for ( int i = 0 ; i < iterations ; i++ )
+        {
+        int dstWidth = 2 * ( 1 + lcg(&seed) % 400 );
+        size_t pitch = dstWidth * 2 + lcg(&seed) % 64;
+
+        for ( size_t k = 0 ; k < pitch * 2 ; k++ )
+            {
+            gSrc[k] = lcg(&seed);
+            }
+
+        //Luma
+        FrameScaler::halveLumaRow(gSrc, gSrc + pitch, gDst, dstWidth);
+        FrameScaler::scaleChannelC(gSrc, pitch, 1, dstWidth * 2, 2, gExpected, dstWidth, 1, dstWidth, 1, 0, 1);
+        if ( 0 != memcmp(gDst, gExpected, dstWidth) )
+            {
+            mismatches++;
+            }
+
+        //Chroma, the C version writes V from the odd source bytes and U from the even ones
+        FrameScaler::halveChromaRow(gSrc, gSrc + pitch, gDst, dstWidth / 2);
+        FrameScaler::scaleChannelC(gSrc + 1, pitch, 2, dstWidth, 2, gExpected, dstWidth, 2, dstWidth / 2, 1, 0, 1);
+        FrameScaler::scaleChannelC(gSrc, pitch, 2, dstWidth, 2, gExpected + 1, dstWidth, 2, dstWidth / 2, 1, 0, 1);
+        if ( 0 != memcmp(gDst, gExpected, dstWidth) )
+            {
+            mismatches++;
+            }
+        }
+
+    CHECK(0 == mismatches);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = ( argc > 1 ) ? atoi(argv[1]) : 2000;
+    uint32_t seed = ( argc > 2 ) ? strtoul(argv[2], NULL, 0) : 1;
+
+#ifdef __ARM_NEON__
+    printf("Checking the NEON path\n");
+#else
+    printf("Checking the scalar path\n");
+#endif
+
+    testKnown();
+    testRandom(iterations, seed);
+    testHalve(iterations, seed);
+
+    printf("%s, %d failures\n", failures ? "FAIL" : "PASS", failures);
+
+    return failures ? 1 : 0;
+}
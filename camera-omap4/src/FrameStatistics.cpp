@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/**
+* @file FrameStatistics.cpp
+*
+* Software image statistics used by the adapters without ISP statistics (software 3A, analytics).
+*
+*/
+
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
+#include "FrameStatistics.h"
+
+namespace android {
+
+//Samples processed at once by the NEON path
+#define SIMD_SAMPLES 16
+
+/*--------------------FrameStatistics Class STARTS here-----------------------------*/
+
+FrameStatistics::FrameStatistics()
+{
+    mRowStep = 4;
+}
+
+void FrameStatistics::setRowStep(unsigned int step)
+{
+    mRowStep = ( 0 < step ) ? step : 1;
+}
+
+status_t FrameStatistics::process(const uint8_t *frame,
+                                  PixelLayout layout,
+                                  unsigned int width,
+                                  unsigned int height,
+                                  unsigned int stride,
+                                  Statistics &stats) const
+{
+    ZoneRow zones[ZONES_Y];
+    RowSamples row;
+    uint32_t sumU = 0, sumV = 0, sumGradient = 0, sumLuma = 0;
+    uint32_t zoneSamples;
+    unsigned int samples, rows = 0;
+    int zoneY;
+
+    if ( ( NULL == frame ) || ( 2 > width ) || ( 0 == height ) )
+        {
+        return BAD_VALUE;
+        }
+
+    if ( ( ( LAYOUT_NV12 == layout ) && ( stride < width ) ) ||
+         ( ( LAYOUT_NV12 != layout ) && ( stride < ( width * 2 ) ) ) )
+        {
+        return BAD_VALUE;
+        }
+
+    memset(&stats, 0, sizeof(Statistics));
+    memset(zones, 0, sizeof(zones));
+
+    ///One sample per pixel pair
+    samples = width / 2;
+
+    for ( unsigned int y = 0 ; y < height ; y += mRowStep )
+        {
+        const uint8_t *line = frame + y * stride;
+
+        switch ( layout )
+            {
+            case LAYOUT_NV12:
+                {
+                const uint8_t *uv = frame + height * stride + ( y / 2 ) * stride;
+                row.mY = line;
+                row.mU = uv;
+                row.mV = uv + 1;
+                row.mStep = 2;
+                break;
+                }
+            case LAYOUT_UYVY:
+                row.mU = line;
+                row.mY = line + 1;
+                row.mV = line + 2;
+                row.mStep = 4;
+                break;
+            case LAYOUT_YUYV:
+            default:
+                row.mY = line;
+                row.mU = line + 1;
+                row.mV = line + 3;
+                row.mStep = 4;
+                break;
+            }
+
+        zoneY = ( y * ZONES_Y ) / height;
+        processRow(row, layout, samples, stats, zones[zoneY], sumU, sumV, sumGradient);
+        rows++;
+        }
+
+    for ( int zy = 0 ; zy < ZONES_Y ; zy++ )
+        {
+        for ( int zx = 0 ; zx < ZONES_X ; zx++ )
+            {
+            zoneSamples = zones[zy].mSamples[zx];
+            sumLuma += zones[zy].mLuma[zx];
+            if ( 0 < zoneSamples )
+                {
+                stats.mZoneLuma[zy][zx] = zones[zy].mLuma[zx] / zoneSamples;
+                }
+            }
+        }
+
+    stats.mSamples = samples * rows;
+    stats.mMeanLuma = sumLuma / stats.mSamples;
+    stats.mMeanU = sumU / stats.mSamples;
+    stats.mMeanV = sumV / stats.mSamples;
+
+    ///The first sample of every row has no left neighbour
+    if ( stats.mSamples > rows )
+        {
+        stats.mSharpness = ( ( uint64_t ) sumGradient * 16 ) / ( stats.mSamples - rows );
+        }
+
+    return NO_ERROR;
+}
+
+uint8_t FrameStatistics::percentile(const Statistics &stats, unsigned int pct)
+{
+    uint64_t limit = ( ( uint64_t ) stats.mSamples * pct ) / 100;
+    uint64_t count = 0;
+
+    ///100% is the brightest sample, not the end of the histogram
+    if ( ( 0 < stats.mSamples ) && ( limit >= stats.mSamples ) )
+        {
+        limit = stats.mSamples - 1;
+        }
+
+    for ( int i = 0 ; i < HISTOGRAM_BINS ; i++ )
+        {
+        count += stats.mHistogram[i];
+        if ( count > limit )
+            {
+            return i;
+            }
+        }
+
+    return HISTOGRAM_BINS - 1;
+}
+
+void FrameStatistics::processSamples(const RowSamples &row,
+                                     unsigned int first,
+                                     unsigned int last,
+                                     unsigned int samples,
+                                     Statistics &stats,
+                                     ZoneRow &zones,
+                                     uint32_t &sumU,
+                                     uint32_t &sumV,
+                                     uint32_t &sumGradient)
+{
+    const uint8_t *y = row.mY + first * row.mStep;
+    unsigned int zoneX;
+    int luma, gradient;
+
+    for ( unsigned int i = first ; i < last ; i++, y += row.mStep )
+        {
+        luma = *y;
+
+        stats.mHistogram[luma]++;
+
+        zoneX = ( i * ZONES_X ) / samples;
+        zones.mLuma[zoneX] += luma;
+        zones.mSamples[zoneX]++;
+
+        sumU += row.mU[i * row.mStep];
+        sumV += row.mV[i * row.mStep];
+
+        if ( 0 < i )
+            {
+            gradient = luma - *( y - row.mStep );
+            sumGradient += ( 0 > gradient ) ? -gradient : gradient;
+            }
+        }
+}
+
+#ifdef __ARM_NEON__
+
+static inline uint32_t sumLanes(uint8x16_t v)
+{
+    uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(v)));
+
+    return ( uint32_t ) ( vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1) );
+}
+
+#endif
+
+void FrameStatistics::processRow(const RowSamples &row,
+                                 PixelLayout layout,
+                                 unsigned int samples,
+                                 Statistics &stats,
+                                 ZoneRow &zones,
+                                 uint32_t &sumU,
+                                 uint32_t &sumV,
+                                 uint32_t &sumGradient)
+{
+    unsigned int i = 0;
+
+#ifdef __ARM_NEON__
+
+    uint8x16_t luma, previous, u, v;
+    uint8_t lumaArr[SIMD_SAMPLES];
+    unsigned int zoneX;
+
+    ///The first sample has no left neighbour, start the vector loop right after it
+    if ( SIMD_SAMPLES < samples )
+        {
+        processSamples(row, 0, 1, samples, stats, zones, sumU, sumV, sumGradient);
+        i = 1;
+        }
+
+    for ( ; ( 0 < i ) && ( ( i + SIMD_SAMPLES ) <= samples ) ; i += SIMD_SAMPLES )
+        {
+
+        zoneX = ( i * ZONES_X ) / samples;
+
+        ///Blocks straddling a zone border are rare, take the scalar path for them
+        if ( zoneX != ( ( ( i + SIMD_SAMPLES - 1 ) * ZONES_X ) / samples ) )
+            {
+            processSamples(row, i, i + SIMD_SAMPLES, samples, stats, zones, sumU, sumV, sumGradient);
+            continue;
+            }
+
+        if ( LAYOUT_NV12 == layout )
+            {
+            uint8x16x2_t chroma = vld2q_u8(row.mU + i * 2);
+            luma = vld2q_u8(row.mY + i * 2).val[0];
+            previous = vld2q_u8(row.mY + ( i - 1 ) * 2).val[0];
+            u = chroma.val[0];
+            v = chroma.val[1];
+            }
+        else if ( LAYOUT_UYVY == layout )
+            {
+            uint8x16x4_t pixels = vld4q_u8(row.mU + i * 4);
+            luma = pixels.val[1];
+            previous = vld4q_u8(row.mU + ( i - 1 ) * 4).val[1];
+            u = pixels.val[0];
+            v = pixels.val[2];
+            }
+        else
+            {
+            uint8x16x4_t pixels = vld4q_u8(row.mY + i * 4);
+            luma = pixels.val[0];
+            previous = vld4q_u8(row.mY + ( i - 1 ) * 4).val[0];
+            u = pixels.val[1];
+            v = pixels.val[3];
+            }
+
+        zones.mLuma[zoneX] += sumLanes(luma);
+        zones.mSamples[zoneX] += SIMD_SAMPLES;
+        sumU += sumLanes(u);
+        sumV += sumLanes(v);
+        sumGradient += sumLanes(vabdq_u8(luma, previous));
+
+        ///Histogram updates can't be vectorized, the lanes are binned one by one
+        vst1q_u8(lumaArr, luma);
+        for ( int k = 0 ; k < SIMD_SAMPLES ; k++ )
+            {
+            stats.mHistogram[lumaArr[k]]++;
+            }
+        }
+
+#endif
+
+    processSamples(row, i, samples, samples, stats, zones, sumU, sumV, sumGradient);
+}
+
+/*--------------------FrameStatistics Class ENDS here-----------------------------*/
+
+};
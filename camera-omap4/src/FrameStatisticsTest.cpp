@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Test of FrameStatistics. Known answers on synthetic frames, then every
+ * field of the statistics compared against a plain per sample reference on
+ * random frames of random size, layout, stride and row step. The same
+ * source builds on the host, where it covers the scalar path, and for the
+ * target, where process() takes the NEON path.
+ *
+ * Usage: FrameStatisticsTest [iterations] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FrameStatistics.h"
+
+using namespace android;
+
+#define MAX_WIDTH 1280
+#define MAX_HEIGHT 96
+#define MAX_STRIDE ( MAX_WIDTH * 2 + 64 )
+
+static int failures = 0;
+
+#define CHECK(cond) do { if ( !(cond) ) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while ( 0 )
+
+static uint8_t gFrame[MAX_STRIDE * MAX_HEIGHT * 2];
+
+static uint32_t lcg(uint32_t *state)
+{
+    *state = *state * 1103515245 + 12345;
+    return *state >> 8;
+}
+
+static void samplePointers(const uint8_t *frame,
+                           FrameStatistics::PixelLayout layout,
+                           unsigned int height,
+                           unsigned int stride,
+                           unsigned int x,
+                           unsigned int y,
+                           uint8_t &luma,
+                           uint8_t &u,
+                           uint8_t &v)
+{
+    const uint8_t *line = frame + y * stride;
+    const uint8_t *uv;
+
+    switch ( layout )
+        {
+        case FrameStatistics::LAYOUT_NV12:
+            uv = frame + height * stride + ( y / 2 ) * stride;
+            luma = line[2 * x];
+            u = uv[2 * x];
+            v = uv[2 * x + 1];
+            break;
+        case FrameStatistics::LAYOUT_UYVY:
+            u = line[4 * x];
+            luma = line[4 * x + 1];
+            v = line[4 * x + 2];
+            break;
+        case FrameStatistics::LAYOUT_YUYV:
+        default:
+            luma = line[4 * x];
+            u = line[4 * x + 1];
+            v = line[4 * x + 3];
+            break;
+        }
+}
+
+///One sample per pixel pair on every step-th row, nothing clever
+static void reference(const uint8_t *frame,
+                      FrameStatistics::PixelLayout layout,
+                      unsigned int width,
+                      unsigned int height,
+                      unsigned int stride,
+                      unsigned int step,
+                      FrameStatistics::Statistics &stats)
+{
+    uint32_t zoneLuma[FrameStatistics::ZONES_Y][FrameStatistics::ZONES_X];
+    uint32_t zoneSamples[FrameStatistics::ZONES_Y][FrameStatistics::ZONES_X];
+    uint32_t sumLuma = 0, sumU = 0, sumV = 0, sumGradient = 0;
+    unsigned int samples = width / 2, rows = 0;
+    uint8_t luma, u, v, previous = 0;
+
+    memset(&stats, 0, sizeof(stats));
+    memset(zoneLuma, 0, sizeof(zoneLuma));
+    memset(zoneSamples, 0, sizeof(zoneSamples));
+
+    for ( unsigned int y = 0 ; y < height ; y += step )
+        {
+        for ( unsigned int x = 0 ; x < samples ; x++ )
+            {
+            samplePointers(frame, layout, height, stride, x, y, luma, u, v);
+
+            stats.mHistogram[luma]++;
+            zoneLuma[( y * FrameStatistics::ZONES_Y ) / height][( x * FrameStatistics::ZONES_X ) / samples] += luma;
+            zoneSamples[( y * FrameStatistics::ZONES_Y ) / height][( x * FrameStatistics::ZONES_X ) / samples]++;
+            sumLuma += luma;
+            sumU += u;
+            sumV += v;
+            if ( 0 < x )
+                {
+                sumGradient += abs(luma - previous);
+                }
+            previous = luma;
+            }
+        rows++;
+        }
+
+    for ( int zy = 0 ; zy < FrameStatistics::ZONES_Y ; zy++ )
+        {
+        for ( int zx = 0 ; zx < FrameStatistics::ZONES_X ; zx++ )
+            {
+            if ( zoneSamples[zy][zx] )
+                {
+                stats.mZoneLuma[zy][zx] = zoneLuma[zy][zx] / zoneSamples[zy][zx];
+                }
+            }
+        }
+
+    stats.mSamples = samples * rows;
+    stats.mMeanLuma = sumLuma / stats.mSamples;
+    stats.mMeanU = sumU / stats.mSamples;
+    stats.mMeanV = sumV / stats.mSamples;
+    if ( stats.mSamples > rows )
+        {
+        stats.mSharpness = ( ( uint64_t ) sumGradient * 16 ) / ( stats.mSamples - rows );
+        }
+}
+
+static bool equal(const FrameStatistics::Statistics &a, const FrameStatistics::Statistics &b)
+{
+    return ( 0 == memcmp(a.mHistogram, b.mHistogram, sizeof(a.mHistogram)) ) &&
+           ( 0 == memcmp(a.mZoneLuma, b.mZoneLuma, sizeof(a.mZoneLuma)) ) &&
+           ( a.mSamples == b.mSamples ) &&
+           ( a.mMeanLuma == b.mMeanLuma ) &&
+           ( a.mMeanU == b.mMeanU ) &&
+           ( a.mMeanV == b.mMeanV ) &&
+           ( a.mSharpness == b.mSharpness );
+}
+
+///Fills the luma of a YUYV frame through a function of the pixel position
+static void fillYuyv(unsigned int width, unsigned int height, unsigned int stride, int pattern)
+{
+    for ( unsigned int y = 0 ; y < height ; y++ )
+        {
+        uint8_t *line = gFrame + y * stride;
+
+        for ( unsigned int x = 0 ; x < width ; x++ )
+            {
+            switch ( pattern )
+                {
+                case 0:
+                    line[2 * x] = 100;
+                    break;
+                case 1:
+                    //Left half dark, right half bright
+                    line[2 * x] = ( x < width / 2 ) ? 20 : 220;
+                    break;
+                case 2:
+                default:
+                    //Sample i has luma 3 * i
+                    line[2 * x] = 3 * ( x / 2 );
+                    break;
+                }
+            line[2 * x + 1] = ( x & 1 ) ? 160 : 90;
+            }
+        }
+}
+
+static void testKnown()
+{
+    FrameStatistics engine;
+    FrameStatistics::Statistics stats;
+    const unsigned int width = 128, height = 64, stride = 256;
+
+    engine.setRowStep(1);
+
+    //Flat frame
+    fillYuyv(width, height, stride, 0);
+    CHECK(NO_ERROR == engine.process(gFrame, FrameStatistics::LAYOUT_YUYV, width, height, stride, stats));
+    CHECK(stats.mSamples == ( width / 2 ) * height);
+    CHECK(stats.mHistogram[100] == stats.mSamples);
+    CHECK(stats.mMeanLuma == 100);
+    CHECK(stats.mMeanU == 90);
+    CHECK(stats.mMeanV == 160);
+    CHECK(stats.mSharpness == 0);
+    CHECK(stats.mZoneLuma[0][0] == 100);
+    CHECK(stats.mZoneLuma[7][7] == 100);
+    CHECK(FrameStatistics::percentile(stats, 0) == 100);
+    CHECK(FrameStatistics::percentile(stats, 100) == 100);
+
+    //Split frame, the zones follow the halves and a single edge per row
+    fillYuyv(width, height, stride, 1);
+    CHECK(NO_ERROR == engine.process(gFrame, FrameStatistics::LAYOUT_YUYV, width, height, stride, stats));
+    CHECK(stats.mHistogram[20] == stats.mSamples / 2);
+    CHECK(stats.mHistogram[220] == stats.mSamples / 2);
+    CHECK(stats.mMeanLuma == 120);
+    for ( int zy = 0 ; zy < FrameStatistics::ZONES_Y ; zy++ )
+        {
+        CHECK(stats.mZoneLuma[zy][3] == 20);
+        CHECK(stats.mZoneLuma[zy][4] == 220);
+        }
+    CHECK(stats.mSharpness == ( 200 * 16 ) / ( width / 2 - 1 ));
+    CHECK(FrameStatistics::percentile(stats, 49) == 20);
+    CHECK(FrameStatistics::percentile(stats, 50) == 220);
+
+    //Ramp of 3 per sample
+    fillYuyv(width, height, stride, 2);
+    CHECK(NO_ERROR == engine.process(gFrame, FrameStatistics::LAYOUT_YUYV, width, height, stride, stats));
+    CHECK(stats.mSharpness == 3 * 16);
+    CHECK(stats.mHistogram[0] == height);
+    CHECK(stats.mHistogram[3 * ( width / 2 - 1 )] == height);
+
+    //Row step
+    engine.setRowStep(4);
+    CHECK(NO_ERROR == engine.process(gFrame, FrameStatistics::LAYOUT_YUYV, width, height, stride, stats));
+    CHECK(stats.mSamples == ( width / 2 ) * ( height / 4 ));
+
+    //Invalid arguments
+    CHECK(BAD_VALUE == engine.process(NULL, FrameStatistics::LAYOUT_YUYV, width, height, stride, stats));
+    CHECK(BAD_VALUE == engine.process(gFrame, FrameStatistics::LAYOUT_YUYV, 1, height, stride, stats));
+    CHECK(BAD_VALUE == engine.process(gFrame, FrameStatistics::LAYOUT_YUYV, width, 0, stride, stats));
+    CHECK(BAD_VALUE == engine.process(gFrame, FrameStatistics::LAYOUT_YUYV, width, height, width, stats));
+    CHECK(BAD_VALUE == engine.process(gFrame, FrameStatistics::LAYOUT_NV12, width, height, width - 1, stats));
+}
+
+static void testRandom(int iterations, uint32_t seed)
+{
+    FrameStatistics engine;
+    FrameStatistics::Statistics stats, expected;
+    FrameStatistics::PixelLayout layout;
+    unsigned int width, height, stride, step;
+    int mismatches = 0;
+
+    for ( int i = 0 ; i < iterations ; i++ )
+        {
+        layout = ( FrameStatistics::PixelLayout ) ( lcg(&seed) % 3 );
+        width = 2 + lcg(&seed) % ( MAX_WIDTH - 1 );
+        height = 1 + lcg(&seed) % MAX_HEIGHT;
+        stride = ( ( FrameStatistics::LAYOUT_NV12 == layout ) ? width : width * 2 ) + lcg(&seed) % 64;
+        step = 1 + lcg(&seed) % 5;
+
+        //Mostly smooth content with noise, so the gradients aren't all saturated
+        for ( unsigned int k = 0 ; k < stride * height * 2 ; k++ )
+            {
+            gFrame[k] = ( k / 7 ) + ( lcg(&seed) % 24 );
+            }
+        if ( 0 == ( i % 4 ) )
+            {
+            for ( unsigned int k = 0 ; k < stride * height * 2 ; k++ )
+                {
+                gFrame[k] = lcg(&seed);
+                }
+            }
+
+        engine.setRowStep(step);
+        CHECK(NO_ERROR == engine.process(gFrame, layout, width, height, stride, stats));
+        reference(gFrame, layout, width, height, stride, step, expected);
+
+        if ( !equal(stats, expected) )
+            {
+            if ( 10 > mismatches )
+                {
+                printf("mismatch: layout %d %ux%u stride %u step %u\n", layout, width, height, stride, step);
+                }
+            mismatches++;
+            }
+        }
+
+    CHECK(0 == mismatches);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = ( argc > 1 ) ? atoi(argv[1]) : 2000;
+    uint32_t seed = ( argc > 2 ) ? strtoul(argv[2], NULL, 0) : 1;
+
+#ifdef __ARM_NEON__
+    printf("Checking the NEON path\n");
+#else
+    printf("Checking the scalar path\n");
+#endif
+
+    testKnown();
+    testRandom(iterations, seed);
+
+    printf("%s, %d failures\n", failures ? "FAIL" : "PASS", failures);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/**
+* @file LatencyHistogram.cpp
+*
+* Fixed size latency histogram, kept apart from the rest of Camera HAL so it can be built on the host.
+*
+*/
+
+#include <string.h>
+
+#include "LatencyHistogram.h"
+
+namespace android {
+
+/*--------------------LatencyHistogram Class STARTS here-----------------------------*/
+
+void LatencyHistogram::reset()
+{
+    Mutex::Autolock lock(mLock);
+
+    memset(mBuckets, 0, sizeof(mBuckets));
+    mCount = 0;
+    mSum = 0;
+    mMin = 0xFFFFFFFF;
+    mMax = 0;
+}
+
+int LatencyHistogram::bucketIndex(uint32_t us)
+{
+    int exponent;
+
+    if ( us < ( uint32_t ) SUB_BUCKETS )
+        {
+        return us;
+        }
+
+    //Position of the most significant bit, always >= 3 here
+    exponent = 31 - __builtin_clz(us);
+
+    return ( exponent - 2 ) * SUB_BUCKETS + ( ( us >> ( exponent - 3 ) ) & ( SUB_BUCKETS - 1 ) );
+}
+
+uint32_t LatencyHistogram::bucketValue(int index)
+{
+    int exponent;
+
+    if ( index < SUB_BUCKETS )
+        {
+        return index;
+        }
+
+    exponent = ( index / SUB_BUCKETS ) + 2;
+
+    return ( SUB_BUCKETS + ( index % SUB_BUCKETS ) ) << ( exponent - 3 );
+}
+
+void LatencyHistogram::add(nsecs_t sample)
+{
+    uint32_t us;
+
+    if ( 0 > sample )
+        {
+        sample = 0;
+        }
+
+    us = ( uint32_t ) ns2us(sample);
+
+    Mutex::Autolock lock(mLock);
+
+    mBuckets[bucketIndex(us)]++;
+    mCount++;
+    mSum += us;
+
+    if ( us < mMin )
+        {
+        mMin = us;
+        }
+
+    if ( us > mMax )
+        {
+        mMax = us;
+        }
+}
+
+uint32_t LatencyHistogram::count() const
+{
+    Mutex::Autolock lock(mLock);
+
+    return mCount;
+}
+
+uint32_t LatencyHistogram::percentileLocked(unsigned int pct) const
+{
+    uint32_t target, accumulated = 0;
+    uint32_t ret;
+
+    if ( 0 == mCount )
+        {
+        return 0;
+        }
+
+    if ( 100 <= pct )
+        {
+        return mMax;
+        }
+
+    target = ( uint32_t ) ( ( ( uint64_t ) mCount * pct + 99 ) / 100 );
+    if ( 0 == target )
+        {
+        target = 1;
+        }
+
+    for ( int i = 0 ; i < NUM_BUCKETS ; i++ )
+        {
+        accumulated += mBuckets[i];
+        if ( accumulated >= target )
+            {
+            ret = bucketValue(i);
+
+            //The bucket lower bound can't be outside the observed range
+            if ( ret < mMin )
+                {
+                ret = mMin;
+                }
+            else if ( ret > mMax )
+                {
+                ret = mMax;
+                }
+
+            return ret;
+            }
+        }
+
+    return mMax;
+}
+
+uint32_t LatencyHistogram::percentile(unsigned int pct) const
+{
+    Mutex::Autolock lock(mLock);
+
+    return percentileLocked(pct);
+}
+
+void LatencyHistogram::dump(String8 &out, const char *name) const
+{
+    Mutex::Autolock lock(mLock);
+
+    out.appendFormat("%s.count=%u\n", name, mCount);
+
+    if ( 0 == mCount )
+        {
+        return;
+        }
+
+    out.appendFormat("%s.min_us=%u\n", name, mMin);
+    out.appendFormat("%s.avg_us=%llu\n", name, ( unsigned long long ) ( mSum / mCount ));
+    out.appendFormat("%s.p50_us=%u\n", name, percentileLocked(50));
+    out.appendFormat("%s.p90_us=%u\n", name, percentileLocked(90));
+    out.appendFormat("%s.p99_us=%u\n", name, percentileLocked(99));
+    out.appendFormat("%s.max_us=%u\n", name, mMax);
+}
+
+/*--------------------LatencyHistogram Class ENDS here-----------------------------*/
+
+};
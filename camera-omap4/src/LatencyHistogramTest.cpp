@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Host test for LatencyHistogram. Checks the exact range, the clamping, the
+ * dump output and, on random sample sets, that every percentile is within
+ * one bucket (12.5%) below the exact one.
+ *
+ * usage: LatencyHistogramTest [iterations] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "LatencyHistogram.h"
+
+using namespace android;
+
+#define MAX_SAMPLES 4096
+
+static int failures = 0;
+
+#define CHECK(cond) do { if ( !(cond) ) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while ( 0 )
+
+static int compare(const void *a, const void *b)
+{
+    uint32_t x = *( const uint32_t * ) a;
+    uint32_t y = *( const uint32_t * ) b;
+
+    return ( x < y ) ? -1 : ( ( x > y ) ? 1 : 0 );
+}
+
+static uint32_t lcg(uint32_t *state)
+{
+    *state = *state * 1103515245 + 12345;
+    return *state >> 8;
+}
+
+static void testEmpty()
+{
+    LatencyHistogram histogram;
+    String8 out;
+
+    CHECK(histogram.count() == 0);
+    CHECK(histogram.percentile(50) == 0);
+
+    histogram.dump(out, "empty");
+    CHECK(strcmp(out.string(), "empty.count=0\n") == 0);
+}
+
+static void testExact()
+{
+    LatencyHistogram histogram;
+
+    // Below SUB_BUCKETS every microsecond has its own bucket
+    for ( int us = 0 ; us < LatencyHistogram::SUB_BUCKETS ; us++ )
+        {
+        histogram.add(us2ns(us));
+        }
+
+    CHECK(histogram.count() == LatencyHistogram::SUB_BUCKETS);
+    CHECK(histogram.percentile(0) == 0);
+    CHECK(histogram.percentile(50) == 3);
+    CHECK(histogram.percentile(100) == 7);
+
+    // A single value comes back as is, the bucket bound is clamped to the observed range
+    histogram.reset();
+    for ( int i = 0 ; i < 10 ; i++ )
+        {
+        histogram.add(us2ns(1000));
+        }
+    CHECK(histogram.percentile(1) == 1000);
+    CHECK(histogram.percentile(99) == 1000);
+
+    // Negative samples count as zero, the largest ones still fit
+    histogram.reset();
+    histogram.add(-5000);
+    histogram.add(us2ns(0xFFFFFFFFULL));
+    CHECK(histogram.count() == 2);
+    CHECK(histogram.percentile(50) == 0);
+    CHECK(histogram.percentile(100) == 0xFFFFFFFF);
+}
+
+static void testDump()
+{
+    LatencyHistogram histogram;
+    String8 out;
+
+    histogram.add(us2ns(100));
+    histogram.add(us2ns(200));
+    histogram.add(us2ns(300));
+    histogram.dump(out, "stage");
+
+    CHECK(strstr(out.string(), "stage.count=3\n") != NULL);
+    CHECK(strstr(out.string(), "stage.min_us=100\n") != NULL);
+    CHECK(strstr(out.string(), "stage.avg_us=200\n") != NULL);
+    CHECK(strstr(out.string(), "stage.max_us=300\n") != NULL);
+    CHECK(strstr(out.string(), "stage.p50_us=") != NULL);
+    CHECK(strstr(out.string(), "stage.p99_us=") != NULL);
+}
+
+static void testRandom(int iterations, uint32_t seed)
+{
+    static const unsigned int pcts[] = { 1, 10, 50, 90, 99 };
+    static uint32_t samples[MAX_SAMPLES];
+    LatencyHistogram histogram;
+
+    for ( int i = 0 ; i < iterations ; i++ )
+        {
+        int count = 1 + lcg(&seed) % MAX_SAMPLES;
+        int range = 1 + lcg(&seed) % 24;
+
+        histogram.reset();
+        for ( int j = 0 ; j < count ; j++ )
+            {
+            samples[j] = lcg(&seed) & ( ( 1 << range ) - 1 );
+            histogram.add(us2ns(samples[j]));
+            }
+        qsort(samples, count, sizeof(samples[0]), compare);
+
+        CHECK(histogram.count() == ( uint32_t ) count);
+        CHECK(histogram.percentile(100) == samples[count - 1]);
+
+        for ( unsigned int k = 0 ; k < sizeof(pcts) / sizeof(pcts[0]) ; k++ )
+            {
+            int rank = ( int ) ( ( ( uint64_t ) count * pcts[k] + 99 ) / 100 );
+            uint32_t exact = samples[( rank ? rank : 1 ) - 1];
+            uint32_t value = histogram.percentile(pcts[k]);
+
+            // The lower bound of the bucket holding the exact percentile
+            CHECK(value <= exact);
+            CHECK(( uint64_t ) value * LatencyHistogram::SUB_BUCKETS >= ( uint64_t ) exact * ( LatencyHistogram::SUB_BUCKETS - 1 ));
+            if ( value > exact )
+                {
+                printf("p%u %u > %u\n", pcts[k], value, exact);
+                }
+            }
+        }
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = ( argc > 1 ) ? atoi(argv[1]) : 1000;
+    uint32_t seed = ( argc > 2 ) ? strtoul(argv[2], NULL, 0) : 1;
+
+    testEmpty();
+    testExact();
+    testDump();
+    testRandom(iterations, seed);
+
+    printf("%s, %d failures\n", failures ? "FAIL" : "PASS", failures);
+
+    return failures ? 1 : 0;
+}
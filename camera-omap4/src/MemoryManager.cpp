@@ -24,6 +24,7 @@
 
 #include "CameraHal.h"
 #include "TICameraParameters.h"
+#include <cutils/properties.h>
 
 extern "C" {
 
@@ -41,6 +42,9 @@ namespace android {
 #define STRIDE_8BIT (4 * 1024)
 #define STRIDE_16BIT (4 * 1024)
 
+///Default maximum size of the buffer pool in MB
+#define DEFAULT_POOL_SIZE_MB "32"
+
 
 ///Utility Macro Declarations
 #define ZERO_OUT_ARR(a,b) { for(unsigned int i=0;i<b;i++) a[i]=NULL;}
@@ -48,6 +52,23 @@ namespace android {
 #define ZERO_OUT_STRUCT(a, b) memset(a, 0, sizeof(b));
 
 /*--------------------MemoryManager Class STARTS here-----------------------------*/
+MemoryManager::MemoryManager()
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    property_get("debug.camera.tilerpool.max", value, DEFAULT_POOL_SIZE_MB);
+    mPool.setMaxBytes(atoi(value) * 1024 * 1024);
+}
+
+MemoryManager::~MemoryManager()
+{
+    LOG_FUNCTION_NAME
+
+    releasePool();
+
+    LOG_FUNCTION_NAME_EXIT
+}
+
 ///@todo Change the name of the MemoryManager class to TilerMemoryManager to indicate that it allocates TILER buffers only
 void* MemoryManager::allocateBuffer(int width, int height, const char* format, int &bytes, int numBufs)
 {
@@ -57,6 +78,7 @@ void* MemoryManager::allocateBuffer(int width, int height, const char* format, i
     const uint numArrayEntriesC = (uint)(numBufs+1);
 
     MemAllocBlock *tMemBlock;
+    TilerBufferPool::BufferKey key;
 
 
     ///Allocate a buffer array
@@ -86,6 +108,11 @@ void* MemoryManager::allocateBuffer(int width, int height, const char* format, i
 
         ZERO_OUT_STRUCT(tMemBlock, MemAllocBlock );
 
+        key.mLayout = TilerBufferPool::LAYOUT_1D;
+        key.mWidth = 0;
+        key.mHeight = 0;
+        key.mBytes = bytes;
+
         ///1D buffers
         for (int i = 0; i < numBufs; i++)
             {
@@ -94,7 +121,7 @@ void* MemoryManager::allocateBuffer(int width, int height, const char* format, i
             tMemBlock->stride = 0;
             CAMHAL_LOGDB("requested bytes = %d", bytes);
             CAMHAL_LOGDB("tMemBlock.dim.len = %d", tMemBlock->dim.len);
-            bufsArr[i] = (uint32_t)MemMgr_Alloc(tMemBlock, 1);
+            bufsArr[i] = mPool.allocateBlock(key, tMemBlock, 1);
             if(!bufsArr[i])
                 {
                 LOGE("Buffer allocation failed for iteration %d", i);
@@ -179,7 +206,12 @@ void* MemoryManager::allocateBuffer(int width, int height, const char* format, i
                 tMemBlock[index].dim.area.height=  height;/*height*/
                 }
 
-            bufsArr[i] = (uint32_t)MemMgr_Alloc(tMemBlock, numAllocs);
+            key.mLayout = ( 2 == numAllocs ) ? TilerBufferPool::LAYOUT_2D_NV12 : TilerBufferPool::LAYOUT_2D_16BIT;
+            key.mWidth = width;
+            key.mHeight = height;
+            key.mBytes = 0;
+
+            bufsArr[i] = mPool.allocateBlock(key, tMemBlock, numAllocs);
             if(!bufsArr[i])
                 {
                 CAMHAL_LOGEB("Buffer allocation failed for iteration %d", i);
@@ -199,6 +231,8 @@ void* MemoryManager::allocateBuffer(int width, int height, const char* format, i
         ///Free the request structure before returning from the function
         free(tMemBlock);
 
+        mPool.addAllocation(bufsArr, key, numBufs);
+
         return (void*)bufsArr;
 
     error:
@@ -206,6 +240,8 @@ void* MemoryManager::allocateBuffer(int width, int height, const char* format, i
         freeBuffer(bufsArr);
         free(tMemBlock);
 
+        mPool.addFailedAllocation();
+
         if ( NULL != mErrorNotifier.get() )
             {
             mErrorNotifier->errorNotify(-ENOMEM);
@@ -249,10 +285,7 @@ int MemoryManager::freeBuffer(void* buf)
         return BAD_VALUE;
         }
 
-    while(*bufEntry)
-        {
-        ret |= MemMgr_Free((void*)*bufEntry++);
-        }
+    ret = mPool.freeBlocks(bufEntry);
 
     ///@todo Check if this way of deleting array is correct, else use malloc/free
     uint32_t * bufArr = (uint32_t*)buf;
@@ -284,6 +317,16 @@ status_t MemoryManager::setErrorHandler(ErrorNotifier *errorNotifier)
     return ret;
 }
 
+int MemoryManager::releasePool()
+{
+    return mPool.releasePool();
+}
+
+void MemoryManager::dumpStats(String8 &out)
+{
+    mPool.dumpStats(out);
+}
+
 };
 
 
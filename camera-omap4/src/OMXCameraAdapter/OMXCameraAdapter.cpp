@@ -344,6 +344,8 @@ status_t OMXCameraAdapter::initialize(int sensor_index)
         mTouchFocusPosY = 0;
         mMeasurementEnabled = false;
         mFaceDetectionRunning = false;
+        mLastFaceMetadata = NULL;
+        mPreviewFrameNumber = 0;
 
         if ( NULL != mFaceDectionResult )
             {
@@ -2142,6 +2144,15 @@ void OMXCameraAdapter::getParameters(CameraParameters& params)
         Mutex::Autolock lock(mFaceDetectionLock);
         if ( mFaceDetectionRunning )
             {
+            ///The legacy string format is only built when the app queries it
+            if ( NULL != mLastFaceMetadata )
+                {
+                encodeFaceCoordinates(*mLastFaceMetadata, mFaceDectionResult, FACE_DETECTION_BUFFER_SIZE);
+                }
+            else
+                {
+                mFaceDectionResult[0] = '\0';
+                }
             params.set( TICameraParameters::KEY_FACE_DETECTION_DATA, mFaceDectionResult);
             }
         else
@@ -3376,6 +3387,7 @@ status_t OMXCameraAdapter::startPreview()
     mFPS = 0.0f;
     mLastFPS = 0.0f;
     mFrameCount = 0;
+    mPreviewFrameNumber = 0;
     mLastFrameCount = 0;
     mIter = 1;
     mLastFPSTime = systemTime();
@@ -4060,6 +4072,7 @@ status_t OMXCameraAdapter::setFaceDetection(bool enable)
         {
         Mutex::Autolock lock(mFaceDetectionLock);
         mFaceDetectionRunning = enable;
+        mLastFaceMetadata = NULL;
         }
 
     LOG_FUNCTION_NAME_EXIT
@@ -4067,11 +4080,12 @@ status_t OMXCameraAdapter::setFaceDetection(bool enable)
     return ret;
 }
 
-status_t OMXCameraAdapter::detectFaces(OMX_BUFFERHEADERTYPE* pBuffHeader)
+status_t OMXCameraAdapter::detectFaces(OMX_BUFFERHEADERTYPE* pBuffHeader, CameraFaceMetadata &faces)
 {
     status_t ret = NO_ERROR;
     OMX_ERRORTYPE eError = OMX_ErrorNone;
     OMX_TI_FACERESULT *faceResult;
+    CameraFace *face;
     OMX_OTHER_EXTRADATATYPE *extraData;
     OMX_FACEDETECTIONTYPE *faceData;
     OMX_TI_PLATFORMPRIVATE *platformPrivate;
@@ -4191,9 +4205,37 @@ status_t OMXCameraAdapter::detectFaces(OMX_BUFFERHEADERTYPE* pBuffHeader)
 
         }
 
+    faces.mFaceCount = 0;
+
     if ( NO_ERROR == ret )
         {
-        ret = encodeFaceCoordinates(faceData, mFaceDectionResult, FACE_DETECTION_BUFFER_SIZE);
+        faceResult = ( OMX_TI_FACERESULT * ) faceData->tFacePosition;
+        for ( unsigned int i = 0 ; i < faceData->ulFaceCount ; i++, faceResult++ )
+            {
+
+            if ( CAMERA_MAX_FACES <= faces.mFaceCount )
+                {
+                CAMHAL_LOGDB("Only %d faces reported out of %d", CAMERA_MAX_FACES, ( unsigned int ) faceData->ulFaceCount);
+                break;
+                }
+
+            if ( mFaceDetectionThreshold <= faceResult->nScore )
+                {
+                CAMHAL_LOGVB("Face %d: left = %d, top = %d, width = %d, height = %d", i,
+                                                       ( unsigned int ) faceResult->nLeft,
+                                                       ( unsigned int ) faceResult->nTop,
+                                                       ( unsigned int ) faceResult->nWidth,
+                                                       ( unsigned int ) faceResult->nHeight);
+
+                face = &faces.mFaces[faces.mFaceCount++];
+                face->mLeft = faceResult->nLeft;
+                face->mTop = faceResult->nTop;
+                face->mWidth = faceResult->nWidth;
+                face->mHeight = faceResult->nHeight;
+                face->mRoll = faceResult->nOrientationRoll;
+                face->mScore = faceResult->nScore;
+                }
+            }
         }
 
     LOG_FUNCTION_NAME_EXIT
@@ -4201,23 +4243,17 @@ status_t OMXCameraAdapter::detectFaces(OMX_BUFFERHEADERTYPE* pBuffHeader)
     return ret;
 }
 
-status_t OMXCameraAdapter::encodeFaceCoordinates(const OMX_FACEDETECTIONTYPE *faceData, char *faceString, size_t faceStringSize)
+status_t OMXCameraAdapter::encodeFaceCoordinates(const CameraFaceMetadata &faces, char *faceString, size_t faceStringSize)
 {
     status_t ret = NO_ERROR;
-    OMX_TI_FACERESULT *faceResult;
+    const CameraFace *face;
     size_t faceResultSize;
     int count = 0;
     char *p;
 
     LOG_FUNCTION_NAME
 
-    if ( NULL == faceData )
-        {
-        CAMHAL_LOGEA("Invalid OMX_FACEDETECTIONTYPE parameter");
-        ret = -EINVAL;
-        }
-
-    if ( NULL == faceString )
+    if ( ( NULL == faceString ) || ( 0 == faceStringSize ) )
         {
         CAMHAL_LOGEA("Invalid faceString parameter");
         ret = -EINVAL;
@@ -4226,44 +4262,30 @@ status_t OMXCameraAdapter::encodeFaceCoordinates(const OMX_FACEDETECTIONTYPE *fa
     if ( NO_ERROR == ret )
         {
 
-        p = mFaceDectionResult;
+        p = faceString;
+        *p = '\0';
         faceResultSize = faceStringSize;
-        faceResult = ( OMX_TI_FACERESULT * ) faceData->tFacePosition;
-        if ( 0 < faceData->ulFaceCount )
-            {
-            for ( int i = 0  ; i < faceData->ulFaceCount ; i++)
+        face = faces.mFaces;
+        for ( unsigned int i = 0  ; i < faces.mFaceCount ; i++, face++ )
+            {
+            count = snprintf(p, faceResultSize, "%d,%dx%d,%dx%d,",
+                                                   face->mRoll,
+                                                   face->mLeft,
+                                                   face->mTop,
+                                                   face->mWidth,
+                                                   face->mHeight);
+
+            ///Truncated output, keep only the complete faces
+            if ( ( 0 > count ) || ( faceResultSize <= ( size_t ) count ) )
                 {
-
-                if ( mFaceDetectionThreshold <= faceResult->nScore )
-                    {
-                    CAMHAL_LOGVB("Face %d: left = %d, top = %d, width = %d, height = %d", i,
-                                                           ( unsigned int ) faceResult->nLeft,
-                                                           ( unsigned int ) faceResult->nTop,
-                                                           ( unsigned int ) faceResult->nWidth,
-                                                           ( unsigned int ) faceResult->nHeight);
-
-                    count = snprintf(p, faceResultSize, "%d,%dx%d,%dx%d,",
-                                                           ( unsigned int ) faceResult->nOrientationRoll,
-                                                           ( unsigned int ) faceResult->nLeft,
-                                                           ( unsigned int ) faceResult->nTop,
-                                                           ( unsigned int ) faceResult->nWidth,
-                                                           ( unsigned int ) faceResult->nHeight);
-                    }
-
-                p += count;
-                faceResultSize -= count;
-                faceResult++;
+                *p = '\0';
+                break;
                 }
-            }
-        else
-            {
-            memset(mFaceDectionResult, '\0', faceStringSize);
+
+            p += count;
+            faceResultSize -= count;
             }
         }
-    else
-        {
-        memset(mFaceDectionResult, '\0', faceStringSize);
-        }
 
     LOG_FUNCTION_NAME_EXIT
 
@@ -6231,6 +6253,38 @@ status_t OMXCameraAdapter::getPictureBufferSize(size_t &length, size_t bufferCou
     return ret;
 }
 
+void OMXCameraAdapter::dumpStats(String8 &out)
+{
+    static const char *commandNames[OMX_CommandPortEnable + 1] =
+        {
+        "omx.cmd.state_set",
+        "omx.cmd.flush",
+        "omx.cmd.port_disable",
+        "omx.cmd.port_enable"
+        };
+
+    LOG_FUNCTION_NAME
+
+    BaseCameraAdapter::dumpStats(out);
+
+    out.appendFormat("omx.fps=%.2f\n", mFPS);
+    out.appendFormat("omx.state=%d\n", mComponentState);
+
+        {
+        Mutex::Autolock lock(mEventLock);
+        out.appendFormat("omx.pending_events=%u\n", mEventSignalQ.size());
+        }
+
+    for ( int i = 0 ; i <= OMX_CommandPortEnable ; i++ )
+        {
+        mCommandLatency[i].dump(out, commandNames[i]);
+        }
+
+    mEventLatency.dump(out, "omx.event");
+
+    LOG_FUNCTION_NAME_EXIT
+}
+
 /* Application callback Functions */
 /*========================================================*/
 /* @ fn SampleTest_EventHandler :: Application callback   */
@@ -6376,6 +6430,17 @@ OMX_ERRORTYPE OMXCameraAdapter::SignalEvent(OMX_IN OMX_HANDLETYPE hComponent,
                     Semaphore *sem  = (Semaphore*) msg->arg3;
                     CAMHAL_LOGDA("Event matched, signalling sem");
                     mEventSignalQ.removeAt(i);
+
+                    //The registration timestamp is stored inside the message id
+                    if ( ( OMX_EventCmdComplete == eEvent ) && ( OMX_CommandPortEnable >= nData1 ) )
+                        {
+                        mCommandLatency[nData1].add(systemTime(SYSTEM_TIME_MONOTONIC) - msg->id);
+                        }
+                    else
+                        {
+                        mEventLatency.add(systemTime(SYSTEM_TIME_MONOTONIC) - msg->id);
+                        }
+
                     //Signal the semaphore provided
                     sem->Signal();
                     free(msg);
@@ -6415,6 +6480,7 @@ status_t OMXCameraAdapter::RegisterForEvent(OMX_IN OMX_HANDLETYPE hComponent,
         msg->arg2 = ( void * ) nData2;
         msg->arg3 = ( void * ) &semaphore;
         msg->arg4 =  ( void * ) hComponent;
+        msg->id = systemTime(SYSTEM_TIME_MONOTONIC);
         res = mEventSignalQ.add(msg);
         if ( NO_MEMORY == res )
             {
@@ -6522,16 +6588,12 @@ OMX_ERRORTYPE OMXCameraAdapter::OMXCameraAdapterFillBufferDone(OMX_IN OMX_HANDLE
             return OMX_ErrorNone;
             }
 
+        FrameTrace::begin(pBuffHeader->pBuffer, FrameTrace::STREAM_PREVIEW);
+
         recalculateFPS();
 
-            {
-            Mutex::Autolock lock(mFaceDetectionLock);
-            if ( mFaceDetectionRunning )
-                {
-                detectFaces(pBuffHeader);
-                CAMHAL_LOGVB("Faces detected: %s", mFaceDectionResult);
-                }
-            }
+        CameraFaceMetadata *faceMetadata = NULL;
+        mPreviewFrameNumber++;
 
         stat |= advanceZoom();
 
@@ -6559,6 +6621,40 @@ OMX_ERRORTYPE OMXCameraAdapter::OMXCameraAdapterFillBufferDone(OMX_IN OMX_HANDLE
 
         res2 = prepareFrame(pBuffHeader, typeOfFrame, pPortParam, cameraFramePreview);
 
+            {
+            Mutex::Autolock lock(mFaceDetectionLock);
+            if ( mFaceDetectionRunning )
+                {
+                ///The record belongs to the buffer header, which isn't filled again before the frame is returned
+                for ( int i = 0 ; i < pPortParam->mNumBufs ; i++ )
+                    {
+                    if ( pPortParam->mBufferHeader[i] == pBuffHeader )
+                        {
+                        faceMetadata = &mFaceMetadata[i];
+                        break;
+                        }
+                    }
+
+                if ( NULL != faceMetadata )
+                    {
+                    detectFaces(pBuffHeader, *faceMetadata);
+                    faceMetadata->mFrameNumber = mPreviewFrameNumber;
+                    faceMetadata->mTimestamp = cameraFramePreview.mTimestamp;
+                    mLastFaceMetadata = faceMetadata;
+                    CAMHAL_LOGVB("Faces detected: %d", faceMetadata->mFaceCount);
+                    }
+                }
+            }
+
+        ///Attach the face metadata to the frames it was detected on
+        cameraFrameVideo.mFrameNumber = mPreviewFrameNumber;
+        cameraFramePreview.mFrameNumber = mPreviewFrameNumber;
+        if ( NULL != faceMetadata )
+            {
+            cameraFrameVideo.mFaceMetadata = faceMetadata;
+            cameraFramePreview.mFaceMetadata = faceMetadata;
+            }
+
         stat |= ( ( NO_ERROR == res1 ) || ( NO_ERROR == res2 ) ) ? ( ( int ) NO_ERROR ) : ( -1 );
 
         if ( mRecording )
@@ -6636,6 +6732,8 @@ OMX_ERRORTYPE OMXCameraAdapter::OMXCameraAdapterFillBufferDone(OMX_IN OMX_HANDLE
 
         mCapturedFrames--;
 
+        FrameTrace::begin(pBuffHeader->pBuffer, FrameTrace::STREAM_IMAGE);
+
         //The usual jpeg capture does not include raw data.
         //Use empty raw frames intead.
         if ( ( CodingNone == mCodingMode ) &&
@@ -71,6 +71,13 @@ OverlayDisplayAdapter::OverlayDisplayAdapter():mDisplayThread(NULL),
     mSuspend = false;
     mFailedDQs = 0;
 
+    mStatsStart = 0;
+    mFramesPosted = 0;
+    mFramesDropped = 0;
+    mFramesDequeued = 0;
+    mFramesReclaimed = 0;
+    mTotalFailedDQs = 0;
+
     mPaused = false;
     mXOff = 0;
     mYOff = 0;
@@ -297,6 +304,16 @@ int OverlayDisplayAdapter::enableDisplay(struct timeval *refTime, S3DParameters
     ///Wait for the ACK - implies that the thread is now started and waiting for frames
     sem.Wait();
 
+        {
+        Mutex::Autolock lock(mStatsLock);
+        mStatsStart = systemTime(SYSTEM_TIME_MONOTONIC);
+        mFramesPosted = 0;
+        mFramesDropped = 0;
+        mFramesDequeued = 0;
+        mFramesReclaimed = 0;
+        mTotalFailedDQs = 0;
+        }
+
     //Register with the frame provider for frames
     mFrameProvider->enableFrameNotification(CameraFrame::PREVIEW_FRAME_SYNC);
 
@@ -382,6 +399,28 @@ status_t OverlayDisplayAdapter::pauseDisplay(bool pause)
     return ret;
 }
 
+status_t OverlayDisplayAdapter::setFrameSize(int width, int height)
+{
+    LOG_FUNCTION_NAME
+
+    CAMHAL_LOGDB("Frame size %d x %d -> %d x %d", mFrameWidth, mFrameHeight, width, height);
+
+    {
+        Mutex::Autolock lock(mLock);
+        mFrameWidth = width;
+        mFrameHeight = height;
+
+        ///Invalidate the current offsets, so that the crop gets
+        ///reprogrammed together with the next posted frame
+        mXOff = ( uint32_t ) -1;
+        mYOff = ( uint32_t ) -1;
+    }
+
+    LOG_FUNCTION_NAME_EXIT
+
+    return NO_ERROR;
+}
+
 
 void OverlayDisplayAdapter::destroy()
 {
@@ -753,7 +792,7 @@ status_t OverlayDisplayAdapter::PostFrame(OverlayDisplayAdapter::DisplayFrame &d
         if ( ( ( mPaused ) && ( CameraFrame::CameraFrame::PREVIEW_FRAME_SYNC == dispFrame.mType ) ) ||
                ( mSuspend ) )
             {
-            mFrameProvider->returnFrame(dispFrame.mBuffer, CameraFrame::PREVIEW_FRAME_SYNC);
+            dropFrame(dispFrame.mBuffer);
 
             return NO_ERROR;
             }
@@ -762,7 +801,7 @@ status_t OverlayDisplayAdapter::PostFrame(OverlayDisplayAdapter::DisplayFrame &d
     if ( NAME_NOT_FOUND != mFramesWithDisplayMap.indexOfKey( (int) dispFrame.mBuffer) )
         {
         CAMHAL_LOGEB("Warning: Buffer 0x%x already queued", (unsigned int)dispFrame.mBuffer);
-        mFrameProvider->returnFrame(dispFrame.mBuffer, CameraFrame::PREVIEW_FRAME_SYNC);
+        dropFrame(dispFrame.mBuffer);
 
         return NO_ERROR;
         }
@@ -818,10 +857,17 @@ status_t OverlayDisplayAdapter::PostFrame(OverlayDisplayAdapter::DisplayFrame &d
             {
             CAMHAL_LOGEB("Posting error 0x%x for buffer 0x%x, index %d", ret, (unsigned int)dispFrame.mBuffer, (unsigned int)buf);
             ///Drop the frame, return it back to the provider (Camera Adapter)
-            mFrameProvider->returnFrame(dispFrame.mBuffer, CameraFrame::PREVIEW_FRAME_SYNC);
+            dropFrame(dispFrame.mBuffer);
             }
         else
             {
+            FrameTrace::mark(dispFrame.mBuffer, FrameTrace::STAGE_DISPLAY_POST);
+
+                {
+                Mutex::Autolock lock(mStatsLock);
+                mFramesPosted++;
+                }
+
             mFramesWithDisplay++;
 
               if(mFramesWithDisplay> OPTIMAL_BUFFER_COUNT_WITH_DISPLAY)
@@ -864,6 +910,11 @@ status_t OverlayDisplayAdapter::PostFrame(OverlayDisplayAdapter::DisplayFrame &d
                         mFrameProvider->returnFrame( (void *) mFramesWithDisplayMap.keyAt(i), CameraFrame::PREVIEW_FRAME_SYNC);
                         }
 
+                        {
+                        Mutex::Autolock lock(mStatsLock);
+                        mFramesReclaimed += mFramesWithDisplayMap.size();
+                        }
+
                     ///Clear the frames with display map
                     mFramesWithDisplayMap.clear();
                     }
@@ -890,7 +941,7 @@ status_t OverlayDisplayAdapter::PostFrame(OverlayDisplayAdapter::DisplayFrame &d
     else
         {
         ///Drop the frame, return it back to the provider (Camera Adapter)
-        mFrameProvider->returnFrame(dispFrame.mBuffer, CameraFrame::PREVIEW_FRAME_SYNC);
+        dropFrame(dispFrame.mBuffer);
         }
 
 
@@ -929,6 +980,12 @@ bool OverlayDisplayAdapter::handleFrameReturn()
             mFrameProvider->returnFrame( (void *) mFramesWithDisplayMap.keyAt(i), CameraFrame::PREVIEW_FRAME_SYNC);
             }
 
+            {
+            Mutex::Autolock lock(mStatsLock);
+            mFramesReclaimed += mFramesWithDisplayMap.size();
+            mTotalFailedDQs++;
+            }
+
         mFramesWithDisplay = 0;
 
         ///Clear the frames with display map
@@ -965,12 +1022,19 @@ bool OverlayDisplayAdapter::handleFrameReturn()
         return true;
         }
 
+    FrameTrace::mark( (void *) mPreviewBufferMap[(int)buf], FrameTrace::STAGE_DISPLAY_DONE);
+
     ///Return the frame back to the provider (Camera Adapter)
     mFrameProvider->returnFrame( (void *) mPreviewBufferMap[(int)buf], CameraFrame::PREVIEW_FRAME_SYNC);
 
     ///Remove the frame from the display frame list
     mFramesWithDisplayMap.removeItem(mPreviewBufferMap[(int)buf]);
 
+        {
+        Mutex::Autolock lock(mStatsLock);
+        mFramesDequeued++;
+        }
+
     mFramesWithDisplay--;
     ///Overlay still holds one buffer back as long as display is enabled
     if ( 1 == mFramesWithDisplay )
@@ -983,6 +1047,47 @@ bool OverlayDisplayAdapter::handleFrameReturn()
     return false;
 }
 
+void OverlayDisplayAdapter::dropFrame(void *frameBuf)
+{
+    ///Drop the frame, return it back to the provider (Camera Adapter)
+    mFrameProvider->returnFrame(frameBuf, CameraFrame::PREVIEW_FRAME_SYNC);
+
+    Mutex::Autolock lock(mStatsLock);
+    mFramesDropped++;
+}
+
+void OverlayDisplayAdapter::dumpStats(String8 &out)
+{
+    nsecs_t elapsed;
+
+    LOG_FUNCTION_NAME
+
+        {
+        Mutex::Autolock lock(mLock);
+        out.appendFormat("display.enabled=%d\n", mDisplayEnabled);
+        out.appendFormat("display.paused=%d\n", mPaused);
+        out.appendFormat("display.suspended=%d\n", mSuspend);
+        out.appendFormat("display.buffers=%d\n", mBufferCount);
+        out.appendFormat("display.buffers_with_display=%u\n", mFramesWithDisplayMap.size());
+        }
+
+        {
+        Mutex::Autolock lock(mStatsLock);
+        elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - mStatsStart;
+        out.appendFormat("display.posted=%u\n", mFramesPosted);
+        out.appendFormat("display.dropped=%u\n", mFramesDropped);
+        out.appendFormat("display.dequeued=%u\n", mFramesDequeued);
+        out.appendFormat("display.reclaimed=%u\n", mFramesReclaimed);
+        out.appendFormat("display.failed_dqs=%u\n", mTotalFailedDQs);
+        if ( ( 0 != mStatsStart ) && ( 0 < elapsed ) )
+            {
+            out.appendFormat("display.fps=%.2f\n", ( mFramesPosted * float(s2ns(1)) ) / elapsed);
+            }
+        }
+
+    LOG_FUNCTION_NAME_EXIT
+}
+
 void OverlayDisplayAdapter::frameCallbackRelay(CameraFrame* caFrame)
 {
 
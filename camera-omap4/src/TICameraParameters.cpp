@@ -69,6 +69,8 @@ const char TICameraParameters::KEY_TEMP_BRACKETING_RANGE_NEG[] = "temporal-brack
 const char TICameraParameters::KEY_S3D_SUPPORTED[] = "s3d-supported";
 const char TICameraParameters::KEY_TOUCH_FOCUS_POS[] = "touch-focus";
 const char TICameraParameters::KEY_MEASUREMENT_ENABLE[] = "measurement";
+const char TICameraParameters::KEY_VIDEO_METADATA[] = "video-metadata";
+const char TICameraParameters::KEY_PREVIEW_CALLBACK_SIZE[] = "preview-callback-size";
 const char TICameraParameters::KEY_GBCE[] = "gbce";
 const char TICameraParameters::KEY_GLBCE[] = "glbce";
 const char TICameraParameters::KEY_CURRENT_ISO[] = "current-iso";
@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+* @file TilerBufferPool.cpp
+*
+* Pool of released TILER blocks used by MemoryManager, kept apart from the rest of Camera HAL
+* so it can be built on the host against a MemMgr mock.
+*
+*/
+
+#define LOG_TAG "CameraHal"
+
+#include <utils/Log.h>
+#include "TilerBufferPool.h"
+
+extern "C" {
+
+#include "memmgr.h"
+
+};
+
+namespace android {
+
+///A 4KB TILER page covers 64x64 pixels in 8-bit mode and 32x64 pixels in 16-bit mode
+#define PAGE_SIZE_1D (4 * 1024)
+#define TILER_PAGE_WIDTH_8BIT 64
+#define TILER_PAGE_WIDTH_16BIT 32
+#define TILER_PAGE_HEIGHT 64
+
+#define ALIGN_UP(x, a) ( ( ( x ) + ( a ) - 1 ) & ~( ( a ) - 1 ) )
+
+/*--------------------TilerBufferPool Class STARTS here-----------------------------*/
+TilerBufferPool::TilerBufferPool()
+{
+    mPoolBytes = 0;
+    mPoolMaxBytes = 0;
+
+    mAllocatedBytes = 0;
+    mPeakBytes = 0;
+    mAllocatedBuffers = 0;
+    mFailedAllocations = 0;
+    mPoolHits = 0;
+    mPoolMisses = 0;
+    mPoolEvictions = 0;
+    mPoolPressureFlushes = 0;
+}
+
+TilerBufferPool::~TilerBufferPool()
+{
+    releasePool();
+}
+
+void TilerBufferPool::setMaxBytes(size_t maxBytes)
+{
+    Mutex::Autolock lock(mLock);
+
+    mPoolMaxBytes = maxBytes;
+    mPoolEvictions += trimPoolLocked(mPoolMaxBytes);
+}
+
+///Estimates the memory backing a single buffer. 1D buffers are page aligned,
+///2D buffers are backed by whole TILER pages.
+size_t TilerBufferPool::estimateBytes(const BufferKey &key)
+{
+    size_t width = key.mWidth;
+    size_t height = key.mHeight;
+
+    switch ( key.mLayout )
+        {
+        case LAYOUT_1D:
+            return ALIGN_UP(key.mBytes, PAGE_SIZE_1D);
+        case LAYOUT_2D_16BIT:
+            return ALIGN_UP(width, TILER_PAGE_WIDTH_16BIT) * 2 * ALIGN_UP(height, TILER_PAGE_HEIGHT);
+        case LAYOUT_2D_NV12:
+        default:
+            ///Full resolution luma plane, chroma plane with interleaved CbCr pairs at half resolution
+            return ALIGN_UP(width, TILER_PAGE_WIDTH_8BIT) * ALIGN_UP(height, TILER_PAGE_HEIGHT) +
+                   ALIGN_UP(( width + 1 ) / 2, TILER_PAGE_WIDTH_16BIT) * 2 * ALIGN_UP(( height + 1 ) / 2, TILER_PAGE_HEIGHT);
+        };
+}
+
+bool TilerBufferPool::keysMatch(const BufferKey &a, const BufferKey &b)
+{
+    return ( a.mLayout == b.mLayout ) &&
+           ( a.mWidth == b.mWidth ) &&
+           ( a.mHeight == b.mHeight ) &&
+           ( a.mBytes == b.mBytes );
+}
+
+uint32_t TilerBufferPool::allocateBlock(const BufferKey &key, void *allocBlocks, int numBlocks)
+{
+    uint32_t block = 0;
+
+        {
+        Mutex::Autolock lock(mLock);
+
+        ///Prefer the most recently released block, it is the most likely one to still be mapped
+        for ( int i = mPool.size() - 1 ; i >= 0 ; i-- )
+            {
+            if ( keysMatch(mPool[i].mKey, key) )
+                {
+                block = mPool[i].mBlock;
+                mPoolBytes -= mPool[i].mBytes;
+                mPool.removeAt(i);
+                break;
+                }
+            }
+
+        if ( 0 != block )
+            {
+            mPoolHits++;
+            }
+        else
+            {
+            mPoolMisses++;
+            }
+        }
+
+    if ( 0 == block )
+        {
+        block = (uint32_t) MemMgr_Alloc((MemAllocBlock *) allocBlocks, numBlocks);
+
+        ///The TILER space might be occupied by blocks of a different layout sitting in the pool.
+        ///Release them and try once more.
+        if ( ( 0 == block ) && ( 0 < releasePool() ) )
+            {
+                {
+                Mutex::Autolock lock(mLock);
+                mPoolPressureFlushes++;
+                }
+
+            LOGD("Allocation failed, retrying after releasing the buffer pool");
+            block = (uint32_t) MemMgr_Alloc((MemAllocBlock *) allocBlocks, numBlocks);
+            }
+        }
+
+    return block;
+}
+
+void TilerBufferPool::addAllocation(uint32_t *blocks, const BufferKey &key, uint32_t count)
+{
+    Mutex::Autolock lock(mLock);
+    Allocation allocation;
+
+    allocation.mKey = key;
+    allocation.mBytes = estimateBytes(key);
+    allocation.mCount = count;
+    mAllocations.add((unsigned int) blocks, allocation);
+
+    mAllocatedBytes += allocation.mBytes * count;
+    mAllocatedBuffers += count;
+    if ( mAllocatedBytes > mPeakBytes )
+        {
+        mPeakBytes = mAllocatedBytes;
+        }
+}
+
+void TilerBufferPool::addFailedAllocation()
+{
+    Mutex::Autolock lock(mLock);
+
+    mFailedAllocations++;
+}
+
+int TilerBufferPool::freeBlocks(uint32_t *blocks)
+{
+    Mutex::Autolock lock(mLock);
+    ssize_t index = mAllocations.indexOfKey((unsigned int) blocks);
+    Allocation allocation;
+    bool recycle = false;
+    int ret = 0;
+
+    if ( 0 <= index )
+        {
+        allocation = mAllocations.valueAt(index);
+        mAllocations.removeItemsAt(index);
+
+        mAllocatedBytes -= allocation.mBytes * allocation.mCount;
+        mAllocatedBuffers -= allocation.mCount;
+        recycle = ( allocation.mBytes <= mPoolMaxBytes );
+        }
+
+    while ( *blocks )
+        {
+        if ( recycle )
+            {
+            PoolEntry entry;
+
+            entry.mKey = allocation.mKey;
+            entry.mBytes = allocation.mBytes;
+            entry.mBlock = *blocks++;
+            mPool.push(entry);
+            mPoolBytes += entry.mBytes;
+            }
+        else
+            {
+            ret |= MemMgr_Free((void *) *blocks++);
+            }
+        }
+
+    ///Release the least recently used blocks in case the pool grew above its limit
+    mPoolEvictions += trimPoolLocked(mPoolMaxBytes);
+
+    return ret;
+}
+
+int TilerBufferPool::trimPoolLocked(size_t maxBytes)
+{
+    int released = 0;
+
+    while ( ( mPoolBytes > maxBytes ) && ( !mPool.isEmpty() ) )
+        {
+        MemMgr_Free((void *) mPool[0].mBlock);
+        mPoolBytes -= mPool[0].mBytes;
+        mPool.removeAt(0);
+        released++;
+        }
+
+    return released;
+}
+
+int TilerBufferPool::releasePool()
+{
+    Mutex::Autolock lock(mLock);
+
+    return trimPoolLocked(0);
+}
+
+size_t TilerBufferPool::poolBytes()
+{
+    Mutex::Autolock lock(mLock);
+
+    return mPoolBytes;
+}
+
+uint32_t TilerBufferPool::poolBlocks()
+{
+    Mutex::Autolock lock(mLock);
+
+    return mPool.size();
+}
+
+void TilerBufferPool::dumpStats(String8 &out)
+{
+    Mutex::Autolock lock(mLock);
+
+    out.appendFormat("memory.allocated_bytes=%u\n", mAllocatedBytes);
+    out.appendFormat("memory.peak_bytes=%u\n", mPeakBytes);
+    out.appendFormat("memory.buffers=%u\n", mAllocatedBuffers);
+    out.appendFormat("memory.allocations=%u\n", mAllocations.size());
+    out.appendFormat("memory.failed_allocations=%u\n", mFailedAllocations);
+    out.appendFormat("memory.pool.max_bytes=%u\n", mPoolMaxBytes);
+    out.appendFormat("memory.pool.bytes=%u\n", mPoolBytes);
+    out.appendFormat("memory.pool.blocks=%u\n", mPool.size());
+    out.appendFormat("memory.pool.hits=%u\n", mPoolHits);
+    out.appendFormat("memory.pool.misses=%u\n", mPoolMisses);
+    out.appendFormat("memory.pool.evictions=%u\n", mPoolEvictions);
+    out.appendFormat("memory.pool.pressure_flushes=%u\n", mPoolPressureFlushes);
+}
+
+};
+
+/*--------------------TilerBufferPool Class ENDS here-----------------------------*/
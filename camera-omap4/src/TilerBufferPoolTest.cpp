@@ -0,0 +1,418 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Host test of the TilerBufferPool behind MemoryManager against a mock
+ * MemMgr. The mock hands out fake block handles, tracks which of them are
+ * live and can be limited to a number of live blocks to emulate a full
+ * TILER container.
+ *
+ * Usage: TilerBufferPoolTest
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "TilerBufferPool.h"
+
+extern "C" {
+
+#include "memmgr.h"
+
+};
+
+using namespace android;
+
+static int failures = 0;
+
+#define CHECK(cond) do { if ( !(cond) ) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while ( 0 )
+
+/* ---------------------------------------------------------------- mock MemMgr */
+
+#define MOCK_MAX_BLOCKS 64
+
+static uint32_t gLive[MOCK_MAX_BLOCKS];
+static int gLiveCount = 0;
+static int gLiveLimit = MOCK_MAX_BLOCKS;
+static uint32_t gNextHandle = 0x1000;
+static int gAllocs = 0;
+static int gFrees = 0;
+static int gBadFrees = 0;
+static uint32_t gLastFreed = 0;
+
+extern "C" void *MemMgr_Alloc(MemAllocBlock blocks[], int num_blocks)
+{
+    uint32_t handle;
+
+    if ( gLiveCount >= gLiveLimit )
+        {
+        return NULL;
+        }
+
+    gAllocs++;
+    handle = gNextHandle;
+    gNextHandle += 0x1000;
+    gLive[gLiveCount++] = handle;
+
+    return (void *) handle;
+}
+
+extern "C" int MemMgr_Free(void *bufPtr)
+{
+    uint32_t handle = (uint32_t) bufPtr;
+
+    gFrees++;
+    gLastFreed = handle;
+
+    for ( int i = 0 ; i < gLiveCount ; i++ )
+        {
+        if ( gLive[i] == handle )
+            {
+            gLive[i] = gLive[--gLiveCount];
+            return 0;
+            }
+        }
+
+    gBadFrees++;
+
+    return -1;
+}
+
+static void resetMock()
+{
+    gLiveCount = 0;
+    gLiveLimit = MOCK_MAX_BLOCKS;
+    gAllocs = 0;
+    gFrees = 0;
+    gBadFrees = 0;
+    gLastFreed = 0;
+}
+
+/* ---------------------------------------------------------------- helpers */
+
+static TilerBufferPool::BufferKey makeKey(int layout, int width, int height, int bytes)
+{
+    TilerBufferPool::BufferKey key;
+
+    key.mLayout = layout;
+    key.mWidth = width;
+    key.mHeight = height;
+    key.mBytes = bytes;
+
+    return key;
+}
+
+///Allocates count blocks into a NULL terminated array, the way MemoryManager does
+static uint32_t *allocate(TilerBufferPool &pool, const TilerBufferPool::BufferKey &key, int count)
+{
+    MemAllocBlock blocks[2];
+    uint32_t *array = new uint32_t[count + 1];
+
+    memset(blocks, 0, sizeof(blocks));
+    memset(array, 0, ( count + 1 ) * sizeof(uint32_t));
+
+    for ( int i = 0 ; i < count ; i++ )
+        {
+        array[i] = pool.allocateBlock(key, blocks, 1);
+        if ( 0 == array[i] )
+            {
+            pool.freeBlocks(array);
+            delete [] array;
+            return NULL;
+            }
+        }
+
+    pool.addAllocation(array, key, count);
+
+    return array;
+}
+
+static int release(TilerBufferPool &pool, uint32_t *array)
+{
+    int ret = pool.freeBlocks(array);
+
+    delete [] array;
+
+    return ret;
+}
+
+/* ---------------------------------------------------------------- tests */
+
+static void testEstimate()
+{
+    //1D buffers are page aligned
+    CHECK(TilerBufferPool::estimateBytes(makeKey(TilerBufferPool::LAYOUT_1D, 0, 0, 5000)) == 8192);
+    CHECK(TilerBufferPool::estimateBytes(makeKey(TilerBufferPool::LAYOUT_1D, 0, 0, 4096)) == 4096);
+
+    //2D buffers are backed by whole 32x64 16-bit pages
+    CHECK(TilerBufferPool::estimateBytes(makeKey(TilerBufferPool::LAYOUT_2D_16BIT, 100, 100, 0)) == 128 * 2 * 128);
+
+    //NV12: 64x64 8-bit luma pages and a half resolution 16-bit chroma plane
+    CHECK(TilerBufferPool::estimateBytes(makeKey(TilerBufferPool::LAYOUT_2D_NV12, 640, 480, 0)) ==
+          640 * 512 + 320 * 2 * 256);
+}
+
+static void testReuse()
+{
+    TilerBufferPool::BufferKey key = makeKey(TilerBufferPool::LAYOUT_2D_NV12, 640, 480, 0);
+    uint32_t first[2];
+    uint32_t *array;
+
+    resetMock();
+        {
+        TilerBufferPool pool;
+
+        pool.setMaxBytes(32 * 1024 * 1024);
+
+        array = allocate(pool, key, 2);
+        CHECK(NULL != array);
+        CHECK(2 == gAllocs);
+        first[0] = array[0];
+        first[1] = array[1];
+
+        //Released blocks stay live inside the pool
+        CHECK(0 == release(pool, array));
+        CHECK(0 == gFrees);
+        CHECK(2 == pool.poolBlocks());
+        CHECK(2 * TilerBufferPool::estimateBytes(key) == pool.poolBytes());
+
+        //The same key gets the same blocks back, most recently released first
+        array = allocate(pool, key, 2);
+        CHECK(NULL != array);
+        CHECK(2 == gAllocs);
+        CHECK(first[1] == array[0]);
+        CHECK(first[0] == array[1]);
+        CHECK(0 == pool.poolBlocks());
+        CHECK(0 == pool.poolBytes());
+        release(pool, array);
+        }
+
+    //Whatever was pooled goes back to MemMgr with the pool
+    CHECK(0 == gLiveCount);
+    CHECK(0 == gBadFrees);
+}
+
+static void testMismatch()
+{
+    TilerBufferPool::BufferKey vga = makeKey(TilerBufferPool::LAYOUT_2D_NV12, 640, 480, 0);
+    uint32_t *array;
+    uint32_t pooled;
+
+    resetMock();
+        {
+        TilerBufferPool pool;
+
+        pool.setMaxBytes(32 * 1024 * 1024);
+
+        array = allocate(pool, vga, 1);
+        pooled = array[0];
+        release(pool, array);
+        CHECK(1 == gAllocs);
+
+        //Any difference in size or layout is a miss, the pooled block stays where it is
+        array = allocate(pool, makeKey(TilerBufferPool::LAYOUT_2D_NV12, 640, 482, 0), 1);
+        CHECK(2 == gAllocs);
+        CHECK(pooled != array[0]);
+        release(pool, array);
+
+        array = allocate(pool, makeKey(TilerBufferPool::LAYOUT_2D_16BIT, 640, 480, 0), 1);
+        CHECK(3 == gAllocs);
+        release(pool, array);
+
+        array = allocate(pool, makeKey(TilerBufferPool::LAYOUT_1D, 0, 0, 4096), 1);
+        CHECK(4 == gAllocs);
+        release(pool, array);
+
+        array = allocate(pool, makeKey(TilerBufferPool::LAYOUT_1D, 0, 0, 4000), 1);
+        CHECK(5 == gAllocs);
+        release(pool, array);
+
+        CHECK(5 == pool.poolBlocks());
+        CHECK(0 == gFrees);
+
+        //The original block is still available for its own key
+        array = allocate(pool, vga, 1);
+        CHECK(5 == gAllocs);
+        CHECK(pooled == array[0]);
+        release(pool, array);
+        }
+
+    CHECK(0 == gLiveCount);
+    CHECK(0 == gBadFrees);
+}
+
+static void testTrim()
+{
+    TilerBufferPool::BufferKey key = makeKey(TilerBufferPool::LAYOUT_1D, 0, 0, 4096);
+    uint32_t *arrays[3];
+    uint32_t oldest;
+
+    resetMock();
+        {
+        TilerBufferPool pool;
+
+        //Room for two blocks
+        pool.setMaxBytes(2 * 4096);
+
+        for ( int i = 0 ; i < 3 ; i++ )
+            {
+            arrays[i] = allocate(pool, key, 1);
+            }
+        oldest = arrays[0][0];
+
+        release(pool, arrays[0]);
+        release(pool, arrays[1]);
+        CHECK(0 == gFrees);
+        CHECK(2 == pool.poolBlocks());
+
+        //The least recently released block is evicted first
+        release(pool, arrays[2]);
+        CHECK(1 == gFrees);
+        CHECK(oldest == gLastFreed);
+        CHECK(2 == pool.poolBlocks());
+        CHECK(2 * 4096 == pool.poolBytes());
+
+        //Lowering the limit trims right away
+        pool.setMaxBytes(4096);
+        CHECK(2 == gFrees);
+        CHECK(1 == pool.poolBlocks());
+
+        //A buffer larger than the whole pool is never kept
+        arrays[0] = allocate(pool, makeKey(TilerBufferPool::LAYOUT_1D, 0, 0, 8192), 1);
+        release(pool, arrays[0]);
+        CHECK(3 == gFrees);
+        CHECK(1 == pool.poolBlocks());
+
+        //0 disables the pool
+        pool.setMaxBytes(0);
+        CHECK(0 == pool.poolBlocks());
+        arrays[0] = allocate(pool, key, 1);
+        release(pool, arrays[0]);
+        CHECK(0 == pool.poolBlocks());
+        CHECK(gLiveCount == 0);
+        }
+
+    CHECK(0 == gBadFrees);
+}
+
+static void testFree()
+{
+    TilerBufferPool::BufferKey key = makeKey(TilerBufferPool::LAYOUT_2D_16BIT, 320, 240, 0);
+    MemAllocBlock blocks[2];
+    uint32_t *array;
+    String8 stats;
+
+    resetMock();
+    memset(blocks, 0, sizeof(blocks));
+        {
+        TilerBufferPool pool;
+
+        pool.setMaxBytes(32 * 1024 * 1024);
+
+        //Arrays which were never recorded, like a partially failed allocation, go straight back
+        array = new uint32_t[3];
+        array[0] = pool.allocateBlock(key, blocks, 1);
+        array[1] = pool.allocateBlock(key, blocks, 1);
+        array[2] = 0;
+        CHECK(0 == release(pool, array));
+        CHECK(2 == gFrees);
+        CHECK(0 == pool.poolBlocks());
+
+        //releasePool hands every pooled block back
+        array = allocate(pool, key, 3);
+        release(pool, array);
+        CHECK(3 == pool.poolBlocks());
+        CHECK(3 == pool.releasePool());
+        CHECK(0 == pool.poolBlocks());
+        CHECK(0 == pool.poolBytes());
+        CHECK(0 == gLiveCount);
+        CHECK(0 == pool.releasePool());
+
+        //MemMgr errors are reported
+        array = new uint32_t[2];
+        array[0] = 0xDEAD000;
+        array[1] = 0;
+        CHECK(0 != release(pool, array));
+        CHECK(1 == gBadFrees);
+        gBadFrees = 0;
+
+        array = allocate(pool, key, 1);
+        pool.dumpStats(stats);
+        CHECK(NULL != strstr(stats.string(), "memory.buffers=1\n"));
+        CHECK(NULL != strstr(stats.string(), "memory.allocations=1\n"));
+        release(pool, array);
+        }
+
+    CHECK(0 == gLiveCount);
+    CHECK(0 == gBadFrees);
+}
+
+static void testPressure()
+{
+    TilerBufferPool::BufferKey small = makeKey(TilerBufferPool::LAYOUT_2D_NV12, 320, 240, 0);
+    TilerBufferPool::BufferKey large = makeKey(TilerBufferPool::LAYOUT_2D_NV12, 1920, 1088, 0);
+    uint32_t *array;
+    String8 stats;
+
+    resetMock();
+        {
+        TilerBufferPool pool;
+
+        pool.setMaxBytes(32 * 1024 * 1024);
+
+        //The container is full of pooled blocks of another size
+        gLiveLimit = 4;
+        array = allocate(pool, small, 4);
+        release(pool, array);
+        CHECK(4 == pool.poolBlocks());
+
+        //The pool is flushed and the allocation retried
+        array = allocate(pool, large, 1);
+        CHECK(NULL != array);
+        CHECK(0 == pool.poolBlocks());
+        CHECK(4 == gFrees);
+        pool.dumpStats(stats);
+        CHECK(NULL != strstr(stats.string(), "memory.pool.pressure_flushes=1\n"));
+
+        //Nothing left to flush, the failure comes through
+        gLiveLimit = 1;
+        CHECK(NULL == allocate(pool, large, 1));
+        CHECK(4 == gFrees);
+        release(pool, array);
+        }
+
+    CHECK(0 == gLiveCount);
+    CHECK(0 == gBadFrees);
+}
+
+int main(int argc, char **argv)
+{
+    testEstimate();
+    testReuse();
+    testMismatch();
+    testTrim();
+    testFree();
+    testPressure();
+
+    printf("%s, %d failures\n", failures ? "FAIL" : "PASS", failures);
+
+    return failures ? 1 : 0;
+}
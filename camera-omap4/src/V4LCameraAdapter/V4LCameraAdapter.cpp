@@ -82,13 +82,20 @@ status_t V4LCameraAdapter::initialize(int sensor_index)
         return NO_MEMORY;
         }
 
-    if ((mCameraHandle = open(device, O_RDWR)) == -1)
+    //Live device, recording or replay of a recorded stream depending on the properties
+    mDevice = V4LCaptureDevice::create();
+    if ( NULL == mDevice )
         {
-        CAMHAL_LOGEB("Error while opening handle to V4L2 Camera: %s", strerror(errno));
-        return -EINVAL;
+        return NO_MEMORY;
+        }
+
+    ret = mDevice->open(device);
+    if ( NO_ERROR != ret )
+        {
+        return ret;
         }
 
-    ret = ioctl (mCameraHandle, VIDIOC_QUERYCAP, &mVideoInfo->cap);
+    ret = mDevice->ioctl(VIDIOC_QUERYCAP, &mVideoInfo->cap);
     if (ret < 0)
         {
         CAMHAL_LOGEA("Error when querying the capabilities of the V4L Camera");
@@ -112,6 +119,8 @@ status_t V4LCameraAdapter::initialize(int sensor_index)
     mVideoInfo->isStreaming = false;
     mRecording = false;
 
+    initSoftware3A();
+
     LOG_FUNCTION_NAME_EXIT
 
     return ret;
@@ -121,6 +130,7 @@ status_t V4LCameraAdapter::fillThisBuffer(void* frameBuf, CameraFrame::FrameType
 {
 
     status_t ret = NO_ERROR;
+    struct v4l2_buffer buf;
 
     if ( !mVideoInfo->isStreaming )
         {
@@ -133,11 +143,14 @@ status_t V4LCameraAdapter::fillThisBuffer(void* frameBuf, CameraFrame::FrameType
         return BAD_VALUE;
         }
 
-    mVideoInfo->buf.index = i;
-    mVideoInfo->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    mVideoInfo->buf.memory = V4L2_MEMORY_MMAP;
+    //Buffers are returned from other threads while the preview thread is
+    //blocked inside DQBUF, don't share the v4l2_buffer with it
+    memset(&buf, 0, sizeof(buf));
+    buf.index = i;
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
 
-    ret = ioctl(mCameraHandle, VIDIOC_QBUF, &mVideoInfo->buf);
+    ret = mDevice->ioctl(VIDIOC_QBUF, &buf);
     if (ret < 0) {
        CAMHAL_LOGEA("Init: VIDIOC_QBUF Failed");
        return -1;
@@ -192,7 +205,7 @@ status_t V4LCameraAdapter::setParameters(const CameraParameters &params)
     mVideoInfo->format.fmt.pix.height = height;
     mVideoInfo->format.fmt.pix.pixelformat = DEFAULT_PIXEL_FORMAT;
 
-    ret = ioctl(mCameraHandle, VIDIOC_S_FMT, &mVideoInfo->format);
+    ret = mDevice->ioctl(VIDIOC_S_FMT, &mVideoInfo->format);
     if (ret < 0) {
         CAMHAL_LOGEB("Open: VIDIOC_S_FMT Failed: %s", strerror(errno));
         return ret;
@@ -262,7 +275,7 @@ status_t V4LCameraAdapter::UseBuffersPreview(void* bufArr, int num)
     mVideoInfo->rb.memory = V4L2_MEMORY_MMAP;
     mVideoInfo->rb.count = num;
 
-    ret = ioctl(mCameraHandle, VIDIOC_REQBUFS, &mVideoInfo->rb);
+    ret = mDevice->ioctl(VIDIOC_REQBUFS, &mVideoInfo->rb);
     if (ret < 0) {
         CAMHAL_LOGEB("VIDIOC_REQBUFS failed: %s", strerror(errno));
         return ret;
@@ -276,18 +289,14 @@ status_t V4LCameraAdapter::UseBuffersPreview(void* bufArr, int num)
         mVideoInfo->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         mVideoInfo->buf.memory = V4L2_MEMORY_MMAP;
 
-        ret = ioctl (mCameraHandle, VIDIOC_QUERYBUF, &mVideoInfo->buf);
+        ret = mDevice->ioctl(VIDIOC_QUERYBUF, &mVideoInfo->buf);
         if (ret < 0) {
             CAMHAL_LOGEB("Unable to query buffer (%s)", strerror(errno));
             return ret;
         }
 
-        mVideoInfo->mem[i] = mmap (0,
-               mVideoInfo->buf.length,
-               PROT_READ | PROT_WRITE,
-               MAP_SHARED,
-               mCameraHandle,
-               mVideoInfo->buf.m.offset);
+        mVideoInfo->mem[i] = mDevice->mmap(mVideoInfo->buf.length,
+                                           mVideoInfo->buf.m.offset);
 
         if (mVideoInfo->mem[i] == MAP_FAILED) {
             CAMHAL_LOGEB("Unable to map buffer (%s)", strerror(errno));
@@ -324,7 +333,7 @@ status_t V4LCameraAdapter::startPreview()
        mVideoInfo->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
        mVideoInfo->buf.memory = V4L2_MEMORY_MMAP;
 
-       ret = ioctl(mCameraHandle, VIDIOC_QBUF, &mVideoInfo->buf);
+       ret = mDevice->ioctl(VIDIOC_QBUF, &mVideoInfo->buf);
        if (ret < 0) {
            CAMHAL_LOGEA("VIDIOC_QBUF Failed");
            return -EINVAL;
@@ -337,7 +346,7 @@ status_t V4LCameraAdapter::startPreview()
    if (!mVideoInfo->isStreaming) {
        bufType = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
-       ret = ioctl (mCameraHandle, VIDIOC_STREAMON, &bufType);
+       ret = mDevice->ioctl(VIDIOC_STREAMON, &bufType);
        if (ret < 0) {
            CAMHAL_LOGEB("StartStreaming: Unable to start capture: %s", strerror(errno));
            return ret;
@@ -346,15 +355,24 @@ status_t V4LCameraAdapter::startPreview()
        mVideoInfo->isStreaming = true;
    }
 
+   resetStats();
+
+   //reset frame rate estimates
+   mFPS = 0.0f;
+   mLastFPS = 0.0f;
+   mFrameCount = 0;
+   mLastFrameCount = 0;
+   mIter = 1;
+   mLastFPSTime = systemTime();
+
+   //Update the flag before the preview thread starts polling for frames
+   mPreviewing = true;
+
    // Create and start preview thread for receiving buffers from V4L Camera
    mPreviewThread = new PreviewThread(this);
 
    CAMHAL_LOGDA("Created preview thread");
 
-
-   //Update the flag to indicate we are previewing
-   mPreviewing = true;
-
    return ret;
 
 }
@@ -371,16 +389,27 @@ status_t V4LCameraAdapter::stopPreview()
         return NO_INIT;
         }
 
+    mPreviewing = false;
+
+    //Stop streaming first, this wakes up a preview thread waiting inside poll.
+    //The buffers stay mapped until the thread has exited.
     if (mVideoInfo->isStreaming) {
         bufType = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
-        ret = ioctl (mCameraHandle, VIDIOC_STREAMOFF, &bufType);
+        ret = mDevice->ioctl(VIDIOC_STREAMOFF, &bufType);
         if (ret < 0) {
             CAMHAL_LOGEB("StopStreaming: Unable to stop capture: %s", strerror(errno));
-            return ret;
+        } else {
+            mVideoInfo->isStreaming = false;
         }
+    }
+
+    //Even if STREAMOFF failed the thread wakes up at least every FRAME_POLL_TIMEOUT_MS
+    mPreviewThread->requestExitAndWait();
+    mPreviewThread.clear();
 
-        mVideoInfo->isStreaming = false;
+    if (ret < 0) {
+        return ret;
     }
 
     mVideoInfo->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -391,13 +420,17 @@ status_t V4LCameraAdapter::stopPreview()
 
     /* Unmap buffers */
     for (int i = 0; i < mPreviewBufferCount; i++)
-        if (munmap(mVideoInfo->mem[i], mVideoInfo->buf.length) < 0)
+        if (mDevice->munmap(mVideoInfo->mem[i], mVideoInfo->buf.length) < 0)
             CAMHAL_LOGEA("Unmap failed");
 
     mPreviewBufs.clear();
 
-    mPreviewThread->requestExitAndWait();
-    mPreviewThread.clear();
+    if ( mDebugFps )
+        {
+        String8 stats;
+        dumpStats(stats);
+        LOGD("V4L frame statistics:\n%s", stats.string());
+        }
 
     return ret;
 
@@ -406,21 +439,378 @@ status_t V4LCameraAdapter::stopPreview()
 char * V4LCameraAdapter::GetFrame(int &index)
 {
     int ret;
+    struct v4l2_buffer buf;
 
-    mVideoInfo->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    mVideoInfo->buf.memory = V4L2_MEMORY_MMAP;
+    index = -1;
+
+    //Don't block inside DQBUF, so that stop requests get serviced in time
+    ret = mDevice->poll(FRAME_POLL_TIMEOUT_MS);
+    if ( 0 == ret )
+        {
+        Mutex::Autolock lock(mStatsLock);
+        mPollTimeouts++;
+        return NULL;
+        }
+    else if ( 0 > ret )
+        {
+        //Expected once streaming is stopped, otherwise don't spin on a persistent error
+        if ( mPreviewing )
+            {
+            CAMHAL_LOGEB("GetFrame: poll failed: %s", strerror(errno));
+            usleep(FRAME_POLL_TIMEOUT_MS * 1000);
+            }
+        return NULL;
+        }
+
+    memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
 
     /* DQ */
-    ret = ioctl(mCameraHandle, VIDIOC_DQBUF, &mVideoInfo->buf);
+    ret = mDevice->ioctl(VIDIOC_DQBUF, &buf);
     if (ret < 0) {
-        CAMHAL_LOGEA("GetFrame: VIDIOC_DQBUF Failed");
+        if ( EAGAIN != errno )
+            {
+            CAMHAL_LOGEB("GetFrame: VIDIOC_DQBUF Failed: %s", strerror(errno));
+            }
         return NULL;
     }
     nDequeued++;
 
-    index = mVideoInfo->buf.index;
+    updateFrameStats(buf, systemTime(SYSTEM_TIME_MONOTONIC));
+
+    index = buf.index;
+
+    return (char *)mVideoInfo->mem[buf.index];
+}
+
+void V4LCameraAdapter::updateFrameStats(const struct v4l2_buffer &buf, nsecs_t dequeueTime)
+{
+    nsecs_t driverTime, interval, nominal;
+    int frameRate;
+
+    Mutex::Autolock lock(mStatsLock);
+
+    driverTime = s2ns( ( nsecs_t ) buf.timestamp.tv_sec ) + us2ns( ( nsecs_t ) buf.timestamp.tv_usec);
+
+    //Depending on the kernel version the driver stamps either with the
+    //monotonic or the wall clock, pick whichever is closer on the first frame
+    if ( 0 == mLastDequeueTime )
+        {
+        nsecs_t realtime = systemTime(SYSTEM_TIME_REALTIME);
+        mRealtimeTimestamps = ( llabs(realtime - driverTime) < llabs(dequeueTime - driverTime) );
+        }
+
+    if ( mRealtimeTimestamps )
+        {
+        mDriverLatency.add(systemTime(SYSTEM_TIME_REALTIME) - driverTime);
+        }
+    else
+        {
+        mDriverLatency.add(dequeueTime - driverTime);
+        }
+
+    frameRate = mParams.getPreviewFrameRate();
+    nominal = ( 0 < frameRate ) ? ( s2ns(1) / frameRate ) : 0;
+
+    if ( 0 != mLastDequeueTime )
+        {
+        interval = driverTime - mLastDriverTime;
+        mFrameInterval.add(interval);
+        mDequeueInterval.add(dequeueTime - mLastDequeueTime);
+
+        if ( 0 < nominal )
+            {
+            mIntervalJitter.add( ( interval > nominal ) ? ( interval - nominal ) : ( nominal - interval ) );
+            if ( interval > ( nominal + nominal / 2 ) )
+                {
+                mIntervalGaps++;
+                }
+            }
+
+        if ( buf.sequence > ( mLastSequence + 1 ) )
+            {
+            mSequenceGaps += buf.sequence - mLastSequence - 1;
+            }
+        }
+
+    mLastDriverTime = driverTime;
+    mLastDequeueTime = dequeueTime;
+    mLastSequence = buf.sequence;
+}
+
+void V4LCameraAdapter::resetStats()
+{
+    Mutex::Autolock lock(mStatsLock);
+
+    mDriverLatency.reset();
+    mFrameInterval.reset();
+    mDequeueInterval.reset();
+    mIntervalJitter.reset();
+    mLastDriverTime = 0;
+    mLastDequeueTime = 0;
+    mLastSequence = 0;
+    mSequenceGaps = 0;
+    mIntervalGaps = 0;
+    mPollTimeouts = 0;
+    mRealtimeTimestamps = false;
+    mStatisticsValid = false;
+    mAEAdjustments = 0;
+    mAWBAdjustments = 0;
+}
+
+void V4LCameraAdapter::dumpStats(String8 &out)
+{
+    BaseCameraAdapter::dumpStats(out);
+
+        {
+        Mutex::Autolock lock(mStatsLock);
+
+        out.appendFormat("v4l.fps=%.2f\n", mFPS);
+        out.appendFormat("v4l.queued=%d\n", nQueued);
+        out.appendFormat("v4l.dequeued=%d\n", nDequeued);
+        out.appendFormat("v4l.sequence_gaps=%u\n", mSequenceGaps);
+        out.appendFormat("v4l.interval_gaps=%u\n", mIntervalGaps);
+        out.appendFormat("v4l.poll_timeouts=%u\n", mPollTimeouts);
+
+        out.appendFormat("v4l.3a.period=%d\n", m3APeriod);
+        out.appendFormat("v4l.3a.ae=%d\n", mSoftAE);
+        out.appendFormat("v4l.3a.awb=%d\n", mSoftAWB);
+        out.appendFormat("v4l.3a.ae_adjustments=%u\n", mAEAdjustments);
+        out.appendFormat("v4l.3a.awb_adjustments=%u\n", mAWBAdjustments);
+        out.appendFormat("v4l.3a.exposure=%d\n", mExposureControl.mValue);
+        out.appendFormat("v4l.3a.gain=%d\n", mGainControl.mValue);
+        out.appendFormat("v4l.3a.red_balance=%d\n", mRedControl.mValue);
+        out.appendFormat("v4l.3a.blue_balance=%d\n", mBlueControl.mValue);
+        if ( mStatisticsValid )
+            {
+            out.appendFormat("v4l.3a.luma=%u\n", mStatistics.mMeanLuma);
+            out.appendFormat("v4l.3a.luma_p2=%u\n", FrameStatistics::percentile(mStatistics, 2));
+            out.appendFormat("v4l.3a.luma_p98=%u\n", FrameStatistics::percentile(mStatistics, 98));
+            out.appendFormat("v4l.3a.u=%u\n", mStatistics.mMeanU);
+            out.appendFormat("v4l.3a.v=%u\n", mStatistics.mMeanV);
+            out.appendFormat("v4l.3a.sharpness=%u\n", mStatistics.mSharpness);
+            }
+        }
+
+    //Sensor cadence, driver delivery and HAL dequeue cadence can be told apart
+    mDriverLatency.dump(out, "v4l.driver_latency");
+    mFrameInterval.dump(out, "v4l.frame_interval");
+    mDequeueInterval.dump(out, "v4l.dequeue_interval");
+    mIntervalJitter.dump(out, "v4l.interval_jitter");
+}
+
+void V4LCameraAdapter::queryControl(V4LControl &control, uint32_t id)
+{
+    struct v4l2_queryctrl query;
+    struct v4l2_control ctrl;
+
+    memset(&control, 0, sizeof(V4LControl));
+    control.mId = id;
+
+    memset(&query, 0, sizeof(query));
+    query.id = id;
+    if ( ( 0 > mDevice->ioctl(VIDIOC_QUERYCTRL, &query) ) ||
+         ( query.flags & V4L2_CTRL_FLAG_DISABLED ) )
+        {
+        return;
+        }
+
+    memset(&ctrl, 0, sizeof(ctrl));
+    ctrl.id = id;
+    if ( 0 > mDevice->ioctl(VIDIOC_G_CTRL, &ctrl) )
+        {
+        return;
+        }
+
+    control.mAvailable = true;
+    control.mMin = query.minimum;
+    control.mMax = query.maximum;
+    control.mValue = ctrl.value;
 
-    return (char *)mVideoInfo->mem[mVideoInfo->buf.index];
+    CAMHAL_LOGDB("Control 0x%x range [%d, %d] value %d", id, control.mMin, control.mMax, control.mValue);
+}
+
+status_t V4LCameraAdapter::setControl(V4LControl &control, int value)
+{
+    struct v4l2_control ctrl;
+
+    if ( !control.mAvailable )
+        {
+        return NO_INIT;
+        }
+
+    if ( value < control.mMin )
+        {
+        value = control.mMin;
+        }
+    else if ( value > control.mMax )
+        {
+        value = control.mMax;
+        }
+
+    if ( value == control.mValue )
+        {
+        return NO_ERROR;
+        }
+
+    memset(&ctrl, 0, sizeof(ctrl));
+    ctrl.id = control.mId;
+    ctrl.value = value;
+    if ( 0 > mDevice->ioctl(VIDIOC_S_CTRL, &ctrl) )
+        {
+        CAMHAL_LOGEB("Setting control 0x%x to %d failed: %s", control.mId, value, strerror(errno));
+        return -EINVAL;
+        }
+
+        {
+        Mutex::Autolock lock(mStatsLock);
+        control.mValue = value;
+        }
+
+    return NO_ERROR;
+}
+
+void V4LCameraAdapter::initSoftware3A()
+{
+    char value[PROPERTY_VALUE_MAX];
+    struct v4l2_queryctrl query;
+
+    LOG_FUNCTION_NAME
+
+    property_get("debug.camera.v4l.soft3a", value, "4");
+    m3APeriod = atoi(value);
+    m3AFrames = 0;
+
+    queryControl(mExposureControl, V4L2_CID_EXPOSURE_ABSOLUTE);
+    if ( !mExposureControl.mAvailable )
+        {
+        queryControl(mExposureControl, V4L2_CID_EXPOSURE);
+        }
+    queryControl(mGainControl, V4L2_CID_GAIN);
+    queryControl(mRedControl, V4L2_CID_RED_BALANCE);
+    queryControl(mBlueControl, V4L2_CID_BLUE_BALANCE);
+
+    ///Software AE and AWB only take over on sensors which don't run their own algorithms
+    memset(&query, 0, sizeof(query));
+    query.id = V4L2_CID_EXPOSURE_AUTO;
+    mSoftAE = ( 0 < m3APeriod ) &&
+              ( 0 > mDevice->ioctl(VIDIOC_QUERYCTRL, &query) ) &&
+              ( mExposureControl.mAvailable || mGainControl.mAvailable );
+
+    memset(&query, 0, sizeof(query));
+    query.id = V4L2_CID_AUTO_WHITE_BALANCE;
+    mSoftAWB = ( 0 < m3APeriod ) &&
+               ( 0 > mDevice->ioctl(VIDIOC_QUERYCTRL, &query) ) &&
+               ( mRedControl.mAvailable && mBlueControl.mAvailable );
+
+    CAMHAL_LOGDB("Software 3A period %d, AE %d, AWB %d", m3APeriod, mSoftAE, mSoftAWB);
+
+    LOG_FUNCTION_NAME_EXIT
+}
+
+void V4LCameraAdapter::runSoftware3A(const uint8_t *frame, int width, int height)
+{
+    FrameStatistics::Statistics stats;
+    status_t ret;
+    int mean, delta;
+    float ratio;
+
+    ///Sensor controls take a few frames to settle, so statistics are only collected periodically
+    if ( ( 0 >= m3APeriod ) || ( 0 != ( m3AFrames++ % m3APeriod ) ) )
+        {
+        return;
+        }
+
+    if ( NO_ERROR != mFrameStatistics.process(frame, FrameStatistics::LAYOUT_YUYV, width, height, width * 2, stats) )
+        {
+        return;
+        }
+
+    if ( mSoftAE )
+        {
+        mean = stats.mMeanLuma;
+
+        ///Clipped highlights pull the mean down, don't chase it into overexposure
+        if ( 250 <= FrameStatistics::percentile(stats, 98) )
+            {
+            mean += AE_TOLERANCE;
+            }
+
+        if ( abs(AE_TARGET_LUMA - mean) > AE_TOLERANCE )
+            {
+            ///Proportional step, limited to a factor of two per iteration
+            ratio = ( float ) AE_TARGET_LUMA / ( ( 0 < mean ) ? mean : 1 );
+            ratio = ( 0.5f > ratio ) ? 0.5f : ( ( 2.0f < ratio ) ? 2.0f : ratio );
+
+            if ( mean < AE_TARGET_LUMA )
+                {
+                //Longer exposure first, gain only once exposure is exhausted
+                if ( mExposureControl.mAvailable && ( mExposureControl.mValue < mExposureControl.mMax ) )
+                    {
+                    ret = setControl(mExposureControl, ( int ) ( mExposureControl.mValue * ratio ) + 1);
+                    }
+                else
+                    {
+                    ret = setControl(mGainControl, ( int ) ( mGainControl.mValue * ratio ) + 1);
+                    }
+                }
+            else
+                {
+                //Drop the gain first, it adds noise
+                if ( mGainControl.mAvailable && ( mGainControl.mValue > mGainControl.mMin ) )
+                    {
+                    ret = setControl(mGainControl, ( int ) ( mGainControl.mValue * ratio ));
+                    }
+                else
+                    {
+                    ret = setControl(mExposureControl, ( int ) ( mExposureControl.mValue * ratio ));
+                    }
+                }
+
+            ///Only count the adjustments that reached the sensor
+            if ( NO_ERROR == ret )
+                {
+                mAEAdjustments++;
+                }
+            }
+        }
+
+    ///Gray world AWB: drive the mean chroma towards neutral gray
+    if ( mSoftAWB )
+        {
+        if ( abs(128 - stats.mMeanV) > AWB_TOLERANCE )
+            {
+            delta = ( ( 128 - stats.mMeanV ) * ( mRedControl.mMax - mRedControl.mMin ) ) / 512;
+            if ( 0 == delta )
+                {
+                delta = ( 128 > stats.mMeanV ) ? 1 : -1;
+                }
+            if ( NO_ERROR == setControl(mRedControl, mRedControl.mValue + delta) )
+                {
+                mAWBAdjustments++;
+                }
+            }
+
+        if ( abs(128 - stats.mMeanU) > AWB_TOLERANCE )
+            {
+            delta = ( ( 128 - stats.mMeanU ) * ( mBlueControl.mMax - mBlueControl.mMin ) ) / 512;
+            if ( 0 == delta )
+                {
+                delta = ( 128 > stats.mMeanU ) ? 1 : -1;
+                }
+            if ( NO_ERROR == setControl(mBlueControl, mBlueControl.mValue + delta) )
+                {
+                mAWBAdjustments++;
+                }
+            }
+        }
+
+        {
+        Mutex::Autolock lock(mStatsLock);
+        mStatistics = stats;
+        mStatisticsValid = true;
+        }
 }
 
 status_t V4LCameraAdapter::setTimeOut(unsigned int sec)
@@ -509,7 +899,21 @@ V4LCameraAdapter::V4LCameraAdapter()
 {
     LOG_FUNCTION_NAME
 
-    // Nothing useful to do in the constructor
+    mDevice = NULL;
+    mVideoInfo = NULL;
+    mPreviewing = false;
+    nQueued = 0;
+    nDequeued = 0;
+    mFPS = 0;
+    m3APeriod = 0;
+    m3AFrames = 0;
+    mSoftAE = false;
+    mSoftAWB = false;
+    memset(&mExposureControl, 0, sizeof(V4LControl));
+    memset(&mGainControl, 0, sizeof(V4LControl));
+    memset(&mRedControl, 0, sizeof(V4LControl));
+    memset(&mBlueControl, 0, sizeof(V4LControl));
+    resetStats();
 
     LOG_FUNCTION_NAME_EXIT
 }
@@ -519,7 +923,12 @@ V4LCameraAdapter::~V4LCameraAdapter()
     LOG_FUNCTION_NAME
 
     // Close the camera handle and free the video info structure
-    close(mCameraHandle);
+    if ( NULL != mDevice )
+      {
+        mDevice->close();
+        delete mDevice;
+        mDevice = NULL;
+      }
 
     if (mVideoInfo)
       {
@@ -548,8 +957,16 @@ int V4LCameraAdapter::previewThread()
             return BAD_VALUE;
             }
 
+        if (UNLIKELY(mDebugFps)) {
+            debugShowFPS();
+        }
+
+        recalculateFPS();
+
         uint8_t* ptr = (uint8_t*) mPreviewBufs.keyAt(index);
 
+        FrameTrace::begin(ptr, FrameTrace::STREAM_PREVIEW);
+
         int width, height;
         uint16_t* dest = (uint16_t*)ptr;
         uint16_t* src = (uint16_t*) fp;
@@ -568,6 +985,8 @@ int V4LCameraAdapter::previewThread()
                 dest += 4096/2-width;
             }
 
+        runSoftware3A(( uint8_t * ) fp, width, height);
+
         mParams.getPreviewSize(&width, &height);
         frame.mFrameType = CameraFrame::PREVIEW_FRAME_SYNC;
         frame.mBuffer = ptr;
@@ -0,0 +1,806 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/**
+* @file V4LCaptureDevice.cpp
+*
+* This file implements the V4L2 device access used by V4LCameraAdapter, including
+* recording of a live frame stream and its replay without any capture hardware.
+*
+*/
+
+
+#include "CameraHal.h"
+#include "V4LCaptureDevice.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <malloc.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <poll.h>
+
+#include <cutils/properties.h>
+
+namespace android {
+
+#undef LOG_TAG
+#define LOG_TAG "V4LCameraAdapter"
+
+/*--------------------V4LCaptureDevice Class STARTS here-----------------------------*/
+
+V4LCaptureDevice::V4LCaptureDevice()
+{
+    mHandle = -1;
+}
+
+V4LCaptureDevice::~V4LCaptureDevice()
+{
+    close();
+}
+
+/**
+   @brief Creates the capture device selected by the system properties
+
+   debug.camera.v4l.replay      - path of a recorded stream, replaces the device node
+   debug.camera.v4l.replayspeed - replay speed multiplier, 0 = as fast as possible (default 1.0)
+   debug.camera.v4l.replayloop  - restart the stream once exhausted (default 1)
+   debug.camera.v4l.record      - path where the frame stream of the real device gets recorded
+
+   @return capture device or NULL if out of memory
+
+ */
+V4LCaptureDevice* V4LCaptureDevice::create()
+{
+    char value[PROPERTY_VALUE_MAX];
+    char speed[PROPERTY_VALUE_MAX];
+    char loop[PROPERTY_VALUE_MAX];
+
+    LOG_FUNCTION_NAME
+
+    property_get("debug.camera.v4l.replay", value, "");
+    if ( '\0' != value[0] )
+        {
+        property_get("debug.camera.v4l.replayspeed", speed, "1.0");
+        property_get("debug.camera.v4l.replayloop", loop, "1");
+
+        CAMHAL_LOGDB("Replaying V4L stream %s at speed %s", value, speed);
+
+        return new V4LReplayDevice(value, atof(speed), ( 0 != atoi(loop) ));
+        }
+
+    property_get("debug.camera.v4l.record", value, "");
+    if ( '\0' != value[0] )
+        {
+        CAMHAL_LOGDB("Recording V4L stream into %s", value);
+
+        return new V4LRecordDevice(value);
+        }
+
+    LOG_FUNCTION_NAME_EXIT
+
+    return new V4LCaptureDevice();
+}
+
+status_t V4LCaptureDevice::open(const char *device)
+{
+    if ( ( mHandle = ::open(device, O_RDWR) ) == -1 )
+        {
+        CAMHAL_LOGEB("Error while opening handle to V4L2 Camera: %s", strerror(errno));
+        return -EINVAL;
+        }
+
+    return NO_ERROR;
+}
+
+void V4LCaptureDevice::close()
+{
+    if ( 0 <= mHandle )
+        {
+        ::close(mHandle);
+        mHandle = -1;
+        }
+}
+
+int V4LCaptureDevice::ioctl(int request, void *arg)
+{
+    return ::ioctl(mHandle, request, arg);
+}
+
+void* V4LCaptureDevice::mmap(size_t length, off_t offset)
+{
+    return ::mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, mHandle, offset);
+}
+
+int V4LCaptureDevice::munmap(void *addr, size_t length)
+{
+    return ::munmap(addr, length);
+}
+
+int V4LCaptureDevice::poll(int timeoutMs)
+{
+    struct pollfd pfd;
+    int ret;
+
+    pfd.fd = mHandle;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    do
+        {
+        ret = ::poll(&pfd, 1, timeoutMs);
+        } while ( ( 0 > ret ) && ( EINTR == errno ) );
+
+    if ( 0 >= ret )
+        {
+        return ret;
+        }
+
+    //Streaming was stopped or the device was unplugged
+    if ( pfd.revents & ( POLLERR | POLLHUP | POLLNVAL ) )
+        {
+        errno = EIO;
+        return -1;
+        }
+
+    return 1;
+}
+
+/*--------------------V4LCaptureDevice Class ENDS here-----------------------------*/
+
+/*--------------------V4LRecordDevice Class STARTS here-----------------------------*/
+
+V4LRecordDevice::V4LRecordDevice(const char *path)
+{
+    strncpy(mPath, path, sizeof(mPath) - 1);
+    mPath[sizeof(mPath) - 1] = '\0';
+    mFile = -1;
+    mHeaderWritten = false;
+    mFramesRecorded = 0;
+    memset(&mFormat, 0, sizeof(mFormat));
+}
+
+V4LRecordDevice::~V4LRecordDevice()
+{
+    close();
+}
+
+status_t V4LRecordDevice::open(const char *device)
+{
+    status_t ret;
+
+    ret = V4LCaptureDevice::open(device);
+    if ( NO_ERROR != ret )
+        {
+        return ret;
+        }
+
+    mFile = ::open(mPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if ( 0 > mFile )
+        {
+        CAMHAL_LOGEB("Unable to create V4L stream file %s: %s", mPath, strerror(errno));
+        V4LCaptureDevice::close();
+        return -EINVAL;
+        }
+
+    mHeaderWritten = false;
+    mFramesRecorded = 0;
+
+    return NO_ERROR;
+}
+
+void V4LRecordDevice::close()
+{
+    if ( 0 <= mFile )
+        {
+        CAMHAL_LOGDB("Recorded %u frames into %s", mFramesRecorded, mPath);
+        ::close(mFile);
+        mFile = -1;
+        }
+
+    mBufferOffsets.clear();
+    mMappings.clear();
+
+    V4LCaptureDevice::close();
+}
+
+int V4LRecordDevice::ioctl(int request, void *arg)
+{
+    int ret;
+
+    ret = V4LCaptureDevice::ioctl(request, arg);
+    if ( ( 0 > ret ) || ( 0 > mFile ) )
+        {
+        return ret;
+        }
+
+    switch ( request )
+        {
+        case VIDIOC_S_FMT:
+            {
+            mFormat = ( ( struct v4l2_format * ) arg )->fmt.pix;
+            break;
+            }
+        case VIDIOC_QUERYBUF:
+            {
+            struct v4l2_buffer *buf = ( struct v4l2_buffer * ) arg;
+            mBufferOffsets.add(buf->index, buf->m.offset);
+            break;
+            }
+        case VIDIOC_STREAMON:
+            {
+            if ( !mHeaderWritten && ( NO_ERROR != writeHeader() ) )
+                {
+                ::close(mFile);
+                mFile = -1;
+                }
+            break;
+            }
+        case VIDIOC_DQBUF:
+            {
+            if ( NO_ERROR != writeFrame( ( struct v4l2_buffer * ) arg) )
+                {
+                //Don't fail the live preview because of the recording
+                CAMHAL_LOGEA("Recording stopped");
+                ::close(mFile);
+                mFile = -1;
+                }
+            break;
+            }
+        default:
+            break;
+        }
+
+    return ret;
+}
+
+void* V4LRecordDevice::mmap(size_t length, off_t offset)
+{
+    void *addr;
+
+    addr = V4LCaptureDevice::mmap(length, offset);
+    if ( MAP_FAILED != addr )
+        {
+        mMappings.add( ( unsigned int ) offset, addr);
+        }
+
+    return addr;
+}
+
+status_t V4LRecordDevice::writeHeader()
+{
+    V4LStreamHeader header;
+
+    header.mMagic = V4L_STREAM_MAGIC;
+    header.mVersion = V4L_STREAM_VERSION;
+    header.mWidth = mFormat.width;
+    header.mHeight = mFormat.height;
+    header.mPixelFormat = mFormat.pixelformat;
+    header.mFrameSize = mFormat.sizeimage;
+    if ( 0 == header.mFrameSize )
+        {
+        //Only packed YUV 4:2:2 is used by the adapter
+        header.mFrameSize = mFormat.width * mFormat.height * 2;
+        }
+
+    if ( sizeof(header) != ( size_t ) ::write(mFile, &header, sizeof(header)) )
+        {
+        CAMHAL_LOGEB("Unable to write V4L stream header: %s", strerror(errno));
+        return -EIO;
+        }
+
+    mHeaderWritten = true;
+
+    return NO_ERROR;
+}
+
+status_t V4LRecordDevice::writeFrame(const struct v4l2_buffer *buf)
+{
+    V4LStreamFrame frame;
+    ssize_t index;
+    void *data;
+
+    index = mBufferOffsets.indexOfKey(buf->index);
+    if ( 0 > index )
+        {
+        CAMHAL_LOGEB("Unknown V4L buffer index %d", buf->index);
+        return -EINVAL;
+        }
+
+    index = mMappings.indexOfKey(mBufferOffsets.valueAt(index));
+    if ( 0 > index )
+        {
+        CAMHAL_LOGEB("V4L buffer %d isn't mapped", buf->index);
+        return -EINVAL;
+        }
+
+    data = mMappings.valueAt(index);
+
+    frame.mTimestampUs = ( uint64_t ) buf->timestamp.tv_sec * 1000000 + buf->timestamp.tv_usec;
+    frame.mSequence = buf->sequence;
+    frame.mBytesUsed = buf->bytesused;
+
+    if ( ( sizeof(frame) != ( size_t ) ::write(mFile, &frame, sizeof(frame)) ) ||
+         ( frame.mBytesUsed != ( uint32_t ) ::write(mFile, data, frame.mBytesUsed) ) )
+        {
+        CAMHAL_LOGEB("Unable to write V4L stream frame: %s", strerror(errno));
+        return -EIO;
+        }
+
+    mFramesRecorded++;
+
+    return NO_ERROR;
+}
+
+/*--------------------V4LRecordDevice Class ENDS here-----------------------------*/
+
+/*--------------------V4LReplayDevice Class STARTS here-----------------------------*/
+
+V4LReplayDevice::V4LReplayDevice(const char *path, float speed, bool loop)
+{
+    strncpy(mPath, path, sizeof(mPath) - 1);
+    mPath[sizeof(mPath) - 1] = '\0';
+    mSpeed = ( 0 > speed ) ? 0 : speed;
+    mLoop = loop;
+    mFile = -1;
+    mFirstFrameOffset = 0;
+    mBufferLength = 0;
+    mStreaming = false;
+    mReplayStart = 0;
+    mStreamStartUs = 0;
+    mSequence = 0;
+    memset(&mHeader, 0, sizeof(mHeader));
+}
+
+V4LReplayDevice::~V4LReplayDevice()
+{
+    close();
+}
+
+status_t V4LReplayDevice::open(const char *device)
+{
+    LOG_FUNCTION_NAME
+
+    //The device node is replaced by the recorded stream
+    mFile = ::open(mPath, O_RDONLY);
+    if ( 0 > mFile )
+        {
+        CAMHAL_LOGEB("Unable to open V4L stream file %s: %s", mPath, strerror(errno));
+        return -EINVAL;
+        }
+
+    if ( ( sizeof(mHeader) != ( size_t ) ::read(mFile, &mHeader, sizeof(mHeader)) ) ||
+         ( V4L_STREAM_MAGIC != mHeader.mMagic ) ||
+         ( V4L_STREAM_VERSION != mHeader.mVersion ) )
+        {
+        CAMHAL_LOGEB("%s is not a valid V4L stream file", mPath);
+        ::close(mFile);
+        mFile = -1;
+        return -EINVAL;
+        }
+
+    mFirstFrameOffset = sizeof(mHeader);
+
+    CAMHAL_LOGDB("Replaying %dx%d 0x%x stream from %s",
+                 mHeader.mWidth,
+                 mHeader.mHeight,
+                 mHeader.mPixelFormat,
+                 mPath);
+
+    LOG_FUNCTION_NAME_EXIT
+
+    return NO_ERROR;
+}
+
+void V4LReplayDevice::close()
+{
+        {
+        Mutex::Autolock lock(mLock);
+        mStreaming = false;
+        mQueuedBuffers.clear();
+        mCondition.broadcast();
+        }
+
+    freeBuffers();
+
+    if ( 0 <= mFile )
+        {
+        ::close(mFile);
+        mFile = -1;
+        }
+}
+
+int V4LReplayDevice::ioctl(int request, void *arg)
+{
+    int ret = 0;
+
+    if ( 0 > mFile )
+        {
+        errno = EBADF;
+        return -1;
+        }
+
+    switch ( request )
+        {
+        case VIDIOC_QUERYCAP:
+            {
+            struct v4l2_capability *cap = ( struct v4l2_capability * ) arg;
+
+            memset(cap, 0, sizeof(*cap));
+            strncpy( ( char * ) cap->driver, "v4l-replay", sizeof(cap->driver) - 1);
+            strncpy( ( char * ) cap->card, mPath, sizeof(cap->card) - 1);
+            cap->capabilities = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING;
+            break;
+            }
+        case VIDIOC_G_FMT:
+        case VIDIOC_S_FMT:
+            {
+            struct v4l2_format *format = ( struct v4l2_format * ) arg;
+
+            //The recorded stream can't be rescaled
+            if ( ( VIDIOC_S_FMT == request ) &&
+                 ( ( format->fmt.pix.width != mHeader.mWidth ) ||
+                   ( format->fmt.pix.height != mHeader.mHeight ) ||
+                   ( format->fmt.pix.pixelformat != mHeader.mPixelFormat ) ) )
+                {
+                CAMHAL_LOGEB("Requested format %dx%d 0x%x doesn't match the recorded %dx%d 0x%x",
+                             format->fmt.pix.width,
+                             format->fmt.pix.height,
+                             format->fmt.pix.pixelformat,
+                             mHeader.mWidth,
+                             mHeader.mHeight,
+                             mHeader.mPixelFormat);
+                errno = EINVAL;
+                ret = -1;
+                break;
+                }
+
+            format->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            format->fmt.pix.width = mHeader.mWidth;
+            format->fmt.pix.height = mHeader.mHeight;
+            format->fmt.pix.pixelformat = mHeader.mPixelFormat;
+            format->fmt.pix.field = V4L2_FIELD_NONE;
+            format->fmt.pix.bytesperline = mHeader.mWidth * 2;
+            format->fmt.pix.sizeimage = mHeader.mFrameSize;
+            break;
+            }
+        case VIDIOC_REQBUFS:
+            {
+            struct v4l2_requestbuffers *rb = ( struct v4l2_requestbuffers * ) arg;
+
+            if ( V4L2_MEMORY_MMAP != rb->memory )
+                {
+                errno = EINVAL;
+                ret = -1;
+                break;
+                }
+
+            freeBuffers();
+            if ( ( 0 < rb->count ) && ( NO_ERROR != allocateBuffers(rb->count) ) )
+                {
+                errno = ENOMEM;
+                ret = -1;
+                }
+            break;
+            }
+        case VIDIOC_QUERYBUF:
+            {
+            struct v4l2_buffer *buf = ( struct v4l2_buffer * ) arg;
+
+            if ( buf->index >= mBuffers.size() )
+                {
+                errno = EINVAL;
+                ret = -1;
+                break;
+                }
+
+            buf->length = mBufferLength;
+            buf->m.offset = buf->index * mBufferLength;
+            buf->bytesused = 0;
+            buf->flags = V4L2_BUF_FLAG_MAPPED;
+            break;
+            }
+        case VIDIOC_QBUF:
+            {
+            struct v4l2_buffer *buf = ( struct v4l2_buffer * ) arg;
+            Mutex::Autolock lock(mLock);
+
+            if ( buf->index >= mBuffers.size() )
+                {
+                errno = EINVAL;
+                ret = -1;
+                break;
+                }
+
+            mQueuedBuffers.push(buf->index);
+            mCondition.signal();
+            break;
+            }
+        case VIDIOC_DQBUF:
+            {
+            ret = dequeueBuffer( ( struct v4l2_buffer * ) arg);
+            break;
+            }
+        case VIDIOC_STREAMON:
+            {
+            Mutex::Autolock lock(mLock);
+
+            mStreaming = true;
+            mReplayStart = 0;
+            break;
+            }
+        case VIDIOC_STREAMOFF:
+            {
+            Mutex::Autolock lock(mLock);
+
+            mStreaming = false;
+            mQueuedBuffers.clear();
+            mCondition.broadcast();
+            break;
+            }
+        default:
+            {
+            CAMHAL_LOGEB("Unsupported V4L replay request 0x%x", request);
+            errno = EINVAL;
+            ret = -1;
+            break;
+            }
+        }
+
+    return ret;
+}
+
+void* V4LReplayDevice::mmap(size_t length, off_t offset)
+{
+    unsigned int index;
+
+    if ( 0 == mBufferLength )
+        {
+        return MAP_FAILED;
+        }
+
+    index = offset / mBufferLength;
+    if ( ( index >= mBuffers.size() ) || ( length > mBufferLength ) )
+        {
+        return MAP_FAILED;
+        }
+
+    return mBuffers[index];
+}
+
+int V4LReplayDevice::munmap(void *addr, size_t length)
+{
+    //Buffers stay allocated until the next REQBUFS or close
+    return 0;
+}
+
+int V4LReplayDevice::poll(int timeoutMs)
+{
+    nsecs_t deadline;
+    nsecs_t wakeup;
+    nsecs_t now;
+    nsecs_t due;
+
+    Mutex::Autolock lock(mLock);
+
+    deadline = systemTime(SYSTEM_TIME_MONOTONIC) + ms2ns(timeoutMs);
+
+    //Ready only once a buffer is queued and the next frame is due, so that DQBUF never waits
+    while ( mStreaming )
+        {
+        now = systemTime(SYSTEM_TIME_MONOTONIC);
+        wakeup = ( 0 > timeoutMs ) ? 0 : deadline;
+
+        if ( !mQueuedBuffers.isEmpty() && ( NO_ERROR == nextFrameDue(due) ) )
+            {
+            if ( due <= now )
+                {
+                return 1;
+                }
+
+            if ( ( 0 == wakeup ) || ( due < wakeup ) )
+                {
+                wakeup = due;
+                }
+            }
+
+        //An exhausted stream behaves like a sensor which stopped producing frames
+        if ( 0 == wakeup )
+            {
+            mCondition.wait(mLock);
+            continue;
+            }
+
+        if ( ( 0 <= timeoutMs ) && ( now >= deadline ) )
+            {
+            return 0;
+            }
+
+        mCondition.waitRelative(mLock, wakeup - now);
+        }
+
+    errno = EIO;
+    return -1;
+}
+
+status_t V4LReplayDevice::allocateBuffers(unsigned int count)
+{
+    void *buffer;
+
+    mBufferLength = ( mHeader.mFrameSize + ( PAGE_SIZE - 1 ) ) & ( ~ ( PAGE_SIZE - 1 ) );
+
+    for ( unsigned int i = 0 ; i < count ; i++ )
+        {
+        buffer = memalign(PAGE_SIZE, mBufferLength);
+        if ( NULL == buffer )
+            {
+            CAMHAL_LOGEA("Not enough memory for the replay buffers");
+            freeBuffers();
+            return NO_MEMORY;
+            }
+
+        mBuffers.push(buffer);
+        }
+
+    return NO_ERROR;
+}
+
+void V4LReplayDevice::freeBuffers()
+{
+    Mutex::Autolock lock(mLock);
+
+    for ( unsigned int i = 0 ; i < mBuffers.size() ; i++ )
+        {
+        free(mBuffers[i]);
+        }
+
+    mBuffers.clear();
+    mQueuedBuffers.clear();
+}
+
+status_t V4LReplayDevice::peekFrame(V4LStreamFrame &frame)
+{
+    if ( sizeof(frame) != ( size_t ) ::read(mFile, &frame, sizeof(frame)) )
+        {
+        return NOT_ENOUGH_DATA;
+        }
+
+    lseek(mFile, - ( off_t ) sizeof(frame), SEEK_CUR);
+
+    return NO_ERROR;
+}
+
+status_t V4LReplayDevice::nextFrameDue(nsecs_t &due)
+{
+    V4LStreamFrame frame;
+    status_t ret;
+
+    ret = peekFrame(frame);
+    if ( ( NO_ERROR != ret ) && mLoop )
+        {
+        lseek(mFile, mFirstFrameOffset, SEEK_SET);
+        mReplayStart = 0;
+        ret = peekFrame(frame);
+        }
+
+    if ( NO_ERROR != ret )
+        {
+        return ret;
+        }
+
+    if ( 0 == mReplayStart )
+        {
+        mReplayStart = systemTime(SYSTEM_TIME_MONOTONIC);
+        mStreamStartUs = frame.mTimestampUs;
+        }
+
+    //Reproduce the recorded inter frame timing
+    due = mReplayStart;
+    if ( 0 < mSpeed )
+        {
+        due += ( nsecs_t ) ( us2ns(frame.mTimestampUs - mStreamStartUs) / mSpeed );
+        }
+
+    return NO_ERROR;
+}
+
+status_t V4LReplayDevice::readFrame(V4LStreamFrame &frame, void *data)
+{
+    uint32_t length;
+
+    if ( sizeof(frame) != ( size_t ) ::read(mFile, &frame, sizeof(frame)) )
+        {
+        return NOT_ENOUGH_DATA;
+        }
+
+    length = ( frame.mBytesUsed < mBufferLength ) ? frame.mBytesUsed : mBufferLength;
+    if ( length != ( uint32_t ) ::read(mFile, data, length) )
+        {
+        //Truncated last frame, nothing after it can be replayed
+        lseek(mFile, 0, SEEK_END);
+        return NOT_ENOUGH_DATA;
+        }
+
+    //Skip anything that doesn't fit inside the replay buffers
+    if ( length < frame.mBytesUsed )
+        {
+        lseek(mFile, frame.mBytesUsed - length, SEEK_CUR);
+        }
+
+    frame.mBytesUsed = length;
+
+    return NO_ERROR;
+}
+
+int V4LReplayDevice::dequeueBuffer(struct v4l2_buffer *buf)
+{
+    V4LStreamFrame frame;
+    unsigned int index;
+    nsecs_t now, due;
+
+    Mutex::Autolock lock(mLock);
+
+    if ( !mStreaming )
+        {
+        errno = EINVAL;
+        return -1;
+        }
+
+    //Like a non blocking driver, fail instead of waiting for a buffer, a
+    //frame which isn't due yet or the end of the stream. poll() does the waiting.
+    if ( mQueuedBuffers.isEmpty() || ( NO_ERROR != nextFrameDue(due) ) ||
+         ( due > systemTime(SYSTEM_TIME_MONOTONIC) ) )
+        {
+        errno = EAGAIN;
+        return -1;
+        }
+
+    index = mQueuedBuffers[0];
+
+    if ( NO_ERROR != readFrame(frame, mBuffers[index]) )
+        {
+        CAMHAL_LOGDA("V4L replay stream exhausted");
+        errno = EAGAIN;
+        return -1;
+        }
+
+    mQueuedBuffers.removeAt(0);
+
+    now = systemTime(SYSTEM_TIME_MONOTONIC);
+    buf->index = index;
+    buf->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf->memory = V4L2_MEMORY_MMAP;
+    buf->bytesused = frame.mBytesUsed;
+    buf->length = mBufferLength;
+    buf->m.offset = index * mBufferLength;
+    buf->field = V4L2_FIELD_NONE;
+    buf->flags = V4L2_BUF_FLAG_MAPPED | V4L2_BUF_FLAG_DONE;
+    buf->sequence = mSequence++;
+    buf->timestamp.tv_sec = ns2s(now);
+    buf->timestamp.tv_usec = ns2us(now) % 1000000;
+
+    return 0;
+}
+
+/*--------------------V4LReplayDevice Class ENDS here-----------------------------*/
+
+};
@@ -33,6 +33,10 @@ LOCAL_CFLAGS += -fpic -fstrict-aliasing
 
 LOCAL_SRC_FILES+= \
         SkImageDecoder_libtijpeg.cpp \
+        JpegHeaderParser.cpp \
+        JpegTileIndex.cpp \
+        JpegDecoderSession.cpp \
+        JpegDecoderPool.cpp \
         SkAllocator.cpp \
         SkMemory.cpp \
 
@@ -43,6 +47,82 @@ include $(BUILD_SHARED_LIBRARY)
 
 ################################################
 
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        JpegHeaderParserTest.cpp \
+        JpegHeaderParser.cpp \
+
+LOCAL_CFLAGS += -O2
+
+LOCAL_MODULE := JpegHeaderParserTest
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        JpegTileIndexTest.cpp \
+        JpegTileIndex.cpp \
+        JpegHeaderParser.cpp \
+
+LOCAL_CFLAGS += -O2
+
+LOCAL_MODULE := JpegTileIndexTest
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        JpegDecoderPoolTest.cpp \
+        JpegDecoderSession.cpp \
+        JpegDecoderPool.cpp \
+
+LOCAL_C_INCLUDES += \
+        hardware/ti/omx/ducati/domx/system/omx_core/inc \
+        $(OMX_VENDOR_INCLUDES)
+
+LOCAL_CFLAGS += -O2
+
+LOCAL_LDLIBS += -lpthread
+
+LOCAL_MODULE := JpegDecoderPoolTest
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+################################################
+
+# Links the libjpeg of the build host, external/jpeg is only built for the target
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        JpegScaledDecodeTest.cpp \
+
+LOCAL_C_INCLUDES += \
+        hardware/ti/omx/ducati/domx/system/omx_core/inc \
+        $(OMX_VENDOR_INCLUDES)
+
+LOCAL_CFLAGS += -O2
+
+LOCAL_LDLIBS += -ljpeg -lm
+
+LOCAL_MODULE := JpegScaledDecodeTest
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
 endif
 endif
 
@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#define LOG_TAG "JpegDecoderPool"
+#include <utils/Log.h>
+
+#include "JpegDecoderPool.h"
+
+static void deadline(struct timespec* ts, int64_t ms)
+{
+    clock_gettime(CLOCK_REALTIME, ts);
+    ms += ts->tv_nsec / 1000000;
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec = ( ts->tv_nsec % 1000000 ) + ( ms % 1000 ) * 1000000;
+}
+
+JpegDecoderPool::JpegDecoderPool(int maxSessions, int idleTimeoutMs)
+{
+    memset(mEntries, 0, sizeof(mEntries));
+
+    if ( ( maxSessions < 1 ) || ( maxSessions > MAX_SESSIONS ) )
+        maxSessions = MAX_SESSIONS;
+    mMaxSessions = maxSessions;
+    mIdleTimeoutMs = idleTimeoutMs;
+    mOpening = 0;
+
+    pthread_mutex_init(&mLock, NULL);
+    pthread_cond_init(&mReleased, NULL);
+    pthread_cond_init(&mReaperWake, NULL);
+    mReaperRunning = false;
+    mExit = false;
+}
+
+JpegDecoderPool::~JpegDecoderPool()
+{
+    pthread_mutex_lock(&mLock);
+    mExit = true;
+    pthread_cond_broadcast(&mReleased);
+    pthread_cond_signal(&mReaperWake);
+    pthread_mutex_unlock(&mLock);
+
+    if ( mReaperRunning )
+        pthread_join(mReaper, NULL);
+
+    for ( int i = 0; i < MAX_SESSIONS; i++ ) {
+        if ( NULL != mEntries[i].session )
+            closeSession(mEntries[i].session);
+    }
+
+    pthread_cond_destroy(&mReaperWake);
+    pthread_cond_destroy(&mReleased);
+    pthread_mutex_destroy(&mLock);
+}
+
+int64_t JpegDecoderPool::now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void JpegDecoderPool::closeSession(JpegDecoderSession* session)
+{
+    session->close();
+    delete session;
+}
+
+JpegDecoderSession* JpegDecoderPool::lease(const JpegDecoderSession::Config& config)
+{
+    JpegDecoderSession* session = NULL;
+    struct timespec ts;
+    int count, idle, free;
+
+    deadline(&ts, LEASE_TIMEOUT_MS);
+
+    pthread_mutex_lock(&mLock);
+
+    while ( !mExit ) {
+        count = 0;
+        idle = -1;
+        free = -1;
+
+        for ( int i = 0; i < mMaxSessions; i++ ) {
+            if ( NULL == mEntries[i].session ) {
+                free = i;
+                continue;
+            }
+
+            count++;
+            if ( mEntries[i].busy )
+                continue;
+
+            if ( mEntries[i].session->isConfiguredFor(config) ) {
+                idle = i;
+                break;
+            }
+            if ( -1 == idle )
+                idle = i;
+        }
+
+        if ( ( -1 != idle ) && mEntries[idle].session->isConfiguredFor(config) ) {
+            mEntries[idle].busy = true;
+            session = mEntries[idle].session;
+            break;
+        }
+
+        if ( ( -1 != free ) && ( count + mOpening < mMaxSessions ) ) {
+            // GetHandle is slow, let the other leases go on meanwhile
+            mOpening++;
+            pthread_mutex_unlock(&mLock);
+
+            session = new JpegDecoderSession();
+            if ( !session->open() ) {
+                delete session;
+                session = NULL;
+            }
+
+            pthread_mutex_lock(&mLock);
+            mOpening--;
+
+            if ( NULL != session ) {
+                for ( free = 0; NULL != mEntries[free].session; free++ )
+                    ;
+                mEntries[free].session = session;
+                mEntries[free].busy = true;
+            } else {
+                pthread_cond_signal(&mReleased);
+            }
+            break;
+        }
+
+        if ( -1 != idle ) {
+            // Gets reconfigured by prepare()
+            mEntries[idle].busy = true;
+            session = mEntries[idle].session;
+            break;
+        }
+
+        if ( ETIMEDOUT == pthread_cond_timedwait(&mReleased, &mLock, &ts) ) {
+            LOGD("No decoder session available");
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&mLock);
+
+    return session;
+}
+
+void JpegDecoderPool::release(JpegDecoderSession* session)
+{
+    bool broken = session->isBroken();
+
+    pthread_mutex_lock(&mLock);
+
+    for ( int i = 0; i < mMaxSessions; i++ ) {
+        if ( session != mEntries[i].session )
+            continue;
+
+        if ( broken ) {
+            mEntries[i].session = NULL;
+        } else {
+            mEntries[i].busy = false;
+            mEntries[i].idleSince = now();
+        }
+        break;
+    }
+
+    if ( !broken && !mReaperRunning && !mExit )
+        mReaperRunning = ( 0 == pthread_create(&mReaper, NULL, reaperThread, this) );
+
+    pthread_cond_signal(&mReleased);
+    pthread_cond_signal(&mReaperWake);
+    pthread_mutex_unlock(&mLock);
+
+    if ( broken ) {
+        LOGE("Closing broken decoder session");
+        closeSession(session);
+    }
+}
+
+void JpegDecoderPool::trim()
+{
+    JpegDecoderSession* idle[MAX_SESSIONS];
+    int count = 0;
+
+    pthread_mutex_lock(&mLock);
+    for ( int i = 0; i < mMaxSessions; i++ ) {
+        if ( ( NULL != mEntries[i].session ) && !mEntries[i].busy ) {
+            idle[count++] = mEntries[i].session;
+            mEntries[i].session = NULL;
+        }
+    }
+    pthread_cond_signal(&mReleased);
+    pthread_mutex_unlock(&mLock);
+
+    for ( int i = 0; i < count; i++ )
+        closeSession(idle[i]);
+}
+
+int JpegDecoderPool::sessions()
+{
+    int count = 0;
+
+    pthread_mutex_lock(&mLock);
+    for ( int i = 0; i < mMaxSessions; i++ ) {
+        if ( NULL != mEntries[i].session )
+            count++;
+    }
+    pthread_mutex_unlock(&mLock);
+
+    return count;
+}
+
+int JpegDecoderPool::idleSessions()
+{
+    int count = 0;
+
+    pthread_mutex_lock(&mLock);
+    for ( int i = 0; i < mMaxSessions; i++ ) {
+        if ( ( NULL != mEntries[i].session ) && !mEntries[i].busy )
+            count++;
+    }
+    pthread_mutex_unlock(&mLock);
+
+    return count;
+}
+
+void* JpegDecoderPool::reaperThread(void* pool)
+{
+    ((JpegDecoderPool*) pool)->reap();
+
+    return NULL;
+}
+
+void JpegDecoderPool::reap()
+{
+    JpegDecoderSession* expired;
+    struct timespec ts;
+    int64_t oldest, time;
+
+    pthread_mutex_lock(&mLock);
+
+    while ( !mExit ) {
+        expired = NULL;
+        oldest = -1;
+        time = now();
+
+        for ( int i = 0; i < mMaxSessions; i++ ) {
+            if ( ( NULL == mEntries[i].session ) || mEntries[i].busy )
+                continue;
+
+            if ( time - mEntries[i].idleSince >= mIdleTimeoutMs ) {
+                expired = mEntries[i].session;
+                mEntries[i].session = NULL;
+                break;
+            }
+            if ( ( -1 == oldest ) || ( mEntries[i].idleSince < oldest ) )
+                oldest = mEntries[i].idleSince;
+        }
+
+        if ( NULL != expired ) {
+            // Closing goes through the OMX state transitions, don't hold up leases
+            pthread_cond_signal(&mReleased);
+            pthread_mutex_unlock(&mLock);
+            LOGD("Closing idle decoder session");
+            closeSession(expired);
+            pthread_mutex_lock(&mLock);
+        } else if ( -1 == oldest ) {
+            pthread_cond_wait(&mReaperWake, &mLock);
+        } else {
+            deadline(&ts, oldest + mIdleTimeoutMs - time);
+            pthread_cond_timedwait(&mReaperWake, &mLock, &ts);
+        }
+    }
+
+    pthread_mutex_unlock(&mLock);
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef JpegDecoderPool_DEFINED
+#define JpegDecoderPool_DEFINED
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "JpegDecoderSession.h"
+
+/** Process wide set of warm decoder sessions, each one is leased for a
+    single decode. A lease prefers an idle session already configured for
+    the geometry, then opens a new one while under maxSessions, and only
+    then reconfigures an idle one. When every session is busy it waits for
+    one to come back, up to LEASE_TIMEOUT_MS.
+    Sessions idle for idleTimeoutMs are closed by a reaper thread, started
+    with the first release, so the Ducati resources aren't held forever.
+    An idle session holds the component and its input buffer, a file size
+    rounded up to INPUT_BUFFER_ALIGN. No output memory, the output is always
+    the bitmap of the caller.
+*/
+class JpegDecoderPool {
+public:
+    enum {
+        MAX_SESSIONS = 2,
+        IDLE_TIMEOUT_MS = 10000,
+        LEASE_TIMEOUT_MS = 2000,
+    };
+
+    JpegDecoderPool(int maxSessions = MAX_SESSIONS, int idleTimeoutMs = IDLE_TIMEOUT_MS);
+    ~JpegDecoderPool();
+
+    /** NULL when no session could be had, the caller decodes on the ARM then */
+    JpegDecoderSession* lease(const JpegDecoderSession::Config& config);
+    /** A broken session is closed instead of going back to the pool */
+    void release(JpegDecoderSession* session);
+    /** Closes every idle session */
+    void trim();
+
+    int sessions();
+    int idleSessions();
+
+private:
+    struct Entry {
+        JpegDecoderSession* session;
+        bool busy;
+        int64_t idleSince;
+    };
+
+    static void* reaperThread(void* pool);
+    void reap();
+    void closeSession(JpegDecoderSession* session);
+    static int64_t now();
+
+    Entry mEntries[MAX_SESSIONS];
+    int mMaxSessions;
+    int mIdleTimeoutMs;
+    int mOpening;                   // sessions being opened outside of mLock
+
+    pthread_mutex_t mLock;
+    pthread_cond_t mReleased;
+    pthread_cond_t mReaperWake;
+    pthread_t mReaper;
+    bool mReaperRunning;
+    bool mExit;
+};
+
+#endif
@@ -0,0 +1,759 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Host test of JpegDecoderPool and JpegDecoderSession against a mock OMX
+ * core. The mock component enforces the state machine (enabled ports
+ * populated before Idle, unpopulated before Loaded, port definitions only in
+ * Loaded, output port enable/disable with its buffer), delivers its
+ * callbacks from its own thread and "decodes" by filling the output with a
+ * checksum of the input.
+ *
+ * Usage: JpegDecoderPoolTest
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "JpegDecoderPool.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { if ( !(cond) ) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while ( 0 )
+
+/* ---------------------------------------------------------------- mock OMX core */
+
+struct MockEvent {
+    int type;                       // 0 event, 1 empty done, 2 fill done
+    OMX_EVENTTYPE event;
+    OMX_U32 data1, data2;
+    OMX_BUFFERHEADERTYPE* buffer;
+};
+
+struct MockComponent {
+    OMX_COMPONENTTYPE omx;          // first, the handle points here
+    OMX_CALLBACKTYPE callbacks;
+    OMX_PTR appData;
+    OMX_STATETYPE state;
+    OMX_STATETYPE pending;          // transition waiting for the ports
+    OMX_PARAM_PORTDEFINITIONTYPE ports[2];
+    OMX_S32 xScale;                 // of the output, Q16
+    OMX_BUFFERHEADERTYPE* buffers[2];
+    bool owned[2];                  // allocated by the component, not by the client
+    bool enabled[2];
+    bool enabling, disabling;       // output port command waiting for its buffer
+    OMX_BUFFERHEADERTYPE* queuedIn;
+    OMX_BUFFERHEADERTYPE* queuedOut;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    MockEvent events[16];
+    int head, tail;
+    bool exit;
+    pthread_t thread;
+};
+
+static pthread_mutex_t gMockLock = PTHREAD_MUTEX_INITIALIZER;
+static int gInitCount = 0;
+static int gHandles = 0;
+static int gHandlesOpened = 0;
+static int gPortDefinitions = 0;
+static int gDecodes = 0;
+static int gFailNextDecode = 0;
+static int gDecodeDelayUs = 0;
+static int gStateViolations = 0;
+static int gLastScale = 0;
+static int gComponentBytes = 0;    // held in buffers allocated by the components
+static OMX_U8* gLastOutput = NULL;
+
+static int mockCount(int* counter)
+{
+    int count;
+
+    pthread_mutex_lock(&gMockLock);
+    count = *counter;
+    pthread_mutex_unlock(&gMockLock);
+
+    return count;
+}
+
+static void mockViolation()
+{
+    pthread_mutex_lock(&gMockLock);
+    gStateViolations++;
+    pthread_mutex_unlock(&gMockLock);
+}
+
+static void mockPost(MockComponent* c, int type, OMX_EVENTTYPE event, OMX_U32 data1, OMX_U32 data2, OMX_BUFFERHEADERTYPE* buffer)
+{
+    pthread_mutex_lock(&c->lock);
+    MockEvent* e = &c->events[c->tail % 16];
+    e->type = type;
+    e->event = event;
+    e->data1 = data1;
+    e->data2 = data2;
+    e->buffer = buffer;
+    c->tail++;
+    pthread_cond_signal(&c->cond);
+    pthread_mutex_unlock(&c->lock);
+}
+
+static void* mockThread(void* arg)
+{
+    MockComponent* c = (MockComponent*) arg;
+
+    pthread_mutex_lock(&c->lock);
+    for ( ;; ) {
+        while ( ( c->head == c->tail ) && !c->exit )
+            pthread_cond_wait(&c->cond, &c->lock);
+        if ( c->head == c->tail )
+            break;
+
+        MockEvent e = c->events[c->head % 16];
+        c->head++;
+        pthread_mutex_unlock(&c->lock);
+
+        if ( 0 == e.type )
+            c->callbacks.EventHandler(c, c->appData, e.event, e.data1, e.data2, NULL);
+        else if ( 1 == e.type )
+            c->callbacks.EmptyBufferDone(c, c->appData, e.buffer);
+        else
+            c->callbacks.FillBufferDone(c, c->appData, e.buffer);
+
+        pthread_mutex_lock(&c->lock);
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    return NULL;
+}
+
+static void mockCheckTransition(MockComponent* c)
+{
+    bool populated = ( ( NULL != c->buffers[0] ) || !c->enabled[0] ) && ( ( NULL != c->buffers[1] ) || !c->enabled[1] );
+    bool empty = ( NULL == c->buffers[0] ) && ( NULL == c->buffers[1] );
+
+    if ( ( ( OMX_StateIdle == c->pending ) && populated ) || ( ( OMX_StateLoaded == c->pending ) && empty ) ) {
+        c->state = c->pending;
+        c->pending = OMX_StateInvalid;
+        mockPost(c, 0, OMX_EventCmdComplete, OMX_CommandStateSet, c->state, NULL);
+    }
+
+    if ( c->enabling && ( NULL != c->buffers[1] ) ) {
+        c->enabling = false;
+        c->enabled[1] = true;
+        mockPost(c, 0, OMX_EventCmdComplete, OMX_CommandPortEnable, 1, NULL);
+    }
+
+    if ( c->disabling && ( NULL == c->buffers[1] ) ) {
+        c->disabling = false;
+        mockPost(c, 0, OMX_EventCmdComplete, OMX_CommandPortDisable, 1, NULL);
+    }
+}
+
+static void mockDecode(MockComponent* c)
+{
+    OMX_BUFFERHEADERTYPE* in = c->queuedIn;
+    OMX_BUFFERHEADERTYPE* out = c->queuedOut;
+    OMX_U8 sum = 0;
+
+    c->queuedIn = NULL;
+    c->queuedOut = NULL;
+
+    if ( gDecodeDelayUs )
+        usleep(gDecodeDelayUs);
+
+    pthread_mutex_lock(&gMockLock);
+    gDecodes++;
+    gLastScale = c->xScale;
+    gLastOutput = out->pBuffer;
+    bool fail = gFailNextDecode;
+    gFailNextDecode = 0;
+    pthread_mutex_unlock(&gMockLock);
+
+    if ( fail ) {
+        c->state = OMX_StateInvalid;
+        mockPost(c, 0, OMX_EventError, (OMX_U32) OMX_ErrorHardware, 0, NULL);
+        return;
+    }
+
+    for ( OMX_U32 i = 0; i < in->nFilledLen; i++ )
+        sum += in->pBuffer[in->nOffset + i];
+
+    memset(out->pBuffer, sum, c->ports[1].nBufferSize);
+    out->nFilledLen = c->ports[1].nBufferSize;
+    out->nOffset = 0;
+
+    mockPost(c, 1, OMX_EventCmdComplete, 0, 0, in);
+    mockPost(c, 2, OMX_EventCmdComplete, 0, 0, out);
+}
+
+static OMX_ERRORTYPE mockSendCommand(OMX_HANDLETYPE h, OMX_COMMANDTYPE cmd, OMX_U32 param, OMX_PTR data)
+{
+    MockComponent* c = (MockComponent*) h;
+
+    if ( ( OMX_CommandPortEnable == cmd ) || ( OMX_CommandPortDisable == cmd ) ) {
+        bool enable = ( OMX_CommandPortEnable == cmd );
+
+        if ( ( 1 != param ) || c->enabling || c->disabling || ( enable == c->enabled[1] ) ) {
+            mockViolation();
+            return OMX_ErrorIncorrectStateOperation;
+        }
+
+        // Nothing to wait for in Loaded, otherwise the buffer has to come or go first
+        if ( OMX_StateLoaded == c->state ) {
+            c->enabled[1] = enable;
+            mockPost(c, 0, OMX_EventCmdComplete, cmd, param, NULL);
+        } else if ( enable ) {
+            c->enabling = true;
+        } else {
+            c->enabled[1] = false;
+            c->disabling = true;
+            mockCheckTransition(c);
+        }
+
+        return OMX_ErrorNone;
+    }
+
+    if ( OMX_CommandStateSet != cmd )
+        return OMX_ErrorBadParameter;
+
+    if ( ( ( OMX_StateLoaded == c->state ) && ( OMX_StateIdle == param ) ) ||
+         ( ( OMX_StateIdle == c->state ) && ( OMX_StateLoaded == param ) ) ) {
+        c->pending = (OMX_STATETYPE) param;
+        mockCheckTransition(c);
+        return OMX_ErrorNone;
+    }
+
+    if ( ( ( OMX_StateIdle == c->state ) && ( OMX_StateExecuting == param ) ) ||
+         ( ( OMX_StateExecuting == c->state ) && ( OMX_StateIdle == param ) ) ) {
+        c->state = (OMX_STATETYPE) param;
+        mockPost(c, 0, OMX_EventCmdComplete, OMX_CommandStateSet, param, NULL);
+        return OMX_ErrorNone;
+    }
+
+    mockViolation();
+    return OMX_ErrorIncorrectStateOperation;
+}
+
+static OMX_ERRORTYPE mockGetParameter(OMX_HANDLETYPE h, OMX_INDEXTYPE index, OMX_PTR param)
+{
+    return OMX_ErrorBadParameter;
+}
+
+static OMX_ERRORTYPE mockSetParameter(OMX_HANDLETYPE h, OMX_INDEXTYPE index, OMX_PTR param)
+{
+    MockComponent* c = (MockComponent*) h;
+
+    if ( OMX_StateLoaded != c->state ) {
+        mockViolation();
+        return OMX_ErrorIncorrectStateOperation;
+    }
+
+    if ( OMX_IndexParamPortDefinition == index ) {
+        OMX_PARAM_PORTDEFINITIONTYPE* def = (OMX_PARAM_PORTDEFINITIONTYPE*) param;
+        if ( def->nPortIndex > 1 )
+            return OMX_ErrorBadParameter;
+        c->ports[def->nPortIndex] = *def;
+        pthread_mutex_lock(&gMockLock);
+        gPortDefinitions++;
+        pthread_mutex_unlock(&gMockLock);
+    }
+
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE mockSetConfig(OMX_HANDLETYPE h, OMX_INDEXTYPE index, OMX_PTR config)
+{
+    MockComponent* c = (MockComponent*) h;
+
+    if ( OMX_IndexConfigCommonScale == index ) {
+        OMX_CONFIG_SCALEFACTORTYPE* scale = (OMX_CONFIG_SCALEFACTORTYPE*) config;
+        if ( ( 1 != scale->nPortIndex ) || ( scale->xWidth != scale->xHeight ) || ( scale->xWidth <= 0 ) )
+            return OMX_ErrorBadParameter;
+        c->xScale = scale->xWidth;
+    }
+
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE mockAllocateBuffer(OMX_HANDLETYPE h, OMX_BUFFERHEADERTYPE** header, OMX_U32 port, OMX_PTR priv, OMX_U32 size)
+{
+    MockComponent* c = (MockComponent*) h;
+    OMX_BUFFERHEADERTYPE* b;
+
+    if ( ( port > 1 ) || ( size < c->ports[port].nBufferSize ) || ( NULL != c->buffers[port] ) ||
+         ( OMX_StateIdle != c->pending ) || !c->enabled[port] ) {
+        mockViolation();
+        return OMX_ErrorBadParameter;
+    }
+
+    b = (OMX_BUFFERHEADERTYPE*) calloc(1, sizeof(OMX_BUFFERHEADERTYPE));
+    b->pBuffer = (OMX_U8*) malloc(size);
+    b->nAllocLen = size;
+    c->buffers[port] = b;
+    c->owned[port] = true;
+    *header = b;
+
+    pthread_mutex_lock(&gMockLock);
+    gComponentBytes += size;
+    pthread_mutex_unlock(&gMockLock);
+
+    mockCheckTransition(c);
+
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE mockUseBuffer(OMX_HANDLETYPE h, OMX_BUFFERHEADERTYPE** header, OMX_U32 port, OMX_PTR priv, OMX_U32 size, OMX_U8* buffer)
+{
+    MockComponent* c = (MockComponent*) h;
+    OMX_BUFFERHEADERTYPE* b;
+
+    if ( ( port > 1 ) || ( size < c->ports[port].nBufferSize ) || ( NULL != c->buffers[port] ) ||
+         !( ( ( OMX_StateIdle == c->pending ) && c->enabled[port] ) || ( ( 1 == port ) && c->enabling ) ) ) {
+        mockViolation();
+        return OMX_ErrorBadParameter;
+    }
+
+    b = (OMX_BUFFERHEADERTYPE*) calloc(1, sizeof(OMX_BUFFERHEADERTYPE));
+    b->pBuffer = buffer;
+    b->nAllocLen = size;
+    c->buffers[port] = b;
+    c->owned[port] = false;
+    *header = b;
+
+    mockCheckTransition(c);
+
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE mockFreeBuffer(OMX_HANDLETYPE h, OMX_U32 port, OMX_BUFFERHEADERTYPE* b)
+{
+    MockComponent* c = (MockComponent*) h;
+
+    if ( ( port > 1 ) || ( b != c->buffers[port] ) ) {
+        mockViolation();
+        return OMX_ErrorBadParameter;
+    }
+
+    if ( c->owned[port] ) {
+        pthread_mutex_lock(&gMockLock);
+        gComponentBytes -= b->nAllocLen;
+        pthread_mutex_unlock(&gMockLock);
+        free(b->pBuffer);
+    }
+    free(b);
+    c->buffers[port] = NULL;
+
+    mockCheckTransition(c);
+
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE mockEmptyThisBuffer(OMX_HANDLETYPE h, OMX_BUFFERHEADERTYPE* b)
+{
+    MockComponent* c = (MockComponent*) h;
+
+    if ( ( OMX_StateExecuting != c->state ) || ( b != c->buffers[0] ) || ( b->nFilledLen > b->nAllocLen ) ) {
+        mockViolation();
+        return OMX_ErrorIncorrectStateOperation;
+    }
+
+    c->queuedIn = b;
+    if ( c->queuedOut )
+        mockDecode(c);
+
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE mockFillThisBuffer(OMX_HANDLETYPE h, OMX_BUFFERHEADERTYPE* b)
+{
+    MockComponent* c = (MockComponent*) h;
+
+    if ( ( OMX_StateExecuting != c->state ) || ( b != c->buffers[1] ) || !c->enabled[1] ) {
+        mockViolation();
+        return OMX_ErrorIncorrectStateOperation;
+    }
+
+    c->queuedOut = b;
+    if ( c->queuedIn )
+        mockDecode(c);
+
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OMX_Init(void)
+{
+    pthread_mutex_lock(&gMockLock);
+    gInitCount++;
+    pthread_mutex_unlock(&gMockLock);
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OMX_Deinit(void)
+{
+    pthread_mutex_lock(&gMockLock);
+    gInitCount--;
+    pthread_mutex_unlock(&gMockLock);
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OMX_GetHandle(OMX_HANDLETYPE* pHandle, OMX_STRING name, OMX_PTR appData, OMX_CALLBACKTYPE* callbacks)
+{
+    MockComponent* c = (MockComponent*) calloc(1, sizeof(MockComponent));
+
+    c->omx.SendCommand = mockSendCommand;
+    c->omx.GetParameter = mockGetParameter;
+    c->omx.SetParameter = mockSetParameter;
+    c->omx.SetConfig = mockSetConfig;
+    c->omx.AllocateBuffer = mockAllocateBuffer;
+    c->omx.UseBuffer = mockUseBuffer;
+    c->omx.FreeBuffer = mockFreeBuffer;
+    c->omx.EmptyThisBuffer = mockEmptyThisBuffer;
+    c->omx.FillThisBuffer = mockFillThisBuffer;
+    c->callbacks = *callbacks;
+    c->appData = appData;
+    c->state = OMX_StateLoaded;
+    c->pending = OMX_StateInvalid;
+    c->enabled[0] = true;
+    c->enabled[1] = true;
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->cond, NULL);
+    pthread_create(&c->thread, NULL, mockThread, c);
+
+    pthread_mutex_lock(&gMockLock);
+    gHandles++;
+    gHandlesOpened++;
+    pthread_mutex_unlock(&gMockLock);
+
+    *pHandle = c;
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OMX_FreeHandle(OMX_HANDLETYPE h)
+{
+    MockComponent* c = (MockComponent*) h;
+
+    // A healthy session has to give the buffers back first
+    if ( ( OMX_StateInvalid != c->state ) && ( ( OMX_StateLoaded != c->state ) || c->buffers[0] || c->buffers[1] ) )
+        mockViolation();
+
+    pthread_mutex_lock(&c->lock);
+    c->exit = true;
+    pthread_cond_signal(&c->cond);
+    pthread_mutex_unlock(&c->lock);
+    pthread_join(c->thread, NULL);
+
+    for ( int i = 0; i < 2; i++ ) {
+        if ( c->buffers[i] ) {
+            if ( c->owned[i] ) {
+                pthread_mutex_lock(&gMockLock);
+                gComponentBytes -= c->buffers[i]->nAllocLen;
+                pthread_mutex_unlock(&gMockLock);
+                free(c->buffers[i]->pBuffer);
+            }
+            free(c->buffers[i]);
+        }
+    }
+    pthread_cond_destroy(&c->cond);
+    pthread_mutex_destroy(&c->lock);
+    free(c);
+
+    pthread_mutex_lock(&gMockLock);
+    gHandles--;
+    pthread_mutex_unlock(&gMockLock);
+    return OMX_ErrorNone;
+}
+
+/* ---------------------------------------------------------------- tests */
+
+static JpegDecoderSession::Config makeConfig(OMX_U32 width, OMX_U32 height)
+{
+    JpegDecoderSession::Config config;
+
+    memset(&config, 0, sizeof(config));
+    config.nWidth = width;
+    config.nHeight = height;
+    config.eInputFormat = OMX_COLOR_FormatYUV420PackedPlanar;
+    config.eOutputFormat = OMX_COLOR_Format16bitRGB565;
+    config.nBytesPerPixel = 2;
+    config.nScale = 1;
+
+    return config;
+}
+
+/* Leases a session, decodes inputSize bytes of seed and checks the output */
+static bool decodeOnce(JpegDecoderPool* pool, OMX_U32 width, OMX_U32 height, OMX_U32 inputSize, OMX_U8 seed)
+{
+    JpegDecoderSession::Config config = makeConfig(width, height);
+    JpegDecoderSession* session = pool->lease(config);
+    OMX_U32 size = width * height * 2;
+    OMX_U8* pixels;
+    OMX_U8 sum = 0;
+    bool ok;
+
+    if ( NULL == session )
+        return false;
+
+    ok = session->prepare(config, inputSize);
+    if ( ok ) {
+        memset(session->inputBuffer(), seed, inputSize);
+        for ( OMX_U32 i = 0; i < inputSize; i++ )
+            sum += seed;
+
+        pixels = (OMX_U8*) malloc(size);
+        ok = session->decode(inputSize, pixels, size);
+        for ( OMX_U32 i = 0; ok && ( i < size ); i++ ) {
+            if ( pixels[i] != sum )
+                ok = false;
+        }
+        free(pixels);
+    }
+
+    pool->release(session);
+
+    return ok;
+}
+
+static void testWarmReuse()
+{
+    JpegDecoderPool pool(1, 10000);
+    int definitions = mockCount(&gPortDefinitions);
+    int opened = mockCount(&gHandlesOpened);
+
+    for ( int i = 0; i < 10; i++ )
+        CHECK(decodeOnce(&pool, 64, 48, 1000 + i * 100, (OMX_U8) i));
+
+    // One handle, the ports set up once
+    CHECK(mockCount(&gHandlesOpened) - opened == 1);
+    CHECK(mockCount(&gPortDefinitions) - definitions == 2);
+
+    // A larger output reconfigures, a larger input too once past the capacity
+    CHECK(decodeOnce(&pool, 128, 96, 1000, 1));
+    CHECK(mockCount(&gPortDefinitions) - definitions == 4);
+    CHECK(decodeOnce(&pool, 128, 96, 60000, 2));
+    CHECK(mockCount(&gPortDefinitions) - definitions == 4);
+    CHECK(decodeOnce(&pool, 128, 96, JpegDecoderSession::INPUT_BUFFER_ALIGN + 1, 3));
+    CHECK(mockCount(&gPortDefinitions) - definitions == 6);
+    CHECK(mockCount(&gHandlesOpened) - opened == 1);
+}
+
+static void testGeometries()
+{
+    JpegDecoderPool pool(2, 10000);
+    int definitions = mockCount(&gPortDefinitions);
+
+    // Two sessions end up configured for one geometry each
+    for ( int i = 0; i < 20; i++ )
+        CHECK(decodeOnce(&pool, ( i & 1 ) ? 320 : 96, ( i & 1 ) ? 240 : 96, 5000, (OMX_U8) i));
+
+    CHECK(pool.sessions() == 2);
+    CHECK(mockCount(&gPortDefinitions) - definitions == 4);
+}
+
+static void testEviction()
+{
+    JpegDecoderPool pool(2, 50);
+    int handles = mockCount(&gHandles);
+
+    CHECK(decodeOnce(&pool, 32, 32, 100, 7));
+    CHECK(pool.sessions() == 1);
+    CHECK(mockCount(&gHandles) == handles + 1);
+
+    usleep(300 * 1000);
+    CHECK(pool.sessions() == 0);
+    CHECK(mockCount(&gHandles) == handles);
+
+    // And comes back when needed
+    CHECK(decodeOnce(&pool, 32, 32, 100, 8));
+    CHECK(pool.sessions() == 1);
+
+    pool.trim();
+    CHECK(pool.sessions() == 0);
+    CHECK(mockCount(&gHandles) == handles);
+}
+
+static void testError()
+{
+    JpegDecoderPool pool(1, 10000);
+    int opened = mockCount(&gHandlesOpened);
+    int handles = mockCount(&gHandles);
+
+    CHECK(decodeOnce(&pool, 32, 32, 100, 1));
+
+    gFailNextDecode = 1;
+    CHECK(!decodeOnce(&pool, 32, 32, 100, 2));
+    // The broken session is gone, the next decode gets a new one
+    CHECK(pool.sessions() == 0);
+    CHECK(mockCount(&gHandles) == handles);
+
+    CHECK(decodeOnce(&pool, 32, 32, 100, 3));
+    CHECK(mockCount(&gHandlesOpened) - opened == 2);
+}
+
+static void testZeroCopy()
+{
+    JpegDecoderPool pool(1, 10000);
+    JpegDecoderSession::Config config = makeConfig(640, 480);
+    JpegDecoderSession* session;
+    OMX_U32 size = config.nWidth * config.nHeight * 2;
+    OMX_U8* pixels = (OMX_U8*) malloc(size);
+    int bytes = mockCount(&gComponentBytes);
+
+    session = pool.lease(config);
+    CHECK(NULL != session);
+    if ( NULL == session ) {
+        free(pixels);
+        return;
+    }
+
+    CHECK(session->prepare(config, 1000));
+    // Only the input buffer comes from the component
+    CHECK(mockCount(&gComponentBytes) - bytes == JpegDecoderSession::INPUT_BUFFER_ALIGN);
+
+    // Too small for the frame, refused without breaking the session
+    CHECK(!session->decode(1000, pixels, size - 1));
+    CHECK(!session->isBroken());
+
+    // Decoded in place, the output port lets go of the pixels afterwards
+    CHECK(session->decode(1000, pixels, size));
+    pthread_mutex_lock(&gMockLock);
+    CHECK(gLastOutput == pixels);
+    pthread_mutex_unlock(&gMockLock);
+    CHECK(session->decode(1000, pixels, size));
+    CHECK(mockCount(&gComponentBytes) - bytes == JpegDecoderSession::INPUT_BUFFER_ALIGN);
+    CHECK(session->reconfigurations() == 1);
+
+    pool.release(session);
+    pool.trim();
+    CHECK(mockCount(&gComponentBytes) == bytes);
+
+    free(pixels);
+}
+
+static int gThreadFailures = 0;
+static pthread_mutex_t gThreadLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void* decodeThread(void* arg)
+{
+    JpegDecoderPool* pool = (JpegDecoderPool*) arg;
+    unsigned int seed = (unsigned int) (long) pthread_self();
+
+    for ( int i = 0; i < 40; i++ ) {
+        int geometry = rand_r(&seed) % 3;
+        if ( !decodeOnce(pool, 32 + geometry * 16, 32, 100 + rand_r(&seed) % 5000, (OMX_U8) i) ) {
+            pthread_mutex_lock(&gThreadLock);
+            gThreadFailures++;
+            pthread_mutex_unlock(&gThreadLock);
+        }
+    }
+
+    return NULL;
+}
+
+static void testConcurrent()
+{
+    JpegDecoderPool pool(2, 10000);
+    pthread_t threads[6];
+    int handles = mockCount(&gHandles);
+
+    gDecodeDelayUs = 500;
+    for ( int i = 0; i < 6; i++ )
+        pthread_create(&threads[i], NULL, decodeThread, &pool);
+    for ( int i = 0; i < 6; i++ )
+        pthread_join(threads[i], NULL);
+    gDecodeDelayUs = 0;
+
+    CHECK(gThreadFailures == 0);
+    CHECK(pool.sessions() <= 2);
+    CHECK(mockCount(&gHandles) - handles <= 2);
+    CHECK(pool.idleSessions() == pool.sessions());
+}
+
+static void testScale()
+{
+    JpegDecoderPool pool(1, 10000);
+    JpegDecoderSession::Config config = makeConfig(4000 / 4, 3000 / 4);
+    JpegDecoderSession* session;
+    OMX_U8* pixels = (OMX_U8*) malloc(config.nWidth * config.nHeight * 2);
+    int definitions;
+
+    // Powers of two up to 1/8, the rest of the sample size is left over
+    CHECK(JpegDecoderSession::scaleFor(0) == 1);
+    CHECK(JpegDecoderSession::scaleFor(1) == 1);
+    CHECK(JpegDecoderSession::scaleFor(3) == 2);
+    CHECK(JpegDecoderSession::scaleFor(4) == 4);
+    CHECK(JpegDecoderSession::scaleFor(7) == 4);
+    CHECK(JpegDecoderSession::scaleFor(8) == 8);
+    CHECK(JpegDecoderSession::scaleFor(32) == 8);
+    CHECK(JpegDecoderSession::scaledSize(4000, 8) == 500);
+    CHECK(JpegDecoderSession::scaledSize(4001, 8) == 501);
+    CHECK(JpegDecoderSession::scaledSize(7, 8) == 1);
+
+    config.nScale = 4;
+    session = pool.lease(config);
+    CHECK(NULL != session);
+    if ( NULL == session ) {
+        free(pixels);
+        return;
+    }
+    CHECK(session->prepare(config, 1000));
+    CHECK(session->decode(1000, pixels, config.nWidth * config.nHeight * 2));
+    CHECK(mockCount(&gLastScale) == ( 1 << 16 ) / 4);
+    pool.release(session);
+
+    // Same output size without scaling is another configuration
+    definitions = mockCount(&gPortDefinitions);
+    config.nScale = 1;
+    session = pool.lease(config);
+    CHECK(NULL != session && !session->isConfiguredFor(config));
+    if ( NULL != session ) {
+        CHECK(session->prepare(config, 1000));
+        CHECK(session->decode(1000, pixels, config.nWidth * config.nHeight * 2));
+        CHECK(mockCount(&gLastScale) == 1 << 16);
+        CHECK(mockCount(&gPortDefinitions) - definitions == 2);
+        pool.release(session);
+    }
+
+    free(pixels);
+}
+
+int main(int argc, char** argv)
+{
+    testWarmReuse();
+    testGeometries();
+    testScale();
+    testZeroCopy();
+    testEviction();
+    testError();
+    testConcurrent();
+
+    // Every pool is gone, so is every handle
+    CHECK(mockCount(&gHandles) == 0);
+    CHECK(mockCount(&gInitCount) == 0);
+    CHECK(mockCount(&gStateViolations) == 0);
+    CHECK(mockCount(&gComponentBytes) == 0);
+
+    printf("%d decodes, %s, %d failures\n", mockCount(&gDecodes), failures ? "FAIL" : "PASS", failures);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,460 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#define LOG_TAG "JpegDecoderSession"
+#include <utils/Log.h>
+
+#include "JpegDecoderSession.h"
+
+#define JPEGD_INPUT_PORT    0
+#define JPEGD_OUTPUT_PORT   1
+
+#define OMX_INIT_STRUCT(_s_, _name_)	\
+    memset(&(_s_), 0x0, sizeof(_name_));	\
+    (_s_).nSize = sizeof(_name_);		\
+    (_s_).nVersion.s.nVersionMajor = 0x1;	\
+    (_s_).nVersion.s.nVersionMinor = 0x1;	\
+    (_s_).nVersion.s.nRevision = 0x0;		\
+    (_s_).nVersion.s.nStep = 0x0
+
+static char gComponentName[] = "OMX.TI.DUCATI1.IMAGE.JPEGD";
+
+JpegDecoderSession::JpegDecoderSession()
+{
+    mHandle = NULL;
+    mInBuffHead = NULL;
+    mOutBuffHead = NULL;
+    memset(&mConfig, 0, sizeof(mConfig));
+    mInputCapacity = 0;
+    mExecuting = false;
+    mOutputEnabled = false;
+    mBroken = false;
+    mReconfigurations = 0;
+
+    sem_init(&mCommandSem, 0, 0);
+    sem_init(&mBufferSem, 0, 0);
+    mError = false;
+    mCompletedCommand = 0;
+    mCompletedParam = 0;
+}
+
+JpegDecoderSession::~JpegDecoderSession()
+{
+    close();
+
+    sem_destroy(&mCommandSem);
+    sem_destroy(&mBufferSem);
+}
+
+bool JpegDecoderSession::open()
+{
+    OMX_CALLBACKTYPE callbacks = { EventHandler, EmptyBufferDone, FillBufferDone };
+    OMX_ERRORTYPE eError;
+
+    if ( NULL != mHandle )
+        return true;
+
+    OMX_Init();
+
+    eError = OMX_GetHandle(&mHandle, gComponentName, this, &callbacks);
+    if ( ( OMX_ErrorNone != eError ) || ( NULL == mHandle ) ) {
+        LOGE("OMX_GetHandle failed 0x%x", eError);
+        mHandle = NULL;
+        OMX_Deinit();
+        return false;
+    }
+
+    // A new component starts with both ports enabled
+    mOutputEnabled = true;
+
+    return true;
+}
+
+void JpegDecoderSession::close()
+{
+    if ( NULL == mHandle )
+        return;
+
+    // A broken component gets freed as it is
+    if ( mExecuting && !mBroken )
+        toLoaded();
+
+    if ( OMX_ErrorNone != OMX_FreeHandle(mHandle) )
+        LOGE("OMX_FreeHandle failed");
+
+    mHandle = NULL;
+    mInBuffHead = NULL;
+    mOutBuffHead = NULL;
+    mExecuting = false;
+    OMX_Deinit();
+}
+
+OMX_U32 JpegDecoderSession::scaleFor(int sampleSize)
+{
+    OMX_U32 scale = 1;
+
+    while ( ( scale < MAX_SCALE ) && ( (int) ( scale * 2 ) <= sampleSize ) )
+        scale *= 2;
+
+    return scale;
+}
+
+bool JpegDecoderSession::isConfiguredFor(const Config& config) const
+{
+    return mExecuting && ( 0 == memcmp(&mConfig, &config, sizeof(Config)) );
+}
+
+OMX_U8* JpegDecoderSession::inputBuffer() const
+{
+    return mInBuffHead ? mInBuffHead->pBuffer : NULL;
+}
+
+bool JpegDecoderSession::prepare(const Config& config, OMX_U32 inputSize)
+{
+    if ( mBroken || ( NULL == mHandle ) )
+        return false;
+
+    if ( isConfiguredFor(config) && ( inputSize <= mInputCapacity ) )
+        return true;
+
+    if ( mExecuting && !toLoaded() ) {
+        mBroken = true;
+        return false;
+    }
+
+    memcpy(&mConfig, &config, sizeof(Config));
+    mInputCapacity = ( inputSize + INPUT_BUFFER_ALIGN - 1 ) & ~( INPUT_BUFFER_ALIGN - 1 );
+    mReconfigurations++;
+
+    if ( !toExecuting() ) {
+        mBroken = true;
+        return false;
+    }
+
+    return true;
+}
+
+bool JpegDecoderSession::decode(OMX_U32 inputLength, void* pixels, OMX_U32 pixelsSize)
+{
+    OMX_ERRORTYPE eError;
+    OMX_U32 outputSize = mConfig.nWidth * mConfig.nHeight * mConfig.nBytesPerPixel;
+
+    if ( mBroken || !mExecuting || ( inputLength > mInputCapacity ) || ( pixelsSize < outputSize ) )
+        return false;
+
+    // The component writes straight into the pixels, they back the output port for this decode only
+    if ( !sendCommand(OMX_CommandPortEnable, JPEGD_OUTPUT_PORT) ) {
+        mBroken = true;
+        return false;
+    }
+
+    eError = OMX_UseBuffer(mHandle, &mOutBuffHead, JPEGD_OUTPUT_PORT, NULL, outputSize, (OMX_U8*) pixels);
+    if ( ( OMX_ErrorNone != eError ) || !waitCommand(OMX_CommandPortEnable, JPEGD_OUTPUT_PORT) ) {
+        LOGE("Output port enable failed 0x%x", eError);
+        mBroken = true;
+        return false;
+    }
+    mOutputEnabled = true;
+
+    mInBuffHead->nFilledLen = inputLength;
+    mInBuffHead->nOffset = 0;
+    mInBuffHead->nFlags = OMX_BUFFERFLAG_EOS;
+    mInBuffHead->nInputPortIndex = JPEGD_INPUT_PORT;
+
+    mOutBuffHead->nFilledLen = 0;
+    mOutBuffHead->nOffset = 0;
+    mOutBuffHead->nFlags = 0;
+    mOutBuffHead->nOutputPortIndex = JPEGD_OUTPUT_PORT;
+
+    eError = OMX_EmptyThisBuffer(mHandle, mInBuffHead);
+    if ( OMX_ErrorNone == eError )
+        eError = OMX_FillThisBuffer(mHandle, mOutBuffHead);
+
+    // Both buffers have to come back before either can be touched again
+    if ( ( OMX_ErrorNone != eError ) ||
+         !wait(&mBufferSem, DECODE_TIMEOUT_MS) || !wait(&mBufferSem, DECODE_TIMEOUT_MS) || mError ) {
+        LOGE("Decode failed 0x%x", eError);
+        mBroken = true;
+        return false;
+    }
+
+    return disableOutput();
+}
+
+bool JpegDecoderSession::disableOutput()
+{
+    OMX_ERRORTYPE eError;
+
+    // Disabling completes once the port is unpopulated
+    if ( !sendCommand(OMX_CommandPortDisable, JPEGD_OUTPUT_PORT) ) {
+        mBroken = true;
+        return false;
+    }
+
+    eError = OMX_FreeBuffer(mHandle, JPEGD_OUTPUT_PORT, mOutBuffHead);
+    mOutBuffHead = NULL;
+    if ( ( OMX_ErrorNone != eError ) || !waitCommand(OMX_CommandPortDisable, JPEGD_OUTPUT_PORT) ) {
+        LOGE("Output port disable failed 0x%x", eError);
+        mBroken = true;
+        return false;
+    }
+    mOutputEnabled = false;
+
+    return true;
+}
+
+bool JpegDecoderSession::configurePorts()
+{
+    OMX_PORT_PARAM_TYPE portType;
+    OMX_PARAM_PORTDEFINITIONTYPE inPortDef, outPortDef;
+    OMX_JPEG_PARAM_UNCOMPRESSEDMODETYPE uncompressedMode;
+    OMX_IMAGE_PARAM_DECODE_SUBREGION subRegion;
+    OMX_CONFIG_SCALEFACTORTYPE scaleFactor;
+    OMX_ERRORTYPE eError;
+
+    OMX_INIT_STRUCT(portType, OMX_PORT_PARAM_TYPE);
+    portType.nPorts = 2;
+    portType.nStartPortNumber = 0;
+    eError = OMX_SetParameter(mHandle, OMX_IndexParamImageInit, &portType);
+    if ( OMX_ErrorNone != eError )
+        goto EXIT;
+
+    OMX_INIT_STRUCT(inPortDef, OMX_PARAM_PORTDEFINITIONTYPE);
+    inPortDef.nPortIndex = JPEGD_INPUT_PORT;
+    inPortDef.eDir = OMX_DirInput;
+    inPortDef.nBufferCountActual = 1;
+    inPortDef.nBufferCountMin = 1;
+    inPortDef.nBufferSize = mInputCapacity;
+    inPortDef.bEnabled = OMX_TRUE;
+    inPortDef.eDomain = OMX_PortDomainImage;
+    inPortDef.format.image.cMIMEType = (OMX_STRING) "OMXJPEGD";
+    inPortDef.format.image.nFrameWidth = mInputCapacity;
+    inPortDef.format.image.nFrameHeight = 1;
+    inPortDef.format.image.nStride = 1;
+    inPortDef.format.image.nSliceHeight = 1;
+    inPortDef.format.image.eCompressionFormat = OMX_IMAGE_CodingJPEG;
+    inPortDef.format.image.eColorFormat = mConfig.eInputFormat;
+    eError = OMX_SetParameter(mHandle, OMX_IndexParamPortDefinition, &inPortDef);
+    if ( OMX_ErrorNone != eError )
+        goto EXIT;
+
+    OMX_INIT_STRUCT(outPortDef, OMX_PARAM_PORTDEFINITIONTYPE);
+    outPortDef.nPortIndex = JPEGD_OUTPUT_PORT;
+    outPortDef.eDir = OMX_DirOutput;
+    outPortDef.nBufferCountActual = 1;
+    outPortDef.nBufferCountMin = 1;
+    outPortDef.nBufferSize = mConfig.nWidth * mConfig.nHeight * mConfig.nBytesPerPixel;
+    outPortDef.bEnabled = OMX_TRUE;
+    outPortDef.eDomain = OMX_PortDomainImage;
+    outPortDef.format.image.cMIMEType = (OMX_STRING) "OMXJPEGD";
+    outPortDef.format.image.nFrameWidth = mConfig.nWidth;
+    outPortDef.format.image.nFrameHeight = mConfig.nHeight;
+    outPortDef.format.image.nStride = mConfig.nWidth;
+    outPortDef.format.image.eCompressionFormat = OMX_IMAGE_CodingUnused;
+    outPortDef.format.image.eColorFormat = mConfig.eOutputFormat;
+    eError = OMX_SetParameter(mHandle, OMX_IndexParamPortDefinition, &outPortDef);
+    if ( OMX_ErrorNone != eError )
+        goto EXIT;
+
+    // Set every time, a reconfigured session may have been scaling before
+    OMX_INIT_STRUCT(scaleFactor, OMX_CONFIG_SCALEFACTORTYPE);
+    scaleFactor.nPortIndex = JPEGD_OUTPUT_PORT;
+    scaleFactor.xWidth = ( 1 << 16 ) / ( ( mConfig.nScale > 1 ) ? mConfig.nScale : 1 );   // Q16
+    scaleFactor.xHeight = scaleFactor.xWidth;
+    eError = OMX_SetConfig(mHandle, OMX_IndexConfigCommonScale, &scaleFactor);
+    if ( OMX_ErrorNone != eError )
+        goto EXIT;
+
+    OMX_INIT_STRUCT(uncompressedMode, OMX_JPEG_PARAM_UNCOMPRESSEDMODETYPE);
+    uncompressedMode.nPortIndex = JPEGD_INPUT_PORT;
+    uncompressedMode.eUncompressedImageMode = OMX_JPEG_UncompressedModeFrame;
+    eError = OMX_SetParameter(mHandle, (OMX_INDEXTYPE) OMX_TI_IndexParamJPEGUncompressedMode, &uncompressedMode);
+    if ( OMX_ErrorNone != eError )
+        goto EXIT;
+
+    OMX_INIT_STRUCT(subRegion, OMX_IMAGE_PARAM_DECODE_SUBREGION);
+    eError = OMX_SetParameter(mHandle, (OMX_INDEXTYPE) OMX_TI_IndexParamDecodeSubregion, &subRegion);
+
+EXIT:
+    if ( OMX_ErrorNone != eError ) {
+        LOGE("Port configuration failed 0x%x", eError);
+        return false;
+    }
+
+    return true;
+}
+
+bool JpegDecoderSession::toExecuting()
+{
+    OMX_ERRORTYPE eError;
+
+    mError = false;
+
+    if ( !configurePorts() )
+        return false;
+
+    // The output port only gets enabled by decode()
+    if ( mOutputEnabled ) {
+        if ( !sendCommand(OMX_CommandPortDisable, JPEGD_OUTPUT_PORT) ||
+             !waitCommand(OMX_CommandPortDisable, JPEGD_OUTPUT_PORT) )
+            return false;
+        mOutputEnabled = false;
+    }
+
+    // Loaded->Idle completes once the enabled input port is populated
+    if ( !sendCommand(OMX_CommandStateSet, OMX_StateIdle) )
+        return false;
+
+    eError = OMX_AllocateBuffer(mHandle, &mInBuffHead, JPEGD_INPUT_PORT, NULL, mInputCapacity);
+    if ( OMX_ErrorNone != eError ) {
+        LOGE("OMX_AllocateBuffer failed 0x%x", eError);
+        return false;
+    }
+
+    if ( !waitCommand(OMX_CommandStateSet, OMX_StateIdle) )
+        return false;
+
+    if ( !sendCommand(OMX_CommandStateSet, OMX_StateExecuting) ||
+         !waitCommand(OMX_CommandStateSet, OMX_StateExecuting) )
+        return false;
+
+    mExecuting = true;
+
+    return true;
+}
+
+bool JpegDecoderSession::toLoaded()
+{
+    OMX_ERRORTYPE eError = OMX_ErrorNone;
+
+    mExecuting = false;
+
+    if ( !sendCommand(OMX_CommandStateSet, OMX_StateIdle) ||
+         !waitCommand(OMX_CommandStateSet, OMX_StateIdle) )
+        return false;
+
+    // Idle->Loaded completes once the enabled ports are unpopulated
+    if ( !sendCommand(OMX_CommandStateSet, OMX_StateLoaded) )
+        return false;
+
+    if ( NULL != mInBuffHead )
+        eError = OMX_FreeBuffer(mHandle, JPEGD_INPUT_PORT, mInBuffHead);
+    if ( ( OMX_ErrorNone == eError ) && ( NULL != mOutBuffHead ) )
+        eError = OMX_FreeBuffer(mHandle, JPEGD_OUTPUT_PORT, mOutBuffHead);
+    mInBuffHead = NULL;
+    mOutBuffHead = NULL;
+
+    if ( OMX_ErrorNone != eError ) {
+        LOGE("OMX_FreeBuffer failed 0x%x", eError);
+        return false;
+    }
+
+    return waitCommand(OMX_CommandStateSet, OMX_StateLoaded);
+}
+
+bool JpegDecoderSession::sendCommand(OMX_COMMANDTYPE cmd, OMX_U32 param)
+{
+    OMX_ERRORTYPE eError;
+
+    eError = OMX_SendCommand(mHandle, cmd, param, NULL);
+    if ( OMX_ErrorNone != eError ) {
+        LOGE("OMX_SendCommand %d %d failed 0x%x", cmd, (int) param, eError);
+        return false;
+    }
+
+    return true;
+}
+
+bool JpegDecoderSession::waitCommand(OMX_COMMANDTYPE cmd, OMX_U32 param)
+{
+    while ( wait(&mCommandSem, COMMAND_TIMEOUT_MS) ) {
+        if ( mError )
+            return false;
+        if ( ( cmd == mCompletedCommand ) && ( param == mCompletedParam ) )
+            return true;
+    }
+
+    LOGE("Command %d %d timed out", cmd, (int) param);
+    return false;
+}
+
+bool JpegDecoderSession::wait(sem_t* sem, int timeoutMs)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeoutMs / 1000;
+    ts.tv_nsec += ( timeoutMs % 1000 ) * 1000000;
+    if ( ts.tv_nsec >= 1000000000 ) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+    while ( 0 != sem_timedwait(sem, &ts) ) {
+        if ( EINTR != errno )
+            return false;
+    }
+
+    return true;
+}
+
+OMX_ERRORTYPE JpegDecoderSession::EventHandler(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent,
+                                               OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData)
+{
+    JpegDecoderSession* session = (JpegDecoderSession*) pAppData;
+
+    switch ( eEvent ) {
+        case OMX_EventCmdComplete:
+            session->mCompletedCommand = nData1;
+            session->mCompletedParam = nData2;
+            sem_post(&session->mCommandSem);
+            break;
+        case OMX_EventError:
+            LOGE("OMX component reported error 0x%x", (unsigned int) nData1);
+            // Wake up whoever is waiting, the session is done for
+            session->mError = true;
+            sem_post(&session->mCommandSem);
+            sem_post(&session->mBufferSem);
+            sem_post(&session->mBufferSem);
+            break;
+        default:
+            break;
+    }
+
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE JpegDecoderSession::EmptyBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer)
+{
+    sem_post(&((JpegDecoderSession*) pAppData)->mBufferSem);
+
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE JpegDecoderSession::FillBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer)
+{
+    sem_post(&((JpegDecoderSession*) pAppData)->mBufferSem);
+
+    return OMX_ErrorNone;
+}
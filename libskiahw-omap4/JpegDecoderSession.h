@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef JpegDecoderSession_DEFINED
+#define JpegDecoderSession_DEFINED
+
+#include <semaphore.h>
+
+extern "C" {
+#include "OMX_Component.h"
+#include "OMX_IVCommon.h"
+#include "OMX_TI_IVCommon.h"
+#include "OMX_TI_Index.h"
+};
+
+/** One instance of the Ducati JPEG decoder, left in the executing state with
+    its buffers allocated between decodes. The ports are only reconfigured
+    when the output geometry changes or the input doesn't fit anymore.
+    The session owns the input buffer, the caller fills inputBuffer(). The
+    output port is only enabled for the length of a decode, on the pixels of
+    the caller, so the frame isn't copied and an idle session holds no
+    output memory.
+    A session is used by one thread at a time, JpegDecoderPool hands them out.
+*/
+class JpegDecoderSession {
+public:
+    enum {
+        INPUT_BUFFER_ALIGN = 0x10000,   // input capacity granularity, so similar files share it
+        COMMAND_TIMEOUT_MS = 3000,
+        DECODE_TIMEOUT_MS = 5000,
+        MAX_SCALE = 8,                  // the IDCT can drop down to 1x1 of each 8x8 block
+    };
+
+    struct Config {
+        OMX_U32 nWidth;                 // of the output, after scaling
+        OMX_U32 nHeight;
+        OMX_COLOR_FORMATTYPE eInputFormat;
+        OMX_COLOR_FORMATTYPE eOutputFormat;
+        OMX_U32 nBytesPerPixel;
+        OMX_U32 nScale;                 // DCT domain downscale, 1, 2, 4 or MAX_SCALE
+    };
+
+    JpegDecoderSession();
+    ~JpegDecoderSession();
+
+    /** Largest DCT domain downscale within sampleSize, what is left is up to the caller */
+    static OMX_U32 scaleFor(int sampleSize);
+    /** Dimension of the output for scale, rounded up as libjpeg does */
+    static OMX_U32 scaledSize(OMX_U32 size, OMX_U32 scale) { return ( size + scale - 1 ) / scale; }
+
+    bool open();
+    void close();
+
+    /** Gets the component executing for config with room for inputSize bytes */
+    bool prepare(const Config& config, OMX_U32 inputSize);
+    OMX_U8* inputBuffer() const;
+    OMX_U32 inputCapacity() const { return mInputCapacity; }
+
+    /** Decodes the first inputLength bytes of inputBuffer() straight into pixels,
+        which have to hold nWidth * nHeight * nBytesPerPixel bytes */
+    bool decode(OMX_U32 inputLength, void* pixels, OMX_U32 pixelsSize);
+
+    bool isConfiguredFor(const Config& config) const;
+    // Set after an error or a timeout, the session can't be leased again
+    bool isBroken() const { return mBroken; }
+    unsigned int reconfigurations() const { return mReconfigurations; }
+
+    static OMX_ERRORTYPE EventHandler(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent,
+                                      OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData);
+    static OMX_ERRORTYPE EmptyBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer);
+    static OMX_ERRORTYPE FillBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_BUFFERHEADERTYPE* pBuffer);
+
+private:
+    bool configurePorts();
+    bool toExecuting();
+    bool toLoaded();
+    bool disableOutput();
+    bool sendCommand(OMX_COMMANDTYPE cmd, OMX_U32 param);
+    bool waitCommand(OMX_COMMANDTYPE cmd, OMX_U32 param);
+    bool wait(sem_t* sem, int timeoutMs);
+
+    OMX_HANDLETYPE mHandle;
+    OMX_BUFFERHEADERTYPE* mInBuffHead;
+    OMX_BUFFERHEADERTYPE* mOutBuffHead;
+    Config mConfig;
+    OMX_U32 mInputCapacity;
+    bool mExecuting;
+    bool mOutputEnabled;
+    bool mBroken;
+    unsigned int mReconfigurations;
+
+    // Written by the OMX callbacks
+    sem_t mCommandSem;
+    sem_t mBufferSem;
+    volatile bool mError;
+    volatile OMX_U32 mCompletedCommand;
+    volatile OMX_U32 mCompletedParam;
+};
+
+#endif
@@ -0,0 +1,448 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <string.h>
+
+#include "JpegHeaderParser.h"
+
+#define M_SOF0  0xC0
+#define M_SOF2  0xC2
+#define M_SOF6  0xC6
+#define M_SOF10 0xCA
+#define M_SOF14 0xCE
+#define M_SOF15 0xCF
+#define M_DHT   0xC4
+#define M_JPG   0xC8
+#define M_DAC   0xCC
+#define M_RST0  0xD0
+#define M_RST7  0xD7
+#define M_SOI   0xD8
+#define M_EOI   0xD9
+#define M_SOS   0xDA
+#define M_DQT   0xDB
+#define M_DRI   0xDD
+#define M_APP0  0xE0
+#define M_APP2  0xE2
+#define M_APP3  0xE3
+#define M_APP15 0xEF
+#define M_TEM   0x01
+
+/* 0xFF fill bytes allowed in front of a marker */
+#define MAX_FILL_BYTES  16
+
+/* Offsets inside the APP3 payload, after the "_JPSJPS_" identifier and its length */
+#define JPS_ID_LENGTH       8
+#define JPS_SEP_OFFSET      10
+#define JPS_MISCF_OFFSET    11
+#define JPS_LAYOUT_OFFSET   12
+#define JPS_TYPE_OFFSET     13
+
+#define MP_FORMAT_ID_LENGTH 4
+#define MP_ENTRY_SIZE       16
+#define MP_TAG_SIZE         12
+
+#define TAGID_MPFVERSION 0xB000
+#define TAGID_NIMAGES 0xB001
+#define TAGID_MPENTRY 0xB002
+#define TAGID_UIDLIST 0xB003
+#define TAGID_TFRAMES 0xB004
+#define TAGID_MPIMAGENUM 0xB101
+#define TAGID_PANSCANORIENTATION 0xB201
+#define TAGID_BVPOINTNUM 0xB204
+#define TAGID_CONVANG 0xB205
+#define TAGID_BASELINELEN 0xB206
+
+#define TAG_TYPE_LONG       0x4
+#define TAG_TYPE_RATIONAL   0x5
+#define TAG_TYPE_UNDEFINED  0x7
+#define TAG_TYPE_SRATIONAL  0xA
+
+static inline uint16_t read16(const uint8_t* p, bool littleEndian) {
+    return littleEndian ? (p[0] | (p[1] << 8)) : ((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t read32(const uint8_t* p, bool littleEndian) {
+    if (littleEndian) {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+JpegHeaderParser::JpegHeaderParser() {
+    mSource = NULL;
+    mStart = mEnd = 0;
+    mOffset = 0;
+    memset(&mHeader, 0, sizeof(mHeader));
+}
+
+/** Makes sure size bytes are in the window, moves what is left to the front
+    and reads as much as fits behind it */
+bool JpegHeaderParser::fill(size_t size) {
+    size_t got;
+
+    if (available() >= size) {
+        return true;
+    }
+
+    if (size > WINDOW_SIZE) {
+        return false;
+    }
+
+    memmove(mWindow, mWindow + mStart, available());
+    mEnd -= mStart;
+    mStart = 0;
+
+    while (mEnd < size) {
+        got = mSource->read(mWindow + mEnd, WINDOW_SIZE - mEnd);
+        if (0 == got) {
+            return false;
+        }
+        mEnd += got;
+    }
+
+    return true;
+}
+
+void JpegHeaderParser::consume(size_t size) {
+    mStart += size;
+    mOffset += size;
+}
+
+/** Drops size bytes, whatever isn't in the window is skipped in the source */
+bool JpegHeaderParser::skip(size_t size) {
+    size_t skipped;
+
+    if (size <= available()) {
+        consume(size);
+        return true;
+    }
+
+    size -= available();
+    mOffset += available();
+    mStart = mEnd = 0;
+
+    skipped = mSource->skip(size);
+    mOffset += skipped;
+
+    return skipped == size;
+}
+
+JpegHeaderParser::Result JpegHeaderParser::parse(Source* source) {
+    uint8_t marker;
+    uint16_t length;
+    size_t inspect;
+    uint32_t offset;
+    int fill_bytes;
+    Result ret;
+
+    mSource = source;
+    mStart = mEnd = 0;
+    mOffset = 0;
+    memset(&mHeader, 0, sizeof(mHeader));
+
+    if (!fill(2) || (0xFF != data()[0]) || (M_SOI != data()[1])) {
+        return RESULT_NOT_JPEG;
+    }
+    consume(2);
+
+    for (;;) {
+        if (!fill(1)) {
+            return RESULT_TRUNCATED;
+        }
+
+        if (0xFF != data()[0]) {
+            return RESULT_INVALID;
+        }
+
+        fill_bytes = 0;
+        while (fill(1) && (0xFF == data()[0])) {
+            consume(1);
+            if (++fill_bytes > MAX_FILL_BYTES) {
+                return RESULT_INVALID;
+            }
+        }
+
+        if (!fill(1)) {
+            return RESULT_TRUNCATED;
+        }
+        marker = data()[0];
+        consume(1);
+
+        if (M_SOS == marker) {
+            mHeader.scanOffset = mOffset - 2;
+            return RESULT_OK;
+        }
+
+        if (M_EOI == marker) {
+            return RESULT_NO_IMAGE;
+        }
+
+        // Markers without a length
+        if ((M_SOI == marker) || (M_TEM == marker) || ((marker >= M_RST0) && (marker <= M_RST7))) {
+            continue;
+        }
+
+        if (0x00 == marker) {
+            return RESULT_INVALID;
+        }
+
+        if (!fill(2)) {
+            return RESULT_TRUNCATED;
+        }
+
+        offset = mOffset;
+        length = (data()[0] << 8) | data()[1];
+        if (length < 2) {
+            return RESULT_INVALID;
+        }
+
+        // Only the segments holding something the decoder uses are brought into the window
+        inspect = 0;
+        if (((marker >= M_SOF0) && (marker <= M_SOF15) && (M_DHT != marker) && (M_JPG != marker) && (M_DAC != marker)) ||
+                (M_APP2 == marker) || (M_APP3 == marker) || (M_DRI == marker)) {
+            inspect = (length < WINDOW_SIZE) ? length : (size_t)WINDOW_SIZE;
+        }
+
+        if (inspect) {
+            if (!fill(inspect)) {
+                return RESULT_TRUNCATED;
+            }
+
+            ret = parseSegment(marker, data() + 2, inspect - 2, offset);
+            if (RESULT_OK != ret) {
+                return ret;
+            }
+        }
+
+        if (((marker >= M_SOF0) && (marker <= M_SOF15)) || (M_DQT == marker) || (M_DRI == marker) ||
+                ((marker >= M_APP0) && (marker <= M_APP15))) {
+            if (mHeader.numSegments < MAX_SEGMENTS) {
+                Segment* segment = &mHeader.segments[mHeader.numSegments++];
+                segment->marker = marker;
+                segment->length = length;
+                segment->offset = offset;
+            }
+        }
+
+        if (!skip(length)) {
+            return RESULT_TRUNCATED;
+        }
+    }
+}
+
+JpegHeaderParser::Result JpegHeaderParser::parseSegment(uint8_t marker, const uint8_t* payload, size_t length, uint32_t offset) {
+    switch (marker) {
+        case M_APP2:
+            if ((length >= MP_FORMAT_ID_LENGTH) && !memcmp(payload, "MPF\0", MP_FORMAT_ID_LENGTH) && !mHeader.hasMpo) {
+                return parseMpo(payload, length, offset);
+            }
+            return RESULT_OK;
+
+        case M_APP3:
+            return parseJps(payload, length);
+
+        case M_DRI:
+            if (length >= 2) {
+                mHeader.restartInterval = read16(payload, false);
+            }
+            return RESULT_OK;
+
+        default:
+            parseFrame(marker, payload, length);
+            return RESULT_OK;
+    }
+}
+
+void JpegHeaderParser::parseFrame(uint8_t marker, const uint8_t* payload, size_t length) {
+    Frame* frame = &mHeader.frame;
+
+    if (length < 6) {
+        return;
+    }
+
+    memset(frame, 0, sizeof(*frame));
+    frame->marker = marker;
+    frame->precision = payload[0];
+    frame->height = read16(payload + 1, false);
+    frame->width = read16(payload + 3, false);
+    frame->numComponents = payload[5];
+
+    for (int i = 0; (i < frame->numComponents) && (i < MAX_COMPONENTS) && (6 + 3 * (size_t)i + 3 <= length); i++) {
+        const uint8_t* p = payload + 6 + 3 * i;
+        frame->components[i].id = p[0];
+        frame->components[i].h = p[1] >> 4;
+        frame->components[i].v = p[1] & 0x0F;
+        frame->components[i].tq = p[2];
+    }
+
+    mHeader.hasFrame = true;
+    if ((M_SOF2 == marker) || (M_SOF6 == marker) || (M_SOF10 == marker) || (M_SOF14 == marker)) {
+        mHeader.progressive = true;
+    }
+}
+
+JpegHeaderParser::Result JpegHeaderParser::parseJps(const uint8_t* payload, size_t length) {
+    // Any other APP3 content is refused, the stereo layout would be unknown
+    if ((length <= JPS_TYPE_OFFSET) || memcmp(payload, "_JPSJPS_", JPS_ID_LENGTH) || (0x01 != payload[JPS_TYPE_OFFSET])) {
+        return RESULT_INVALID;
+    }
+
+    mHeader.hasJps = true;
+    mHeader.jps.type = payload[JPS_TYPE_OFFSET];
+    mHeader.jps.layout = payload[JPS_LAYOUT_OFFSET];
+    mHeader.jps.miscFlags = payload[JPS_MISCF_OFFSET];
+    mHeader.jps.separation = payload[JPS_SEP_OFFSET];
+
+    return RESULT_OK;
+}
+
+/** MP header and index IFDs, all offsets are relative to the MP header
+    (CIPA DC-007) and get checked against the bytes in the window */
+JpegHeaderParser::Result JpegHeaderParser::parseMpo(const uint8_t* payload, size_t length, uint32_t offset) {
+    Mpo* mpo = &mHeader.mpo;
+    const uint8_t* ref = payload + MP_FORMAT_ID_LENGTH;
+    size_t refLength = length - MP_FORMAT_ID_LENGTH;
+    uint32_t ifdOffset, count, tagCount, tagValue, entryCount;
+    uint16_t tagID, tagType;
+    const uint8_t* p;
+    bool littleEndian;
+
+    if (refLength < 8) {
+        return RESULT_OK;
+    }
+
+    memset(mpo, 0, sizeof(*mpo));
+    mHeader.hasMpo = true;
+    // Segment length field plus the MP format identifier
+    mpo->tiffOffset = offset + 2 + MP_FORMAT_ID_LENGTH;
+
+    littleEndian = ('I' == ref[0]) && ('I' == ref[1]);
+    ifdOffset = read32(ref + 4, littleEndian);
+
+    for (int ifd = 0; (ifd < MAX_MP_IFDS) && ifdOffset; ifd++) {
+        if ((ifdOffset > refLength) || (refLength - ifdOffset < 2)) {
+            break;
+        }
+
+        p = ref + ifdOffset;
+        count = read16(p, littleEndian);
+        p += 2;
+
+        for (uint32_t j = 0; j < count; j++) {
+            if ((size_t)(ref + refLength - p) < MP_TAG_SIZE) {
+                return RESULT_OK;
+            }
+
+            tagID = read16(p, littleEndian);
+            tagType = read16(p + 2, littleEndian);
+            tagCount = read32(p + 4, littleEndian);
+            tagValue = read32(p + 8, littleEndian);
+            p += MP_TAG_SIZE;
+
+            switch (tagID) {
+                case TAGID_MPFVERSION:
+                    if (TAG_TYPE_UNDEFINED != tagType)
+                        return RESULT_INVALID;
+                    mpo->version = tagValue;
+                    break;
+
+                case TAGID_NIMAGES:
+                    if (TAG_TYPE_LONG != tagType)
+                        return RESULT_INVALID;
+                    mpo->numberOfImages = tagValue;
+                    break;
+
+                case TAGID_MPENTRY:
+                    if (TAG_TYPE_UNDEFINED != tagType)
+                        return RESULT_INVALID;
+
+                    entryCount = tagCount / MP_ENTRY_SIZE;
+                    mpo->numEntries = 0;
+                    for (uint32_t i = 0; (i < entryCount) && (i < MAX_MP_ENTRIES); i++) {
+                        const uint8_t* entry;
+                        if ((tagValue > refLength) || ((refLength - tagValue) / MP_ENTRY_SIZE <= i)) {
+                            break;
+                        }
+
+                        entry = ref + tagValue + i * MP_ENTRY_SIZE;
+                        mpo->entries[i].imageAttribute = read32(entry, littleEndian);
+                        mpo->entries[i].imageSize = read32(entry + 4, littleEndian);
+                        mpo->entries[i].dataOffset = read32(entry + 8, littleEndian);
+                        mpo->entries[i].dependentImage1 = read16(entry + 12, littleEndian);
+                        mpo->entries[i].dependentImage2 = read16(entry + 14, littleEndian);
+                        mpo->numEntries++;
+                    }
+                    break;
+
+                case TAGID_UIDLIST:
+                    if (TAG_TYPE_UNDEFINED != tagType)
+                        return RESULT_INVALID;
+                    break;
+
+                case TAGID_TFRAMES:
+                    if (TAG_TYPE_LONG != tagType)
+                        return RESULT_INVALID;
+                    mpo->totalFrames = tagValue;
+                    break;
+
+                case TAGID_MPIMAGENUM:
+                    if (TAG_TYPE_LONG != tagType)
+                        return RESULT_INVALID;
+                    mpo->individualNum = tagValue;
+                    break;
+
+                case TAGID_PANSCANORIENTATION:
+                    if (TAG_TYPE_LONG != tagType)
+                        return RESULT_INVALID;
+                    break;
+
+                case TAGID_BVPOINTNUM:
+                    if (TAG_TYPE_LONG != tagType)
+                        return RESULT_INVALID;
+                    mpo->baseViewpointNum = tagValue;
+                    break;
+
+                case TAGID_CONVANG:
+                    if (TAG_TYPE_SRATIONAL != tagType)
+                        return RESULT_INVALID;
+                    mpo->convergenceAngle = tagValue;
+                    break;
+
+                case TAGID_BASELINELEN:
+                    if (TAG_TYPE_RATIONAL != tagType)
+                        return RESULT_INVALID;
+                    mpo->baselineLength = tagValue;
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        // Offset of the next IFD, the attribute IFD follows the index IFD
+        if ((size_t)(ref + refLength - p) < 4) {
+            break;
+        }
+        ifdOffset = read32(p, littleEndian);
+    }
+
+    return RESULT_OK;
+}
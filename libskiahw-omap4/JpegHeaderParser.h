@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef JpegHeaderParser_DEFINED
+#define JpegHeaderParser_DEFINED
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** Scans the markers of a JPEG stream up to the first SOS.
+    The stream is read in chunks into a fixed window, segments which aren't
+    needed are skipped by length and nothing is allocated, so the parser can
+    be run on every gallery thumbnail.
+    Everything here is plain C++, JpegHeaderParserTest builds it on the host.
+*/
+class JpegHeaderParser {
+public:
+    enum {
+        WINDOW_SIZE = 4096,     // segments longer than this are only seen up to WINDOW_SIZE bytes
+        MAX_SEGMENTS = 24,
+        MAX_COMPONENTS = 4,
+        MAX_MP_ENTRIES = 8,
+        MAX_MP_IFDS = 4,
+    };
+
+    enum Result {
+        RESULT_OK = 0,          // reached the first scan
+        RESULT_NOT_JPEG,
+        RESULT_NO_IMAGE,        // EOI before any scan
+        RESULT_TRUNCATED,
+        RESULT_INVALID,
+    };
+
+    /** Where the bytes come from, skip() must not need a buffer from the caller */
+    class Source {
+    public:
+        virtual ~Source() {}
+        virtual size_t read(void* buffer, size_t size) = 0;
+        virtual size_t skip(size_t size) = 0;
+    };
+
+    /** DQT, DHT, SOFn, DRI and APPn segments, the offset is the one of the
+        length field in the stream */
+    struct Segment {
+        uint8_t marker;
+        uint16_t length;
+        uint32_t offset;
+    };
+
+    struct Component {
+        uint8_t id;
+        uint8_t h;
+        uint8_t v;
+        uint8_t tq;
+    };
+
+    struct Frame {
+        uint8_t marker;
+        uint8_t precision;
+        uint16_t width;
+        uint16_t height;
+        uint8_t numComponents;      // as in the stream, only MAX_COMPONENTS are kept
+        Component components[MAX_COMPONENTS];
+    };
+
+    /** JPS stereo descriptor (APP3 "_JPSJPS_") */
+    struct Jps {
+        uint8_t type;
+        uint8_t layout;
+        uint8_t miscFlags;
+        uint8_t separation;
+    };
+
+    struct MpEntry {
+        uint32_t imageAttribute;
+        uint32_t imageSize;
+        uint32_t dataOffset;        // relative to Mpo::tiffOffset
+        uint16_t dependentImage1;
+        uint16_t dependentImage2;
+    };
+
+    /** Multi Picture index (APP2 "MPF") of the first image */
+    struct Mpo {
+        uint32_t tiffOffset;        // stream offset of the MP header, the base of the MP entry offsets
+        uint32_t version;
+        uint32_t numberOfImages;
+        uint32_t totalFrames;
+        uint32_t individualNum;
+        uint32_t baseViewpointNum;
+        uint32_t convergenceAngle;
+        uint32_t baselineLength;
+        uint32_t numEntries;        // entries kept, at most MAX_MP_ENTRIES
+        MpEntry entries[MAX_MP_ENTRIES];
+    };
+
+    struct Header {
+        bool hasFrame;
+        bool progressive;
+        bool hasJps;
+        bool hasMpo;
+        uint16_t restartInterval;
+        uint32_t scanOffset;        // stream offset of the SOS marker
+        Frame frame;
+        Jps jps;
+        Mpo mpo;
+        uint32_t numSegments;
+        Segment segments[MAX_SEGMENTS];
+    };
+
+    JpegHeaderParser();
+
+    /** Parses from the current position of source, which has to be the SOI */
+    Result parse(Source* source);
+
+    const Header& header() const { return mHeader; }
+
+private:
+    bool fill(size_t size);
+    bool skip(size_t size);
+    void consume(size_t size);
+    size_t available() const { return mEnd - mStart; }
+    const uint8_t* data() const { return mWindow + mStart; }
+
+    Result parseSegment(uint8_t marker, const uint8_t* payload, size_t length, uint32_t offset);
+    void parseFrame(uint8_t marker, const uint8_t* payload, size_t length);
+    Result parseJps(const uint8_t* payload, size_t length);
+    Result parseMpo(const uint8_t* payload, size_t length, uint32_t offset);
+
+    Source* mSource;
+    uint8_t mWindow[WINDOW_SIZE];
+    size_t mStart, mEnd;            // valid bytes of the window
+    uint32_t mOffset;               // stream offset of mWindow[mStart]
+    Header mHeader;
+};
+
+#endif
@@ -0,0 +1,347 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Host test for JpegHeaderParser. Checks the fields parsed out of synthetic
+ * JPEG, JPS and MPO headers, then fuzzes the parser with mutated copies of
+ * them. Every input is parsed twice, once read a single byte at a time and
+ * once in random chunks, and both runs have to agree. Build it with
+ * -fsanitize=address to catch out of bounds reads.
+ *
+ * usage: JpegHeaderParserTest [iterations] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "JpegHeaderParser.h"
+
+#define MAX_INPUT   (64 * 1024)
+
+class MemorySource : public JpegHeaderParser::Source {
+public:
+    MemorySource(const uint8_t* data, size_t size, size_t chunk)
+        : mData(data), mSize(size), mPos(0), mChunk(chunk) { }
+
+    virtual size_t read(void* buffer, size_t size) {
+        size_t n = size;
+        if (mChunk && (n > mChunk))
+            n = 1 + rand() % mChunk;
+        if (n > mSize - mPos)
+            n = mSize - mPos;
+        memcpy(buffer, mData + mPos, n);
+        mPos += n;
+        return n;
+    }
+
+    virtual size_t skip(size_t size) {
+        if (size > mSize - mPos)
+            size = mSize - mPos;
+        mPos += size;
+        return size;
+    }
+
+private:
+    const uint8_t* mData;
+    size_t mSize, mPos, mChunk;
+};
+
+class Writer {
+public:
+    Writer() : size(0) { }
+
+    void u8(int v) { if (size < MAX_INPUT) buf[size++] = (uint8_t)v; }
+    void be16(int v) { u8(v >> 8); u8(v); }
+    void le16(int v) { u8(v); u8(v >> 8); }
+    void be32(uint32_t v) { be16(v >> 16); be16(v & 0xFFFF); }
+    void le32(uint32_t v) { le16(v & 0xFFFF); le16(v >> 16); }
+    void u16(int v, bool le) { if (le) le16(v); else be16(v); }
+    void u32(uint32_t v, bool le) { if (le) le32(v); else be32(v); }
+    void bytes(const void* p, size_t n) { for (size_t i = 0; i < n; i++) u8(((const uint8_t*)p)[i]); }
+    void marker(int m) { u8(0xFF); u8(m); }
+    void segment(int m, size_t payload) { marker(m); be16(payload + 2); }
+    void fill(int v, size_t n) { for (size_t i = 0; i < n; i++) u8(v); }
+
+    uint8_t buf[MAX_INPUT];
+    size_t size;
+};
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+static JpegHeaderParser parser, reference;
+
+static JpegHeaderParser::Result parse(JpegHeaderParser* p, const uint8_t* data, size_t size, size_t chunk) {
+    MemorySource source(data, size, chunk);
+    return p->parse(&source);
+}
+
+static void writeFrame(Writer* w, int sof, int width, int height) {
+    w->segment(sof, 6 + 3 * 3);
+    w->u8(8);
+    w->be16(height);
+    w->be16(width);
+    w->u8(3);
+    w->u8(1); w->u8(0x22); w->u8(0);
+    w->u8(2); w->u8(0x11); w->u8(1);
+    w->u8(3); w->u8(0x11); w->u8(1);
+}
+
+static void writeTables(Writer* w) {
+    w->segment(0xDB, 65);
+    w->u8(0);
+    w->fill(1, 64);
+    w->segment(0xC4, 17 + 12);
+    w->u8(0);
+    w->fill(0, 16);
+    w->fill(0, 12);
+}
+
+static void writeScan(Writer* w) {
+    w->segment(0xDA, 10);
+    w->fill(0, 10);
+    w->fill(0x55, 64);
+    w->marker(0xD9);
+}
+
+static void writeBaseline(Writer* w) {
+    w->marker(0xD8);
+    w->segment(0xE0, 14);
+    w->bytes("JFIF\0\1\1\0\0\1\0\1\0\0", 14);
+    // Larger than the window, has to be skipped through the source
+    w->segment(0xE1, 10000);
+    w->bytes("Exif\0\0", 6);
+    w->fill(0xAB, 10000 - 6);
+    writeTables(w);
+    w->segment(0xDD, 2);
+    w->be16(16);
+    writeFrame(w, 0xC0, 640, 480);
+    writeScan(w);
+}
+
+static void writeJps(Writer* w) {
+    w->marker(0xD8);
+    w->segment(0xE3, 16);
+    w->bytes("_JPSJPS_", 8);
+    w->be16(4);                     // descriptor length
+    w->u8(0);                       // separation
+    w->u8(0x05);                    // misc flags
+    w->u8(0x02);                    // layout
+    w->u8(0x01);                    // type
+    w->fill(0, 2);
+    writeTables(w);
+    writeFrame(w, 0xC0, 1280, 720);
+    writeScan(w);
+}
+
+/* MP header with an index IFD holding two entries and an attribute IFD */
+static void writeMpo(Writer* w, bool le) {
+    const size_t indexIFD = 8, indexTags = 3, attrTags = 2;
+    const size_t entries = indexIFD + 2 + indexTags * 12 + 4;
+    const size_t attrIFD = entries + 2 * 16;
+    const size_t total = attrIFD + 2 + attrTags * 12 + 4;
+
+    w->marker(0xD8);
+    w->segment(0xE2, 4 + total);
+    w->bytes("MPF\0", 4);
+    w->bytes(le ? "II" : "MM", 2);
+    w->u16(0x2A, le);
+    w->u32(indexIFD, le);
+
+    w->u16(indexTags, le);
+    w->u16(0xB000, le); w->u16(7, le); w->u32(4, le); w->bytes("0100", 4);
+    w->u16(0xB001, le); w->u16(4, le); w->u32(1, le); w->u32(2, le);
+    w->u16(0xB002, le); w->u16(7, le); w->u32(32, le); w->u32(entries, le);
+    w->u32(attrIFD, le);
+
+    w->u32(0x20030000, le); w->u32(100000, le); w->u32(0, le); w->u16(0, le); w->u16(0, le);
+    w->u32(0x00020002, le); w->u32(90000, le); w->u32(123456, le); w->u16(0, le); w->u16(0, le);
+
+    w->u16(attrTags, le);
+    w->u16(0xB101, le); w->u16(4, le); w->u32(1, le); w->u32(1, le);
+    w->u16(0xB204, le); w->u16(4, le); w->u32(1, le); w->u32(1, le);
+    w->u32(0, le);
+
+    writeTables(w);
+    writeFrame(w, 0xC0, 1920, 1080);
+    writeScan(w);
+}
+
+static void testBaseline() {
+    Writer w;
+    writeBaseline(&w);
+
+    CHECK(JpegHeaderParser::RESULT_OK == parse(&parser, w.buf, w.size, 0));
+    const JpegHeaderParser::Header& h = parser.header();
+    CHECK(h.hasFrame && !h.progressive && !h.hasJps && !h.hasMpo);
+    CHECK(640 == h.frame.width && 480 == h.frame.height && 3 == h.frame.numComponents);
+    CHECK(2 == h.frame.components[0].h && 2 == h.frame.components[0].v && 1 == h.frame.components[1].h);
+    CHECK(16 == h.restartInterval);
+    CHECK(0xFF == w.buf[h.scanOffset] && 0xDA == w.buf[h.scanOffset + 1]);
+    // APP0, APP1, DQT, DHT, DRI, SOF0
+    CHECK(6 == h.numSegments);
+    for (uint32_t i = 0; i < h.numSegments; i++) {
+        CHECK(h.segments[i].marker == w.buf[h.segments[i].offset - 1]);
+        CHECK(h.segments[i].length == ((w.buf[h.segments[i].offset] << 8) | w.buf[h.segments[i].offset + 1]));
+    }
+
+    // Truncated anywhere before the scan never parses
+    for (size_t size = 0; size < h.scanOffset + 2; size += 7) {
+        CHECK(JpegHeaderParser::RESULT_OK != parse(&reference, w.buf, size, 3));
+    }
+}
+
+static void testFillAndProgressive() {
+    Writer w;
+    w.marker(0xD8);
+    w.fill(0xFF, 5);
+    writeFrame(&w, 0xC2, 33, 17);
+    w.fill(0xFF, 3);
+    writeScan(&w);
+
+    CHECK(JpegHeaderParser::RESULT_OK == parse(&parser, w.buf, w.size, 0));
+    CHECK(parser.header().progressive && 33 == parser.header().frame.width);
+
+    Writer eoi;
+    eoi.marker(0xD8);
+    writeTables(&eoi);
+    eoi.marker(0xD9);
+    CHECK(JpegHeaderParser::RESULT_NO_IMAGE == parse(&parser, eoi.buf, eoi.size, 0));
+
+    CHECK(JpegHeaderParser::RESULT_NOT_JPEG == parse(&parser, eoi.buf + 2, eoi.size - 2, 0));
+}
+
+static void testJps() {
+    Writer w;
+    writeJps(&w);
+
+    CHECK(JpegHeaderParser::RESULT_OK == parse(&parser, w.buf, w.size, 0));
+    const JpegHeaderParser::Header& h = parser.header();
+    CHECK(h.hasJps && 1 == h.jps.type && 2 == h.jps.layout && 5 == h.jps.miscFlags && 0 == h.jps.separation);
+
+    // An APP3 which isn't a JPS descriptor is refused
+    w.buf[6] = 'X';
+    CHECK(JpegHeaderParser::RESULT_INVALID == parse(&parser, w.buf, w.size, 0));
+}
+
+static void testMpo(bool le) {
+    Writer w;
+    writeMpo(&w, le);
+
+    CHECK(JpegHeaderParser::RESULT_OK == parse(&parser, w.buf, w.size, 0));
+    const JpegHeaderParser::Mpo& m = parser.header().mpo;
+    CHECK(parser.header().hasMpo);
+    CHECK(2 + 2 + 2 + 4 == m.tiffOffset);
+    CHECK(2 == m.numberOfImages && 2 == m.numEntries);
+    CHECK(100000 == m.entries[0].imageSize && 123456 == m.entries[1].dataOffset);
+    CHECK(0x00020002 == m.entries[1].imageAttribute);
+    CHECK(1 == m.individualNum && 1 == m.baseViewpointNum);
+    CHECK(1920 == parser.header().frame.width);
+}
+
+static uint32_t lcg(uint32_t* state) {
+    *state = *state * 1103515245 + 12345;
+    return *state >> 8;
+}
+
+static void fuzz(int iterations, uint32_t seed) {
+    static Writer seeds[5];
+    static uint8_t input[MAX_INPUT];
+    int ok = 0;
+
+    writeBaseline(&seeds[0]);
+    writeJps(&seeds[1]);
+    writeMpo(&seeds[2], true);
+    writeMpo(&seeds[3], false);
+    writeFrame(&seeds[4], 0xC0, 1, 1);      // no SOI, random bytes get appended
+
+    srand(seed);
+
+    for (int n = 0; n < iterations; n++) {
+        const Writer* s = &seeds[lcg(&seed) % 5];
+        size_t size = s->size;
+        memcpy(input, s->buf, size);
+
+        int mutations = 1 + lcg(&seed) % 8;
+        for (int m = 0; m < mutations; m++) {
+            size_t pos = size ? lcg(&seed) % size : 0;
+            switch (lcg(&seed) % 6) {
+                case 0: input[pos] = lcg(&seed); break;
+                case 1: input[pos] ^= 1 << (lcg(&seed) % 8); break;
+                case 2: input[pos] = 0xFF; break;
+                case 3: input[pos] = 0x00; break;
+                case 4: size = pos; break;
+                case 5:
+                    while (size < MAX_INPUT && (lcg(&seed) % 16))
+                        input[size++] = lcg(&seed);
+                    break;
+            }
+        }
+
+        JpegHeaderParser::Result r1 = parse(&reference, input, size, 1);
+        JpegHeaderParser::Result r2 = parse(&parser, input, size, 1 + lcg(&seed) % 5000);
+
+        if ((r1 != r2) || memcmp(&reference.header(), &parser.header(), sizeof(JpegHeaderParser::Header))) {
+            printf("FAIL iteration %d: results differ between chunk sizes (%d, %d)\n", n, r1, r2);
+            failures++;
+            continue;
+        }
+
+        const JpegHeaderParser::Header& h = parser.header();
+        if (h.numSegments > JpegHeaderParser::MAX_SEGMENTS || h.mpo.numEntries > JpegHeaderParser::MAX_MP_ENTRIES) {
+            printf("FAIL iteration %d: counts out of range\n", n);
+            failures++;
+        }
+
+        if (JpegHeaderParser::RESULT_OK == r1) {
+            ok++;
+            if ((h.scanOffset + 2 > size) || (0xDA != input[h.scanOffset + 1])) {
+                printf("FAIL iteration %d: bad scan offset %u\n", n, h.scanOffset);
+                failures++;
+            }
+            for (uint32_t i = 0; i < h.numSegments; i++) {
+                if (h.segments[i].offset + h.segments[i].length > size) {
+                    printf("FAIL iteration %d: segment %u out of the input\n", n, i);
+                    failures++;
+                }
+            }
+        }
+    }
+
+    printf("%d fuzz iterations, %d parsed up to a scan\n", iterations, ok);
+}
+
+int main(int argc, char** argv) {
+    int iterations = (argc > 1) ? atoi(argv[1]) : 100000;
+    uint32_t seed = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1;
+
+    testBaseline();
+    testFillAndProgressive();
+    testJps();
+    testMpo(true);
+    testMpo(false);
+    fuzz(iterations, seed);
+
+    printf("%s, %d failures\n", failures ? "FAIL" : "PASS", failures);
+
+    return failures ? 1 : 0;
+}
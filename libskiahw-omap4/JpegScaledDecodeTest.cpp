@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Host test of the DCT domain downscaling used for sample sizes above 1,
+ * against the libjpeg of the host. Synthetic images are encoded, decoded at
+ * full size and at 1/2, 1/4 and 1/8, and every scaled decode has to:
+ * - come out with the size JpegDecoderSession::scaledSize() gives the
+ *   bitmap, so SIMCOP and ARM decodes report the same bounds;
+ * - stay within a PSNR threshold of the full decode reduced by a box
+ *   filter of the same ratio.
+ *
+ * usage: JpegScaledDecodeTest
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "JpegDecoderSession.h"
+
+extern "C" {
+#include <jpeglib.h>
+};
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+struct Case {
+    int width;
+    int height;
+    int subsampled;     // 4:2:0 when set, 4:4:4 otherwise
+};
+
+/* Lowest PSNR allowed against the box filtered full decode, in dB */
+static const struct {
+    int scale;
+    double minPsnr;
+} kScales[] = {
+    { 2, 52.0 },
+    { 4, 50.0 },
+    { 8, 50.0 },
+};
+
+/* ---------------------------------------------------------------- in memory libjpeg streams */
+
+struct MemoryDest {
+    struct jpeg_destination_mgr pub;
+    JOCTET* data;
+    size_t capacity;
+    size_t size;
+};
+
+static void initDestination(j_compress_ptr cinfo) {
+    MemoryDest* dest = (MemoryDest*)cinfo->dest;
+
+    dest->pub.next_output_byte = dest->data;
+    dest->pub.free_in_buffer = dest->capacity;
+}
+
+static boolean emptyOutputBuffer(j_compress_ptr cinfo) {
+    MemoryDest* dest = (MemoryDest*)cinfo->dest;
+    size_t used = dest->capacity;
+
+    dest->capacity *= 2;
+    dest->data = (JOCTET*)realloc(dest->data, dest->capacity);
+    dest->pub.next_output_byte = dest->data + used;
+    dest->pub.free_in_buffer = dest->capacity - used;
+
+    return TRUE;
+}
+
+static void termDestination(j_compress_ptr cinfo) {
+    MemoryDest* dest = (MemoryDest*)cinfo->dest;
+
+    dest->size = dest->capacity - dest->pub.free_in_buffer;
+}
+
+static void initSource(j_decompress_ptr cinfo) {
+}
+
+static boolean fillInputBuffer(j_decompress_ptr cinfo) {
+    static const JOCTET eoi[2] = { 0xFF, JPEG_EOI };
+
+    // Truncated stream, end it
+    cinfo->src->next_input_byte = eoi;
+    cinfo->src->bytes_in_buffer = 2;
+
+    return TRUE;
+}
+
+static void skipInputData(j_decompress_ptr cinfo, long count) {
+    if (count > (long)cinfo->src->bytes_in_buffer)
+        count = cinfo->src->bytes_in_buffer;
+    cinfo->src->next_input_byte += count;
+    cinfo->src->bytes_in_buffer -= count;
+}
+
+static void termSource(j_decompress_ptr cinfo) {
+}
+
+/* ---------------------------------------------------------------- encode and decode */
+
+/* Smooth gradients with some texture, the kind of content photos have */
+static uint8_t pattern(int x, int y, int channel) {
+    double v = 128 + 60 * sin(x * 0.013) * cos(y * 0.017) + 40 * sin((x + y) * 0.004);
+
+    switch (channel) {
+        case 0:
+            return (uint8_t)v;
+        case 1:
+            return (uint8_t)(255 - v * 0.7);
+        default:
+            return (uint8_t)((int)(v + ((x * 31 + y * 17) % 9)) & 255);
+    }
+}
+
+static MemoryDest encode(const Case& c) {
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    MemoryDest dest;
+    JSAMPROW row = (JSAMPROW)malloc(c.width * 3);
+
+    memset(&dest, 0, sizeof(dest));
+    dest.capacity = 64 * 1024;
+    dest.data = (JOCTET*)malloc(dest.capacity);
+    dest.pub.init_destination = initDestination;
+    dest.pub.empty_output_buffer = emptyOutputBuffer;
+    dest.pub.term_destination = termDestination;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    cinfo.dest = &dest.pub;
+    cinfo.image_width = c.width;
+    cinfo.image_height = c.height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 90, TRUE);
+    if (!c.subsampled) {
+        cinfo.comp_info[0].h_samp_factor = 1;
+        cinfo.comp_info[0].v_samp_factor = 1;
+    }
+
+    jpeg_start_compress(&cinfo, TRUE);
+    for (int y = 0; y < c.height; y++) {
+        for (int x = 0; x < c.width; x++) {
+            for (int k = 0; k < 3; k++)
+                row[x * 3 + k] = pattern(x, y, k);
+        }
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    free(row);
+
+    return dest;
+}
+
+/* Decodes to RGB at 1/scale, the caller frees the pixels */
+static uint8_t* decode(const MemoryDest& stream, int scale, int* width, int* height) {
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    struct jpeg_source_mgr src;
+    uint8_t* pixels;
+
+    memset(&src, 0, sizeof(src));
+    src.init_source = initSource;
+    src.fill_input_buffer = fillInputBuffer;
+    src.skip_input_data = skipInputData;
+    src.resync_to_restart = jpeg_resync_to_restart;
+    src.term_source = termSource;
+    src.next_input_byte = stream.data;
+    src.bytes_in_buffer = stream.size;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    cinfo.src = &src;
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scale;
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+
+    *width = cinfo.output_width;
+    *height = cinfo.output_height;
+    pixels = (uint8_t*)malloc(*width * *height * 3);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = pixels + cinfo.output_scanline * *width * 3;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+
+    return pixels;
+}
+
+/* PSNR of the scaled decode against the box filtered full one, over the complete boxes only */
+static double psnr(const uint8_t* full, int fullWidth, int fullHeight,
+                   const uint8_t* scaled, int width, int height, int scale) {
+    double error = 0;
+    long samples = 0;
+
+    for (int y = 0; (y < height) && ((y + 1) * scale <= fullHeight); y++) {
+        for (int x = 0; (x < width) && ((x + 1) * scale <= fullWidth); x++) {
+            for (int k = 0; k < 3; k++) {
+                double mean = 0, diff;
+
+                for (int j = 0; j < scale; j++) {
+                    for (int i = 0; i < scale; i++)
+                        mean += full[((y * scale + j) * fullWidth + x * scale + i) * 3 + k];
+                }
+                mean /= scale * scale;
+
+                diff = mean - scaled[(y * width + x) * 3 + k];
+                error += diff * diff;
+                samples++;
+            }
+        }
+    }
+
+    if ((0 == samples) || (0 == error))
+        return 99.0;
+
+    return 10 * log10(255.0 * 255.0 / (error / samples));
+}
+
+static void testCase(const Case& c) {
+    MemoryDest stream = encode(c);
+    int fullWidth, fullHeight;
+    uint8_t* full = decode(stream, 1, &fullWidth, &fullHeight);
+
+    CHECK(fullWidth == c.width && fullHeight == c.height);
+
+    for (unsigned int i = 0; i < sizeof(kScales) / sizeof(kScales[0]); i++) {
+        int scale = kScales[i].scale;
+        int width, height;
+        uint8_t* scaled = decode(stream, scale, &width, &height);
+        double value;
+
+        // The bitmap is set up with these bounds before either decoder runs
+        CHECK((OMX_U32)width == JpegDecoderSession::scaledSize(c.width, scale));
+        CHECK((OMX_U32)height == JpegDecoderSession::scaledSize(c.height, scale));
+
+        value = psnr(full, fullWidth, fullHeight, scaled, width, height, scale);
+        printf("%dx%d %s 1/%d: %dx%d, %.1f dB\n", c.width, c.height, c.subsampled ? "4:2:0" : "4:4:4",
+               scale, width, height, value);
+        CHECK(value >= kScales[i].minPsnr);
+
+        free(scaled);
+    }
+
+    free(full);
+    free(stream.data);
+}
+
+int main(int argc, char** argv) {
+    static const Case cases[] = {
+        { 1600, 1200, 1 },
+        { 1001, 767, 1 },
+        { 643, 481, 0 },
+    };
+
+    for (unsigned int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        testCase(cases[i]);
+
+    printf("%s, %d failures\n", failures ? "FAIL" : "PASS", failures);
+
+    return failures ? 1 : 0;
+}
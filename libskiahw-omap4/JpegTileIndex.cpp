@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "JpegTileIndex.h"
+
+enum {
+    M_SOF0 = 0xC0,
+    M_SOF1 = 0xC1,
+    M_SOF15 = 0xCF,
+    M_DHT = 0xC4,
+    M_JPG = 0xC8,
+    M_DAC = 0xCC,
+    M_RST0 = 0xD0,
+    M_RST7 = 0xD7,
+    M_SOI = 0xD8,
+    M_EOI = 0xD9,
+    M_SOS = 0xDA,
+    M_APP1 = 0xE1,
+    M_COM = 0xFE,
+    M_TEM = 0x01,
+};
+
+static inline uint32_t read16(const uint8_t* p) {
+    return (p[0] << 8) | p[1];
+}
+
+static inline void write16(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+JpegTileIndex::JpegTileIndex()
+    : mData(NULL), mSize(0), mWidth(0), mHeight(0), mMcuWidth(0), mMcuHeight(0),
+      mMcuRows(0), mColumns(0), mHeader(NULL), mHeaderSize(0), mFrameOffset(0),
+      mIntervals(NULL), mNumIntervals(0) {
+}
+
+JpegTileIndex::~JpegTileIndex() {
+    reset();
+}
+
+void JpegTileIndex::reset() {
+    free(mHeader);
+    free(mIntervals);
+    mHeader = NULL;
+    mIntervals = NULL;
+    mHeaderSize = 0;
+    mNumIntervals = 0;
+    mData = NULL;
+    mSize = 0;
+    mWidth = mHeight = 0;
+}
+
+bool JpegTileIndex::build(const uint8_t* data, size_t size, const JpegHeaderParser::Header& header) {
+    const JpegHeaderParser::Frame& frame = header.frame;
+    uint32_t mcusPerRow;
+    int hmax = 0, vmax = 0;
+
+    reset();
+
+    if (!header.hasFrame || header.progressive || !header.restartInterval ||
+            ((M_SOF0 != frame.marker) && (M_SOF1 != frame.marker))) {
+        return false;
+    }
+    if (!frame.width || !frame.height || !frame.numComponents ||
+            (frame.numComponents > JpegHeaderParser::MAX_COMPONENTS)) {
+        return false;
+    }
+
+    // A single component scan isn't interleaved, its MCU is one block whatever the sampling
+    if (1 == frame.numComponents) {
+        hmax = vmax = 1;
+    } else {
+        for (int i = 0; i < frame.numComponents; i++) {
+            if (!frame.components[i].h || !frame.components[i].v) {
+                return false;
+            }
+            if (frame.components[i].h > hmax) hmax = frame.components[i].h;
+            if (frame.components[i].v > vmax) vmax = frame.components[i].v;
+        }
+    }
+
+    mMcuWidth = 8 * hmax;
+    mMcuHeight = 8 * vmax;
+    mcusPerRow = (frame.width + mMcuWidth - 1) / mMcuWidth;
+    mMcuRows = (frame.height + mMcuHeight - 1) / mMcuHeight;
+
+    if (mcusPerRow % header.restartInterval) {
+        return false;
+    }
+    mColumns = mcusPerRow / header.restartInterval;
+
+    mData = data;
+    mSize = size;
+    mWidth = frame.width;
+    mHeight = frame.height;
+
+    if (!buildHeader(header)) {
+        reset();
+        return false;
+    }
+
+    return true;
+}
+
+bool JpegTileIndex::buildHeader(const JpegHeaderParser::Header& header) {
+    uint32_t pos = 2, scan = header.scanOffset;
+    uint32_t length;
+    uint8_t marker;
+
+    if ((mSize < 4) || (scan + 5 > mSize) || (0xFF != mData[0]) || (M_SOI != mData[1])) {
+        return false;
+    }
+
+    // Everything before the SOS fits. APP1 (EXIF, XMP) and COM are dropped on the way, the other
+    // APPn stay: JFIF and Adobe (APP14) tell the decoder which colour transform to apply
+    length = read16(mData + scan + 2);
+    if ((length < 3) || (scan + 2 + length > mSize)) {
+        return false;
+    }
+    // Only an interleaved scan of every component can be cut
+    if (mData[scan + 4] != header.frame.numComponents) {
+        return false;
+    }
+
+    mHeader = (uint8_t*)malloc(scan + 2 + length);
+    if (NULL == mHeader) {
+        return false;
+    }
+    mHeader[0] = 0xFF;
+    mHeader[1] = M_SOI;
+    mHeaderSize = 2;
+    mFrameOffset = 0;
+
+    while (pos < scan) {
+        if (0xFF != mData[pos]) {
+            return false;
+        }
+        if (0xFF == mData[pos + 1]) {
+            pos++;
+            continue;
+        }
+
+        marker = mData[pos + 1];
+        if ((M_SOI == marker) || (M_TEM == marker) || ((marker >= M_RST0) && (marker <= M_RST7))) {
+            pos += 2;
+            continue;
+        }
+
+        length = read16(mData + pos + 2);
+        if ((length < 2) || (pos + 2 + length > scan)) {
+            return false;
+        }
+
+        if ((marker >= M_SOF0) && (marker <= M_SOF15) && (M_DHT != marker) && (M_JPG != marker) && (M_DAC != marker)) {
+            if (length < 8) {
+                return false;
+            }
+            mFrameOffset = mHeaderSize;
+        }
+
+        if ((M_APP1 != marker) && (M_COM != marker)) {
+            memcpy(mHeader + mHeaderSize, mData + pos, 2 + length);
+            mHeaderSize += 2 + length;
+        }
+        pos += 2 + length;
+    }
+
+    if (!mFrameOffset) {
+        return false;
+    }
+
+    length = read16(mData + scan + 2);
+    memcpy(mHeader + mHeaderSize, mData + scan, 2 + length);
+    mHeaderSize += 2 + length;
+
+    return buildIntervals(scan + 2 + length);
+}
+
+bool JpegTileIndex::buildIntervals(uint32_t offset) {
+    uint32_t count = mMcuRows * mColumns;
+    uint32_t pos = offset, start = offset;
+    const uint8_t* p;
+    uint8_t marker;
+
+    mIntervals = (uint32_t*)malloc(2 * count * sizeof(uint32_t));
+    if (NULL == mIntervals) {
+        return false;
+    }
+    mNumIntervals = 0;
+
+    while (pos + 1 < mSize) {
+        p = (const uint8_t*)memchr(mData + pos, 0xFF, mSize - pos - 1);
+        if (NULL == p) {
+            pos = mSize;
+            break;
+        }
+        pos = p - mData;
+
+        marker = mData[pos + 1];
+        if (0x00 == marker) {
+            // Stuffed 0xFF
+            pos += 2;
+            continue;
+        }
+        if (0xFF == marker) {
+            // Fill byte
+            pos++;
+            continue;
+        }
+        if ((marker < M_RST0) || (marker > M_RST7)) {
+            // EOI, or whatever ends the scan
+            break;
+        }
+
+        if (mNumIntervals + 1 >= count) {
+            return false;
+        }
+        mIntervals[2 * mNumIntervals] = start;
+        mIntervals[2 * mNumIntervals + 1] = pos;
+        mNumIntervals++;
+        pos += 2;
+        start = pos;
+    }
+
+    if (pos > mSize) {
+        pos = mSize;
+    }
+    mIntervals[2 * mNumIntervals] = start;
+    mIntervals[2 * mNumIntervals + 1] = pos;
+    mNumIntervals++;
+
+    return mNumIntervals == count;
+}
+
+uint32_t JpegTileIndex::intervalSize(uint32_t row, uint32_t column) const {
+    const uint32_t* interval = mIntervals + 2 * (row * mColumns + column);
+
+    return interval[1] - interval[0];
+}
+
+bool JpegTileIndex::locate(int left, int top, int right, int bottom, Tile* tile) const {
+    int columnWidth, bottomEdge, rightEdge;
+
+    if (!isValid()) {
+        return false;
+    }
+
+    if (left < 0) left = 0;
+    if (top < 0) top = 0;
+    if (right > mWidth) right = mWidth;
+    if (bottom > mHeight) bottom = mHeight;
+    if ((left >= right) || (top >= bottom)) {
+        return false;
+    }
+
+    columnWidth = mMcuWidth * (((mWidth + mMcuWidth - 1) / mMcuWidth) / mColumns);
+
+    tile->firstColumn = left / columnWidth;
+    tile->lastColumn = (right + columnWidth - 1) / columnWidth;
+    tile->firstRow = top / mMcuHeight;
+    tile->lastRow = (bottom + mMcuHeight - 1) / mMcuHeight;
+
+    tile->x = tile->firstColumn * columnWidth;
+    tile->y = tile->firstRow * mMcuHeight;
+    rightEdge = tile->lastColumn * columnWidth;
+    bottomEdge = tile->lastRow * mMcuHeight;
+    tile->width = ((rightEdge < mWidth) ? rightEdge : mWidth) - tile->x;
+    tile->height = ((bottomEdge < mHeight) ? bottomEdge : mHeight) - tile->y;
+
+    // Header, intervals with an RSTn between each of them, EOI
+    tile->size = mHeaderSize + 2;
+    for (uint32_t row = tile->firstRow; row < tile->lastRow; row++) {
+        for (uint32_t column = tile->firstColumn; column < tile->lastColumn; column++) {
+            tile->size += intervalSize(row, column) + 2;
+        }
+    }
+    tile->size -= 2;
+
+    return true;
+}
+
+size_t JpegTileIndex::write(const Tile& tile, uint8_t* out) const {
+    uint8_t* p = out;
+    const uint32_t* interval;
+    uint32_t restart = 0;
+
+    memcpy(p, mHeader, mHeaderSize);
+    write16(p + mFrameOffset + 5, tile.height);
+    write16(p + mFrameOffset + 7, tile.width);
+    p += mHeaderSize;
+
+    for (uint32_t row = tile.firstRow; row < tile.lastRow; row++) {
+        for (uint32_t column = tile.firstColumn; column < tile.lastColumn; column++) {
+            // The decoder expects the markers numbered from RST0 again
+            if (restart) {
+                *p++ = 0xFF;
+                *p++ = M_RST0 + ((restart - 1) & 7);
+            }
+            restart++;
+
+            interval = mIntervals + 2 * (row * mColumns + column);
+            memcpy(p, mData + interval[0], interval[1] - interval[0]);
+            p += interval[1] - interval[0];
+        }
+    }
+
+    *p++ = 0xFF;
+    *p++ = M_EOI;
+
+    return p - out;
+}
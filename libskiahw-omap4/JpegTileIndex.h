@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef JpegTileIndex_DEFINED
+#define JpegTileIndex_DEFINED
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "JpegHeaderParser.h"
+
+/** Offsets of the restart intervals of a baseline JPEG held in memory.
+    The entropy coder is reset at every RSTn marker, so the intervals
+    covering a rectangle can be copied out as they are, behind the tables
+    of the image, into a smaller JPEG which any decoder takes.
+    This only works when every MCU row starts a new interval, images
+    without DRI or with an interval not dividing the row aren't indexed.
+    Everything here is plain C++, JpegTileIndexTest builds it on the host.
+*/
+class JpegTileIndex {
+public:
+    /** MCU aligned part of the image, in pixels of the full image */
+    struct Tile {
+        int x;
+        int y;
+        int width;
+        int height;
+        size_t size;                // bytes written by write()
+        uint32_t firstRow;          // MCU rows
+        uint32_t lastRow;           // exclusive
+        uint32_t firstColumn;       // restart intervals within a row
+        uint32_t lastColumn;        // exclusive
+    };
+
+    JpegTileIndex();
+    ~JpegTileIndex();
+
+    /** Indexes data, the whole file header was parsed from. data has to
+        outlive the index, only offsets into it are kept. */
+    bool build(const uint8_t* data, size_t size, const JpegHeaderParser::Header& header);
+    void reset();
+
+    bool isValid() const { return NULL != mData; }
+    int width() const { return mWidth; }
+    int height() const { return mHeight; }
+
+    /** Smallest tile covering the rectangle, which is clipped to the image */
+    bool locate(int left, int top, int right, int bottom, Tile* tile) const;
+    /** Writes tile as a standalone JPEG, out has to hold tile.size bytes */
+    size_t write(const Tile& tile, uint8_t* out) const;
+
+private:
+    bool buildHeader(const JpegHeaderParser::Header& header);
+    bool buildIntervals(uint32_t offset);
+    uint32_t intervalSize(uint32_t row, uint32_t column) const;
+
+    const uint8_t* mData;
+    size_t mSize;
+    int mWidth, mHeight;
+    int mMcuWidth, mMcuHeight;
+    uint32_t mMcuRows;
+    uint32_t mColumns;              // restart intervals per MCU row
+
+    uint8_t* mHeader;               // SOI, tables, SOF and SOS, without APP1 and COM
+    size_t mHeaderSize;
+    size_t mFrameOffset;            // of the SOF marker within mHeader
+
+    uint32_t* mIntervals;           // start and end offset of every interval, row by row
+    uint32_t mNumIntervals;
+};
+
+#endif
@@ -0,0 +1,364 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Host test for JpegTileIndex. Builds synthetic baseline streams whose
+ * restart intervals carry their own row and column, cuts tiles out of them
+ * and checks the tables, the patched frame size and the intervals of every
+ * tile. Then cuts random tiles out of mutated streams, build it with
+ * -fsanitize=address to catch out of bounds accesses.
+ *
+ * usage: JpegTileIndexTest [iterations] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "JpegHeaderParser.h"
+#include "JpegTileIndex.h"
+
+#define MAX_INPUT   (64 * 1024)
+
+class MemorySource : public JpegHeaderParser::Source {
+public:
+    MemorySource(const uint8_t* data, size_t size)
+        : mData(data), mSize(size), mPos(0) { }
+
+    virtual size_t read(void* buffer, size_t size) {
+        if (size > mSize - mPos)
+            size = mSize - mPos;
+        memcpy(buffer, mData + mPos, size);
+        mPos += size;
+        return size;
+    }
+
+    virtual size_t skip(size_t size) {
+        if (size > mSize - mPos)
+            size = mSize - mPos;
+        mPos += size;
+        return size;
+    }
+
+private:
+    const uint8_t* mData;
+    size_t mSize, mPos;
+};
+
+class Writer {
+public:
+    Writer() : size(0) { }
+
+    void u8(int v) { if (size < MAX_INPUT) buf[size++] = (uint8_t)v; }
+    void be16(int v) { u8(v >> 8); u8(v); }
+    void marker(int m) { u8(0xFF); u8(m); }
+    void segment(int m, size_t payload) { marker(m); be16(payload + 2); }
+    void fill(int v, size_t n) { for (size_t i = 0; i < n; i++) u8(v); }
+
+    uint8_t buf[MAX_INPUT];
+    size_t size;
+};
+
+struct Image {
+    int width;
+    int height;
+    int components;
+    int hv;             // sampling of the first component
+    int interval;       // DRI, in MCUs
+    int progressive;
+};
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+static JpegHeaderParser parser;
+static JpegTileIndex tileIndex;
+static uint8_t tileBuf[MAX_INPUT];
+
+static int mcuWidth(const Image& image) {
+    return (image.components > 1) ? 8 * (image.hv >> 4) : 8;
+}
+
+static int mcuHeight(const Image& image) {
+    return (image.components > 1) ? 8 * (image.hv & 0xF) : 8;
+}
+
+/* Interval payload: row, column, a stuffed 0xFF and a fill byte before the next marker */
+static void writeInterval(Writer* w, int row, int column) {
+    w->u8(0x10 + row);
+    w->u8(0x20 + column);
+    w->u8(0xFF);
+    w->u8(0x00);
+    w->u8(0x33);
+    w->u8(0xFF);
+}
+
+static void writeImage(Writer* w, const Image& image) {
+    int mcusPerRow = (image.width + mcuWidth(image) - 1) / mcuWidth(image);
+    int rows = (image.height + mcuHeight(image) - 1) / mcuHeight(image);
+    int restart = 0;
+
+    w->marker(0xD8);
+    w->segment(0xE0, 14);
+    w->fill(0x4A, 14);
+    w->segment(0xE1, 40);
+    w->fill(0x45, 40);
+    w->segment(0xDB, 65);
+    w->u8(0);
+    w->fill(1, 64);
+    w->segment(0xFE, 5);
+    w->fill(0x43, 5);
+    // Adobe, transform 1: YCbCr
+    w->segment(0xEE, 12);
+    for (const char* p = "Adobe"; *p; p++)
+        w->u8(*p);
+    w->be16(100);
+    w->be16(0);
+    w->be16(0);
+    w->u8(1);
+    if (image.interval) {
+        w->segment(0xDD, 2);
+        w->be16(image.interval);
+    }
+    w->segment(image.progressive ? 0xC2 : 0xC0, 6 + 3 * image.components);
+    w->u8(8);
+    w->be16(image.height);
+    w->be16(image.width);
+    w->u8(image.components);
+    for (int i = 0; i < image.components; i++) {
+        w->u8(i + 1);
+        w->u8(i ? 0x11 : image.hv);
+        w->u8(i ? 1 : 0);
+    }
+    w->segment(0xC4, 17 + 12);
+    w->u8(0);
+    w->fill(0, 16);
+    w->fill(0, 12);
+    w->segment(0xDA, 4 + 2 * image.components);
+    w->u8(image.components);
+    for (int i = 0; i < image.components; i++) {
+        w->u8(i + 1);
+        w->u8(0);
+    }
+    w->u8(0);
+    w->u8(63);
+    w->u8(0);
+
+    for (int row = 0; row < rows; row++) {
+        for (int mcu = 0; mcu < mcusPerRow; mcu += image.interval ? image.interval : mcusPerRow) {
+            if (row || mcu) {
+                w->marker(0xD0 + (restart++ & 7));
+            }
+            writeInterval(w, row, image.interval ? mcu / image.interval : 0);
+        }
+    }
+    w->marker(0xD9);
+}
+
+static bool buildIndex(const Writer& w) {
+    MemorySource source(w.buf, w.size);
+
+    if (JpegHeaderParser::RESULT_OK != parser.parse(&source))
+        return false;
+
+    return tileIndex.build(w.buf, w.size, parser.header());
+}
+
+/* Walks the tile written into tileBuf and checks it against what was asked for */
+static void checkTile(const JpegTileIndex::Tile& tile, size_t size) {
+    size_t pos = 2;
+    int restart = 0, adobe = 0;
+
+    CHECK(size == tile.size);
+    CHECK(0xFF == tileBuf[0] && 0xD8 == tileBuf[1]);
+    CHECK(0xFF == tileBuf[size - 2] && 0xD9 == tileBuf[size - 1]);
+
+    // The tables and the APPn carrying the colour transform are kept, EXIF and COM are not
+    while ((pos + 4 <= size) && (0xDA != tileBuf[pos + 1])) {
+        uint8_t marker = tileBuf[pos + 1];
+        int length = (tileBuf[pos + 2] << 8) | tileBuf[pos + 3];
+
+        CHECK(0xFF == tileBuf[pos]);
+        CHECK((0xE1 != marker) && (0xFE != marker));
+        if (0xEE == marker) {
+            adobe++;
+            CHECK(14 == length && 0 == memcmp(tileBuf + pos + 4, "Adobe", 5) && 1 == tileBuf[pos + 15]);
+        }
+        if (0xC0 == marker) {
+            CHECK(tile.height == ((tileBuf[pos + 5] << 8) | tileBuf[pos + 6]));
+            CHECK(tile.width == ((tileBuf[pos + 7] << 8) | tileBuf[pos + 8]));
+        }
+        pos += 2 + length;
+    }
+    CHECK(1 == adobe);
+    CHECK(pos + 4 <= size);
+    if (pos + 4 > size)
+        return;
+    pos += 2 + ((tileBuf[pos + 2] << 8) | tileBuf[pos + 3]);
+
+    for (uint32_t row = tile.firstRow; row < tile.lastRow; row++) {
+        for (uint32_t column = tile.firstColumn; column < tile.lastColumn; column++) {
+            if (pos + 6 > size) {
+                CHECK(pos + 6 <= size);
+                return;
+            }
+            if ((row != tile.firstRow) || (column != tile.firstColumn)) {
+                CHECK(0xFF == tileBuf[pos] && (0xD0 + (restart++ & 7)) == tileBuf[pos + 1]);
+                pos += 2;
+            }
+            CHECK(0x10 + row == tileBuf[pos] && 0x20 + column == tileBuf[pos + 1]);
+            CHECK(0xFF == tileBuf[pos + 2] && 0x00 == tileBuf[pos + 3] && 0xFF == tileBuf[pos + 5]);
+            pos += 6;
+        }
+    }
+    CHECK(pos + 2 == size);
+}
+
+static void testTiles(const Image& image) {
+    Writer w;
+    JpegTileIndex::Tile tile;
+    int columnWidth = mcuWidth(image) * image.interval;
+
+    writeImage(&w, image);
+    CHECK(buildIndex(w));
+    CHECK(tileIndex.isValid() && image.width == tileIndex.width() && image.height == tileIndex.height());
+
+    // Every rectangle is covered by the least intervals holding it
+    for (int top = 0; top < image.height; top += 5) {
+        for (int left = 0; left < image.width; left += 7) {
+            int right = left + 1 + (left * 3) % 50;
+            int bottom = top + 1 + (top * 5) % 40;
+
+            CHECK(tileIndex.locate(left, top, right, bottom, &tile));
+            CHECK(tile.x <= left && tile.y <= top);
+            CHECK(tile.x % columnWidth == 0 && tile.y % mcuHeight(image) == 0);
+            CHECK(tile.x + columnWidth > left && tile.y + mcuHeight(image) > top);
+            if (right > image.width) right = image.width;
+            if (bottom > image.height) bottom = image.height;
+            CHECK(tile.x + tile.width >= right && tile.y + tile.height >= bottom);
+            CHECK((tile.x + tile.width == image.width) || (tile.x + tile.width - columnWidth < right));
+            CHECK((tile.y + tile.height == image.height) || (tile.y + tile.height - mcuHeight(image) < bottom));
+
+            CHECK(tile.size <= sizeof(tileBuf));
+            checkTile(tile, tileIndex.write(tile, tileBuf));
+        }
+    }
+
+    // Clipped to the image, nothing left of an outside rectangle
+    CHECK(tileIndex.locate(-10, -10, image.width + 10, image.height + 10, &tile));
+    CHECK(0 == tile.x && 0 == tile.y && image.width == tile.width && image.height == tile.height);
+    checkTile(tile, tileIndex.write(tile, tileBuf));
+    CHECK(!tileIndex.locate(image.width, 0, image.width + 10, 10, &tile));
+    CHECK(!tileIndex.locate(10, 10, 10, 20, &tile));
+}
+
+static void testNotIndexed() {
+    Image noInterval = { 64, 48, 3, 0x22, 0, 0 };
+    Image oddInterval = { 64, 48, 3, 0x22, 3, 0 };
+    Image progressive = { 64, 48, 3, 0x22, 2, 1 };
+    Writer w1, w2, w3, w4;
+    JpegTileIndex::Tile tile;
+
+    writeImage(&w1, noInterval);
+    CHECK(!buildIndex(w1));
+    CHECK(!tileIndex.isValid() && !tileIndex.locate(0, 0, 8, 8, &tile));
+
+    writeImage(&w2, oddInterval);
+    CHECK(!buildIndex(w2));
+
+    writeImage(&w3, progressive);
+    CHECK(!buildIndex(w3));
+
+    // A lost restart marker leaves the intervals short of the MCU rows
+    Image image = { 64, 48, 3, 0x22, 2, 0 };
+    writeImage(&w4, image);
+    for (size_t i = w4.size - 1; i > 0; i--) {
+        if ((0xFF == w4.buf[i - 1]) && (0xD3 == w4.buf[i])) {
+            w4.buf[i] = 0x00;
+            break;
+        }
+    }
+    CHECK(!buildIndex(w4));
+}
+
+static uint32_t lcg(uint32_t* state) {
+    *state = *state * 1103515245 + 12345;
+    return *state >> 8;
+}
+
+static void fuzz(int iterations, uint32_t seed) {
+    Image images[] = {
+        { 64, 48, 3, 0x22, 2, 0 },
+        { 100, 30, 3, 0x21, 1, 0 },
+        { 37, 19, 1, 0x11, 5, 0 },
+    };
+    Writer w;
+    JpegTileIndex::Tile tile;
+    int indexed = 0;
+
+    for (int i = 0; i < iterations; i++) {
+        const Image& image = images[lcg(&seed) % 3];
+        w.size = 0;
+        writeImage(&w, image);
+
+        int mutations = 1 + lcg(&seed) % 4;
+        for (int m = 0; m < mutations; m++) {
+            uint32_t r = lcg(&seed);
+            size_t pos = r % w.size;
+            switch ((r >> 16) % 3) {
+                case 0: w.buf[pos] = (uint8_t)lcg(&seed); break;
+                case 1: w.buf[pos] = 0xFF; break;
+                case 2: w.size = pos + 1; break;
+            }
+        }
+
+        if (!buildIndex(w))
+            continue;
+        indexed++;
+
+        int left = (int)(lcg(&seed) % (image.width + 20)) - 10;
+        int top = (int)(lcg(&seed) % (image.height + 20)) - 10;
+        if (tileIndex.locate(left, top, left + 1 + lcg(&seed) % 60, top + 1 + lcg(&seed) % 60, &tile) &&
+                (tile.size <= sizeof(tileBuf))) {
+            CHECK(tile.size == tileIndex.write(tile, tileBuf));
+        }
+    }
+
+    printf("%d fuzz iterations, %d indexed\n", iterations, indexed);
+}
+
+int main(int argc, char** argv) {
+    int iterations = (argc > 1) ? atoi(argv[1]) : 100000;
+    uint32_t seed = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1;
+    Image yuv420 = { 64, 48, 3, 0x22, 2, 0 };
+    Image yuv422 = { 100, 30, 3, 0x21, 1, 0 };
+    Image gray = { 37, 19, 1, 0x11, 5, 0 };
+
+    testTiles(yuv420);
+    testTiles(yuv422);
+    testTiles(gray);
+    testNotIndexed();
+    fuzz(iterations, seed);
+
+    printf("%s, %d failures\n", failures ? "FAIL" : "PASS", failures);
+
+    return failures ? 1 : 0;
+}
@@ -119,7 +119,7 @@ void TIS3DHeapAllocator::config(int filetype,int stereoWidth, int stereoHeight,
     {
         nWidth = (size_t)stereoWidth;
         nHeight = (size_t) stereoHeight;
-        numImages = (size_t) numImages;
+        this->numImages = (size_t) numImages;
         // Reset the Allocation calls
         decodeCount = 0;
         mypixelref = NULL;
@@ -127,6 +127,41 @@ void TIS3DHeapAllocator::config(int filetype,int stereoWidth, int stereoHeight,
 
 }
 
+/** Stereo buffer for concurrent decode of the views */
+TISkMallocPixelRef* TIS3DHeapAllocator::allocStereo(SkBitmap::Config config,
+                                            SkColorTable* ctable) {
+    size_t nBytesPerPixel = 2;
+    void *addr;
+
+    /*round up if nWidth is not multiple of 32*/
+    nWidth = (size_t)((nWidth + MULTIPLE_32) & ~MULTIPLE_32);
+
+    /*round up if nHeight is not multiple of 16*/
+    nHeight= (size_t)((nHeight + MULTIPLE_16) & ~MULTIPLE_16);
+
+    if (config == 6) nBytesPerPixel = 4;
+
+    bm_size = (nWidth * nHeight * nBytesPerPixel);
+
+    addr = tisk_malloc_flags(bm_size, 0);  // returns NULL on failure
+    if (NULL == addr) {
+        return NULL;
+    }
+
+    return new TISkMallocPixelRef(addr, bm_size, ctable);
+}
+
+bool TIS3DViewAllocator::allocPixelRef(SkBitmap* dst,
+                                            SkColorTable* ctable) {
+    if (NULL == pixelref) {
+        return false;
+    }
+
+    dst->setPixelRef(pixelref, offset);
+    dst->lockPixels();
+    return true;
+}
+
 /** To reset buffer offset */
 void TIS3DHeapAllocator::reset(SkBitmap* dst) {
     if(mypixelref!= NULL)
@@ -92,6 +92,12 @@ public:
     void config(int filetype,int stereoWidth, int stereoHeight, int numImages);
     void reset(SkBitmap* dst);
 
+    /* Allocates the whole stereo buffer up front, so the views can be
+       decoded concurrently each through its own TIS3DViewAllocator.
+       The caller owns the returned reference. */
+    TISkMallocPixelRef* allocStereo(SkBitmap::Config config, SkColorTable* ctable);
+    size_t viewOffset(int view) const { return (bm_size / numImages) * view; }
+
 private:
     TISkMallocPixelRef * mypixelref;
     int decodeCount;
@@ -101,6 +107,18 @@ private:
     size_t bm_size;
 };
 
+/* Attaches one view of a stereo buffer allocated by TIS3DHeapAllocator */
+class TIS3DViewAllocator : public SkBitmap::Allocator {
+public:
+    TIS3DViewAllocator() : pixelref(NULL), offset(0) {}
+    virtual bool allocPixelRef(SkBitmap*, SkColorTable*);
+    void config(SkPixelRef* stereo, size_t viewOffset) { pixelref = stereo; offset = viewOffset; }
+
+private:
+    SkPixelRef * pixelref;
+    size_t offset;
+};
+
     /*values for possible S3D subsampling modes*/
     enum {
         TYPE_JPG = 0,
@@ -37,6 +37,9 @@
 #include <timm_osal_error.h>
 #include <timm_osal_memory.h>
 #include <unistd.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <cutils/properties.h>
 
 
 #define LOG_TAG "LIBSKIAHW"
@@ -44,6 +47,7 @@
 
 #define TIME_DECODE
 #define JPEG_DECODER_DUMP_INPUT_AND_OUTPUT 0 // set directory persmissions for /temp as 777
+#define JPEG_HW_DECODE_PROPERTY "debug.skiahw.jpeg.hwdecode" // 1 sends baseline JPEGs to SIMCOP
 #define JPEGD_Trace(ARGS,...)  TIMM_OSAL_InfoExt(TIMM_OSAL_TRACEGRP_OMXIMGDEC,ARGS,##__VA_ARGS__) //PRINT OMAP4
 #if JPEG_DECODER_DUMP_INPUT_AND_OUTPUT
     int dOutputCount = 0;
@@ -57,98 +61,24 @@ TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_NONE;
 TIMM_OSAL_PTR dataPipes[OMX_JPEGD_TEST_NUM_PORTS];
 //////////////////////////////////////////////////////////////////////////
 
-OMX_ERRORTYPE OMX_EventHandler(OMX_HANDLETYPE hComponent,
-                                    OMX_PTR pAppData,
-                                    OMX_EVENTTYPE eEvent,
-                                    OMX_U32 nData1,
-                                    OMX_U32 nData2,
-                                    OMX_PTR pEventData)
-    {
-    LOG_FUNCTION_NAME
-
-    ((SkTIJPEGImageDecoder *)pAppData)->EventHandler(hComponent, eEvent, nData1, nData2, pEventData);
-
-    LOG_FUNCTION_NAME_EXIT
-
-    return OMX_ErrorNone;
-    }
-
-
-OMX_ERRORTYPE OMX_EmptyBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR ptr, OMX_BUFFERHEADERTYPE* pBuffer)
-    {
-    LOG_FUNCTION_NAME
-
-    SkTIJPEGImageDecoder * ImgDec = (SkTIJPEGImageDecoder *)ptr;
-    ImgDec->iLastState = ImgDec->iState;
-    ImgDec->iState = SkTIJPEGImageDecoder::STATE_EMPTY_BUFFER_DONE_CALLED;
-    sem_post(ImgDec->semaphore) ;
-
-    LOG_FUNCTION_NAME_EXIT
-
-    return OMX_ErrorNone;
-    }
-
-
-OMX_ERRORTYPE OMX_FillBufferDone (OMX_HANDLETYPE hComponent, OMX_PTR ptr, OMX_BUFFERHEADERTYPE* pBuffHead)
-    {
-    LOG_FUNCTION_NAME
-
-    LIBSKIAHW_LOGDB("\nOMX_FillBufferDone:: nFilledLen = %ld \n", pBuffHead->nFilledLen);
-
-    if(pBuffHead->nAllocLen == 0)
-        {
-        LIBSKIAHW_LOGDA("[ZERO length]");
-        }
-
-    if(pBuffHead->nFlags & OMX_BUFFERFLAG_EOS)
-        {
-        pBuffHead->nFlags &= ~OMX_BUFFERFLAG_EOS;
-        LIBSKIAHW_LOGDA("[EOS detected]");
-        }
-
-    ((SkTIJPEGImageDecoder *)ptr)->FillBufferDone(pBuffHead->pBuffer, pBuffHead->nFilledLen);
-
-    LOG_FUNCTION_NAME_EXIT
-
-    return OMX_ErrorNone;
-    }
-
+///Warm SIMCOP decoder sessions shared by every decoder instance of the process
+static JpegDecoderPool gJpegDecoderPool;
 
 SkTIJPEGImageDecoder::~SkTIJPEGImageDecoder()
     {
     LOG_FUNCTION_NAME
-    OMX_ERRORTYPE eError = OMX_ErrorNone;
-
-    AutoTimeMillis atm("DeInit time: ");
-
-    sem_destroy(semaphore);
 
-    if (semaphore != NULL)
-        {
-        free(semaphore) ;
-        semaphore = NULL;
-        }
-    /*### Assume that the inStream will be closed by some upper layer */
-    /*### Assume that the Bitmap object/file need not be closed. */
-    /*### More needs to be done here */
-    /*### Do different things based on iLastState */
-    LIBSKIAHW_LOGDA("Calling FREEHANDLE\n");
-    if (pOMXHandle) {
-        eError = OMX_FreeHandle(pOMXHandle);
-        if ( (eError != OMX_ErrorNone) )    {
-            LIBSKIAHW_LOGEA("Error in Free Handle function\n");
-        }
-        pOMXHandle = NULL;
-        OMX_Deinit();
-    }
+    ResetTileIndex();
 
     if (pARMHandle) {
         delete pARMHandle;
         pARMHandle=NULL;
         }
 
-    if(JpegHeaderInfo.MPIndexIFDTags.MPEntry)
-        delete[] JpegHeaderInfo.MPIndexIFDTags.MPEntry;
+    if (pARMViewHandle) {
+        delete pARMViewHandle;
+        pARMViewHandle=NULL;
+        }
 
     LOG_FUNCTION_NAME_EXIT
     }
@@ -157,23 +87,14 @@ SkTIJPEGImageDecoder::SkTIJPEGImageDecoder()
     {
     LOG_FUNCTION_NAME
 
-    pInBuffHead = NULL;
-    pOutBuffHead = NULL;
-    semaphore = NULL;
-    semaphore = (sem_t*)malloc(sizeof(sem_t)) ;
-    sem_init(semaphore, 0x00, 0x00);
-
-    pOMXHandle = NULL;
     pARMHandle = NULL;
-    pBeforeDecodeTime = NULL;
-    pDecodeTime = NULL;
-    pAfterDecodeTime = NULL;
+    pARMViewHandle = NULL;
+    pTileStream = NULL;
+    bArmTileIndex = false;
 
-    JpegHeaderInfo.MPIndexIFDTags.MPEntry = NULL;
     fileType = TYPE_JPG;
     finalBytesRead = 0;
-
-    LIBSKIAHW_LOGDB("semaphore created semaphore = 0x%x", semaphore);
+    inputFileSize = 0;
 
     LIBSKIAHW_LOGDB("Process ID using this instance 0x%x", getpid());
 
@@ -181,11 +102,6 @@ SkTIJPEGImageDecoder::SkTIJPEGImageDecoder()
     }
 
 
-OMX_S16 SkTIJPEGImageDecoder::Get16m(const void * Short)
-    {
-    return(((OMX_U8 *)Short)[0] << 8) | ((OMX_U8 *)Short)[1];
-    }
-
 void SkTIJPEGImageDecoder::FixFrameSize(JPEG_HEADER_INFO* JpegHeaderInfo)
     {
     LOG_FUNCTION_NAME
@@ -205,28 +121,26 @@ void SkTIJPEGImageDecoder::FixFrameSize(JPEG_HEADER_INFO* JpegHeaderInfo)
     }
 
 
-OMX_S16 SkTIJPEGImageDecoder::GetYUVformat(OMX_U8 * Data)
+OMX_S16 SkTIJPEGImageDecoder::GetYUVformat(const JpegHeaderParser::Frame* frame)
     {
     LOG_FUNCTION_NAME
 
     unsigned char Nf;
     OMX_U32 j;
-    OMX_U32 temp_index;
     OMX_U32 temp;
     OMX_U32 image_format;
     short H[4],V[4];
 
-    Nf = Data[7];
+    Nf = frame->numComponents;
 
-    for (j = 0; j < Nf; j++)
+    for (j = 0; j < Nf && j < JpegHeaderParser::MAX_COMPONENTS; j++)
         {
-       temp_index = j * 3 + 7 + 2;
         /*---------------------------------------------------------*/
        /* H[j]: upper 4 bits of a byte, horizontal sampling fator.                  */
        /* V[j]: lower 4 bits of a byte, vertical sampling factor.                    */
        /*---------------------------------------------------------*/
-         H[j] = (0x0f & (Data[temp_index] >> 4));
-         V[j] = (0x0f & Data[temp_index]);
+         H[j] = frame->components[j].h;
+         V[j] = frame->components[j].v;
         }
 
     /*------------------------------------------------------------------*/
@@ -240,7 +154,7 @@ OMX_S16 SkTIJPEGImageDecoder::GetYUVformat(OMX_U8 * Data)
         image_format = OMX_COLOR_FormatL8;
         }
 
-    if (Nf == 3)
+    if (Nf == 3 && V[1]*H[1] != 0)
         {
         temp = (V[0]*H[0])/(V[1]*H[1]) ;
 
@@ -269,628 +183,166 @@ OMX_S16 SkTIJPEGImageDecoder::GetYUVformat(OMX_U8 * Data)
     return (image_format);
     }
 
-/* BigEndianRead32Bits() gets a 32-bit value into a pointer variable */
-void SkTIJPEGImageDecoder::BigEndianRead32Bits(OMX_U32 *pVal,OMX_U8* ptr)
-{
-    *pVal = (OMX_U32)((*(ptr+3)));
-    *pVal |= (OMX_U32)((*(ptr+2)) <<8);
-    *pVal |= (OMX_U32)((*(ptr+1)) <<16);
-    *pVal |= (OMX_U32)((*(ptr)) <<24);
-}
+/* Feeds the header parser from the SkStream, skipped segments are never copied */
+class SkStreamHeaderSource : public JpegHeaderParser::Source {
+public:
+    SkStreamHeaderSource(SkStream* stream) : fStream(stream) {}
 
-/* BigEndianRead16Bits() gets a 16-bit value into a pointer variable  */
-void SkTIJPEGImageDecoder::BigEndianRead16Bits(OMX_U16 *pVal,OMX_U8* ptr)
-{
-    *pVal = *ptr;
-    *pVal <<=8;
-    *pVal |= *(ptr+1);
-}
+    virtual size_t read(void* buffer, size_t size) {
+        return fStream->read(buffer, size);
+    }
+
+    virtual size_t skip(size_t size) {
+        return fStream->skip(size);
+    }
+
+private:
+    SkStream* fStream;
+};
 
 OMX_S32 SkTIJPEGImageDecoder::ParseJpegHeader (SkStream* stream, JPEG_HEADER_INFO* JpgHdrInfo)
     {
     LOG_FUNCTION_NAME
 
-    OMX_U8 a = 0;
     OMX_S32 lSize = 0;
     lSize = stream->getLength();
     stream->rewind();
 
-    OMX_U8 *Data = NULL;
-    size_t bytesRead=0;
-    JpgHdrInfo->nProgressive = 0; /*Default value is non progressive*/
-    OMX_U32 littleEndian = 0, skipFactor = 0, nextIFDOffset = 0, nextOffset = 0, tagValOffset = 0;
-    OMX_U32 tagCount, tagValue;
-    OMX_U8 *pOffsetRef;
-    OMX_U8 *pOffsetVal;
-    OMX_U16 MPIndexCount, tagID, tagType;
-
-    a = stream->readU8();bytesRead++;
-    if ( a != 0xff || stream->readU8() != M_SOI )
+    SkStreamHeaderSource source(stream);
+    JpegHeaderParser::Result result = headerParser.parse(&source);
+    const JpegHeaderParser::Header& header = headerParser.header();
+
+    fileType = TYPE_JPG;
+    JpgHdrInfo->nProgressive = header.progressive ? 1 : 0;
+    if (header.progressive)
         {
-        return 0;
+        LIBSKIAHW_LOGDA("nProgressive IMAGE!\n");
         }
-    bytesRead++;
 
-    for ( ;; )
+    switch (result)
         {
-        OMX_U32 itemlen = 0;
-        OMX_U32 marker = 0;
-        OMX_U32 ll = 0,lh = 0, got = 0;
-
-        for ( a=0;a<15 /* 7 originally */;a++ )
-            {
-            marker = stream->readU8();
-            bytesRead++;
-            if ( marker != 0xff )
-                {
-                break;
-                }
-            if ( a >= 14 /* 6 originally */)
-                {
-                LIBSKIAHW_LOGDA("too many padding bytes\n");
-                if ( Data != NULL )
-                    {
-                    free(Data);
-                    Data=NULL;
-                    }
-                return 0;
-                }
-            }
-
-        if ( marker == 0xff )
-            {
-            /* 0xff is legal padding, but if we get that many, something's wrong.*/
-            LIBSKIAHW_LOGEA("too many padding bytes!");
-            }
-
-        /* Read the length of the section.*/
-        lh = stream->readU8();
-        ll = stream->readU8();
-        bytesRead+=2;
-        itemlen = (lh << 8) | ll;
-
-        if ( itemlen < 2 )
-            {
-            LIBSKIAHW_LOGEA("invalid marker");
-            }
-
-        Data = (OMX_U8 *)malloc(itemlen);
-        if ( Data == NULL )
-            {
-            LIBSKIAHW_LOGEA("Could not allocate memory");
+        case JpegHeaderParser::RESULT_OK:
             break;
-            }
-
-        /* Store first two pre-read bytes. */
-        Data[0] = (OMX_U8)lh;
-        Data[1] = (OMX_U8)ll;
-
-        got = stream->read(Data+2, itemlen-2); /* Read the whole section.*/
-        bytesRead +=got;
-
-        if ( got != itemlen-2 )
-            {
+        case JpegHeaderParser::RESULT_NO_IMAGE:
+            LIBSKIAHW_LOGDA("No image in jpeg!\n");
+            return 0;
+        case JpegHeaderParser::RESULT_TRUNCATED:
             LIBSKIAHW_LOGEA("Premature end of file?");
-            if ( Data != NULL )
-                {
-                free(Data);
-                Data=NULL;
-                }
             return 0;
-            }
-
-        switch ( marker )
-            {
-            case M_SOS:
-                    {
-                        if ( Data != NULL )
-                        {
-                        free(Data);
-                        Data=NULL;
-                        }
-                    return lSize;
-                }
-
-            case M_EOI:
-                    {
-                    LIBSKIAHW_LOGDA("No image in jpeg!\n");
-                    if ( Data != NULL )
-                        {
-                        free(Data);
-                        Data=NULL;
-                        }
-                    return 0;
-                }
-
-            case M_COM: /* Comment section  */
-                    {
-                        break;
-                }
-
-            case M_JFIF:
-                    {
-                        break;
-                }
-
-            case M_EXIF:
-                    {
-                        break;
-                }
-
-            case M_SOF2:
-                    {
-                    LIBSKIAHW_LOGDA("nProgressive IMAGE!\n");
-                    JpgHdrInfo->nProgressive=1;
-                    break;
-                }
-
-            case M_SOF0:
-            case M_SOF1:
-            case M_SOF3:
-            case M_SOF5:
-            case M_SOF6:
-            case M_SOF7:
-            case M_SOF9:
-            case M_SOF10:
-            case M_SOF11:
-            case M_SOF13:
-            case M_SOF14:
-            case M_SOF15:
-                    {
-                        JpgHdrInfo->nHeight = Get16m(Data+3);
-                        JpgHdrInfo->nWidth = Get16m(Data+5);
-                        JpgHdrInfo->nFormat = GetYUVformat(Data);
-                        switch (JpgHdrInfo->nFormat) {
-                        case OMX_COLOR_FormatYUV420Planar:
-                            LIBSKIAHW_LOGDA("Image chroma format is OMX_COLOR_FormatYUV420Planar\n");
-                            break;
-                        case OMX_COLOR_FormatYUV411Planar:
-                            LIBSKIAHW_LOGDA("Image chroma format is OMX_COLOR_FormatYUV411Planar\n");
-                            break;
-                        case OMX_COLOR_FormatCbYCrY:
-                            LIBSKIAHW_LOGDA("Image chroma format is OMX_COLOR_FormatYUV422Interleaved\n");
-                            break;
-                        case OMX_COLOR_FormatYUV444Interleaved:
-                            LIBSKIAHW_LOGDA("Image chroma format is OMX_COLOR_FormatYUV444Interleaved\n");
-                            break;
-                        case OMX_COLOR_FormatL8:
-                            LIBSKIAHW_LOGDA("Image chroma format is OMX_COLOR_FormatL8 \n");
-                            break;
-                        default:
-                            LIBSKIAHW_LOGDA("Cannot find Image chroma format \n");
-                            JpgHdrInfo->nFormat = OMX_COLOR_FormatUnused;
-                            break;
-                        }
-
-                        LIBSKIAHW_LOGDB("Image Width x Height = %u * %u\n", Get16m(Data+5), Get16m(Data+3)  );
-
-                        if ( Data != NULL ) {
-                            free(Data);
-                            Data=NULL;
-                        }
-                        break;
-                }
-            case M_JPS:
-                    {
-                        if((*(Data+2) == 0x5F && *(Data+3) == 0x4A && *(Data+4) == 0x50 && *(Data+5) == 0x53 && *(Data+6) == 0x4A && *(Data+7) == 0x50 && *(Data+8) == 0x53 && *(Data+9) == 0x5F)
-                            && (0x01 == (OMX_U8) *(Data+JPS_TYPE_OFFSET)))
-                        {
-                            LIBSKIAHW_LOGDA("Valid Stereo JPS type file \n");
-                             fileType = TYPE_JPS;
-
-                            JpgHdrInfo->s3dDesc.nType = (OMX_U8) *(Data+JPS_TYPE_OFFSET);
-                            JpgHdrInfo->s3dDesc.nLayout = (OMX_U8) *(Data+JPS_LAYOUT_OFFSET);
-
-                            // Setting the frame order
-                            if((OMX_U8) *(Data+JPS_MISCF_OFFSET) & JPS_MISCF_FO_MASK)
-                                JpgHdrInfo->s3dDesc.nFrameOrder = S3D_ORDER_LF;
-                            else
-                                JpgHdrInfo->s3dDesc.nFrameOrder = S3D_ORDER_RF;
-
-                            switch((OMX_U8) *(Data+JPS_MISCF_OFFSET) & JPS_MISCF_SS_MASK)
-                            {
-                                    case S3D_SS_NONE:
-                                            //LIBSKIAHW_LOGDA("No SubSampling \n");
-                                            JpgHdrInfo->s3dDesc.nSubSampling = S3D_SS_NONE;
-                                            break;
-                                    case S3D_SS_VERT:
-                                            //LIBSKIAHW_LOGDA("VERT SubSampling \n");
-                                            JpgHdrInfo->s3dDesc.nSubSampling = S3D_SS_VERT;
-                                            break;
-                                    case S3D_SS_HORZ:
-                                            //LIBSKIAHW_LOGDA("HORZ SubSampling \n");
-                                            JpgHdrInfo->s3dDesc.nSubSampling = S3D_SS_HORZ;
-                                            break;
-                                    case S3D_SS_BOTH:
-                                           // LIBSKIAHW_LOGDA("HORZ and VERT SubSampling \n");
-                                            JpgHdrInfo->s3dDesc.nSubSampling = S3D_SS_BOTH;
-                                            break;
-                            }
-
-                            // Separation field , read it even if Don't care
-                            JpgHdrInfo->s3dDesc.nSeparation = (OMX_U8) *(Data+JPS_SEP_OFFSET);
-
-                            //LIBSKIAHW_LOGDA("ntype=0x%x, layout=0x%x, miscflag=0x%x, separation=0x%x \n", (OMX_U8) *(Data+JPS_TYPE_OFFSET), (OMX_U8) *(Data+JPS_LAYOUT_OFFSET) , (OMX_U8) *(Data+JPS_MISCF_OFFSET) , (OMX_U8) *(Data+JPS_SEP_OFFSET));
-                       }
-                       else
-                            {
-                                LIBSKIAHW_LOGDA("Non-Supported or invalid JPS file  \n");
-                                if ( Data != NULL ) {
-                                    free(Data);
-                                    Data=NULL;
-                                }
-                                return 0;
-                            }
-                    break;
-                    }
-            case M_MPO:
-                    {
-                        if(*(Data+2) == 0x4D && *(Data+3) == 0x50 && *(Data+4) == 0x46 && *(Data+5) == 0x00 )
-                        {
-                            LIBSKIAHW_LOGDA("Valid MPO type file \n");
-                            fileType = TYPE_MPO;
-                            pOffsetRef = Data + MP_START_OF_OFFSET_REF; // Start of reference
-                            finalBytesRead  =bytesRead + 4 - got;// reset and add MP Format ID
-
-                            if(*(pOffsetRef) == 0x49 && *(pOffsetRef+1) == 0x49 /*&& *(pOffsetRef+2) == 0x2A && *(pOffsetRef+3) == 0x00 */)
-                            {
-                                //LIBSKIAHW_LOGDA("Little Endian \n");
-                                littleEndian = 1;
-                            }
-                            Data += 0x0A;//Skipping to read the offset
-                            // Read 0th IFD offset
-                            if(littleEndian)
-                                skipFactor = (OMX_U32) (*Data);
-                            else
-                                BigEndianRead32Bits(&skipFactor,Data);
-
-                            Data = pOffsetRef + skipFactor; // Jump to 0th IFD
-
-                            // Reset the offset value
-                            nextIFDOffset = 0;
-                            tagValue = 0;
-
-                             //Default parameters for now
-                            JpgHdrInfo->s3dDesc.nType = 0x01; // STEROSCOPIC IMAGES
-                            JpgHdrInfo->s3dDesc.nLayout = S3D_FORMAT_OVERUNDER;
-                            JpgHdrInfo->s3dDesc.nFrameOrder = S3D_ORDER_LF;
-                            JpgHdrInfo->s3dDesc.nSubSampling = S3D_SS_NONE;
-                            JpgHdrInfo->s3dDesc.nSeparation = NULL;
-
-                            do
-                            {
-                                Data += nextIFDOffset;
-                                //nextIFDOffset = 0;
-
-                                if(littleEndian)
-                                {
-                                    MPIndexCount = (OMX_U16)((*Data) + (*(Data+1)<<8));
-                                }
-                                else
-                                {
-                                    BigEndianRead16Bits(&MPIndexCount,Data);
-                                }
-                                Data += sizeof(OMX_U16);
-
-                                for(int j=0;j<MPIndexCount;j++)
-                                {
-                                    if(littleEndian)
-                                    {
-                                        tagID = (OMX_U16)((*Data) + (*(Data+1)<<8));
-                                        Data += sizeof(OMX_U16);
-
-                                        tagType = (OMX_U16)((*Data) + (*(Data+1)<<8));
-                                        Data += sizeof(OMX_U16);
-
-                                        tagCount = (OMX_U32)((*Data) + (*(Data+1)<<8) +
-                                                              (*(Data+2)<<16) + (*(Data+3)<<24));
-                                        Data += sizeof(OMX_U32);
-
-                                        tagValue = (OMX_U32)((*Data) + (*(Data+1)<<8) +
-                                                              (*(Data+2)<<16) + (*(Data+3)<<24));
-                                        Data += sizeof(OMX_U32);
-
-                                    }
-                                    else
-                                    {
-                                        BigEndianRead16Bits(&tagID,Data);
-                                        Data += sizeof(OMX_U16);
-
-                                        BigEndianRead16Bits(&tagType,Data);
-                                        Data += sizeof(OMX_U16);
-
-                                        BigEndianRead32Bits(&tagCount,Data);
-                                        Data += sizeof(OMX_U32);
-
-                                        BigEndianRead32Bits(&tagValue,Data);
-                                        Data += sizeof(OMX_U32);
-                                    }
-
-                                    switch (tagID)
-                                    {
-                                        case TAGID_MPFVERSION://MPFVersion
-
-                                            if((tagType != (OMX_U16)TAG_TYPE_UNDEFINED))
-                                                goto EXIT;
-
-                                            //LIBSKIAHW_LOGDA("MPF Version \n");
-                                            JpgHdrInfo->MPIndexIFDTags.MPFVersion = tagValue;
-                                            //TODO: Passed this structure to upper layers
-                                            break;
-                                        case TAGID_NIMAGES://Number of Images
-
-                                            if((tagType != (OMX_U16)TAG_TYPE_LONG))
-                                                goto EXIT;
-
-                                            JpgHdrInfo->MPIndexIFDTags.numberOfImages = (OMX_U8) tagValue;
-                                            //LIBSKIAHW_LOGDA("Number of Images %x \n", JpgHdrInfo->MPIndexIFDTags.numberOfImages);
-                                            //TODO: Passed this structure to upper layers
-                                            break;
-                                        case TAGID_MPENTRY://MPEntry
-
-                                            if((tagType != (OMX_U16)TAG_TYPE_UNDEFINED))
-                                                goto EXIT;
-
-                                            //LIBSKIAHW_LOGDA("MPEntry \n");
-                                            pOffsetVal = pOffsetRef + tagValue;
-                                            JpgHdrInfo->MPIndexIFDTags.MPEntry = new MP_ENTRY[(int)(tagCount/16)];
-                                            for(int i=0;i<(int)(tagCount/16);i++)
-                                            {
-                                                JpgHdrInfo->MPIndexIFDTags.MPEntry[i].imageAttribute =
-                                                (OMX_U32)((*pOffsetVal) + (*(pOffsetVal+1)<<8) + (*(pOffsetVal+2)<<16) + (*(pOffsetVal+3)<<24));
-                                                pOffsetVal += sizeof(OMX_U32);
-                                               // LIBSKIAHW_LOGDA("MPEntryAttribute %x \n", JpgHdrInfo->MPIndexIFDTags.MPEntry[i].imageAttribute);
-
-                                                JpgHdrInfo->MPIndexIFDTags.MPEntry[i].imageSize =
-                                                (OMX_U32)((*pOffsetVal) + (*(pOffsetVal+1)<<8) + (*(pOffsetVal+2)<<16) + (*(pOffsetVal+3)<<24));
-                                                pOffsetVal += sizeof(OMX_U32);
-                                               //  LIBSKIAHW_LOGDA("MPEntry ImageSize %x \n", JpgHdrInfo->MPIndexIFDTags.MPEntry[i].imageSize);
-
-                                                JpgHdrInfo->MPIndexIFDTags.MPEntry[i].dataOffset =
-                                                (OMX_U32)((*pOffsetVal) + (*(pOffsetVal+1)<<8) + (*(pOffsetVal+2)<<16) + (*(pOffsetVal+3)<<24));
-                                                pOffsetVal += sizeof(OMX_U32);
-                                                // LIBSKIAHW_LOGDA("MPEntry dataOffset%x \n", JpgHdrInfo->MPIndexIFDTags.MPEntry[i].dataOffset);
-
-                                                JpgHdrInfo->MPIndexIFDTags.MPEntry[i].dependentImage1=
-                                                (OMX_U16)((*pOffsetVal) + (*(pOffsetVal+1)<<8));
-                                                pOffsetVal += sizeof(OMX_U16);
-                                                // LIBSKIAHW_LOGDA("MPEntrydependentImage1  %x \n", JpgHdrInfo->MPIndexIFDTags.MPEntry[i].dependentImage1);
-
-                                                JpgHdrInfo->MPIndexIFDTags.MPEntry[i].dependentImage2 =
-                                                (OMX_U16)((*pOffsetVal) + (*(pOffsetVal+1)<<8));
-                                                pOffsetVal += sizeof(OMX_U16);
-                                                //  LIBSKIAHW_LOGDA("MPEntry dependentImage2  %x \n", JpgHdrInfo->MPIndexIFDTags.MPEntry[i].dependentImage2);
-
-                                            }
-
-                                            pOffsetVal = NULL;
-                                        break;
-                                        case TAGID_UIDLIST://Indifidual Image Unique ID list
-
-                                            if((tagType != (OMX_U16)TAG_TYPE_UNDEFINED))
-                                                goto EXIT;
-
-                                            //LIBSKIAHW_LOGDA("Image Unique ID list Non-supported\n");
-                                            //TODO: Passed this structure to upper layers
-
-                                        break;
-                                        case TAGID_TFRAMES://Total number of capture frames
-
-                                            if((tagType != (OMX_U16)TAG_TYPE_LONG))
-                                                goto EXIT;
-
-                                            JpgHdrInfo->MPIndexIFDTags.totalFrames = (OMX_U8) tagValue;
-                                            //TODO: Passed this structure to upper layers
-                                            //LIBSKIAHW_LOGDA("Number of captures frames  %x \n", JpgHdrInfo->MPIndexIFDTags.totalFrames);
-
-                                        break;
-                                        case TAGID_MPIMAGENUM: //MP Individual Image Number
-
-                                             if((tagType != (OMX_U16)TAG_TYPE_LONG))
-                                                goto EXIT;
-
-                                            JpgHdrInfo->MPIndexIFDTags.MPIndividualNum= tagValue;
-                                            //LIBSKIAHW_LOGDA("MP Individual Image Number  %x \n", JpgHdrInfo->MPIndexIFDTags.MPIndividualNum);
-
-                                            if(tagValue == 0x1)
-                                                JpgHdrInfo->s3dDesc.nFrameOrder = S3D_ORDER_LF;
-
-                                        break;
-                                        case TAGID_PANSCANORIENTATION: // Panorama Scanning Orientation
-
-                                             if((tagType != (OMX_U16)TAG_TYPE_LONG))
-                                                goto EXIT;
-
-                                            //LIBSKIAHW_LOGDA("Panorama Scanning Information not yet supported \n");
-                                            //TODO: Passed this structure to upper layers
-
-                                        break;
-                                        case TAGID_BVPOINTNUM: //Base Viewpoint Number
-
-                                            if((tagType != (OMX_U16)TAG_TYPE_LONG))
-                                                goto EXIT;
-
-                                            JpgHdrInfo->MPIndexIFDTags.baseViewpointNum= tagValue;
-                                            //LIBSKIAHW_LOGDA("Base Viewpoint Number %x  \n", JpgHdrInfo->MPIndexIFDTags.baseViewpointNum);
-                                            //TODO: Passed this structure to upper layers
-
-                                        break;
-                                        case TAGID_CONVANG: //Convergence Angle
-
-                                            if((tagType != (OMX_U16)TAG_TYPE_SRATIONAL))
-                                                goto EXIT;
-
-                                            JpgHdrInfo->MPIndexIFDTags.convergenceAngle = tagValue;// Need to convert it to a 64 bits value according to standard
-                                            //LIBSKIAHW_LOGDA("Convergence Angle  %x \n", JpgHdrInfo->MPIndexIFDTags.convergenceAngle );
-                                            //TODO: Passed this structure to upper layers
-
-                                        break;
-                                        case TAGID_BASELINELEN: //Base Line Length
-
-                                            if((tagType != (OMX_U16)TAG_TYPE_RATIONAL))
-                                                goto EXIT;
-
-                                            JpgHdrInfo->MPIndexIFDTags.baselineLength= tagValue;// Need to convert it to a 64 bits value according to standard
-                                            //LIBSKIAHW_LOGDA("Base Line Length  %x \n", JpgHdrInfo->MPIndexIFDTags.baselineLength);
-                                            //TODO: Passed this structure to upper layers
-
-                                        break;
-                                        default:
-                                            LIBSKIAHW_LOGDA("Not Supported \n");
-                                        break;
-                                    }
-                                }
-                                //At the end of the IFD, read the nextIFD offset
-                                if(littleEndian)
-                                {
-                                    nextIFDOffset = (OMX_U32)((*Data) + (*(Data+1)<<8) +
-                                                          (*(Data+2)<<16) + (*(Data+3)<<24));
-                                    //LIBSKIAHW_LOGDA("Resseting offset %x \n", nextIFDOffset);
-                                }
-                                else
-                                {
-                                    BigEndianRead32Bits(&nextIFDOffset,Data);
-                                }
-                                if((nextIFDOffset >(itemlen-6))) //APP2 field length (2bytes) + MPformat ID (4 bytes)
-                                    {
-                                        //LIBSKIAHW_LOGDA("size of app %d \n", itemlen);
-                                        nextIFDOffset =0;
-                                    }
-
-                                Data = pOffsetRef; // Reset
-
-                            }while(nextIFDOffset!=NULL);
-                            Data = pOffsetRef -MP_START_OF_OFFSET_REF;
-                        }
-                    }
-            default:
-                     {
-                    /* Skip any other sections.*/
-                    break;
-                }
-            }
-
-            if ( Data != NULL )
-            {
-                free(Data);
-                Data=NULL;
-            }
-    }
-
-EXIT:
-    if ( Data != NULL )
-    {
-        free(Data);
-        Data=NULL;
-    }
-    LOG_FUNCTION_NAME_EXIT
-    return 0;
-}
-
-void SkTIJPEGImageDecoder::FillBufferDone(OMX_U8* pBuffer, OMX_U32 nFilledLen)
-    {
-    LOG_FUNCTION_NAME
-
-#if JPEG_DECODER_DUMP_INPUT_AND_OUTPUT
-    char *tmp= (char*)bitmap->getPixels();
-    char path[50];
-    snprintf(path, sizeof(path), "/JDO_%d_%d_%dx%d.yuv", dOutputCount, bitmap->config(), bitmap->width(), bitmap->height());
+        default:
+            LIBSKIAHW_LOGDA("Not a supported jpeg header\n");
+            return 0;
+        }
 
-    SkFILEWStream tempFile(path);
-    if (tempFile.write(pBuffer, nFilledLen) == false)
+    if (header.hasFrame)
         {
-        LIBSKIAHW_LOGDB("Writing to %s failed\n", path);
+        JpgHdrInfo->nHeight = header.frame.height;
+        JpgHdrInfo->nWidth = header.frame.width;
+        JpgHdrInfo->nFormat = GetYUVformat(&header.frame);
+        switch (JpgHdrInfo->nFormat) {
+        case OMX_COLOR_FormatYUV420Planar:
+            LIBSKIAHW_LOGDA("Image chroma format is OMX_COLOR_FormatYUV420Planar\n");
+            break;
+        case OMX_COLOR_FormatYUV411Planar:
+            LIBSKIAHW_LOGDA("Image chroma format is OMX_COLOR_FormatYUV411Planar\n");
+            break;
+        case OMX_COLOR_FormatCbYCrY:
+            LIBSKIAHW_LOGDA("Image chroma format is OMX_COLOR_FormatYUV422Interleaved\n");
+            break;
+        case OMX_COLOR_FormatYUV444Interleaved:
+            LIBSKIAHW_LOGDA("Image chroma format is OMX_COLOR_FormatYUV444Interleaved\n");
+            break;
+        case OMX_COLOR_FormatL8:
+            LIBSKIAHW_LOGDA("Image chroma format is OMX_COLOR_FormatL8 \n");
+            break;
+        default:
+            LIBSKIAHW_LOGDA("Cannot find Image chroma format \n");
+            JpgHdrInfo->nFormat = OMX_COLOR_FormatUnused;
+            break;
         }
-    else
-        {
-        LIBSKIAHW_LOGDB("Writing to %s succeeded\n", path);
+
+        LIBSKIAHW_LOGDB("Image Width x Height = %u * %u\n", header.frame.width, header.frame.height);
         }
 
-    dOutputCount++;
+    if (header.hasJps)
+        {
+        LIBSKIAHW_LOGDA("Valid Stereo JPS type file \n");
+        fileType = TYPE_JPS;
 
-#endif
+        JpgHdrInfo->s3dDesc.nType = header.jps.type;
+        JpgHdrInfo->s3dDesc.nLayout = header.jps.layout;
 
-    LIBSKIAHW_LOGDB("\n THE ADDRESSSS OFFFF BM->getPixels(): %p \n", bitmap->getPixels());
-    iLastState = iState;
-    iState = STATE_FILL_BUFFER_DONE_CALLED;
+        // Setting the frame order
+        if (header.jps.miscFlags & JPS_MISCF_FO_MASK)
+            JpgHdrInfo->s3dDesc.nFrameOrder = S3D_ORDER_LF;
+        else
+            JpgHdrInfo->s3dDesc.nFrameOrder = S3D_ORDER_RF;
 
-    if(pDecodeTime) {
-        delete pDecodeTime;
-        pDecodeTime = NULL;
-    }
+        // Both bits map straight onto S3D_SS_NONE .. S3D_SS_BOTH
+        JpgHdrInfo->s3dDesc.nSubSampling = header.jps.miscFlags & JPS_MISCF_SS_MASK;
 
-    LOG_FUNCTION_NAME_EXIT
-    }
+        // Separation field , read it even if Don't care
+        JpgHdrInfo->s3dDesc.nSeparation = header.jps.separation;
+        }
 
+    if (header.hasMpo)
+        {
+        const JpegHeaderParser::Mpo& mpo = header.mpo;
+        OMX_U32 images;
 
-void SkTIJPEGImageDecoder::EventHandler(OMX_HANDLETYPE hComponent,
-                                            OMX_EVENTTYPE eEvent,
-                                            OMX_U32 nData1,
-                                            OMX_U32 nData2,
-                                            OMX_PTR pEventData)
-    {
-    LOG_FUNCTION_NAME
+        LIBSKIAHW_LOGDA("Valid MPO type file \n");
+        fileType = TYPE_MPO;
+        finalBytesRead = mpo.tiffOffset;
 
-    switch ( eEvent )
-        {
+        //Default parameters for now
+        JpgHdrInfo->s3dDesc.nType = 0x01; // STEROSCOPIC IMAGES
+        JpgHdrInfo->s3dDesc.nLayout = S3D_FORMAT_OVERUNDER;
+        JpgHdrInfo->s3dDesc.nFrameOrder = S3D_ORDER_LF;
+        JpgHdrInfo->s3dDesc.nSubSampling = S3D_SS_NONE;
+        JpgHdrInfo->s3dDesc.nSeparation = 0;
 
-        case OMX_EventCmdComplete:
-                {
-                    /* Do not move the common stmts in these conditionals outside. */
-                    /* We do not want to apply them in cases when these conditions are not met. */
-                    if ((nData1 == OMX_CommandStateSet) && (nData2 == OMX_StateIdle))
-                        {
-                        LIBSKIAHW_LOGDA("Component State Changed To OMX_StateIdle\n");
-                        iLastState = iState;
-                        iState = STATE_IDLE;
-                        sem_post(semaphore) ;
-                        }
-                    else if ((nData1 == OMX_CommandStateSet) && (nData2 == OMX_StateExecuting))
-                        {
-                        LIBSKIAHW_LOGDA("Component State Changed To OMX_StateExecuting\n");
-                        iLastState = iState;
-                        iState = STATE_EXECUTING;
-                        sem_post(semaphore) ;
-                        }
-                    else if ((nData1 == OMX_CommandStateSet) && (nData2 == OMX_StateLoaded))
-                        {
-                        LIBSKIAHW_LOGDA("Component State Changed To OMX_StateLoaded\n");
-                        iLastState = iState;
-                        iState = STATE_LOADED;
-                        sem_post(semaphore) ;
-                        }
-                    break;
-            }
+        // Only the images which have an MP entry can be located in the stream
+        images = mpo.numberOfImages;
+        if (images > (mpo.numEntries ? mpo.numEntries : 1))
+            images = mpo.numEntries ? mpo.numEntries : 1;
+
+        JpgHdrInfo->MPIndexIFDTags.MPFVersion = mpo.version;
+        JpgHdrInfo->MPIndexIFDTags.numberOfImages = (OMX_U8) images;
+        JpgHdrInfo->MPIndexIFDTags.totalFrames = (OMX_U8) mpo.totalFrames;
+        JpgHdrInfo->MPIndexIFDTags.MPIndividualNum = (OMX_U8) mpo.individualNum;
+        JpgHdrInfo->MPIndexIFDTags.baseViewpointNum = (OMX_U8) mpo.baseViewpointNum;
+        JpgHdrInfo->MPIndexIFDTags.convergenceAngle = (OMX_U8) mpo.convergenceAngle;
+        JpgHdrInfo->MPIndexIFDTags.baselineLength = (OMX_U8) mpo.baselineLength;
 
-        case OMX_EventError:
-                {
-                    LIBSKIAHW_LOGDA("\n\n\nOMX Component  reported an Error!!!!\n\n\n");
-                    iLastState = iState;
-                    iState = STATE_ERROR;
-                    OMX_SendCommand(hComponent, OMX_CommandStateSet, OMX_StateInvalid, NULL);
-                    sem_post(semaphore) ;
-                    break;
+        for (OMX_U32 i = 0; i < mpo.numEntries; i++)
+            {
+            JpgHdrInfo->MPIndexIFDTags.MPEntry[i].imageAttribute = mpo.entries[i].imageAttribute;
+            JpgHdrInfo->MPIndexIFDTags.MPEntry[i].imageSize = mpo.entries[i].imageSize;
+            JpgHdrInfo->MPIndexIFDTags.MPEntry[i].dataOffset = mpo.entries[i].dataOffset;
+            JpgHdrInfo->MPIndexIFDTags.MPEntry[i].dependentImage1 = mpo.entries[i].dependentImage1;
+            JpgHdrInfo->MPIndexIFDTags.MPEntry[i].dependentImage2 = mpo.entries[i].dependentImage2;
             }
-        default:
-            break;
-    }
-    LOG_FUNCTION_NAME_EXIT
 
-    }
+        if (mpo.individualNum == 0x1)
+            JpgHdrInfo->s3dDesc.nFrameOrder = S3D_ORDER_LF;
+        }
 
+    LOG_FUNCTION_NAME_EXIT
+    return lSize;
+}
 
-OMX_S32 SkTIJPEGImageDecoder::fill_data(OMX_BUFFERHEADERTYPE *pBuf, SkStream* stream, OMX_S32 bufferSize)
+OMX_S32 SkTIJPEGImageDecoder::fill_data(OMX_U8* pBuffer, SkStream* stream, OMX_S32 bufferSize)
     {
     LOG_FUNCTION_NAME
 
-    pBuf->nFilledLen = stream->read(pBuf->pBuffer, bufferSize);
+    OMX_S32 nFilledLen = stream->read(pBuffer, bufferSize);
 
 #if JPEG_DECODER_DUMP_INPUT_AND_OUTPUT
     char path[50];
     snprintf(path, sizeof(path), "/JDI_%d.jpg", dInputCount);
 
     SkFILEWStream tempFile(path);
-    if (tempFile.write(pBuf->pBuffer, pBuf->nFilledLen) == false)
+    if (tempFile.write(pBuffer, nFilledLen) == false)
         JPEGD_Trace("Writing to %s failed\n", path);
     else
         JPEGD_Trace("Writing to %s succeeded\n", path);
@@ -900,14 +352,19 @@ OMX_S32 SkTIJPEGImageDecoder::fill_data(OMX_BUFFERHEADERTYPE *pBuf, SkStream* st
 #endif
 
     LOG_FUNCTION_NAME_EXIT
-    return pBuf->nFilledLen;
+    return nFilledLen;
     }
 
 
-///Decision engine method that decides between ARM decoder or SIMCOP decoder
+///Decision engine method that decides between ARM decoder or SIMCOP decoder.
+///SIMCOP is opt-in through JPEG_HW_DECODE_PROPERTY, by default 2D images stay on the ARM for backward compatibility
 bool SkTIJPEGImageDecoder::IsHwFormat(SkStream* stream)
 {
-    bool useHw = false;//Use SW for 2D Images backward compatility
+    char value[PROPERTY_VALUE_MAX];
+    bool useHw;
+
+    property_get(JPEG_HW_DECODE_PROPERTY, value, "0");
+    useHw = ( 0 != atoi(value) );
 
     inputFileSize = ParseJpegHeader(stream , &JpegHeaderInfo);
 
@@ -922,6 +379,12 @@ bool SkTIJPEGImageDecoder::IsHwFormat(SkStream* stream)
         useHw = false;
         }
 
+    //Stereo MPO and JPS files stay on the ARM path, onDecodeOmx() knows only one view
+    if(fileType != TYPE_JPG)
+        {
+        useHw = false;
+        }
+
     return useHw;
 }
 
@@ -930,7 +393,7 @@ bool SkTIJPEGImageDecoder::onDecode(SkStream* stream, SkBitmap* bm, Mode mode)
 {
     LOG_FUNCTION_NAME
     LIBSKIAHW_LOGEB ("Process %x calling onDecode", getpid());
-    if(IsHwFormat(stream) && IsHwAvailable())
+    if(IsHwFormat(stream))
         {
         LOG_FUNCTION_NAME_EXIT
         return onDecodeOmx(stream, bm, mode);
@@ -943,78 +406,185 @@ bool SkTIJPEGImageDecoder::onDecode(SkStream* stream, SkBitmap* bm, Mode mode)
         }
 }
 
-///Method which tries to acquire SIMCOP resource
-bool SkTIJPEGImageDecoder::IsHwAvailable()
+SkJPEGImageDecoder* SkTIJPEGImageDecoder::GetArmDecoder(SkJPEGImageDecoder** handle)
 {
-    LOG_FUNCTION_NAME
-    char strTIJpegDec[] = "OMX.TI.DUCATI1.IMAGE.JPEGD";
-    OMX_ERRORTYPE eError = OMX_ErrorNone;
+    if(!*handle)
+        {
+        *handle = SkNEW(SkJPEGImageDecoder);
+        if(!*handle)
+            {
+            return NULL;
+            }
+        }
 
-    AutoTimeMillis atm("Init time: ");
+    (*handle)->setSampleSize(this->getSampleSize());
+    (*handle)->setDitherImage(this->getDitherImage());
+    (*handle)->SetDeviceConfig(this->GetDeviceConfig());
 
-    if(pOMXHandle)
-        {
-        return true;
+    return *handle;
+}
+
+bool SkTIJPEGImageDecoder::DecodeMpoViews(MPO_DECODE_JOB* job)
+{
+    job->bResult = true;
+
+    for(int i = job->nFirst; i < job->nViews; i += 2)
+    {
+        MPO_VIEW* view = &job->pViews[i];
+        SkMemoryStream viewStream(view->pData, view->nSize);
+
+        job->pDecoder->setAllocator(&view->allocator);
+        if(!job->pDecoder->decode(&viewStream, &view->bitmap, job->mode))
+            {
+            LIBSKIAHW_LOGEB("MPO view %d decode failed", i);
+            job->bResult = false;
+            }
+        // The allocators live on the stack of onDecodeMpo
+        job->pDecoder->setAllocator(NULL);
+    }
+
+    return job->bResult;
+}
+
+void* SkTIJPEGImageDecoder::MpoDecodeThread(void* job)
+{
+    DecodeMpoViews((MPO_DECODE_JOB*)job);
+    return NULL;
+}
+
+///Decodes the views of an MPO file on two decoders at once, each into its part of one stereo bitmap
+bool SkTIJPEGImageDecoder::onDecodeMpo(SkStream* stream, SkBitmap* bm, Mode mode)
+{
+    LOG_FUNCTION_NAME
+
+    MPO_VIEW views[JpegHeaderParser::MAX_MP_ENTRIES];
+    MPO_DECODE_JOB jobs[2];
+    SkAutoMalloc storage;
+    const OMX_U8* base;
+    size_t length = stream->getLength();
+    int numViews = 0;
+    pthread_t thread;
+    bool threadStarted = false;
+    TISkMallocPixelRef* stereo;
+
+    // Every view gets its own stream over the file, so the file has to be in memory
+    base = (const OMX_U8*) stream->getMemoryBase();
+    if(NULL == base)
+        {
+        stream->rewind();
+        base = (const OMX_U8*) storage.alloc(length);
+        if((NULL == base) || (stream->read((void*) base, length) != length))
+            {
+            LIBSKIAHW_LOGEA("Could not read the MPO file");
+            return false;
+            }
         }
 
-    OMX_Init();
+    // The MP entries give the offset of each image directly
+    for(int i = 0; i < JpegHeaderInfo.MPIndexIFDTags.numberOfImages; i++)
+    {
+        size_t offset = 0;
+        size_t size = length;
+
+        if(i)
+            {
+            offset = JpegHeaderInfo.MPIndexIFDTags.MPEntry[i].dataOffset + finalBytesRead;
+            if(offset >= length)
+                break;
+            size = length - offset;
+            }
+
+        if((JpegHeaderInfo.MPIndexIFDTags.MPEntry[i].imageSize != 0) &&
+           (JpegHeaderInfo.MPIndexIFDTags.MPEntry[i].imageSize < size))
+            size = JpegHeaderInfo.MPIndexIFDTags.MPEntry[i].imageSize;
+
+        if((size < 2) || (base[offset] != 0xff) || (base[offset + 1] != M_SOI))
+            {
+            LIBSKIAHW_LOGEB("No image at the offset of MPO view %d", i);
+            break;
+            }
+
+        views[i].pData = base + offset;
+        views[i].nSize = size;
+        numViews++;
+    }
 
-    OMX_CALLBACKTYPE JPEGCallBack ={OMX_EventHandler, OMX_EmptyBufferDone, OMX_FillBufferDone};
+    if(numViews < 2)
+        {
+        LOG_FUNCTION_NAME_EXIT
+        stream->rewind();
+        return pARMHandle->decode(stream, bm, mode);
+        }
 
-    eError = OMX_GetHandle(&pOMXHandle, strTIJpegDec, (void *)this, &JPEGCallBack);
-    if ( (eError != OMX_ErrorNone) ||  (pOMXHandle == NULL) )
+    // For now we are assuming same resolutions files and we put in TOP/BOTTOM
+    // configuration, there is no need to set any other layout
+    // as our driver and algo better handle T/B.
+    S3DAllocator.config(fileType, bm->width(), (bm->height() * numViews), numViews);
+    stereo = S3DAllocator.allocStereo(bm->config(), NULL);
+    if(NULL == stereo)
         {
-        LIBSKIAHW_LOGEB ("Error in Get Handle function eError %d\n", eError);
-        pOMXHandle = NULL;
-         OMX_Deinit();
-         LOG_FUNCTION_NAME_EXIT
-         return false;
+        LIBSKIAHW_LOGEA("Could not allocate the stereo buffer");
+        return false;
         }
 
-    iLastState = STATE_LOADED;
-    iState = STATE_LOADED;
-    LIBSKIAHW_LOGEB ("SIMCOP Available to process %x", getpid());
+    for(int i = 0; i < numViews; i++)
+    {
+        views[i].allocator.config(stereo, S3DAllocator.viewOffset(i));
+    }
 
-    LOG_FUNCTION_NAME_EXIT
-    return true;
+    for(int j = 0; j < 2; j++)
+    {
+        jobs[j].pViews = views;
+        jobs[j].nFirst = j;
+        jobs[j].nViews = numViews;
+        jobs[j].mode = mode;
+        jobs[j].bResult = false;
+    }
+    jobs[0].pDecoder = pARMHandle;
+    jobs[1].pDecoder = GetArmDecoder(&pARMViewHandle);
 
-}
+    if(jobs[1].pDecoder)
+        {
+        threadStarted = (0 == pthread_create(&thread, NULL, MpoDecodeThread, &jobs[1]));
+        }
 
-bool SkTIJPEGImageDecoder::isValidStream(SkStream* stream, int nextFileOffset)
-{
-        OMX_U8 a = 0;
+    if(!threadStarted)
+        {
+        // Decode all the views here
+        LIBSKIAHW_LOGDA("MPO views decoded sequentially");
+        jobs[1].pDecoder = pARMHandle;
+        DecodeMpoViews(&jobs[1]);
+        }
 
-        a = stream->readU8();
-        if ( a != 0xff || stream->readU8() != M_SOI )
+    DecodeMpoViews(&jobs[0]);
+
+    if(threadStarted)
         {
-            stream->rewind();
-            return false;
+        pthread_join(thread, NULL);
         }
-        else
+
+    if(jobs[0].bResult && jobs[1].bResult)
         {
-            stream->rewind();
-            return true;
+        // The first view starts the stereo buffer
+        *bm = views[0].bitmap;
         }
+
+    stereo->unref();
+
+    LOG_FUNCTION_NAME_EXIT
+    return jobs[0].bResult && jobs[1].bResult;
 }
 
 ///Method for decoding using ARM decoder
 bool SkTIJPEGImageDecoder::onDecodeArm(SkStream* stream, SkBitmap* bm, Mode mode)
 {
-    if(!pARMHandle)
+    if(!GetArmDecoder(&pARMHandle))
         {
-        pARMHandle = SkNEW(SkJPEGImageDecoder);
-        if(!pARMHandle)
-            {
-            return false;
-            }
+        return false;
         }
-    bool ret=false;
-    int nextFileOffset;
+
     stream->rewind();
 
-    pARMHandle->setSampleSize(this->getSampleSize());
-    pARMHandle->setDitherImage(this->getDitherImage());
-    pARMHandle->SetDeviceConfig(this->GetDeviceConfig());
     int scaleFactor = this->getSampleSize();
 
     if(fileType== TYPE_MPO)
@@ -1024,33 +594,7 @@ bool SkTIJPEGImageDecoder::onDecodeArm(SkStream* stream, SkBitmap* bm, Mode mode
         if(SkImageDecoder::kDecodeBounds_Mode == mode )
             return pARMHandle->decode(stream, bm, mode);
 
-        // For now we are assuming same resolutions files and we put in TOP/BOTTOM
-        // configuration, there is no need to set any other layout
-        // as our driver and algo better handle T/B.
-        S3DAllocator.config(fileType, bm->width(), (bm->height() *JpegHeaderInfo.MPIndexIFDTags.numberOfImages), JpegHeaderInfo.MPIndexIFDTags.numberOfImages);
-        pARMHandle->setAllocator(&S3DAllocator);
-
-        for(int i=0;i < JpegHeaderInfo.MPIndexIFDTags.numberOfImages;i++)
-        {
-            // The offset of the first image is 0, so skip from next image
-            if(i)
-            {
-                nextFileOffset = JpegHeaderInfo.MPIndexIFDTags.MPEntry[i].dataOffset + finalBytesRead;
-
-                stream->rewind();
-                // Skipping to offset
-                for(int j=0;j<nextFileOffset;j++)
-                    stream->read(NULL, 1);
-                /*int realSize = stream->skip((size_t) (myoffset));
-                LIBSKIAHW_LOGDA("Skipping by %d bytes \n", realSize);*/
-
-                if(!isValidStream(stream, nextFileOffset))
-                    return true;
-            }
-            ret = pARMHandle->decode(stream, bm, mode);
-        }
-        S3DAllocator.reset(bm);
-        return ret;
+        return onDecodeMpo(stream, bm, mode);
     }
     else if(fileType==TYPE_JPS)
     {
@@ -1066,39 +610,24 @@ bool SkTIJPEGImageDecoder::onDecodeArm(SkStream* stream, SkBitmap* bm, Mode mode
     return pARMHandle->decode(stream, bm, mode);
 }
 
-///Method for decoding using SIMCOP decoder
+///Method for decoding using SIMCOP decoder, on a session leased from the process wide pool
 bool SkTIJPEGImageDecoder::onDecodeOmx(SkStream* stream, SkBitmap* bm, Mode mode)
     {
     LOG_FUNCTION_NAME
 
-    android::gTIJpegDecMutex.lock();
-    /* Critical section */
-
 #ifdef TIME_DECODE
     AutoTimeMillis atm("TI JPEG Decode");
 #endif
-{
-
-    AutoTimeMillis atm("Configuration Decode");
 
-    int nRetval;
-    int nIndex1;
-    int nIndex2;
     int scaleFactor;
-    int bitsPerPixel;
-    void *p_out=NULL;
-    MemAllocBlock *MemReqDescTiler;
-    OMX_S32 nCompId = 100;
-    OMX_ERRORTYPE eError = OMX_ErrorNone;
-    OMX_PORT_PARAM_TYPE PortType;
-
-    OMX_JPEG_PARAM_UNCOMPRESSEDMODETYPE tUncompressedMode;
-    OMX_IMAGE_PARAM_DECODE_SUBREGION pSubRegionDecode;
+    OMX_U32 dctScale, nOutWidth, nOutHeight;
+    OMX_S32 nRead;
+    bool ret;
+    JpegDecoderSession::Config sessionConfig;
+    JpegDecoderSession* session;
 
     LIBSKIAHW_LOGDA("\nUsing TI Image Decoder.\n");
 
-    bitmap = bm;
-    inStream = stream;
     SkBitmap::Config config = this->getPrefConfig(k32Bit_SrcDepth, false);
     scaleFactor = this->getSampleSize();
 
@@ -1106,6 +635,11 @@ bool SkTIJPEGImageDecoder::onDecodeOmx(SkStream* stream, SkBitmap* bm, Mode mode
     LIBSKIAHW_LOGDB("mode = %d\n", mode);
     LIBSKIAHW_LOGDB("scaleFactor = %d ", scaleFactor);
 
+    // Downscaled in the IDCT, the bitmap may come out larger than sampleSize asks for
+    dctScale = JpegDecoderSession::scaleFor(scaleFactor);
+    nOutWidth = JpegDecoderSession::scaledSize(JpegHeaderInfo.nWidth, dctScale);
+    nOutHeight = JpegDecoderSession::scaledSize(JpegHeaderInfo.nHeight, dctScale);
+    LIBSKIAHW_LOGDB("DCT scale 1/%d ", dctScale);
 
 #ifdef TIME_DECODE
     atm.setResolution(JpegHeaderInfo.nWidth , JpegHeaderInfo.nHeight);
@@ -1113,14 +647,14 @@ bool SkTIJPEGImageDecoder::onDecodeOmx(SkStream* stream, SkBitmap* bm, Mode mode
 
     if (inputFileSize == 0) {
         LIBSKIAHW_LOGEA("The file size is 0. Maybe the format of the file is not correct\n");
-        goto EXIT;
+        return false;
     }
 
     // if no user preference, see what the device recommends
     if (config == SkBitmap::kNo_Config)
         config = SkImageDecoder::GetDeviceConfig();
 
-    bm->setConfig(config, JpegHeaderInfo.nWidth/scaleFactor, JpegHeaderInfo.nHeight/scaleFactor);
+    bm->setConfig(config, nOutWidth, nOutHeight);
     bm->setIsOpaque(true);
     LIBSKIAHW_LOGDB("bm->width() = %d\n", bm->width());
     LIBSKIAHW_LOGDB("bm->height() = %d\n", bm->height());
@@ -1129,484 +663,265 @@ bool SkTIJPEGImageDecoder::onDecodeOmx(SkStream* stream, SkBitmap* bm, Mode mode
 
     if (SkImageDecoder::kDecodeBounds_Mode == mode)
         {
-        android::gTIJpegDecMutex.unlock();
-        LIBSKIAHW_LOGDA("Leaving Critical Section 1 \n");
+        LOG_FUNCTION_NAME_EXIT
         return true;
         }
 
-    PortType.nSize = sizeof(OMX_PORT_PARAM_TYPE);
-    PortType.nVersion.s.nVersionMajor = 0x1;
-    PortType.nVersion.s.nVersionMinor = 0x1;
-    PortType.nVersion.s.nRevision = 0x0;
-    PortType.nVersion.s.nStep = 0x0;
-    PortType.nPorts = 2;
-    PortType.nStartPortNumber = 0;
-
-    eError = OMX_SetParameter(pOMXHandle, OMX_IndexParamImageInit, &PortType);
-    if ( eError != OMX_ErrorNone )
-        {
-        LIBSKIAHW_LOGEA ("Error in OMX_SetParameter function\n");
-        iState = STATE_ERROR;
-        goto EXIT;
-        }
-
-    /**********************************************************************/
-    /* Set the component's OMX_PARAM_PORTDEFINITIONTYPE structure (INPUT) */
-    /**********************************************************************/
-
-    InPortDef.nSize = sizeof(OMX_PARAM_PORTDEFINITIONTYPE);
-    InPortDef.nVersion.s.nVersionMajor = 0x1;
-    InPortDef.nVersion.s.nVersionMinor = 0x1;
-    InPortDef.nVersion.s.nRevision = 0x0;
-    InPortDef.nVersion.s.nStep = 0x0;
-    InPortDef.nPortIndex = OMX_JPEGD_TEST_INPUT_PORT;
-    InPortDef.eDir = OMX_DirInput;
-    InPortDef.nBufferCountActual =1;
-    InPortDef.nBufferCountMin = 1;
-    InPortDef.nBufferSize = inputFileSize;
-    InPortDef.bEnabled = OMX_TRUE;
-    InPortDef.bPopulated = OMX_FALSE;
-    InPortDef.eDomain = OMX_PortDomainImage;
-    InPortDef.format.image.cMIMEType = (OMX_STRING)"OMXJPEGD";
-    InPortDef.format.image.pNativeRender = 0;
-    InPortDef.format.image.nFrameWidth = inputFileSize;
-    InPortDef.format.image.nFrameHeight = 1;
-    InPortDef.format.image.nStride = 1;
-    InPortDef.format.image.nSliceHeight = 1;
-    InPortDef.format.image.bFlagErrorConcealment = OMX_FALSE;
-    InPortDef.format.image.eCompressionFormat = OMX_IMAGE_CodingJPEG;
-    InPortDef.format.image.pNativeWindow = 0x0;
-    InPortDef.bBuffersContiguous = OMX_FALSE;
-    InPortDef.nBufferAlignment = 0;
+    memset(&sessionConfig, 0, sizeof(sessionConfig));
+    sessionConfig.nWidth = nOutWidth;
+    sessionConfig.nHeight = nOutHeight;
+    sessionConfig.nScale = dctScale;
 
     if (JpegHeaderInfo.nFormat == OMX_COLOR_FormatYCbYCr)
         {
-        InPortDef.format.image.eColorFormat = OMX_COLOR_FormatCbYCrY;
+        sessionConfig.eInputFormat = OMX_COLOR_FormatCbYCrY;
         }
     else
         {
         ///@todo Check this input format
-        InPortDef.format.image.eColorFormat = OMX_COLOR_FormatYUV420PackedPlanar;
+        sessionConfig.eInputFormat = OMX_COLOR_FormatYUV420PackedPlanar;
         }
 
-    eError = OMX_SetParameter (pOMXHandle, OMX_IndexParamPortDefinition, &InPortDef);
-    if ( eError != OMX_ErrorNone )
-        {
-        LIBSKIAHW_LOGEA ("Error in OMX_SetParameter function\n");
-        eError = OMX_ErrorBadParameter;
-        iState = STATE_ERROR;
-        goto EXIT;
-        }
-
-    /***********************************************************************/
-    /* Set the component's OMX_PARAM_PORTDEFINITIONTYPE structure (OUTPUT) */
-    /***********************************************************************/
-
-    OutPortDef.nSize = sizeof(OMX_PARAM_PORTDEFINITIONTYPE);
-    OutPortDef.nVersion.s.nVersionMajor = 0x1;
-    OutPortDef.nVersion.s.nVersionMinor = 0x1;
-    OutPortDef.nVersion.s.nRevision = 0x0;
-    OutPortDef.nVersion.s.nStep = 0x0;
-
-    OutPortDef.nPortIndex = OMX_JPEGD_TEST_OUTPUT_PORT;
-    OutPortDef.eDir = OMX_DirOutput;
-    OutPortDef.nBufferCountActual = 1;
-    OutPortDef.nBufferCountMin = 1;
-    OutPortDef.bEnabled = OMX_TRUE;
-    OutPortDef.bPopulated = OMX_FALSE;
-    OutPortDef.eDomain = OMX_PortDomainImage;
-    OutPortDef.format.image.cMIMEType = (OMX_STRING)"OMXJPEGD";
-    OutPortDef.format.image.pNativeRender = 0;
-    OutPortDef.format.image.nFrameWidth = JpegHeaderInfo.nWidth/scaleFactor;
-    LIBSKIAHW_LOGDB("\nOutPortDef.format.image.nFrameWidth = %d\n", (int)OutPortDef.format.image.nFrameWidth);
-
-    OutPortDef.format.image.nFrameHeight = JpegHeaderInfo.nHeight/scaleFactor;
-    LIBSKIAHW_LOGDB("\nOutPortDef.format.image.nFrameHeight = %d\n", (int)OutPortDef.format.image.nFrameHeight);
-
-    OutPortDef.format.image.nStride = JpegHeaderInfo.nWidth/scaleFactor;
-    LIBSKIAHW_LOGDB("\n OutPortDef.format.image.nStride = %d\n", (int)OutPortDef.format.image.nStride);
-
-    OutPortDef.format.image.nSliceHeight = 0;
-    OutPortDef.format.image.bFlagErrorConcealment = OMX_FALSE;
-    OutPortDef.format.image.eCompressionFormat = OMX_IMAGE_CodingUnused;
-    OutPortDef.format.image.pNativeWindow = 0x0;
-    OutPortDef.bBuffersContiguous = OMX_FALSE;
-    OutPortDef.nBufferAlignment = 0; //64
-
     if (config == SkBitmap::kA8_Config)
         { /* 8-bits per pixel, with only alpha specified (0 is transparent, 0xFF is opaque) */
-        OutPortDef.format.image.eColorFormat = OMX_COLOR_FormatL8;
-        bitsPerPixel = 1;
+        sessionConfig.eOutputFormat = OMX_COLOR_FormatL8;
+        sessionConfig.nBytesPerPixel = 1;
         }
     else if (config == SkBitmap::kRGB_565_Config)
         { /* 16-bits per pixel*/
-        OutPortDef.format.image.eColorFormat = OMX_COLOR_Format16bitRGB565;
+        sessionConfig.eOutputFormat = OMX_COLOR_Format16bitRGB565;
         LIBSKIAHW_LOGDA("Color format is OMX_COLOR_Format16bitRGB565\n");
-        bitsPerPixel = 2;
+        sessionConfig.nBytesPerPixel = 2;
         }
     else if (config == SkBitmap::kARGB_8888_Config)
         { /* 32-bits per pixel */
-        OutPortDef.format.image.eColorFormat = OMX_COLOR_Format32bitARGB8888;
+        sessionConfig.eOutputFormat = OMX_COLOR_Format32bitARGB8888;
         LIBSKIAHW_LOGDA("Color format is OMX_COLOR_Format32bitARGB8888\n");
-        bitsPerPixel = 4;
+        sessionConfig.nBytesPerPixel = 4;
         }
     else
         { /* Set DEFAULT color format*/
         ///@todo extend the bitmap supported formats to YUV422, YUV420 etc
-        OutPortDef.format.image.eColorFormat = OMX_COLOR_FormatCbYCrY;
-        bitsPerPixel = 2;
+        sessionConfig.eOutputFormat = OMX_COLOR_FormatCbYCrY;
+        sessionConfig.nBytesPerPixel = 2;
         }
 
-    OutPortDef.nBufferSize = (JpegHeaderInfo.nWidth / scaleFactor ) * (JpegHeaderInfo.nHeight / scaleFactor) * bitsPerPixel ;
-    LIBSKIAHW_LOGDB("Output buffer size is %ld\n", OutPortDef.nBufferSize);
-
-
-    eError = OMX_SetParameter (pOMXHandle, OMX_IndexParamPortDefinition, &OutPortDef);
-    if ( eError != OMX_ErrorNone )
+    session = gJpegDecoderPool.lease(sessionConfig);
+    if (NULL == session)
         {
-        eError = OMX_ErrorBadParameter;
-        iState = STATE_ERROR;
-        goto EXIT;
+        LIBSKIAHW_LOGDA("No SIMCOP session available, using the ARM decoder\n");
+        LOG_FUNCTION_NAME_EXIT
+        return onDecodeArm(stream, bm, mode);
         }
 
-    tUncompressedMode.nSize = sizeof(OMX_JPEG_PARAM_UNCOMPRESSEDMODETYPE);
-    tUncompressedMode.nVersion.s.nVersionMajor = 0x1;
-    tUncompressedMode.nVersion.s.nVersionMinor = 0x1;
-    tUncompressedMode.nVersion.s.nRevision = 0x0;
-    tUncompressedMode.nVersion.s.nStep = 0x0;
-
-    /* Test Set Parameteres OMX_JPEG_PARAM_UNCOMPRESSEDMODETYPE */
-    tUncompressedMode.nPortIndex = OMX_JPEGD_TEST_INPUT_PORT;
-    tUncompressedMode.eUncompressedImageMode = OMX_JPEG_UncompressedModeFrame;
+    {
+    AutoTimeMillis atm("Configuration Decode");
+    ret = session->prepare(sessionConfig, inputFileSize);
+    }
 
-    eError = OMX_SetParameter (pOMXHandle, (OMX_INDEXTYPE)OMX_TI_IndexParamJPEGUncompressedMode,&tUncompressedMode);
-    if ( eError != OMX_ErrorNone )
+    if (ret && !bm->allocPixels(&allocator, NULL))
         {
-        LIBSKIAHW_LOGEB ("JPEGDec test:: error= %x\n", eError);
-        iState = STATE_ERROR;
-        goto EXIT;
+        LIBSKIAHW_LOGEA("xxxxxxxxxxxxxxxxxxxx allocPixels failed\n");
+        ret = false;
         }
 
-    LIBSKIAHW_LOGDA("OMX_SetParameter input image uncompressed mode done successfully");
+    if (ret)
+        {
+        AutoTimeMillis atm("BufferDecode Time");
 
-    pSubRegionDecode.nSize = sizeof(OMX_IMAGE_PARAM_DECODE_SUBREGION);
-    pSubRegionDecode.nVersion.s.nVersionMajor = 0x1;
-    pSubRegionDecode.nVersion.s.nVersionMinor = 0x1;
-    pSubRegionDecode.nVersion.s.nRevision = 0x0;
-    pSubRegionDecode.nVersion.s.nStep = 0x0;
+        stream->rewind();
+        nRead = fill_data(session->inputBuffer(), stream, inputFileSize);
+        ret = session->decode(nRead, bm->getPixels(), bm->getSize());
+        }
 
-    pSubRegionDecode.nXOrg = 0;
-    pSubRegionDecode.nYOrg = 0;
-    pSubRegionDecode.nXLength = 0;
-    pSubRegionDecode.nYLength = 0;
+    gJpegDecoderPool.release(session);
 
-    /* Set Parameteres OMX_IMAGE_PARAM_DECODE_SUBREGION   */
-    eError = OMX_SetParameter(pOMXHandle,(OMX_INDEXTYPE)OMX_TI_IndexParamDecodeSubregion,&pSubRegionDecode);
-    if ( eError != OMX_ErrorNone )
+#if JPEG_DECODER_DUMP_INPUT_AND_OUTPUT
+    if (ret)
         {
-        LIBSKIAHW_LOGEB ("JPEGDec test:: %d:error= %x\n", __LINE__, eError);
-        iState = STATE_ERROR;
-        goto EXIT;
-        }
-    LIBSKIAHW_LOGDA("OMX_SetParameter sub region decode done successfully");
+        char path[50];
+        snprintf(path, sizeof(path), "/JDO_%d_%d_%dx%d.yuv", dOutputCount, bm->config(), bm->width(), bm->height());
 
-   eError = OMX_SendCommand(pOMXHandle, OMX_CommandStateSet, OMX_StateIdle ,NULL);
-    if ( eError != OMX_ErrorNone )
-        {
-        LIBSKIAHW_LOGEA ("Error from SendCommand-Idle(Init) State function\n");
-        iState = STATE_ERROR;
-        goto EXIT;
+        SkFILEWStream tempFile(path);
+        if (tempFile.write(bm->getPixels(), bm->getSize()) == false)
+            {
+            LIBSKIAHW_LOGDB("Writing to %s failed\n", path);
+            }
+        else
+            {
+            LIBSKIAHW_LOGDB("Writing to %s succeeded\n", path);
+            }
+
+        dOutputCount++;
         }
+#endif
 
-    if (!bm->allocPixels(&allocator, NULL))
+    if (!ret)
         {
-        LIBSKIAHW_LOGEA("xxxxxxxxxxxxxxxxxxxx allocPixels failed\n");
-        iState = STATE_ERROR;
-        goto EXIT;
+        LIBSKIAHW_LOGEA("SIMCOP decode failed, using the ARM decoder\n");
+        LOG_FUNCTION_NAME_EXIT
+        return onDecodeArm(stream, bm, mode);
         }
 
-    eError = OMX_AllocateBuffer(pOMXHandle, &pInBuffHead,  InPortDef.nPortIndex, (void *)&nCompId, InPortDef.nBufferSize);
-    if ( eError != OMX_ErrorNone )
+    LOG_FUNCTION_NAME_EXIT
+    return true;
+    }
+
+void SkTIJPEGImageDecoder::ResetTileIndex()
+    {
+    tileIndex.reset();
+
+    // The index of the ARM decoder reads from pTileStream
+    if (bArmTileIndex && pARMHandle)
         {
-        LIBSKIAHW_LOGEB ("JPEGDec test:: %d:error= %x\n", __LINE__, eError);
-        iState = STATE_ERROR;
-        goto EXIT;
+        delete pARMHandle;
+        pARMHandle = NULL;
         }
+    bArmTileIndex = false;
 
-    eError = OMX_UseBuffer(pOMXHandle, &pOutBuffHead,  OutPortDef.nPortIndex, (void *)&nCompId, OutPortDef.nBufferSize, (OMX_U8*)bm->getPixels());
-    if ( eError != OMX_ErrorNone )
+    if (pTileStream)
         {
-        LIBSKIAHW_LOGEB ("JPEGDec test:: %d:error= %x\n", __LINE__, eError);
-        iState = STATE_ERROR;
-        goto EXIT;
+        pTileStream->unref();
+        pTileStream = NULL;
         }
-
-    LIBSKIAHW_LOGDB(" \n THE ADDRESSSS OFFFF BM->getPixels(): %p  \n", bm->getPixels());
-}
-    android::gTIJpegDecMutex.unlock();
-    pBeforeDecodeTime=new AutoTimeMillis("Before_BufferDecode Time");
-    Run();
-
-    return true;
-
-EXIT:
-    if (iState == STATE_ERROR) {
-        sem_post(semaphore);
-        Run();
     }
-    android::gTIJpegDecMutex.unlock();
-    LIBSKIAHW_LOGDA("Leaving Critical Section 3 \n");
 
-    LOG_FUNCTION_NAME_EXIT
-    return false;
-    }
-
-void SkTIJPEGImageDecoder::PrintState()
+///Keeps the whole file and indexes its restart intervals, so that decodeRegion only decodes the MCUs covering the region.
+///Files which can't be cut along restart markers are indexed by the ARM decoder instead
+bool SkTIJPEGImageDecoder::onBuildTileIndex(SkStream* stream, int *width, int *height)
     {
     LOG_FUNCTION_NAME
-    switch(iState)
+
+    size_t length;
+    void* data;
+
+    ResetTileIndex();
+
+    length = stream->getLength();
+    if (length == 0)
         {
-        case STATE_LOADED:
-            LIBSKIAHW_LOGDA("Current State is STATE_LOADED.\n");
-            break;
+        LIBSKIAHW_LOGEA("Stream length unknown, cannot build the tile index\n");
+        return false;
+        }
 
-        case STATE_IDLE:
-            LIBSKIAHW_LOGDA("Current State is STATE_IDLE.\n");
-            break;
+    data = sk_malloc_flags(length, 0);
+    if (NULL == data)
+        {
+        LIBSKIAHW_LOGEB("Cannot allocate %d bytes for the tile index\n", length);
+        return false;
+        }
 
-        case STATE_EXECUTING:
-            LIBSKIAHW_LOGDA("Current State is STATE_EXECUTING.\n");
-            break;
+    stream->rewind();
+    if (stream->read(data, length) != length)
+        {
+        LIBSKIAHW_LOGEA("Premature end of file?");
+        sk_free(data);
+        return false;
+        }
 
-        case STATE_EMPTY_BUFFER_DONE_CALLED:
-            LIBSKIAHW_LOGDA("Current State is STATE_EMPTY_BUFFER_DONE_CALLED.\n");
-            break;
+    pTileStream = new SkMemoryStream();
+    pTileStream->setMemoryOwned(data, length);
 
-        case STATE_FILL_BUFFER_DONE_CALLED:
-            LIBSKIAHW_LOGDA("Current State is STATE_FILL_BUFFER_DONE_CALLED.\n");
-            break;
+    if (ParseJpegHeader(pTileStream, &JpegHeaderInfo) == 0)
+        {
+        ResetTileIndex();
+        return false;
+        }
 
-        case STATE_ERROR:
-            LIBSKIAHW_LOGDA("Current State is STATE_ERROR.\n");
-            break;
+    if ((fileType == TYPE_JPG) && tileIndex.build((const uint8_t*)data, length, headerParser.header()))
+        {
+        LIBSKIAHW_LOGDB("Tile index of %dx%d built\n", tileIndex.width(), tileIndex.height());
+        *width = tileIndex.width();
+        *height = tileIndex.height();
 
-        case STATE_EXIT:
-            LIBSKIAHW_LOGDA("Current State is STATE_EXIT.\n");
-            break;
+        LOG_FUNCTION_NAME_EXIT
+        return true;
+        }
 
-        default:
-            LIBSKIAHW_LOGDA("Current State is Invalid.\n");
-            break;
+    LIBSKIAHW_LOGDA("No usable restart markers, the ARM decoder indexes the file\n");
+    if (!GetArmDecoder(&pARMHandle))
+        {
+        ResetTileIndex();
+        return false;
+        }
 
+    pTileStream->rewind();
+    bArmTileIndex = pARMHandle->buildTileIndex(pTileStream, width, height);
+    if (!bArmTileIndex)
+        {
+        ResetTileIndex();
         }
+
     LOG_FUNCTION_NAME_EXIT
+    return bArmTileIndex;
     }
 
-void SkTIJPEGImageDecoder::Run()
+///Decodes the restart intervals covering rect, cut out as a JPEG of their own, and crops them to rect.
+///The tile goes through onDecode like any other file, so it runs on SIMCOP whenever IsHwFormat allows it
+bool SkTIJPEGImageDecoder::onDecodeRegion(SkBitmap* bm, SkIRect rect)
     {
     LOG_FUNCTION_NAME
 
-    int nRead;
-    OMX_ERRORTYPE eError = OMX_ErrorNone;
-
-    while(1)
-        {
-
-        sem_wait(semaphore) ;
-        LIBSKIAHW_LOGDA("-Run Sem Signalled\n");
+    JpegTileIndex::Tile tile;
+    SkBitmap tileBitmap;
+    SkBitmap subsetBitmap;
+    SkIRect subset;
 
-        PrintState();
-        switch(iState)
+    if (bArmTileIndex)
         {
-            case STATE_IDLE:
-                    {
-                        if (iLastState == STATE_LOADED)
-                            {
-                            LIBSKIAHW_LOGDA("Entered STATE_IDLE in switch - iLastState = STATE_LOADED\n\n");
-                            eError = OMX_SendCommand(pOMXHandle,OMX_CommandStateSet, OMX_StateExecuting, NULL);
-                            if ( eError != OMX_ErrorNone )
-                                {
-                                LIBSKIAHW_LOGEA("eError from SendCommand-Executing State function\n");
-                                iState = STATE_ERROR;
-                                break;
-                                }
-                            }
-                        else if ((iLastState == STATE_EMPTY_BUFFER_DONE_CALLED) || (iLastState==STATE_FILL_BUFFER_DONE_CALLED))
-                            {
-                            LIBSKIAHW_LOGDA("Entered STATE_IDLE in switch - iLastState = STATE_EMPTY_BUFFER_DONE_CALLED\n\n");
-
-                            eError = OMX_SendCommand(pOMXHandle, OMX_CommandPortDisable, 0x0, NULL);
-                            if ( eError != OMX_ErrorNone )
-                                {
-                                LIBSKIAHW_LOGEA("Error from SendCommand-PortDisable function. Input port.\n");
-                                iState = STATE_ERROR;
-                                break;
-                                }
-
-                            eError = OMX_SendCommand(pOMXHandle, OMX_CommandPortDisable, 0x1, NULL);
-                            if ( eError != OMX_ErrorNone )
-                                {
-                                LIBSKIAHW_LOGEA("Error from SendCommand-PortDisable function. Output port.\n");
-                                iState = STATE_ERROR;
-                                break;
-                                }
-
-                            /* Free buffers */
-                            eError = OMX_FreeBuffer(pOMXHandle, InPortDef.nPortIndex, pInBuffHead);
-                            if ( eError != OMX_ErrorNone )
-                                {
-                                LIBSKIAHW_LOGEA("Error from OMX_FreeBuffer. Input port.\n");
-                                iState = STATE_ERROR;
-                                break;
-                                }
-
-                            eError = OMX_FreeBuffer(pOMXHandle, OutPortDef.nPortIndex, pOutBuffHead);
-                            if ( eError != OMX_ErrorNone )
-                                {
-                                LIBSKIAHW_LOGEA("Error from OMX_FreeBuffer. Output port.\n");
-                                iState = STATE_ERROR;
-                                break;
-                                }
-
-                         eError = OMX_SendCommand(pOMXHandle,OMX_CommandStateSet, OMX_StateLoaded, NULL);
-                            if ( eError != OMX_ErrorNone )
-                                {
-                                LIBSKIAHW_LOGEA("Error from SendCommand-Idle State function\n");
-                                iState = STATE_ERROR;
-                                break;
-                                }
-                            break;
-                            }
-                        else
-                            {
-                            LIBSKIAHW_LOGDB("Entered STATE_IDLE in switch - iLastState = %d\n\n", iLastState);
-                            iState = STATE_ERROR;
-                            }
-                        break;
-                    }
-
-            case STATE_EXECUTING:
-                    {
-                        LIBSKIAHW_LOGDA("\nOMX Component in executing state, queuing the input and output buffers\n");
-                        TIMM_OSAL_Memset (pInBuffHead->pBuffer, 0, InPortDef.nBufferSize);
-                        TIMM_OSAL_Memset (pOutBuffHead->pBuffer, 0XFF, OutPortDef.nBufferSize);
-
-                        inStream->rewind();
-                        nRead = fill_data(pInBuffHead, inStream, pInBuffHead->nAllocLen);
-
-                        pInBuffHead->nFlags = OMX_BUFFERFLAG_EOS;
-                        pInBuffHead->nInputPortIndex = OMX_JPEGD_TEST_INPUT_PORT;
-                        pInBuffHead->nAllocLen = pInBuffHead->nFilledLen;
-                        pInBuffHead->nOffset = 0;
-
-                        if(pBeforeDecodeTime) {
-                            delete pBeforeDecodeTime;
-                            pBeforeDecodeTime = NULL;
-                        }
-
-                        pDecodeTime=new AutoTimeMillis("BufferDecode Time");
-                        OMX_EmptyThisBuffer(pOMXHandle, pInBuffHead);
-
-                        pOutBuffHead->nOutputPortIndex = OMX_JPEGD_TEST_OUTPUT_PORT;
-                        OMX_FillThisBuffer(pOMXHandle, pOutBuffHead);
-                        LIBSKIAHW_LOGDA("\nQueued input and output buffers to the component\n");
-                        break;
-                }
-
-            case STATE_EMPTY_BUFFER_DONE_CALLED:
-            case STATE_FILL_BUFFER_DONE_CALLED:
-                    {
-
-                        pAfterDecodeTime=new AutoTimeMillis("After_BufferDecode Time");
-
-                        ///@todo make this logic cleaner - should be waiting for both EBD and FBD to arrive
-                        ///        Put this function under mutex so that state variables are not raced
-                        LIBSKIAHW_LOGDA("\nProcessing empty buffer done or fill buffer done state, sending component to idle state\n");
-                        eError = OMX_SendCommand(pOMXHandle,OMX_CommandStateSet, OMX_StateIdle, NULL);
-                        if ( eError != OMX_ErrorNone ) {
-                            LIBSKIAHW_LOGEA("Error from SendCommand-Idle(nStop) State function\n");
-                            iState = STATE_ERROR;
-                        }
-                        break;
-                }
-
-            case STATE_LOADED:
-            case STATE_ERROR:
-                    {
-                        /*### Assume that the inStream will be closed by some upper layer */
-                        /*### Assume that the Bitmap object/file need not be closed. */
-                        /*### More needs to be done here */
-                        /*### Do different things based on iLastState */
-            if ( iState == STATE_ERROR ) {
-                if (pInBuffHead != NULL) {
-                    /* Free buffers if it got allocated */
-                    eError = OMX_FreeBuffer(pOMXHandle, InPortDef.nPortIndex, pInBuffHead);
-                    if ( eError != OMX_ErrorNone ) {
-                        LIBSKIAHW_LOGEA("Error from OMX_FreeBuffer. Input port.\n");
-                    }
-                }
-                if (pOutBuffHead != NULL) {
-                    eError = OMX_FreeBuffer(pOMXHandle, OutPortDef.nPortIndex, pOutBuffHead);
-                    if ( eError != OMX_ErrorNone ) {
-                        LIBSKIAHW_LOGEA("Error from OMX_FreeBuffer. Output port.\n");
-                    }
-                }
+        if (!GetArmDecoder(&pARMHandle))
+            {
+            return false;
             }
 
-                        iState = STATE_EXIT;
-                        sem_post(semaphore);
-
-                        if(pAfterDecodeTime) {
-                            delete pAfterDecodeTime;
-                            pAfterDecodeTime = NULL;
-                        }
-
-                        break;
-                }
-
-            default:
-                break;
+        LOG_FUNCTION_NAME_EXIT
+        return pARMHandle->decodeRegion(bm, rect, this->getPrefConfig(k32Bit_SrcDepth, false));
         }
 
-        if (iState == STATE_EXIT)
-            {
-            break;
-            }
+    if (!rect.intersect(0, 0, tileIndex.width(), tileIndex.height()) ||
+            !tileIndex.locate(rect.fLeft, rect.fTop, rect.fRight, rect.fBottom, &tile))
+        {
+        LIBSKIAHW_LOGEA("Region outside of the image or no tile index\n");
+        return false;
         }
-    LOG_FUNCTION_NAME_EXIT
-    }
 
-///@optimization Use one global instance of decoder so that we don't have to call OMX_GetHandle, OMX_FreeHandle every time
-static SkTIJPEGImageDecoder gJpegDecoder;
+    LIBSKIAHW_LOGDB("Region %dx%d decoded from tile %dx%d\n", rect.width(), rect.height(), tile.width, tile.height);
 
-///Wrapper class which will be created every time by the factory method.
-///This class wraps the handle to the global singleton jpeg decoder instance
-class SkJPEGTIImageDecoderWrapper : public SkImageDecoder {
-public:
-    SkJPEGTIImageDecoderWrapper(SkImageDecoder* ptr)
+    SkAutoMalloc tileData(tile.size);
+    tileIndex.write(tile, (uint8_t*)tileData.get());
+    SkMemoryStream tileStream(tileData.get(), tile.size);
+
+    {
+#ifdef TIME_DECODE
+    AutoTimeMillis atm("Tile Decode");
+    atm.setResolution(tile.width, tile.height);
+#endif
+
+    if (!this->onDecode(&tileStream, &tileBitmap, SkImageDecoder::kDecodePixels_Mode))
         {
-        mPtr = ptr;
+        LIBSKIAHW_LOGEA("Tile decode failed\n");
+        return false;
         }
-    virtual Format getFormat() const {
-        return kJPEG_Format;
     }
 
-protected:
-    virtual bool onDecode(SkStream* stream, SkBitmap* bm,
-                          Mode mode)
+    // The tile may be downscaled by other than sampleSize, depending on the decoder that ran
+    subset.set((rect.fLeft - tile.x) * tileBitmap.width() / tile.width,
+               (rect.fTop - tile.y) * tileBitmap.height() / tile.height,
+               (rect.fRight - tile.x) * tileBitmap.width() / tile.width,
+               (rect.fBottom - tile.y) * tileBitmap.height() / tile.height);
+    if (!subset.intersect(0, 0, tileBitmap.width(), tileBitmap.height()) ||
+            !tileBitmap.extractSubset(&subsetBitmap, subset))
         {
-            mPtr->setSampleSize(this->getSampleSize());
-            mPtr->setDitherImage(this->getDitherImage());
-            mPtr->SetDeviceConfig(this->GetDeviceConfig());
-            return mPtr->decode(stream, bm, mode);
+        LIBSKIAHW_LOGEA("Region smaller than a pixel at this sample size\n");
+        return false;
         }
-public:
-    SkImageDecoder *mPtr;
-};
+
+    LOG_FUNCTION_NAME_EXIT
+    return subsetBitmap.copyTo(bm, subsetBitmap.config(), this->getAllocator());
+    }
 
 ///LIBSKIAHW Factory method
 extern "C" SkImageDecoder* SkImageDecoder_HWJPEG_Factory() {
-    return new SkJPEGTIImageDecoderWrapper(&gJpegDecoder);
+    return SkNEW(SkTIJPEGImageDecoder);
 }
 
-
@@ -29,6 +29,9 @@
 #include "SkBitmap.h"
 #include "SkStream.h"
 #include "SkAllocator.h"
+#include "JpegHeaderParser.h"
+#include "JpegDecoderPool.h"
+#include "JpegTileIndex.h"
 #include "SkImageDecoder.h"
 #include <stdio.h>
 #include <string.h>
@@ -52,10 +55,6 @@ extern "C" {
 };
 
 
-namespace android {
-    Mutex       gTIJpegDecMutex;
-}; //namespace android
-
 ///LIBSKIAHW Logging Functions
 #define ENABLE_LOGD
 #ifdef ENABLE_LOGD
@@ -160,7 +159,7 @@ typedef struct MP_FIELDS_SUPPORTED
 {
     OMX_U32     MPFVersion;
     OMX_U8     numberOfImages;
-    MP_ENTRY*    MPEntry; //Image UIDList not supported for nows
+    MP_ENTRY    MPEntry[JpegHeaderParser::MAX_MP_ENTRIES]; //Image UIDList not supported for nows
     OMX_U8     totalFrames;
     OMX_U8     MPIndividualNum;
     OMX_U8     panOrientation;
@@ -196,20 +195,11 @@ class SkTIJPEGImageDecoder :public SkImageDecoder
 {
 protected:
     virtual bool onDecode(SkStream* stream, SkBitmap* bm, Mode);
+    virtual bool onBuildTileIndex(SkStream* stream, int *width, int *height);
+    virtual bool onDecodeRegion(SkBitmap* bitmap, SkIRect rect);
 
 public:
 
-    enum JPEGDEC_State
-    {
-        STATE_LOADED, // 0
-        STATE_IDLE, // 1
-        STATE_EXECUTING, // 2
-        STATE_FILL_BUFFER_DONE_CALLED, // 3
-        STATE_EMPTY_BUFFER_DONE_CALLED, // 4
-        STATE_ERROR, // 5
-        STATE_EXIT // 6
-    };
-
     typedef struct JpegDecoderParams
     {
         // Quatization Table
@@ -222,14 +212,6 @@ public:
     ~SkTIJPEGImageDecoder();
     bool SetJpegDecodeParameters(JpegDecoderParams * jdp) {memcpy(&jpegDecParams, jdp, sizeof(JpegDecoderParams)); return true;}
     virtual Format getFormat() const { return kJPEG_Format; }
-    void Run();
-    void PrintState();
-    void FillBufferDone(OMX_U8* pBuffer, OMX_U32 nFilledLen);
-    void EventHandler(OMX_HANDLETYPE hComponent,
-                                        OMX_EVENTTYPE eEvent,
-                                        OMX_U32 nData1,
-                                        OMX_U32 nData2,
-                                        OMX_PTR pEventData);
 
 private:
 
@@ -255,6 +237,24 @@ private:
         S3D_SS_BOTH = 0x3, // misc flags = 0x03
     };
 
+    /* One image of an MPO file, decoded straight into its part of the stereo buffer */
+    typedef struct MPO_VIEW {
+        const OMX_U8* pData;
+        size_t nSize;
+        SkBitmap bitmap;
+        TIS3DViewAllocator allocator;
+    } MPO_VIEW;
+
+    /* Every other view of an MPO file, starting at nFirst */
+    typedef struct MPO_DECODE_JOB {
+        SkJPEGImageDecoder *pDecoder;
+        MPO_VIEW *pViews;
+        int nFirst;
+        int nViews;
+        SkImageDecoder::Mode mode;
+        bool bResult;
+    } MPO_DECODE_JOB;
+
     typedef struct JPEG_HEADER_INFO {
         int nWidth;
         int nHeight ;
@@ -264,39 +264,34 @@ private:
         MP_FIELDS_SUPPORTED MPIndexIFDTags;//S3D
     } JPEG_HEADER_INFO;
 
-        OMX_HANDLETYPE pOMXHandle;
         SkJPEGImageDecoder *pARMHandle;
-        AutoTimeMillis *pDecodeTime, *pBeforeDecodeTime, *pAfterDecodeTime;
-        OMX_BUFFERHEADERTYPE *pInBuffHead;
-        OMX_BUFFERHEADERTYPE *pOutBuffHead;
-        OMX_PARAM_PORTDEFINITIONTYPE InPortDef;
-        OMX_PARAM_PORTDEFINITIONTYPE OutPortDef;
+        SkJPEGImageDecoder *pARMViewHandle; // second MPO view decoder, runs on its own thread
         JpegDecoderParams jpegDecParams;
-        SkStream* inStream;
-        SkBitmap* bitmap;
         TIHeapAllocator allocator;
 
         TIS3DHeapAllocator S3DAllocator;
         int fileType;
         size_t finalBytesRead;
+        JpegHeaderParser headerParser;
+
+        SkMemoryStream *pTileStream;    // whole file, kept by buildTileIndex for decodeRegion
+        JpegTileIndex tileIndex;
+        bool bArmTileIndex;             // the ARM decoder indexed the file instead
 
-    OMX_S16 GetYUVformat(OMX_U8 * Data);
-    OMX_S16 Get16m(const void * Short);
-    void BigEndianRead32Bits(OMX_U32 *pVal,OMX_U8* ptr);
-    void BigEndianRead16Bits(OMX_U16 *pVal,OMX_U8* ptr);
+    OMX_S16 GetYUVformat(const JpegHeaderParser::Frame* frame);
     OMX_S32 ParseJpegHeader (SkStream* stream, JPEG_HEADER_INFO* JpegHeaderInfo);
-    OMX_S32 fill_data(OMX_BUFFERHEADERTYPE *pBuf, SkStream* stream, OMX_S32 bufferSize);
+    OMX_S32 fill_data(OMX_U8* pBuffer, SkStream* stream, OMX_S32 bufferSize);
     void FixFrameSize(JPEG_HEADER_INFO* JpegHeaderInfo);
     bool IsHwFormat(SkStream* stream);
-    bool IsHwAvailable();
     bool onDecodeOmx(SkStream* stream, SkBitmap* bm, Mode);
     bool onDecodeArm(SkStream* stream, SkBitmap* bm, Mode);
-    bool isValidStream(SkStream* stream, int nextFileOffset);
+    bool onDecodeMpo(SkStream* stream, SkBitmap* bm, Mode);
+    void ResetTileIndex();
+    SkJPEGImageDecoder* GetArmDecoder(SkJPEGImageDecoder** handle);
+    static bool DecodeMpoViews(MPO_DECODE_JOB* job);
+    static void* MpoDecodeThread(void* job);
 
 public:
-    sem_t *semaphore;
-    JPEGDEC_State iState;
-    JPEGDEC_State iLastState;
     JPEG_HEADER_INFO JpegHeaderInfo;
     OMX_S32 inputFileSize;
 
@@ -352,12 +347,4 @@ typedef struct OMX_CUSTOM_RESOLUTION
 
 
 
-OMX_ERRORTYPE OMX_FillBufferDone (OMX_HANDLETYPE hComponent, OMX_PTR ptr, OMX_BUFFERHEADERTYPE* pBuffHead);
-OMX_ERRORTYPE OMX_EmptyBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR ptr, OMX_BUFFERHEADERTYPE* pBuffer);
-OMX_ERRORTYPE OMX_EventHandler(OMX_HANDLETYPE hComponent,
-                                            OMX_PTR pAppData,
-                                            OMX_EVENTTYPE eEvent,
-                                            OMX_U32 nData1,
-                                            OMX_U32 nData2,
-                                            OMX_PTR pEventData);
 
@@ -777,14 +777,7 @@ int runJPEGDecoderTest(int argc, char** argv) {
     flagCodecType = findJPGDType(&inStream);
 
 #ifdef TARGET_OMAP4
-    if( CODECTYPE_SIMCOP == flagCodecType ) {
-        if( bSubRegDecFlag ){
-            //TBD:Implement the subregion decode parameter setting for SIMCOP JPEG decoder here.
-            PRINT("%s():%d:: !!!! Currently SIMCOP JPEG Decoder is not fully functional...\n",__FUNCTION__,__LINE__);
-            PRINT("%s():%d:: !!!! Select SW JPG decoder and run subregion decode tests.\n",__FUNCTION__,__LINE__);
-            return FAIL;
-        }
-    }
+    //libskiahw decodes subregions through its tile index, on SIMCOP or on the SW decoder
 
 #else  //OMAP3
     if( CODECTYPE_DSP == flagCodecType ) {
@@ -800,8 +793,8 @@ int runJPEGDecoderTest(int argc, char** argv) {
     AutoTimeMicros atm("Decode Time Measurement:");
 #endif
 
-    //gingerbread- SW(ARM) subregion decode supported
-    if( CODECTYPE_SW == flagCodecType && bSubRegDecFlag ){
+    //gingerbread- SW(ARM) and OMAP4 libskiahw subregion decode supported
+    if( CODECTYPE_DSP != flagCodecType && bSubRegDecFlag ){
         int ht = 0, wd = 0;
 
         if( skJpegDec->buildTileIndex(&inStream, &wd, &ht) == false ) {
@@ -817,7 +810,7 @@ int runJPEGDecoderTest(int argc, char** argv) {
             return FAIL;
         }
     }
-    else {  //if !(CODECTYPE_SW == flagCodecType && bSubRegDecFlag )
+    else {  //if !(CODECTYPE_DSP != flagCodecType && bSubRegDecFlag )
 
         /*call decode*/
         if (skJpegDec->decode(&inStream, &skBM, prefConfig, SkImageDecoder::kDecodePixels_Mode) == false) {